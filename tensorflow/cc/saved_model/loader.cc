@@ -15,10 +15,17 @@ limitations under the License.
 
 #include "tensorflow/cc/saved_model/loader.h"
 
+#include <algorithm>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "tensorflow/cc/saved_model/constants.h"
 #include "tensorflow/cc/saved_model/reader.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/tensor_id.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/monitoring/counter.h"
 #include "tensorflow/core/lib/monitoring/sampler.h"
@@ -257,14 +264,431 @@ Status GetAssetFileDefs(const MetaGraphDef& meta_graph_def,
   return Status::OK();
 }
 
+bool IsVariableOp(const NodeDef& node) {
+  return node.op() == "VariableV2" || node.op() == "Variable" ||
+         node.op() == "VarHandleOp";
+}
+
+void AddTensorInfoNodes(const TensorInfo& tensor_info,
+                        std::vector<string>* nodes) {
+  switch (tensor_info.encoding_case()) {
+    case TensorInfo::kName:
+      nodes->push_back(string(ParseTensorName(tensor_info.name()).node()));
+      break;
+    case TensorInfo::kCooSparse:
+      for (const string& name : {tensor_info.coo_sparse().values_tensor_name(),
+                                 tensor_info.coo_sparse().indices_tensor_name(),
+                                 tensor_info.coo_sparse()
+                                     .dense_shape_tensor_name()}) {
+        nodes->push_back(string(ParseTensorName(name).node()));
+      }
+      break;
+    case TensorInfo::kCompositeTensor:
+      for (const TensorInfo& component :
+           tensor_info.composite_tensor().components()) {
+        AddTensorInfoNodes(component, nodes);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Returns the nodes that are needed to serve the SignatureDef
+// `signature_def_key`: its inputs and outputs, the init op, and the nodes
+// that the loader feeds.
+Status GetSignatureRoots(const string& export_dir,
+                         const MetaGraphDef& meta_graph_def,
+                         const string& signature_def_key,
+                         std::vector<string>* roots) {
+  const auto signature_it =
+      meta_graph_def.signature_def().find(signature_def_key);
+  if (signature_it == meta_graph_def.signature_def().end()) {
+    return errors::NotFound("Could not find SignatureDef with key: ",
+                            signature_def_key, " in: ", export_dir);
+  }
+  for (const auto& input : signature_it->second.inputs()) {
+    AddTensorInfoNodes(input.second, roots);
+  }
+  for (const auto& output : signature_it->second.outputs()) {
+    AddTensorInfoNodes(output.second, roots);
+  }
+
+  string init_op_name;
+  TF_RETURN_IF_ERROR(GetInitOp(export_dir, meta_graph_def, &init_op_name));
+  if (!init_op_name.empty()) {
+    roots->push_back(string(ParseTensorName(init_op_name).node()));
+  }
+  std::vector<AssetFileDef> asset_file_defs;
+  TF_RETURN_IF_ERROR(GetAssetFileDefs(meta_graph_def, &asset_file_defs));
+  for (const AssetFileDef& asset_file_def : asset_file_defs) {
+    AddTensorInfoNodes(asset_file_def.tensor_info(), roots);
+  }
+  const string& filename_tensor_name =
+      meta_graph_def.saver_def().filename_tensor_name();
+  if (!filename_tensor_name.empty()) {
+    roots->push_back(string(ParseTensorName(filename_tensor_name).node()));
+  }
+  return Status::OK();
+}
+
+// Returns the names of the nodes of `graph` in the transitive fanin of
+// `roots`, including the roots themselves.
+std::unordered_set<string> FaninClosure(const GraphDef& graph,
+                                        const std::vector<string>& roots) {
+  std::unordered_map<string, const NodeDef*> nodes;
+  for (const NodeDef& node : graph.node()) nodes[node.name()] = &node;
+  std::unordered_set<string> closure;
+  std::vector<string> stack(roots);
+  while (!stack.empty()) {
+    const string name = stack.back();
+    stack.pop_back();
+    auto it = nodes.find(name);
+    if (it == nodes.end() || !closure.insert(name).second) continue;
+    for (const string& input : it->second->input()) {
+      stack.push_back(string(ParseTensorName(input).node()));
+    }
+  }
+  return closure;
+}
+
+// Removes the nodes of `graph` that aren't in the transitive fanin of
+// `roots`, and the functions that the remaining nodes don't call.
+void PruneGraph(const std::vector<string>& roots, GraphDef* graph) {
+  const std::unordered_set<string> kept = FaninClosure(*graph, roots);
+  GraphDef pruned;
+  for (NodeDef& node : *graph->mutable_node()) {
+    if (kept.count(node.name()) > 0) pruned.add_node()->Swap(&node);
+  }
+  graph->mutable_node()->Swap(pruned.mutable_node());
+  const FunctionLibraryDefinition flib(OpRegistry::Global(), graph->library());
+  *graph->mutable_library() = flib.ReachableDefinitions(*graph).ToProto();
+}
+
+// Removes the tensors that no node uses from the RestoreV2 ops of `graph`, so
+// that running them doesn't read these tensors from the checkpoint.
+void PruneRestoreV2Ops(GraphDef* graph) {
+  std::unordered_map<string, NodeDef*> nodes;
+  std::unordered_map<string, std::vector<std::pair<NodeDef*, int>>> fanouts;
+  for (NodeDef& node : *graph->mutable_node()) {
+    nodes[node.name()] = &node;
+    for (int i = 0; i < node.input_size(); ++i) {
+      const TensorId id = ParseTensorName(node.input(i));
+      fanouts[string(id.node())].emplace_back(&node, i);
+    }
+  }
+  auto find_string_constant = [&](const string& input, Tensor* value) {
+    auto it = nodes.find(string(ParseTensorName(input).node()));
+    if (it == nodes.end() || it->second->op() != "Const" ||
+        fanouts[it->first].size() != 1) {
+      return static_cast<NodeDef*>(nullptr);
+    }
+    const auto value_it = it->second->attr().find("value");
+    if (value_it == it->second->attr().end() ||
+        !value->FromProto(value_it->second.tensor()) ||
+        value->dtype() != DT_STRING || value->dims() != 1) {
+      return static_cast<NodeDef*>(nullptr);
+    }
+    return it->second;
+  };
+
+  for (NodeDef& restore : *graph->mutable_node()) {
+    if (restore.op() != "RestoreV2" || restore.input_size() < 3) continue;
+    Tensor names, slices;
+    NodeDef* names_node = find_string_constant(restore.input(1), &names);
+    NodeDef* slices_node = find_string_constant(restore.input(2), &slices);
+    auto dtypes = restore.mutable_attr()->find("dtypes");
+    if (names_node == nullptr || slices_node == nullptr ||
+        dtypes == restore.mutable_attr()->end()) {
+      continue;
+    }
+    const int num_tensors = dtypes->second.list().type_size();
+    if (names.NumElements() != num_tensors ||
+        slices.NumElements() != num_tensors) {
+      continue;
+    }
+
+    std::vector<int> new_indices(num_tensors, -1);
+    bool valid = true;
+    for (const auto& fanout : fanouts[restore.name()]) {
+      const string& input = fanout.first->input(fanout.second);
+      const TensorId id = ParseTensorName(input);
+      if (IsTensorIdControl(id)) continue;
+      const int port = id.index();
+      if (port >= num_tensors) {
+        valid = false;
+        break;
+      }
+      new_indices[port] = 0;
+    }
+    int num_used = 0;
+    for (int& index : new_indices) {
+      if (index == 0) index = num_used++;
+    }
+    if (!valid || num_used == num_tensors) continue;
+
+    Tensor new_names(DT_STRING, TensorShape({num_used}));
+    Tensor new_slices(DT_STRING, TensorShape({num_used}));
+    AttrValue new_dtypes;
+    for (int i = 0; i < num_tensors; ++i) {
+      if (new_indices[i] < 0) continue;
+      new_names.vec<tstring>()(new_indices[i]) = names.vec<tstring>()(i);
+      new_slices.vec<tstring>()(new_indices[i]) = slices.vec<tstring>()(i);
+      new_dtypes.mutable_list()->add_type(dtypes->second.list().type(i));
+    }
+    new_names.AsProtoTensorContent(
+        (*names_node->mutable_attr())["value"].mutable_tensor());
+    new_slices.AsProtoTensorContent(
+        (*slices_node->mutable_attr())["value"].mutable_tensor());
+    dtypes->second = new_dtypes;
+    restore.mutable_attr()->erase("_output_shapes");
+    for (const auto& fanout : fanouts[restore.name()]) {
+      const string& input = fanout.first->input(fanout.second);
+      const TensorId id = ParseTensorName(input);
+      if (IsTensorIdControl(id)) continue;
+      const int index = new_indices[id.index()];
+      fanout.first->set_input(
+          fanout.second, index == 0
+                             ? restore.name()
+                             : strings::StrCat(restore.name(), ":", index));
+    }
+  }
+}
+
+// Returns true if `node` assigns a value to one of the variables in `nodes`.
+bool IsVariableAssign(const NodeDef& node,
+                      const std::unordered_map<string, const NodeDef*>& nodes) {
+  if ((node.op() != "Assign" && node.op() != "AssignVariableOp") ||
+      node.input_size() == 0) {
+    return false;
+  }
+  const auto it = nodes.find(string(ParseTensorName(node.input(0)).node()));
+  return it != nodes.end() && IsVariableOp(*it->second);
+}
+
+// Prunes the graph of `meta_graph_def` to the nodes needed to serve the
+// SignatureDef `signature_def_key`, and its restore op to the variables that
+// remain, and drops the other SignatureDefs.
+Status PruneMetaGraphDefToSignature(const string& export_dir,
+                                    const string& signature_def_key,
+                                    MetaGraphDef* meta_graph_def) {
+  std::vector<string> roots;
+  TF_RETURN_IF_ERROR(GetSignatureRoots(export_dir, *meta_graph_def,
+                                       signature_def_key, &roots));
+  GraphDef* graph = meta_graph_def->mutable_graph_def();
+  const std::unordered_set<string> serving_nodes = FaninClosure(*graph, roots);
+
+  std::unordered_map<string, const NodeDef*> nodes;
+  for (const NodeDef& node : graph->node()) nodes[node.name()] = &node;
+  const string restore_op_name(
+      ParseTensorName(meta_graph_def->saver_def().restore_op_name()).node());
+  const auto restore_op = nodes.find(restore_op_name);
+  if (restore_op != nodes.end()) {
+    // Restore only the variables that serving uses, if the restore op assigns
+    // the variables directly.
+    const std::unordered_set<string> restore_nodes =
+        FaninClosure(*graph, {restore_op_name});
+    std::vector<string> kept_assigns;
+    int num_assigns = 0;
+    for (const NodeDef& node : graph->node()) {
+      if (restore_nodes.count(node.name()) == 0 ||
+          !IsVariableAssign(node, nodes)) {
+        continue;
+      }
+      ++num_assigns;
+      const string variable(ParseTensorName(node.input(0)).node());
+      if (serving_nodes.count(variable) > 0) {
+        kept_assigns.push_back(node.name());
+      }
+    }
+    if (static_cast<int>(kept_assigns.size()) < num_assigns) {
+      string name = strings::StrCat(restore_op_name, "_", signature_def_key);
+      for (int i = 1; nodes.count(name) > 0; ++i) {
+        name = strings::StrCat(restore_op_name, "_", signature_def_key, "_", i);
+      }
+      NodeDef new_restore_op;
+      new_restore_op.set_name(name);
+      new_restore_op.set_op("NoOp");
+      new_restore_op.set_device(restore_op->second->device());
+      for (const string& assign : kept_assigns) {
+        new_restore_op.add_input(strings::StrCat("^", assign));
+      }
+      *graph->add_node() = std::move(new_restore_op);
+      meta_graph_def->mutable_saver_def()->set_restore_op_name(name);
+      roots.push_back(name);
+    } else {
+      roots.push_back(restore_op_name);
+    }
+  }
+
+  PruneGraph(roots, graph);
+  PruneRestoreV2Ops(graph);
+  PruneGraph(roots, graph);
+
+  auto* signatures = meta_graph_def->mutable_signature_def();
+  for (auto it = signatures->begin(); it != signatures->end();) {
+    if (it->first != signature_def_key &&
+        it->first != kSavedModelInitOpSignatureKey) {
+      it = signatures->erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return Status::OK();
+}
+
+// Turns `node` into a constant with value `value`, keeping its name, device,
+// control inputs and colocation constraints.
+void ReplaceWithConstant(const Tensor& value, NodeDef* node) {
+  std::vector<string> control_inputs;
+  for (const string& input : node->input()) {
+    if (IsTensorIdControl(ParseTensorName(input))) {
+      control_inputs.push_back(input);
+    }
+  }
+  node->clear_input();
+  for (const string& input : control_inputs) node->add_input(input);
+
+  AttrValue colocation;
+  const auto colocation_it = node->attr().find(kColocationAttrName);
+  const bool has_colocation = colocation_it != node->attr().end();
+  if (has_colocation) colocation = colocation_it->second;
+  node->clear_attr();
+  if (has_colocation) (*node->mutable_attr())[kColocationAttrName] = colocation;
+
+  node->set_op("Const");
+  (*node->mutable_attr())["dtype"].set_type(value.dtype());
+  value.AsProtoTensorContent((*node->mutable_attr())["value"].mutable_tensor());
+}
+
+// Replaces the variables that serving the SignatureDef `signature_def_key`
+// only reads with constants that hold their values in `session`, so that
+// Grappler's constant folding can fold them into the computations that use
+// them. The variables that are also written are kept, and only these are
+// restored by the restore op of `frozen`. Sets `changed` to false if no
+// variable can be frozen.
+Status FreezeReadOnlyVariables(const RunOptions& run_options,
+                               const string& export_dir,
+                               const string& signature_def_key,
+                               const MetaGraphDef& meta_graph_def,
+                               Session* session, MetaGraphDef* frozen,
+                               bool* changed) {
+  *changed = false;
+  std::vector<string> roots;
+  TF_RETURN_IF_ERROR(GetSignatureRoots(export_dir, meta_graph_def,
+                                       signature_def_key, &roots));
+  const GraphDef& graph = meta_graph_def.graph_def();
+  const std::unordered_set<string> serving_nodes = FaninClosure(graph, roots);
+  std::unordered_map<string, std::vector<std::pair<const NodeDef*, int>>>
+      fanouts;
+  for (const NodeDef& node : graph.node()) {
+    if (serving_nodes.count(node.name()) == 0) continue;
+    for (int i = 0; i < node.input_size(); ++i) {
+      const TensorId id = ParseTensorName(node.input(i));
+      if (IsTensorIdControl(id)) continue;
+      fanouts[string(id.node())].emplace_back(&node, i);
+    }
+  }
+
+  // Reference variables are read by the ops that take them as non-reference
+  // inputs, and resource variables by ReadVariableOp. Both are replaced with
+  // a constant: the former by the variable, the latter by each read.
+  // Variables read inside functions, as in SavedModels exported by TF2, are
+  // used by function calls and are never frozen.
+  std::unordered_set<string> frozen_variables;
+  std::unordered_map<string, int> fetch_indices;
+  std::vector<string> fetches;
+  for (const NodeDef& node : graph.node()) {
+    if (serving_nodes.count(node.name()) == 0 || !IsVariableOp(node)) {
+      continue;
+    }
+    const bool is_resource = node.op() == "VarHandleOp";
+    bool is_read_only = true;
+    std::vector<string> reads;
+    for (const auto& fanout : fanouts[node.name()]) {
+      const NodeDef& consumer = *fanout.first;
+      if (is_resource) {
+        is_read_only = consumer.op() == "ReadVariableOp";
+        reads.push_back(consumer.name());
+      } else {
+        const OpDef* op_def;
+        DataType type;
+        is_read_only =
+            OpRegistry::Global()->LookUpOpDef(consumer.op(), &op_def).ok() &&
+            InputTypeForNode(consumer, *op_def, fanout.second, &type).ok() &&
+            !IsRefType(type);
+      }
+      if (!is_read_only) break;
+    }
+    if (!is_read_only) continue;
+    frozen_variables.insert(node.name());
+    if (!is_resource) reads = {node.name()};
+    for (const string& read : reads) {
+      fetch_indices[read] = fetches.size();
+      fetches.push_back(strings::StrCat(read, ":0"));
+    }
+  }
+  if (frozen_variables.empty()) return Status::OK();
+
+  std::vector<Tensor> values;
+  if (!fetches.empty()) {
+    RunMetadata run_metadata;
+    TF_RETURN_IF_ERROR(RunOnce(run_options, {}, fetches, {}, &values,
+                               &run_metadata, session));
+  }
+
+  *frozen = meta_graph_def;
+  GraphDef* frozen_graph = frozen->mutable_graph_def();
+  std::unordered_map<string, const NodeDef*> nodes;
+  for (const NodeDef& node : graph.node()) nodes[node.name()] = &node;
+  // The frozen variables must not be restored anymore.
+  std::unordered_set<string> removed;
+  for (const NodeDef& node : graph.node()) {
+    if (!IsVariableAssign(node, nodes)) continue;
+    const string variable(ParseTensorName(node.input(0)).node());
+    if (frozen_variables.count(variable) > 0) removed.insert(node.name());
+  }
+  GraphDef rewritten;
+  for (NodeDef& node : *frozen_graph->mutable_node()) {
+    if (removed.count(node.name()) > 0) continue;
+    NodeDef* new_node = rewritten.add_node();
+    new_node->Swap(&node);
+    const auto fetch = fetch_indices.find(new_node->name());
+    if (fetch != fetch_indices.end()) {
+      ReplaceWithConstant(values[fetch->second], new_node);
+    }
+    auto* inputs = new_node->mutable_input();
+    inputs->erase(std::remove_if(inputs->begin(), inputs->end(),
+                                 [&removed](const string& input) {
+                                   const TensorId id = ParseTensorName(input);
+                                   return IsTensorIdControl(id) &&
+                                          removed.count(string(id.node())) > 0;
+                                 }),
+                  inputs->end());
+  }
+  frozen_graph->mutable_node()->Swap(rewritten.mutable_node());
+  TF_RETURN_IF_ERROR(
+      PruneMetaGraphDefToSignature(export_dir, signature_def_key, frozen));
+  LOG(INFO) << "Froze " << frozen_variables.size()
+            << " read-only variables for SignatureDef " << signature_def_key;
+  *changed = true;
+  return Status::OK();
+}
+
 Status LoadSavedModelInternal(const SessionOptions& session_options,
                               const RunOptions& run_options,
                               const string& export_dir,
                               const std::unordered_set<string>& tags,
+                              const string& signature_def_key,
+                              bool freeze_variables,
                               SavedModelBundle* const bundle) {
   const uint64 read_start_microseconds = Env::Default()->NowMicros();
   TF_RETURN_IF_ERROR(ReadMetaGraphDefFromSavedModel(export_dir, tags,
                                                     &bundle->meta_graph_def));
+  if (!signature_def_key.empty()) {
+    TF_RETURN_IF_ERROR(PruneMetaGraphDefToSignature(
+        export_dir, signature_def_key, &bundle->meta_graph_def));
+  }
 
   TF_RETURN_IF_ERROR(LoadMetaGraphIntoSession(
       bundle->meta_graph_def, session_options, &bundle->session));
@@ -277,6 +701,42 @@ Status LoadSavedModelInternal(const SessionOptions& session_options,
                  bundle->meta_graph_def.saver_def().restore_op_name(),
                  bundle->meta_graph_def.saver_def().filename_tensor_name(),
                  asset_file_defs, bundle->session.get()));
+  if (freeze_variables) {
+    MetaGraphDef frozen;
+    bool changed;
+    const Status s = FreezeReadOnlyVariables(
+        run_options, export_dir, signature_def_key, bundle->meta_graph_def,
+        bundle->session.get(), &frozen, &changed);
+    if (!s.ok()) {
+      LOG(WARNING) << "Not freezing the variables of SignatureDef "
+                   << signature_def_key << ": " << s;
+    } else if (changed) {
+      // Switch to a session with the frozen graph, which restores only the
+      // variables that remain, once it is known to work. Otherwise, e.g. if
+      // the constants make the graph too large, keep the unfrozen session.
+      std::unique_ptr<Session> frozen_session;
+      Status frozen_status =
+          LoadMetaGraphIntoSession(frozen, session_options, &frozen_session);
+      if (frozen_status.ok()) {
+        frozen_status =
+            RunRestore(run_options, export_dir,
+                       frozen.saver_def().restore_op_name(),
+                       frozen.saver_def().filename_tensor_name(),
+                       asset_file_defs, frozen_session.get());
+      }
+      if (frozen_status.ok()) {
+        bundle->session->Close().IgnoreError();
+        bundle->session = std::move(frozen_session);
+        bundle->meta_graph_def = std::move(frozen);
+      } else {
+        LOG(WARNING) << "Not freezing the variables of SignatureDef "
+                     << signature_def_key << ": " << frozen_status;
+        if (frozen_session != nullptr) {
+          frozen_session->Close().IgnoreError();
+        }
+      }
+    }
+  }
   // Record walltime spent in restoring graph from disk, but postpone metric
   // increments until graph init finishes.
   const uint64 restore_graph_walltime =
@@ -301,14 +761,20 @@ Status LoadSavedModelInternal(const SessionOptions& session_options,
 
 SavedModelBundleInterface::~SavedModelBundleInterface() {}
 
-Status LoadSavedModel(const SessionOptions& session_options,
-                      const RunOptions& run_options, const string& export_dir,
-                      const std::unordered_set<string>& tags,
-                      SavedModelBundle* const bundle) {
+namespace {
+
+Status LoadSavedModelAndCount(const SessionOptions& session_options,
+                              const RunOptions& run_options,
+                              const string& export_dir,
+                              const std::unordered_set<string>& tags,
+                              const string& signature_def_key,
+                              bool freeze_variables,
+                              SavedModelBundle* const bundle) {
   // TODO(robson): Add tests for the counters.
   const uint64 start_microseconds = Env::Default()->NowMicros();
-  const Status status = LoadSavedModelInternal(session_options, run_options,
-                                               export_dir, tags, bundle);
+  const Status status =
+      LoadSavedModelInternal(session_options, run_options, export_dir, tags,
+                             signature_def_key, freeze_variables, bundle);
   auto log_and_count = [&](const string& status_str) {
     LOG(INFO) << "SavedModel load for tags { " << absl::StrJoin(tags, " ")
               << " }; Status: " << status_str << ". Took "
@@ -325,6 +791,31 @@ Status LoadSavedModel(const SessionOptions& session_options,
   return status;
 }
 
+}  // namespace
+
+Status LoadSavedModel(const SessionOptions& session_options,
+                      const RunOptions& run_options, const string& export_dir,
+                      const std::unordered_set<string>& tags,
+                      SavedModelBundle* const bundle) {
+  return LoadSavedModelAndCount(session_options, run_options, export_dir, tags,
+                                /*signature_def_key=*/"",
+                                /*freeze_variables=*/false, bundle);
+}
+
+Status LoadSavedModelForSignature(const SessionOptions& session_options,
+                                  const RunOptions& run_options,
+                                  const string& export_dir,
+                                  const std::unordered_set<string>& tags,
+                                  const string& signature_def_key,
+                                  bool freeze_variables,
+                                  SavedModelBundle* const bundle) {
+  if (signature_def_key.empty()) {
+    return errors::InvalidArgument("No SignatureDef key given.");
+  }
+  return LoadSavedModelAndCount(session_options, run_options, export_dir, tags,
+                                signature_def_key, freeze_variables, bundle);
+}
+
 namespace {
 // Session wrapper that prevents calls to Session::Create(), Session::Extend(),
 // and the deprecated partial-run methods.
@@ -452,6 +943,23 @@ Status LoadSavedModel(const SessionOptions& session_options,
   return Status::OK();
 }
 
+Status LoadSavedModelForSignature(const SessionOptions& session_options,
+                                  const RunOptions& run_options,
+                                  const string& export_dir,
+                                  const std::unordered_set<string>& tags,
+                                  const string& signature_def_key,
+                                  bool freeze_variables,
+                                  SavedModelBundleLite* const bundle) {
+  SavedModelBundle legacy_bundle;
+  TF_RETURN_IF_ERROR(LoadSavedModelForSignature(
+      session_options, run_options, export_dir, tags, signature_def_key,
+      freeze_variables, &legacy_bundle));
+  *bundle = SavedModelBundleLite(
+      absl::make_unique<LiteSessionWrapper>(std::move(legacy_bundle.session)),
+      std::move(*legacy_bundle.meta_graph_def.mutable_signature_def()));
+  return Status::OK();
+}
+
 bool MaybeSavedModelDirectory(const string& export_dir) {
   const string saved_model_pb_path =
       io::JoinPath(export_dir, kSavedModelFilenamePb);
@@ -117,6 +117,33 @@ Status LoadSavedModel(const SessionOptions& session_options,
                       const std::unordered_set<string>& tags,
                       SavedModelBundleLite* const bundle);
 
+/// Loads the part of a SavedModel that is needed to serve the SignatureDef
+/// `signature_def_key`, like LoadSavedModel() does for the whole SavedModel.
+/// The graph is pruned to the inputs and outputs of the signature and the
+/// init op before the session is created, and only the variables that remain
+/// are restored from the checkpoint. The other SignatureDefs are dropped.
+///
+/// If `freeze_variables` is true, the variables that the signature only reads
+/// are treated as read-only: they are replaced with constants holding their
+/// restored values, which Grappler's constant folding then folds into the
+/// computations that use them. Variables that the graph also writes are kept.
+Status LoadSavedModelForSignature(const SessionOptions& session_options,
+                                  const RunOptions& run_options,
+                                  const string& export_dir,
+                                  const std::unordered_set<string>& tags,
+                                  const string& signature_def_key,
+                                  bool freeze_variables,
+                                  SavedModelBundle* const bundle);
+
+/// Like the overload above, but creates a SavedModelBundleLite.
+Status LoadSavedModelForSignature(const SessionOptions& session_options,
+                                  const RunOptions& run_options,
+                                  const string& export_dir,
+                                  const std::unordered_set<string>& tags,
+                                  const string& signature_def_key,
+                                  bool freeze_variables,
+                                  SavedModelBundleLite* const bundle);
+
 /// Checks whether the provided directory could contain a SavedModel. Note that
 /// the method does not load any data by itself. If the method returns `false`,
 /// the export directory definitely does not contain a SavedModel. If the method
@@ -20,7 +20,9 @@ limitations under the License.
 #include "tensorflow/cc/saved_model/tag_constants.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/path.h"
@@ -240,5 +242,61 @@ TEST_F(LoaderTest, SavedModelInitOpV2Format) {
   CheckSavedModelBundle(export_dir, bundle);
 }
 
+TEST_F(LoaderTest, LoadForSignature) {
+  SavedModelBundle bundle;
+  SessionOptions session_options;
+  RunOptions run_options;
+
+  const string export_dir =
+      io::JoinPath(testing::TensorFlowSrcRoot(), kTestDataPbTxt);
+  TF_ASSERT_OK(LoadSavedModelForSignature(
+      session_options, run_options, export_dir, {kSavedModelTagServe},
+      "regress_x_to_y", /*freeze_variables=*/false, &bundle));
+  CheckSavedModelBundle(export_dir, bundle);
+  EXPECT_EQ(0, bundle.GetSignatures().count("regress_x2_to_y3"));
+  // Only regress_x2_to_y3 uses c.
+  for (const NodeDef& node : bundle.meta_graph_def.graph_def().node()) {
+    EXPECT_NE("c", node.name());
+    EXPECT_NE("y3", node.name());
+    if (node.name() == "a") EXPECT_EQ("VariableV2", node.op());
+  }
+}
+
+TEST_F(LoaderTest, LoadForSignatureAndFreezeVariables) {
+  SavedModelBundle bundle;
+  SessionOptions session_options;
+  RunOptions run_options;
+
+  const string export_dir =
+      io::JoinPath(testing::TensorFlowSrcRoot(), kTestDataPbTxt);
+  TF_ASSERT_OK(LoadSavedModelForSignature(
+      session_options, run_options, export_dir, {kSavedModelTagServe},
+      "regress_x_to_y", /*freeze_variables=*/true, &bundle));
+  CheckSavedModelBundle(export_dir, bundle);
+  int num_frozen = 0;
+  for (const NodeDef& node : bundle.meta_graph_def.graph_def().node()) {
+    if (node.name() == "a" || node.name() == "b") {
+      EXPECT_EQ("Const", node.op());
+      ++num_frozen;
+    }
+    // The init op assigns the asset path to filename_tensor.
+    if (node.name() == "filename_tensor") EXPECT_EQ("VariableV2", node.op());
+  }
+  EXPECT_EQ(2, num_frozen);
+}
+
+TEST_F(LoaderTest, LoadForMissingSignature) {
+  SavedModelBundle bundle;
+  SessionOptions session_options;
+  RunOptions run_options;
+
+  const string export_dir =
+      io::JoinPath(testing::TensorFlowSrcRoot(), kTestDataPbTxt);
+  Status st = LoadSavedModelForSignature(
+      session_options, run_options, export_dir, {kSavedModelTagServe},
+      "missing_signature", /*freeze_variables=*/false, &bundle);
+  EXPECT_TRUE(errors::IsNotFound(st));
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/base_collective_executor.h"
 
 #include <algorithm>
+#include <chrono>  // NOLINT
 #include <functional>
 #include <utility>
 
@@ -34,6 +35,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/platform/types.h"
@@ -215,6 +217,14 @@ BaseCollectiveExecutor::~BaseCollectiveExecutor() {}
 
 void BaseCollectiveExecutor::StartAbort(const Status& s) {
   LOG(WARNING) << "BaseCollectiveExecutor::StartAbort " << s;
+  std::vector<PendingBucket*> pending;
+  {
+    mutex_lock l(bucket_mu_);
+    for (auto& it : pending_buckets_) pending.push_back(it.second);
+    pending_buckets_.clear();
+    bucket_cv_.notify_all();
+  }
+  for (PendingBucket* bucket : pending) FailBucket(bucket, s);
   remote_access_->StartAbort(s);
 }
 
@@ -239,6 +249,16 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
     done(s);
   };
 
+  if (bucketer_ != nullptr &&
+      col_params.instance.type == REDUCTION_COLLECTIVE) {
+    CollectiveBucketer::Placement placement;
+    if (bucketer_->Place(ctx->device()->name(), col_params, ctx->frame_iter(),
+                         ctx->input(0).TotalBytes(), &placement)) {
+      ExecuteBucketedAsync(ctx, col_params, placement, done_safe);
+      return;
+    }
+  }
+
   Tensor* output = ctx->mutable_output(0);
   const Tensor* input = (col_params.instance.type == REDUCTION_COLLECTIVE ||
                          col_params.instance.type == GATHER_COLLECTIVE ||
@@ -246,10 +266,18 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
                           col_params.is_source))
                             ? &ctx->input(0)
                             : nullptr;
+  RunCollective(ctx, col_params, exec_key, input, output, done_safe);
+}
+
+void BaseCollectiveExecutor::RunCollective(OpKernelContext* ctx,
+                                           const CollectiveParams& col_params,
+                                           const string& exec_key,
+                                           const Tensor* input, Tensor* output,
+                                           const StatusCallback& done) {
   CollectiveImplementationInterface* col_impl = nullptr;
   Status status = CreateCollective(col_params, &col_impl);
   if (!status.ok()) {
-    done_safe(status);
+    done(status);
     DCHECK_EQ(nullptr, col_impl);
     return;
   }
@@ -258,14 +286,14 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
                             exec_key, step_id_, input, output);
   status = col_impl->InitializeCollectiveContext(col_ctx);
   if (!status.ok()) {
-    done_safe(status);
+    done(status);
     delete col_ctx;
     delete col_impl;
     return;
   }
   // Run on an unbounded work queue that can handle blocking work so as to not
   // starve executor threads.
-  remote_access_->RunClosure([col_impl, col_ctx, done_safe, ctx]() {
+  remote_access_->RunClosure([col_impl, col_ctx, done, ctx]() {
     profiler::TraceMe activity(
         [&] {
           return strings::StrCat(ctx->op_kernel().name(), ":",
@@ -273,14 +301,204 @@ void BaseCollectiveExecutor::ExecuteAsync(OpKernelContext* ctx,
                                  "#id=", ctx->step_id(), "#");
         },
         profiler::TraceMeLevel::kInfo);
-    col_impl->Run([col_impl, col_ctx, done_safe](const Status& s) {
-      done_safe(s);
+    col_impl->Run([col_impl, col_ctx, done](const Status& s) {
+      done(s);
       delete col_ctx;
       delete col_impl;
     });
   });
 }
 
+struct BaseCollectiveExecutor::PendingBucket {
+  struct Member {
+    OpKernelContext* ctx = nullptr;
+    const CollectiveParams* col_params = nullptr;
+    StatusCallback done;
+  };
+  string key;
+  // Indexed by CollectiveBucketer::Placement::index.
+  std::vector<Member> members;
+  int num_ready = 0;
+  uint64 deadline_micros = 0;
+};
+
+namespace {
+// CollectiveParams and packed buffer for the single reduction run over a
+// full bucket.  The merge and final ops are borrowed from the first member,
+// whose kernel outlives the reduction.
+struct BucketReduction {
+  ~BucketReduction() {
+    col_params.merge_op.release();
+    col_params.final_op.release();
+  }
+
+  CollectiveParams col_params;
+  Tensor buffer;
+};
+}  // namespace
+
+void BaseCollectiveExecutor::ExecuteBucketedAsync(
+    OpKernelContext* ctx, const CollectiveParams& col_params,
+    const CollectiveBucketer::Placement& placement,
+    const StatusCallback& done) {
+  const string key =
+      strings::StrCat(ctx->device()->name(), ":", placement.bucket_key);
+  PendingBucket* full_bucket = nullptr;
+  bool start_watcher = false;
+  {
+    mutex_lock l(bucket_mu_);
+    PendingBucket*& bucket = pending_buckets_[key];
+    if (bucket == nullptr) {
+      bucket = new PendingBucket;
+      bucket->key = key;
+      bucket->members.resize(placement.num_members);
+      bucket->deadline_micros = Env::Default()->NowMicros() +
+                                bucketer_->options().flush_timeout_micros;
+    }
+    PendingBucket::Member* member = &bucket->members[placement.index];
+    DCHECK(member->ctx == nullptr) << "Duplicate member "
+                                   << col_params.ToString() << " in bucket "
+                                   << key;
+    member->ctx = ctx;
+    member->col_params = &col_params;
+    member->done = done;
+    if (++bucket->num_ready == placement.num_members) {
+      full_bucket = bucket;
+      pending_buckets_.erase(key);
+    } else if (!bucket_watcher_running_) {
+      bucket_watcher_running_ = true;
+      start_watcher = true;
+    }
+  }
+  if (start_watcher) {
+    Ref();  // Ensure this lasts until the watcher exits.
+    remote_access_->RunClosure([this] {
+      WatchPendingBuckets();
+      Unref();
+    });
+  }
+  if (full_bucket != nullptr) RunBucket(full_bucket);
+}
+
+void BaseCollectiveExecutor::RunBucket(PendingBucket* bucket) {
+  std::unique_ptr<PendingBucket> bucket_owner(bucket);
+  const int num_members = bucket->members.size();
+  const PendingBucket::Member& first = bucket->members[0];
+  OpKernelContext* ctx = first.ctx;
+
+  BucketReduction* reduction = new BucketReduction;
+  CollectiveParams& cp = reduction->col_params;
+  cp.group = first.col_params->group;
+  cp.instance = first.col_params->instance;
+  cp.task = first.col_params->task;
+  cp.name = strings::StrCat(first.col_params->name, " (bucket of ",
+                            num_members, ")");
+  cp.default_rank = first.col_params->default_rank;
+  cp.subdiv_rank = first.col_params->subdiv_rank;
+  cp.merge_op.reset(first.col_params->merge_op.get());
+  cp.final_op.reset(first.col_params->final_op.get());
+  int64 total_elts = 0;
+  for (const PendingBucket::Member& m : bucket->members) {
+    total_elts += m.ctx->input(0).NumElements();
+  }
+  cp.instance.shape = TensorShape({total_elts});
+
+  AllocationAttributes attr;
+  reduction->buffer =
+      Tensor(ctx->device()->GetAllocator(ctx->output_alloc_attr(0)),
+             cp.instance.data_type, cp.instance.shape, attr);
+  char* buf = static_cast<char*>(DMAHelper::base(&reduction->buffer));
+  if (buf == nullptr) {
+    delete reduction;
+    FailBucket(bucket_owner.release(),
+               errors::ResourceExhausted("Failed to allocate ", total_elts,
+                                         " elements for collective bucket ",
+                                         bucket->key));
+    return;
+  }
+  int64 offset = 0;
+  for (const PendingBucket::Member& m : bucket->members) {
+    const Tensor& in = m.ctx->input(0);
+    memcpy(buf + offset, DMAHelper::base(&in), in.TotalBytes());
+    offset += in.TotalBytes();
+  }
+
+  // The members run in the root frame, see CollectiveBucketer::Place.
+  const string exec_key = strings::StrCat(
+      "bucket(", cp.instance.instance_key, ",", num_members, "):0:0");
+  std::vector<PendingBucket::Member> members = std::move(bucket->members);
+  RunCollective(ctx, cp, exec_key, &reduction->buffer, &reduction->buffer,
+                [reduction, members](const Status& s) {
+                  const char* buf = static_cast<const char*>(
+                      DMAHelper::base(&reduction->buffer));
+                  int64 offset = 0;
+                  for (const PendingBucket::Member& m : members) {
+                    Tensor* out = m.ctx->mutable_output(0);
+                    if (s.ok()) {
+                      memcpy(DMAHelper::base(out), buf + offset,
+                             out->TotalBytes());
+                    }
+                    offset += out->TotalBytes();
+                  }
+                  delete reduction;
+                  for (const PendingBucket::Member& m : members) {
+                    m.done(s);
+                  }
+                });
+}
+
+void BaseCollectiveExecutor::FailBucket(PendingBucket* bucket,
+                                        const Status& s) {
+  std::unique_ptr<PendingBucket> bucket_owner(bucket);
+  for (PendingBucket::Member& m : bucket->members) {
+    if (m.ctx != nullptr) m.done(s);
+  }
+}
+
+void BaseCollectiveExecutor::WatchPendingBuckets() {
+  while (true) {
+    std::vector<PendingBucket*> expired;
+    {
+      mutex_lock l(bucket_mu_);
+      const uint64 now = Env::Default()->NowMicros();
+      uint64 next_deadline = kuint64max;
+      for (auto it = pending_buckets_.begin(); it != pending_buckets_.end();) {
+        if (it->second->deadline_micros <= now) {
+          expired.push_back(it->second);
+          it = pending_buckets_.erase(it);
+        } else {
+          next_deadline = std::min(next_deadline, it->second->deadline_micros);
+          ++it;
+        }
+      }
+      if (expired.empty()) {
+        if (pending_buckets_.empty()) {
+          bucket_watcher_running_ = false;
+          return;
+        }
+        bucket_cv_.wait_for(l,
+                            std::chrono::microseconds(next_deadline - now));
+        continue;
+      }
+    }
+    // Falling back to unbucketed reductions here would be a local decision:
+    // a peer that filled the bucket in time runs the bucketed ring while this
+    // worker runs the unbucketed ones, and the step hangs.  Failing the step
+    // aborts it on all members instead.
+    for (PendingBucket* bucket : expired) {
+      const Status s = errors::DeadlineExceeded(
+          "Collective bucket ", bucket->key, " received only ",
+          bucket->num_ready, " of ", bucket->members.size(),
+          " members within ", bucketer_->options().flush_timeout_micros,
+          " microseconds.  Its members may depend on each other; disable "
+          "bucketing with ConfigProto.Experimental.collective_bucket_bytes = "
+          "0, or raise collective_bucket_flush_timeout_micros.");
+      LOG(ERROR) << s;
+      FailBucket(bucket, s);
+    }
+  }
+}
+
 void BaseCollectiveExecutor::CompleteParamsAsync(
     const string& device, CollectiveParams* cp, CancellationManager* cancel_mgr,
     StatusCallback done) {
@@ -19,6 +19,7 @@ limitations under the License.
 #include <string>
 
 #include "tensorflow/core/common_runtime/buf_rendezvous.h"
+#include "tensorflow/core/common_runtime/collective_bucketer.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 
@@ -97,12 +98,14 @@ class BaseCollectiveExecutor : public CollectiveExecutor {
   BaseCollectiveExecutor(CollectiveExecutorMgrInterface* cem,
                          PerStepCollectiveRemoteAccess* remote_access,
                          int64 step_id, const DeviceMgr* dev_mgr,
-                         const string* gpu_ring_order)
+                         const string* gpu_ring_order,
+                         CollectiveBucketer* bucketer = nullptr)
       : CollectiveExecutor(cem),
         step_id_(step_id),
         dev_mgr_(dev_mgr),
         remote_access_(remote_access),
-        gpu_ring_order_(gpu_ring_order) {}
+        gpu_ring_order_(gpu_ring_order),
+        bucketer_(bucketer) {}
 
   ~BaseCollectiveExecutor() override;
 
@@ -168,11 +171,38 @@ class BaseCollectiveExecutor : public CollectiveExecutor {
   std::unordered_map<int32, int32> launched_ GUARDED_BY(launch_mu_);
 
  private:
+  struct PendingBucket;
+
   Status CreateCollective(const CollectiveParams& col_params,
                           CollectiveImplementationInterface** col_impl);
+  // Creates the implementation for `col_params` and runs it on the
+  // collective work queue.
+  void RunCollective(OpKernelContext* ctx, const CollectiveParams& col_params,
+                     const string& exec_key, const Tensor* input,
+                     Tensor* output, const StatusCallback& done);
+  // Holds back a reduction until every member of its bucket is ready, then
+  // reduces all members with a single collective over a packed buffer.
+  void ExecuteBucketedAsync(OpKernelContext* ctx,
+                            const CollectiveParams& col_params,
+                            const CollectiveBucketer::Placement& placement,
+                            const StatusCallback& done);
+  void RunBucket(PendingBucket* bucket);
+  // Fails `bucket` and all of its members that have arrived with `s`.
+  void FailBucket(PendingBucket* bucket, const Status& s);
+  // Fails buckets that did not fill within the flush timeout, and with them
+  // the step.  Runs on the collective work queue while any bucket is pending.
+  void WatchPendingBuckets();
   // Check if all ops on which this collective depends on have launched.
   bool CheckDependencies(const CollectiveParams& col_params)
       EXCLUSIVE_LOCKS_REQUIRED(launch_mu_);
+
+  CollectiveBucketer* bucketer_;  // Not owned, may be null.
+  mutex bucket_mu_;
+  condition_variable bucket_cv_;
+  // device name + bucket key -> partially filled bucket.
+  std::unordered_map<string, PendingBucket*> pending_buckets_
+      GUARDED_BY(bucket_mu_);
+  bool bucket_watcher_running_ GUARDED_BY(bucket_mu_) = false;
 };
 
 }  // namespace tensorflow
@@ -0,0 +1,327 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/collective_bucketer.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/unbounded_work_queue.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr int kNumDevices = 2;
+constexpr int kGroupKey = 5;
+constexpr int kTensorLen = 4;
+const char kTaskName[] = "/job:worker/replica:0/task:0";
+
+std::unique_ptr<OpKernel> GetKernel(const NodeDef& node, DeviceBase* device) {
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()), node,
+      TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+std::unique_ptr<OpKernel> GetBinaryOp(const string& op, DeviceBase* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder(strings::StrCat(op, "_node"), op)
+                  .Attr("T", DT_FLOAT)
+                  .Input(FakeInput(DT_FLOAT))
+                  .Input(FakeInput(DT_FLOAT))
+                  .Finalize(&node_def));
+  return GetKernel(node_def, device);
+}
+
+// Records the keys of all the buffers that are sent, which contain the exec
+// keys of the collectives.
+class KeyRecordingRMA : public CollectiveRemoteAccessLocal {
+ public:
+  KeyRecordingRMA(const DeviceMgr* dev_mgr,
+                  DeviceResolverInterface* dev_resolver,
+                  std::shared_ptr<UnboundedWorkQueue> work_queue,
+                  int64 step_id, mutex* mu, std::vector<string>* keys)
+      : CollectiveRemoteAccessLocal(dev_mgr, dev_resolver, work_queue,
+                                    step_id),
+        mu_(mu),
+        keys_(keys) {}
+
+  void PostToPeer(const string& peer_device, const string& peer_task,
+                  const string& key, Device* from_device,
+                  DeviceContext* from_device_ctx,
+                  const AllocatorAttributes& from_alloc_attr,
+                  const Tensor* from_tensor,
+                  const DeviceLocality& client_locality,
+                  const StatusCallback& done) override {
+    {
+      mutex_lock l(*mu_);
+      keys_->push_back(key);
+    }
+    CollectiveRemoteAccessLocal::PostToPeer(
+        peer_device, peer_task, key, from_device, from_device_ctx,
+        from_alloc_attr, from_tensor, client_locality, done);
+  }
+
+ private:
+  mutex* mu_;
+  std::vector<string>* keys_;
+};
+
+// Runs small CPU all-reduces through BaseCollectiveExecutor::ExecuteAsync with
+// a CollectiveBucketer, i.e. through the pack, reduce and scatter path once
+// the bucketer has learned its plan.
+class BucketedReductionTest : public ::testing::Test {
+ protected:
+  // One CollectiveReduce of instance `instance_key` on one device.
+  struct Member {
+    ~Member() {
+      ctx.reset();
+      if (dev_ctx != nullptr) dev_ctx->Unref();
+    }
+
+    Device* device = nullptr;
+    int32 instance_key = 0;
+    CollectiveParams col_params;
+    Tensor input;
+    std::unique_ptr<OpKernel> kernel;
+    gtl::InlinedVector<TensorValue, 4> inputs;
+    gtl::InlinedVector<AllocatorAttributes, 4> input_alloc_attrs;
+    gtl::InlinedVector<DeviceContext*, 4> input_device_contexts;
+    DeviceContext* dev_ctx = nullptr;
+    int forward_from = 0;
+    AllocatorAttributes output_attr;
+    OpKernelContext::Params params;
+    std::unique_ptr<OpKernelContext> ctx;
+    Notification done;
+    Status status;
+  };
+
+  BucketedReductionTest() {
+    std::vector<std::unique_ptr<Device>> devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    for (int di = 0; di < kNumDevices; ++di) {
+      devices.push_back(absl::make_unique<ThreadPoolDevice>(
+          sess_opts, strings::StrCat(kTaskName, "/cpu:", di), Bytes(4 << 20),
+          DeviceLocality(), cpu_allocator()));
+    }
+    dev_mgr_ = absl::make_unique<StaticDeviceMgr>(std::move(devices));
+    dev_resolver_ = absl::make_unique<DeviceResolverLocal>(dev_mgr_.get());
+    work_queue_ = std::make_shared<UnboundedWorkQueue>(Env::Default(), "test");
+
+    CollectiveBucketOptions options;
+    options.bucket_bytes = 1024;
+    options.max_tensor_bytes = 256;
+    options.flush_timeout_micros = 100 * 1000;
+    bucketer_ = absl::make_unique<CollectiveBucketer>(options);
+  }
+
+  // The input of `instance_key` on device `di`.  The mean over all devices
+  // is ExpectedValue().
+  static float InputValue(int di, int32 instance_key, int i) {
+    return (di + 1) * (instance_key * 10 + i);
+  }
+
+  static float ExpectedValue(int32 instance_key, int i) {
+    float sum = 0;
+    for (int di = 0; di < kNumDevices; ++di) {
+      sum += InputValue(di, instance_key, i);
+    }
+    return sum / kNumDevices;
+  }
+
+  std::unique_ptr<Member> NewMember(int di, int32 instance_key) {
+    auto m = absl::make_unique<Member>();
+    TF_CHECK_OK(dev_mgr_->LookupDevice(
+        strings::StrCat(kTaskName, "/cpu:", di), &m->device));
+    m->instance_key = instance_key;
+
+    CollectiveParams& cp = m->col_params;
+    cp.name = "bucketed_reduction";
+    cp.group.group_key = kGroupKey;
+    cp.group.group_size = kNumDevices;
+    cp.group.device_type = DEVICE_CPU;
+    cp.instance.type = REDUCTION_COLLECTIVE;
+    cp.instance.instance_key = instance_key;
+    cp.instance.data_type = DT_FLOAT;
+    cp.instance.shape = TensorShape({kTensorLen});
+    cp.instance.impl_details.collective_name = "RingReduce";
+    cp.instance.impl_details.subdiv_offsets = {0};
+    cp.instance.impl_details.subdiv_permutations.resize(1);
+    for (int dj = 0; dj < kNumDevices; ++dj) {
+      cp.instance.device_names.push_back(
+          strings::StrCat(kTaskName, "/cpu:", dj));
+      cp.instance.task_names.push_back(kTaskName);
+      cp.instance.impl_details.subdiv_permutations[0].push_back(dj);
+      cp.task.is_local.push_back(true);
+    }
+    cp.default_rank = di;
+    cp.subdiv_rank = {di};
+    cp.merge_op = GetBinaryOp("Add", m->device);
+    cp.final_op = GetBinaryOp("Div", m->device);
+
+    m->input = Tensor(DT_FLOAT, TensorShape({kTensorLen}));
+    for (int i = 0; i < kTensorLen; ++i) {
+      m->input.flat<float>()(i) = InputValue(di, instance_key, i);
+    }
+
+    NodeDef node_def;
+    TF_CHECK_OK(
+        NodeDefBuilder(strings::StrCat("reduce_", instance_key),
+                       "CollectiveReduce")
+            .Attr("T", DT_FLOAT)
+            .Attr("merge_op", "Add")
+            .Attr("final_op", "Div")
+            .Attr("group_size", kNumDevices)
+            .Attr("group_key", kGroupKey)
+            .Attr("instance_key", instance_key)
+            .Attr("subdiv_offsets", cp.instance.impl_details.subdiv_offsets)
+            .Input(FakeInput(DT_FLOAT))
+            .Finalize(&node_def));
+    m->kernel = GetKernel(node_def, m->device);
+
+    m->inputs.push_back(TensorValue(&m->input));
+    m->input_alloc_attrs.push_back(AllocatorAttributes());
+    m->dev_ctx = new DeviceContext;
+    m->input_device_contexts.push_back(m->dev_ctx);
+    m->params.device = m->device;
+    m->params.op_kernel = m->kernel.get();
+    m->params.inputs = &m->inputs;
+    m->params.input_alloc_attrs = &m->input_alloc_attrs;
+    m->params.input_device_contexts = &m->input_device_contexts;
+    m->params.op_device_context = m->dev_ctx;
+    m->params.forward_from_array = &m->forward_from;
+    m->params.output_attr_array = &m->output_attr;
+    return m;
+  }
+
+  // Runs one step that all-reduces `instance_keys` on all devices, and returns
+  // once every reduction is done.
+  std::vector<std::unique_ptr<Member>> RunStep(
+      int64 step_id, const std::vector<int32>& instance_keys) {
+    std::vector<std::unique_ptr<Member>> members;
+    BaseCollectiveExecutor* col_exec = new BaseCollectiveExecutor(
+        &col_exec_mgr_,
+        new KeyRecordingRMA(dev_mgr_.get(), dev_resolver_.get(), work_queue_,
+                            step_id, &keys_mu_, &keys_),
+        step_id, dev_mgr_.get(), &gpu_ring_order_, bucketer_.get());
+    for (int di = 0; di < kNumDevices; ++di) {
+      for (int32 instance_key : instance_keys) {
+        std::unique_ptr<Member> m = NewMember(di, instance_key);
+        m->params.step_id = step_id;
+        m->ctx = absl::make_unique<OpKernelContext>(&m->params, 1);
+        Tensor* output = nullptr;
+        TF_CHECK_OK(m->ctx->allocate_output(0, m->input.shape(), &output));
+        members.push_back(std::move(m));
+      }
+    }
+    for (const auto& m : members) {
+      Member* member = m.get();
+      col_exec->ExecuteAsync(member->ctx.get(), member->col_params,
+                             strings::StrCat(member->instance_key, ":0:0"),
+                             [member](const Status& s) {
+                               member->status = s;
+                               member->done.Notify();
+                             });
+    }
+    for (const auto& m : members) m->done.WaitForNotification();
+    col_exec->Unref();
+    return members;
+  }
+
+  void ExpectReduced(const std::vector<std::unique_ptr<Member>>& members) {
+    for (const auto& m : members) {
+      TF_ASSERT_OK(m->status);
+      const Tensor& output = *m->ctx->mutable_output(0);
+      for (int i = 0; i < kTensorLen; ++i) {
+        EXPECT_FLOAT_EQ(ExpectedValue(m->instance_key, i),
+                        output.flat<float>()(i))
+            << "instance " << m->instance_key << " on "
+            << m->device->name() << " at " << i;
+      }
+    }
+  }
+
+  // Returns true if a bucketed reduction sent any buffers since the last call.
+  bool SentBucket() {
+    mutex_lock l(keys_mu_);
+    bool found = false;
+    for (const string& key : keys_) {
+      if (key.find("bucket(") != string::npos) found = true;
+    }
+    keys_.clear();
+    return found;
+  }
+
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::shared_ptr<UnboundedWorkQueue> work_queue_;
+  std::unique_ptr<CollectiveBucketer> bucketer_;
+  string gpu_ring_order_;
+  mutex keys_mu_;
+  std::vector<string> keys_ GUARDED_BY(keys_mu_);
+};
+
+TEST_F(BucketedReductionTest, PacksReducesAndScatters) {
+  const std::vector<int32> instance_keys = {3, 1, 2};
+  // The first step runs every reduction on its own, while the bucketer learns
+  // its plan.
+  ExpectReduced(RunStep(1, instance_keys));
+  EXPECT_FALSE(SentBucket());
+  // The later steps pack all three reductions into a single bucket.
+  for (int64 step_id = 2; step_id < 4; ++step_id) {
+    ExpectReduced(RunStep(step_id, instance_keys));
+    EXPECT_TRUE(SentBucket());
+  }
+}
+
+TEST_F(BucketedReductionTest, FailsStepWhenBucketDoesNotFill) {
+  ExpectReduced(RunStep(1, {1, 2, 3}));
+  // Instance 3 never runs, so its bucket cannot fill.  The members that did
+  // arrive fail on every device rather than being reduced without the bucket.
+  for (const auto& m : RunStep(2, {1, 2})) {
+    EXPECT_TRUE(errors::IsDeadlineExceeded(m->status)) << m->status;
+  }
+  EXPECT_FALSE(SentBucket());
+  // The bucket is not disabled: a complete step still uses it.
+  ExpectReduced(RunStep(3, {1, 2, 3}));
+  EXPECT_TRUE(SentBucket());
+}
+
+}  // namespace
+}  // namespace tensorflow
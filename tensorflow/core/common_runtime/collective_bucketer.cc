@@ -0,0 +1,123 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_bucketer.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+namespace {
+// Defaults used when the corresponding ConfigProto field is unset.
+constexpr int64 kDefaultFlushTimeoutMicros = 10 * 1000 * 1000;
+}  // namespace
+
+/*static*/
+CollectiveBucketOptions CollectiveBucketOptions::FromConfig(
+    const ConfigProto& config) {
+  CollectiveBucketOptions options;
+  options.bucket_bytes = config.experimental().collective_bucket_bytes();
+  options.max_tensor_bytes =
+      config.experimental().collective_bucket_max_tensor_bytes();
+  if (options.max_tensor_bytes <= 0) {
+    options.max_tensor_bytes = options.bucket_bytes / 4;
+  }
+  options.flush_timeout_micros =
+      config.experimental().collective_bucket_flush_timeout_micros();
+  if (options.flush_timeout_micros <= 0) {
+    options.flush_timeout_micros = kDefaultFlushTimeoutMicros;
+  }
+  return options;
+}
+
+bool CollectiveBucketer::Bucketable(const CollectiveParams& col_params,
+                                    const FrameAndIter& frame_iter,
+                                    int64 num_bytes) const {
+  // Only root-frame reductions are executed exactly once per step, which the
+  // plan relies on.  Explicitly ordered collectives keep their own ordering,
+  // and packing is done in host memory so only CPU ring reductions qualify.
+  return options_.enabled() &&
+         col_params.instance.type == REDUCTION_COLLECTIVE &&
+         col_params.group.device_type == DEVICE_CPU &&
+         col_params.instance.impl_details.collective_name == "RingReduce" &&
+         col_params.instance.impl_details.dependencies.empty() &&
+         frame_iter.frame_id == 0 && frame_iter.iter_id == 0 &&
+         num_bytes > 0 && num_bytes <= options_.max_tensor_bytes;
+}
+
+string CollectiveBucketer::SignatureKey(
+    const string& device, const CollectiveParams& col_params) const {
+  return strings::StrCat(
+      device, ":", col_params.group.group_key, ":",
+      col_params.instance.data_type, ":",
+      col_params.merge_op ? col_params.merge_op->type_string() : "", ":",
+      col_params.final_op ? col_params.final_op->type_string() : "");
+}
+
+void CollectiveBucketer::FreezePlan(SignatureState* state) const {
+  std::sort(state->recorded.begin(), state->recorded.end());
+  size_t begin = 0;
+  while (begin < state->recorded.size()) {
+    size_t end = begin;
+    int64 bytes = 0;
+    while (end < state->recorded.size() &&
+           (end == begin ||
+            bytes + state->recorded[end].second <= options_.bucket_bytes)) {
+      bytes += state->recorded[end].second;
+      ++end;
+    }
+    // A bucket with a single member would only add packing overhead.
+    if (end - begin > 1) {
+      for (size_t i = begin; i < end; ++i) {
+        Placement& p = state->placements[state->recorded[i].first];
+        p.bucket_key = state->recorded[begin].first;
+        p.index = static_cast<int>(i - begin);
+        p.num_members = static_cast<int>(end - begin);
+      }
+      VLOG(1) << "CollectiveBucketer: bucket " << state->recorded[begin].first
+              << " holds " << (end - begin) << " instances, " << bytes
+              << " bytes";
+    }
+    begin = end;
+  }
+  state->frozen = true;
+  state->recorded.clear();
+  state->seen.clear();
+}
+
+bool CollectiveBucketer::Place(const string& device,
+                               const CollectiveParams& col_params,
+                               const FrameAndIter& frame_iter, int64 num_bytes,
+                               Placement* placement) {
+  if (!Bucketable(col_params, frame_iter, num_bytes)) return false;
+  const int32 instance_key = col_params.instance.instance_key;
+  mutex_lock l(mu_);
+  SignatureState& state = signatures_[SignatureKey(device, col_params)];
+  if (!state.frozen) {
+    if (state.seen.insert(instance_key).second) {
+      state.recorded.emplace_back(instance_key, num_bytes);
+      return false;
+    }
+    FreezePlan(&state);
+  }
+  auto it = state.placements.find(instance_key);
+  if (it == state.placements.end()) return false;
+  *placement = it->second;
+  return true;
+}
+
+}  // namespace tensorflow
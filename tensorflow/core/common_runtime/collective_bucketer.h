@@ -0,0 +1,109 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_BUCKETER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_BUCKETER_H_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/control_flow.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+class ConfigProto;
+
+// Options controlling how small all-reduce collectives are packed together.
+struct CollectiveBucketOptions {
+  // Maximum number of bytes packed into a single bucket.  Bucketing is
+  // disabled when this is not positive.
+  int64 bucket_bytes = 0;
+  // Reductions whose input is larger than this are never bucketed.
+  int64 max_tensor_bytes = 0;
+  // Maximum time a partially filled bucket waits for its remaining members
+  // before the step fails.
+  int64 flush_timeout_micros = 0;
+
+  bool enabled() const { return bucket_bytes > 0; }
+
+  // Returns options read from `config.experimental()`, substituting defaults
+  // for unset fields.
+  static CollectiveBucketOptions FromConfig(const ConfigProto& config);
+};
+
+// Decides which all-reduce collectives are packed into a shared contiguous
+// buffer and reduced with a single ring reduction.
+//
+// Every member of a group must form identical buckets, so membership cannot
+// be decided by arrival timing.  Instead, for every (device, group, data type,
+// merge_op, final_op) signature the bucketer records the root-frame reduction
+// instances that run on the device until one of them is seen a second time.
+// At that point the plan for the signature is frozen: the recorded instances
+// are sorted by instance key and greedily cut into buckets of at most
+// `bucket_bytes`.  All participants run the same graph, so all participants
+// derive the same plan.  This relies on steps of the graph not overlapping on
+// a worker, which holds for synchronous training.
+//
+// The bucketer is shared by all steps; the per-step assembly of buckets is
+// done by BaseCollectiveExecutor.
+class CollectiveBucketer {
+ public:
+  // Where a single collective instance lives inside its bucket.
+  struct Placement {
+    // Instance key of the first member, which identifies the bucket.
+    int32 bucket_key = -1;
+    // Position of the instance within the bucket, in instance key order.
+    int index = -1;
+    int num_members = 0;
+  };
+
+  explicit CollectiveBucketer(const CollectiveBucketOptions& options)
+      : options_(options) {}
+
+  const CollectiveBucketOptions& options() const { return options_; }
+
+  // Returns true and fills `*placement` if the reduction described by
+  // `col_params`, executing on `device` in `frame_iter` with an input of
+  // `num_bytes`, should be reduced as part of a bucket.
+  bool Place(const string& device, const CollectiveParams& col_params,
+             const FrameAndIter& frame_iter, int64 num_bytes,
+             Placement* placement);
+
+ private:
+  struct SignatureState {
+    bool frozen = false;
+    // Instances recorded before the plan was frozen, with their input sizes.
+    std::vector<std::pair<int32, int64>> recorded;
+    std::unordered_set<int32> seen;
+    std::unordered_map<int32, Placement> placements;
+  };
+
+  bool Bucketable(const CollectiveParams& col_params,
+                  const FrameAndIter& frame_iter, int64 num_bytes) const;
+  string SignatureKey(const string& device,
+                      const CollectiveParams& col_params) const;
+  void FreezePlan(SignatureState* state) const;
+
+  const CollectiveBucketOptions options_;
+  mutex mu_;
+  std::unordered_map<string, SignatureState> signatures_ GUARDED_BY(mu_);
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_BUCKETER_H_
@@ -0,0 +1,109 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_bucketer.h"
+
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+namespace {
+
+const char kDevice[] = "/job:worker/replica:0/task:0/device:CPU:0";
+const FrameAndIter kRootFrame(0, 0);
+
+class CollectiveBucketerTest : public ::testing::Test {
+ protected:
+  CollectiveBucketerTest() {
+    CollectiveBucketOptions options;
+    options.bucket_bytes = 1024;
+    options.max_tensor_bytes = 256;
+    options.flush_timeout_micros = 1000;
+    bucketer_.reset(new CollectiveBucketer(options));
+  }
+
+  void InitParams(int32 instance_key, CollectiveParams* cp) {
+    cp->group.group_key = 1;
+    cp->group.group_size = 2;
+    cp->group.device_type = DEVICE_CPU;
+    cp->instance.type = REDUCTION_COLLECTIVE;
+    cp->instance.instance_key = instance_key;
+    cp->instance.data_type = DT_FLOAT;
+    cp->instance.impl_details.collective_name = "RingReduce";
+  }
+
+  bool Place(int32 instance_key, int64 num_bytes,
+             CollectiveBucketer::Placement* placement,
+             const FrameAndIter& frame_iter = kRootFrame) {
+    CollectiveParams cp;
+    InitParams(instance_key, &cp);
+    return bucketer_->Place(kDevice, cp, frame_iter, num_bytes, placement);
+  }
+
+  std::unique_ptr<CollectiveBucketer> bucketer_;
+};
+
+TEST_F(CollectiveBucketerTest, FromConfigDefaults) {
+  ConfigProto config;
+  EXPECT_FALSE(CollectiveBucketOptions::FromConfig(config).enabled());
+  config.mutable_experimental()->set_collective_bucket_bytes(4096);
+  CollectiveBucketOptions options = CollectiveBucketOptions::FromConfig(config);
+  EXPECT_TRUE(options.enabled());
+  EXPECT_EQ(1024, options.max_tensor_bytes);
+  EXPECT_GT(options.flush_timeout_micros, 0);
+}
+
+TEST_F(CollectiveBucketerTest, LearnsPlanOnFirstStep) {
+  CollectiveBucketer::Placement p;
+  // First step: instances arrive out of key order and are only recorded.
+  for (int32 key : {5, 3, 4, 7, 6, 8}) {
+    EXPECT_FALSE(Place(key, 256, &p));
+  }
+  // A large reduction is never bucketed.
+  EXPECT_FALSE(Place(9, 4096, &p));
+  // Second step: the plan is frozen into buckets of at most 1024 bytes, cut
+  // in instance key order.
+  ASSERT_TRUE(Place(4, 256, &p));
+  EXPECT_EQ(3, p.bucket_key);
+  EXPECT_EQ(1, p.index);
+  EXPECT_EQ(4, p.num_members);
+  ASSERT_TRUE(Place(6, 256, &p));
+  EXPECT_EQ(3, p.bucket_key);
+  EXPECT_EQ(3, p.index);
+  ASSERT_TRUE(Place(8, 256, &p));
+  EXPECT_EQ(7, p.bucket_key);
+  EXPECT_EQ(1, p.index);
+  EXPECT_EQ(2, p.num_members);
+}
+
+TEST_F(CollectiveBucketerTest, SingletonBucketIsNotUsed) {
+  CollectiveBucketer::Placement p;
+  EXPECT_FALSE(Place(1, 256, &p));
+  EXPECT_FALSE(Place(1, 256, &p));
+}
+
+TEST_F(CollectiveBucketerTest, IgnoresNonRootFrames) {
+  CollectiveBucketer::Placement p;
+  EXPECT_FALSE(Place(1, 64, &p));
+  EXPECT_FALSE(Place(2, 64, &p));
+  // Loop iterations repeat instance keys within a step and must not freeze
+  // the plan.
+  EXPECT_FALSE(Place(1, 64, &p, FrameAndIter(17, 1)));
+  EXPECT_FALSE(Place(3, 64, &p));
+  ASSERT_TRUE(Place(1, 64, &p));
+  EXPECT_EQ(3, p.num_members);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -33,7 +33,13 @@ CollectiveExecutorMgr::CollectiveExecutorMgr(
       gpu_ring_order_(
           config.gpu_options().experimental().collective_ring_order()),
       work_queue_(std::make_shared<UnboundedWorkQueue>(Env::Default(),
-                                                       "collective_ops")) {}
+                                                       "collective_ops")) {
+  CollectiveBucketOptions bucket_options =
+      CollectiveBucketOptions::FromConfig(config);
+  if (bucket_options.enabled()) {
+    bucketer_.reset(new CollectiveBucketer(bucket_options));
+  }
+}
 
 CollectiveExecutorMgr::~CollectiveExecutorMgr() {
   for (auto iter : executor_table_) {
@@ -61,7 +67,7 @@ CollectiveExecutor* CollectiveExecutorMgr::Create(int64 step_id) {
   CollectiveRemoteAccessLocal* rma = new CollectiveRemoteAccessLocal(
       dev_mgr_, dev_resolver_.get(), work_queue_, step_id);
   return new BaseCollectiveExecutor(this, rma, step_id, dev_mgr_,
-                                    &gpu_ring_order_);
+                                    &gpu_ring_order_, bucketer_.get());
 }
 
 void CollectiveExecutorMgr::Cleanup(int64 step_id) {
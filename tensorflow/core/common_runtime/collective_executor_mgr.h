@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_EXECUTOR_MGR_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_EXECUTOR_MGR_H_
 
+#include "tensorflow/core/common_runtime/collective_bucketer.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/lib/gtl/flatmap.h"
 #include "tensorflow/core/platform/unbounded_work_queue.h"
@@ -68,6 +69,9 @@ class CollectiveExecutorMgr : public CollectiveExecutorMgrInterface {
   // collective op execution.  Ownership is shared between `this` and
   // `CollectiveRemoteAccessLocal`.
   std::shared_ptr<UnboundedWorkQueue> work_queue_;
+  // Packs small all-reduces into buckets across steps.  Null unless enabled
+  // by ConfigProto.Experimental.collective_bucket_bytes.
+  std::unique_ptr<CollectiveBucketer> bucketer_;
 
  private:
   mutex exec_mu_;
@@ -31,6 +31,8 @@ class NoOpStatsPublisher : public StatsPublisherInterface {
   void PublishGraphProto(
       const std::vector<const GraphDef*>& graph_defs) override {}
 
+  bool PublishesGraphProto() const override { return false; }
+
   std::unique_ptr<ProfileHandler> GetProfileHandler(
       uint64 step, int64 execution_count, const RunOptions& ropts) override {
     return nullptr;
@@ -41,6 +41,10 @@ class StatsPublisherInterface {
   virtual void PublishGraphProto(
       const std::vector<const GraphDef*>& graph_defs) = 0;
 
+  // Returns false if PublishGraphProto does nothing, so that sessions don't
+  // need to keep the graph_defs for it.
+  virtual bool PublishesGraphProto() const { return true; }
+
   // Returns a profile handler for the given step based on the execution_count
   // and RunOptions.
   //
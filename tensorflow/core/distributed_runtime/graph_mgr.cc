@@ -313,6 +313,53 @@ Status GraphMgr::Register(const string& handle, const GraphDef& gdef,
   return Status::OK();
 }
 
+Status GraphMgr::AddGraphChunk(int64 registration_id, int32 chunk_index,
+                               const GraphDef& chunk, bool is_last_chunk,
+                               bool* complete, GraphDef* gdef) {
+  // Chunks are sent one after the other, so a registration whose next chunk
+  // takes this long has been abandoned.
+  static const uint64 kChunkTimeoutMicros = 10 * 60 * 1000 * 1000ULL;
+  *complete = false;
+  const uint64 now = Env::Default()->NowMicros();
+  mutex_lock l(chunks_mu_);
+  for (auto it = pending_chunks_.begin(); it != pending_chunks_.end();) {
+    if (now - it->second.last_chunk_micros > kChunkTimeoutMicros) {
+      LOG(WARNING) << "Dropping the graph registered in chunks with id "
+                   << it->first << ", whose next chunk did not arrive.";
+      it = pending_chunks_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  auto it = pending_chunks_.find(registration_id);
+  if (it == pending_chunks_.end()) {
+    if (chunk_index != 0) {
+      return errors::FailedPrecondition(
+          "Chunk ", chunk_index, " of the graph registered with id ",
+          registration_id,
+          " arrived without the earlier chunks, which may have expired.");
+    }
+    it = pending_chunks_.emplace(registration_id, PendingChunks()).first;
+  } else if (chunk_index != it->second.next_chunk_index) {
+    const int32 expected = it->second.next_chunk_index;
+    pending_chunks_.erase(it);
+    return errors::InvalidArgument("Expected chunk ", expected,
+                                   " of the graph registered with id ",
+                                   registration_id, ", got chunk ",
+                                   chunk_index);
+  }
+  PendingChunks* pending = &it->second;
+  pending->graph.MergeFrom(chunk);
+  ++pending->next_chunk_index;
+  pending->last_chunk_micros = now;
+  if (!is_last_chunk) return Status::OK();
+  gdef->Swap(&pending->graph);
+  pending_chunks_.erase(it);
+  *complete = true;
+  return Status::OK();
+}
+
 Status GraphMgr::Deregister(const string& handle) {
   Item* item = nullptr;
   // Removes one item from table_.
@@ -80,6 +80,14 @@ class GraphMgr {
                   DistributedFunctionLibraryRuntime* cluster_flr,
                   string* graph_handle);
 
+  // Buffers chunk "chunk_index" of a graph whose registration is split over
+  // several requests with the same "registration_id". Once "is_last_chunk"
+  // is set, sets "*complete" to true and moves the whole graph to "gdef".
+  // Fails if a chunk is missing, e.g. because the earlier chunks expired.
+  Status AddGraphChunk(int64 registration_id, int32 chunk_index,
+                       const GraphDef& chunk, bool is_last_chunk,
+                       bool* complete, GraphDef* gdef);
+
   // Executes one step of a registered graph "handle".
   //
   // If "out" is not nullptr, "out" specifies all keys the execution
@@ -162,6 +170,20 @@ class GraphMgr {
   // mechanism to gc these graphs.
   std::unordered_map<string, Item*> table_;
 
+  // A graph registered in chunks that has not received its last chunk.
+  struct PendingChunks {
+    GraphDef graph;
+    int32 next_chunk_index = 0;
+    uint64 last_chunk_micros = 0;
+  };
+
+  // Graphs registered in chunks, by registration id. They are freed with the
+  // session, and expire if their next chunk doesn't arrive in time, e.g.
+  // because the client went away.
+  mutex chunks_mu_;
+  std::unordered_map<int64, PendingChunks> pending_chunks_
+      GUARDED_BY(chunks_mu_);
+
   void StartParallelExecutors(const string& handle, int64 step_id, Item* item,
                               Rendezvous* rendezvous,
                               CollectiveExecutor::Handle* ce_handle,
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/master_session.h"
 
+#include <algorithm>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
@@ -42,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/refcount.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
@@ -50,6 +52,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
@@ -59,6 +62,10 @@ limitations under the License.
 
 namespace tensorflow {
 
+// The maximum number of partitions that are built and registered at once
+// when partitions are streamed to the workers.
+static const int kMaxConcurrentPartitions = 8;
+
 // MasterSession wraps ClientGraph in a reference counted object.
 // This way, MasterSession can clear up the cache mapping Run requests to
 // compiled graphs while the compiled graph is still being used.
@@ -305,6 +312,8 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
                                    const PartitionOptions& popts);
 
   // The actual graph partitioning and registration implementation.
+  void ComputeStartTimes(const ClientGraph& client_graph,
+                         PartitionOptions* popts);
   Status DoBuildPartitions(
       PartitionOptions popts, ClientGraph* client_graph,
       std::unordered_map<string, GraphDef>* out_partitions);
@@ -312,6 +321,20 @@ class MasterSession::ReffedClientGraph : public core::RefCounted {
       const PartitionOptions& popts,
       std::unordered_map<string, GraphDef> graph_partitions);
 
+  // Builds the partitions of one worker at a time, several in parallel, and
+  // registers each one as soon as it is built, in requests of about
+  // "chunk_bytes" each. Keeps the registered partitions in "graph_defs"
+  // unless it is null.
+  Status DoStreamPartitions(PartitionOptions popts, ClientGraph* client_graph,
+                            int64 chunk_bytes,
+                            std::unordered_map<string, GraphDef>* graph_defs);
+  // Registers "graph_def" with "worker", moving its nodes into requests of
+  // about "chunk_bytes" each. If "keep_graph_def" is true, "graph_def" holds
+  // the whole graph again once it is registered.
+  Status RegisterPartitionInChunks(WorkerInterface* worker,
+                                   GraphDef* graph_def, int64 chunk_bytes,
+                                   bool keep_graph_def, string* graph_handle);
+
   // Prepares a number of calls to workers. One call per partition.
   // This is a generic method that handles Run, PartialRun, and RunCallable.
   template <class FetchListType, class ClientRequestType,
@@ -342,21 +365,41 @@ Status MasterSession::ReffedClientGraph::RegisterPartitions(
       std::unique_ptr<ClientGraph> client_graph;
       std::swap(client_graph_before_register_, client_graph);
       mu_.unlock();
-      std::unordered_map<string, GraphDef> graph_defs;
       popts.flib_def = client_graph->flib_def.get();
-      Status s = DoBuildPartitions(popts, client_graph.get(), &graph_defs);
-      if (s.ok()) {
-        // NOTE(mrry): The pointers in `graph_defs_for_publishing` do not remain
-        // valid after the call to DoRegisterPartitions begins, so
-        // `stats_publisher_` must make a copy if it wants to retain the
-        // GraphDef objects.
-        std::vector<const GraphDef*> graph_defs_for_publishing;
-        graph_defs_for_publishing.reserve(partitions_.size());
-        for (const auto& name_def : graph_defs) {
-          graph_defs_for_publishing.push_back(&name_def.second);
+      const int64 chunk_bytes =
+          session_opts_.config.experimental().register_graph_chunk_bytes();
+      Status s;
+      if (chunk_bytes > 0) {
+        // The partitions are only held until they are registered, unless
+        // `stats_publisher_` needs them.
+        std::unordered_map<string, GraphDef> graph_defs;
+        const bool publish = stats_publisher_->PublishesGraphProto();
+        s = DoStreamPartitions(popts, client_graph.get(), chunk_bytes,
+                               publish ? &graph_defs : nullptr);
+        if (s.ok() && publish) {
+          std::vector<const GraphDef*> graph_defs_for_publishing;
+          graph_defs_for_publishing.reserve(graph_defs.size());
+          for (const auto& name_def : graph_defs) {
+            graph_defs_for_publishing.push_back(&name_def.second);
+          }
+          stats_publisher_->PublishGraphProto(graph_defs_for_publishing);
+        }
+      } else {
+        std::unordered_map<string, GraphDef> graph_defs;
+        s = DoBuildPartitions(popts, client_graph.get(), &graph_defs);
+        if (s.ok()) {
+          // NOTE(mrry): The pointers in `graph_defs_for_publishing` do not
+          // remain valid after the call to DoRegisterPartitions begins, so
+          // `stats_publisher_` must make a copy if it wants to retain the
+          // GraphDef objects.
+          std::vector<const GraphDef*> graph_defs_for_publishing;
+          graph_defs_for_publishing.reserve(partitions_.size());
+          for (const auto& name_def : graph_defs) {
+            graph_defs_for_publishing.push_back(&name_def.second);
+          }
+          stats_publisher_->PublishGraphProto(graph_defs_for_publishing);
+          s = DoRegisterPartitions(popts, std::move(graph_defs));
         }
-        stats_publisher_->PublishGraphProto(graph_defs_for_publishing);
-        s = DoRegisterPartitions(popts, std::move(graph_defs));
       }
       mu_.lock();
       init_result_ = s;
@@ -419,22 +462,152 @@ void MasterSession::ReffedClientGraph::TrackFeedsAndFetches(
   }
 }
 
+void MasterSession::ReffedClientGraph::ComputeStartTimes(
+    const ClientGraph& client_graph, PartitionOptions* popts) {
+  CostModel cost_model(true);
+  cost_model.InitFromGraph(client_graph.graph);
+  // TODO(yuanbyu): Use the real cost model.
+  // execution_state_->MergeFromGlobal(&cost_model);
+  if (popts->max_outstanding_recvs > 0) {
+    Status s =
+        EstimateCostsWithOpLevelCostModel(client_graph.graph, &cost_model);
+    if (!s.ok()) {
+      LOG(WARNING) << "Scheduling recvs with unit costs: " << s;
+    }
+  }
+  SlackAnalysis sa(&client_graph.graph, &cost_model);
+  if (popts->max_outstanding_recvs > 0) {
+    // Order the recvs by the latest time their consumers can start without
+    // delaying the step, so that the critical path is fed first.
+    const Microseconds makespan = -sa.ComputeAlap(&popts->start_times);
+    for (Microseconds& start_time : popts->start_times) {
+      start_time += makespan;
+    }
+  } else {
+    sa.ComputeAsap(&popts->start_times);
+  }
+}
+
 Status MasterSession::ReffedClientGraph::DoBuildPartitions(
     PartitionOptions popts, ClientGraph* client_graph,
     std::unordered_map<string, GraphDef>* out_partitions) {
   if (popts.need_to_record_start_times) {
-    CostModel cost_model(true);
-    cost_model.InitFromGraph(client_graph->graph);
-    // TODO(yuanbyu): Use the real cost model.
-    // execution_state_->MergeFromGlobal(&cost_model);
-    SlackAnalysis sa(&client_graph->graph, &cost_model);
-    sa.ComputeAsap(&popts.start_times);
+    ComputeStartTimes(*client_graph, &popts);
   }
 
   // Partition the graph.
   return Partition(popts, &client_graph->graph, out_partitions);
 }
 
+Status MasterSession::ReffedClientGraph::DoStreamPartitions(
+    PartitionOptions popts, ClientGraph* client_graph, int64 chunk_bytes,
+    std::unordered_map<string, GraphDef>* graph_defs) {
+  if (popts.need_to_record_start_times) {
+    ComputeStartTimes(*client_graph, &popts);
+  }
+
+  thread::ThreadPool pool(Env::Default(), "register_partitions",
+                          std::max(1, std::min(port::NumSchedulableCPUs(),
+                                               kMaxConcurrentPartitions)));
+  mutex mu;
+  auto consume = [this, &popts, &mu, chunk_bytes, graph_defs](
+                     const string& name, GraphDef* graph_def) -> Status {
+    Part part;
+    part.name = name;
+    TrackFeedsAndFetches(&part, *graph_def, popts);
+    {
+      mutex_lock l(mu);
+      part.worker = worker_cache_->GetOrCreateWorker(part.name);
+    }
+    if (part.worker == nullptr) {
+      return errors::NotFound("worker ", part.name);
+    }
+    Status s = RegisterPartitionInChunks(part.worker, graph_def, chunk_bytes,
+                                         graph_defs != nullptr,
+                                         &part.graph_handle);
+    mutex_lock l(mu);
+    if (graph_defs != nullptr) (*graph_defs)[name].Swap(graph_def);
+    partitions_.push_back(std::move(part));
+    return s;
+  };
+  return StreamPartitions(
+      popts, &client_graph->graph,
+      [&pool](std::function<void()> fn) { pool.Schedule(std::move(fn)); },
+      consume);
+}
+
+Status MasterSession::ReffedClientGraph::RegisterPartitionInChunks(
+    WorkerInterface* worker, GraphDef* graph_def, int64 chunk_bytes,
+    bool keep_graph_def, string* graph_handle) {
+  RegisterGraphRequest req;
+  RegisterGraphResponse resp;
+  req.set_session_handle(session_handle_);
+  req.set_create_worker_session_called(!should_deregister_);
+  *req.mutable_graph_options() = session_opts_.config.graph_options();
+  *req.mutable_debug_options() = callable_opts_.run_options().debug_options();
+  req.set_collective_graph_key(collective_graph_key_);
+  if (static_cast<int64>(graph_def->ByteSizeLong()) <= chunk_bytes) {
+    req.mutable_graph_def()->Swap(graph_def);
+    Status s = worker->RegisterGraph(&req, &resp);
+    if (keep_graph_def) graph_def->Swap(req.mutable_graph_def());
+    TF_RETURN_IF_ERROR(s);
+    *graph_handle = resp.graph_handle();
+    return Status::OK();
+  }
+
+  int64 registration_id = 0;
+  while (registration_id == 0) {
+    registration_id = static_cast<int64>(random::New64());
+  }
+  req.set_chunked_registration_id(registration_id);
+  // The first chunk also carries the versions and the function library.
+  GraphDef* chunk = req.mutable_graph_def();
+  chunk->mutable_versions()->Swap(graph_def->mutable_versions());
+  chunk->mutable_library()->Swap(graph_def->mutable_library());
+  // Nodes are moved from the back, which leaves the others in place, so they
+  // are reversed first to be sent in order.
+  auto* nodes = graph_def->mutable_node();
+  std::reverse(nodes->pointer_begin(), nodes->pointer_end());
+  GraphDef registered;
+  Status s;
+  for (int32 chunk_index = 0; s.ok(); ++chunk_index) {
+    int64 bytes = chunk->ByteSizeLong();
+    while (!nodes->empty() && bytes < chunk_bytes) {
+      NodeDef* node = nodes->ReleaseLast();
+      bytes += node->ByteSizeLong();
+      chunk->mutable_node()->AddAllocated(node);
+    }
+    req.set_chunk_index(chunk_index);
+    req.set_has_more_chunks(!nodes->empty());
+    s = worker->RegisterGraph(&req, &resp);
+    if (s.ok() && req.has_more_chunks() && !resp.graph_handle().empty()) {
+      // The worker registered the chunk on its own. Its handle is recorded
+      // so that the partial graph is deregistered with the others.
+      *graph_handle = resp.graph_handle();
+      s = errors::Unimplemented(
+          "The worker does not support RegisterGraph requests in chunks. "
+          "Unset ConfigProto.Experimental.register_graph_chunk_bytes.");
+    }
+    if (keep_graph_def) {
+      registered.mutable_versions()->Swap(chunk->mutable_versions());
+      registered.mutable_library()->Swap(chunk->mutable_library());
+      for (NodeDef& node : *chunk->mutable_node()) {
+        registered.add_node()->Swap(&node);
+      }
+    }
+    chunk->Clear();
+    if (!req.has_more_chunks()) break;
+  }
+  if (keep_graph_def) graph_def->Swap(&registered);
+  TF_RETURN_IF_ERROR(s);
+  if (resp.graph_handle().empty()) {
+    return errors::Internal("The worker did not return a handle for a graph "
+                            "registered in chunks.");
+  }
+  *graph_handle = resp.graph_handle();
+  return Status::OK();
+}
+
 Status MasterSession::ReffedClientGraph::DoRegisterPartitions(
     const PartitionOptions& popts,
     std::unordered_map<string, GraphDef> graph_partitions) {
@@ -1643,6 +1816,9 @@ Status MasterSession::BuildAndRegisterPartitions(ReffedClientGraph* rcg) {
   if (session_opts_.config.graph_options().enable_recv_scheduling()) {
     popts.scheduling_for_recvs = true;
     popts.need_to_record_start_times = true;
+    popts.max_outstanding_recvs = std::max(
+        0,
+        session_opts_.config.experimental().recv_scheduling_max_outstanding());
   }
 
   TF_RETURN_IF_ERROR(rcg->RegisterPartitions(std::move(popts)));
@@ -0,0 +1,266 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/recv_tensor_batcher.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/common_runtime/copy_tensor.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/distributed_runtime/rendezvous_mgr_interface.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Number of cleaned up steps that are remembered to reject late requests.
+constexpr size_t kMaxCleanedUpSteps = 1000;
+
+}  // namespace
+
+RecvTensorBatcher::RecvTensorBatcher(const WorkerEnv* env,
+                                     PrepareRecvFn prepare_recv)
+    : env_(env), prepare_recv_(std::move(prepare_recv)) {}
+
+void RecvTensorBatcher::RecvAsync(CallOptions* opts,
+                                  const RecvTensorBatchRequest* request,
+                                  RecvTensorBatchResponse* response,
+                                  StatusCallback done) {
+  if (request->rendezvous_key_size() == 0) {
+    done(errors::InvalidArgument(
+        "RecvTensorBatch requires at least one rendezvous key."));
+    return;
+  }
+  auto waiter = std::make_shared<Waiter>();
+  waiter->step_id = request->step_id();
+  waiter->request = request;
+  waiter->response = response;
+  waiter->opts = opts;
+  waiter->done = std::move(done);
+
+  // The cancellation callback is installed before the waiter becomes visible
+  // to SlotReady(), which clears it again in Respond().
+  opts->SetCancelCallback([this, waiter]() {
+    {
+      mutex_lock l(mu_);
+      if (waiter->completed) return;
+      waiter->completed = true;
+      DetachLocked(waiter);
+    }
+    // This runs while the RPC layer holds its cancellation lock, which the
+    // completion callback acquires, so respond from another thread.
+    SchedClosure([waiter]() {
+      waiter->done(errors::Cancelled("RecvTensorBatch was cancelled."));
+    });
+  });
+
+  std::vector<string> new_keys;
+  bool step_cleaned_up = false;
+  bool respond_cleaned_up = false;
+  {
+    mutex_lock l(mu_);
+    if (cleaned_up_steps_.count(waiter->step_id) > 0) {
+      // Creating the slots of a step that was cleaned up would leak them.
+      step_cleaned_up = true;
+      respond_cleaned_up = !waiter->completed;
+      waiter->completed = true;
+    } else {
+      StepSlots& slots = steps_[waiter->step_id];
+      for (const string& key : request->rendezvous_key()) {
+        auto it = slots.emplace(key, Slot());
+        if (it.second) new_keys.push_back(key);
+        if (!it.first->second.ready && !waiter->completed) {
+          it.first->second.waiters.push_back(waiter);
+        }
+      }
+    }
+  }
+  if (step_cleaned_up) {
+    if (respond_cleaned_up) {
+      opts->ClearCancelCallback();
+      waiter->done(errors::Aborted("Step ", waiter->step_id,
+                                   " was cleaned up before RecvTensorBatch "
+                                   "was received."));
+    }
+    return;
+  }
+  for (const string& key : new_keys) {
+    StartRecv(waiter->step_id, key);
+  }
+  bool completed = false;
+  {
+    mutex_lock l(mu_);
+    waiter->registering = false;
+    completed = !waiter->completed && TryCompleteLocked(waiter);
+  }
+  if (completed) Respond(waiter);
+}
+
+void RecvTensorBatcher::StartRecv(int64 step_id, const string& key) {
+  Rendezvous::ParsedKey parsed;
+  Status s = Rendezvous::ParseKey(key, &parsed);
+  Device* src_dev = nullptr;
+  if (s.ok()) {
+    s = prepare_recv_(parsed, &src_dev);
+  }
+  if (!s.ok()) {
+    SlotReady(step_id, key, s, Tensor(), false);
+    return;
+  }
+  env_->rendezvous_mgr->RecvLocalAsync(
+      step_id, parsed,
+      [this, step_id, key, src_dev](const Status& status,
+                                    const Rendezvous::Args& send_args,
+                                    const Rendezvous::Args& recv_args,
+                                    const Tensor& val, const bool is_dead) {
+        // Tensors are returned in the response proto, so values that live in
+        // accelerator memory are first copied to the host.
+        if (status.ok() && !is_dead && src_dev->tensorflow_gpu_device_info() &&
+            !send_args.alloc_attrs.on_host()) {
+          AllocatorAttributes alloc_attrs;
+          alloc_attrs.set_gpu_compatible(true);
+          alloc_attrs.set_on_host(true);
+          Allocator* alloc = src_dev->GetAllocator(alloc_attrs);
+          Tensor* copy = new Tensor(alloc, val.dtype(), val.shape());
+          StatusCallback copy_ready = [this, step_id, key, copy,
+                                       is_dead](const Status& s) {
+            SlotReady(step_id, key, s, *copy, is_dead);
+            delete copy;
+          };
+          CopyDeviceToHost(&val, alloc, alloc, key, src_dev, copy,
+                           send_args.device_context, std::move(copy_ready));
+          return;
+        }
+        SlotReady(step_id, key, status, val, is_dead);
+      });
+}
+
+void RecvTensorBatcher::SlotReady(int64 step_id, const string& key,
+                                  const Status& status, const Tensor& tensor,
+                                  bool is_dead) {
+  std::vector<std::shared_ptr<Waiter>> completed;
+  {
+    mutex_lock l(mu_);
+    auto step_it = steps_.find(step_id);
+    if (step_it == steps_.end()) return;
+    auto slot_it = step_it->second.find(key);
+    if (slot_it == step_it->second.end() || slot_it->second.ready) return;
+    Slot& slot = slot_it->second;
+    slot.ready = true;
+    slot.status = status;
+    slot.tensor = tensor;
+    slot.is_dead = is_dead;
+    std::vector<std::shared_ptr<Waiter>> waiters;
+    waiters.swap(slot.waiters);
+    // NOTE: `slot` may be erased by TryCompleteLocked() below.
+    for (const auto& waiter : waiters) {
+      if (waiter->completed || waiter->registering) continue;
+      if (TryCompleteLocked(waiter)) completed.push_back(waiter);
+    }
+  }
+  for (const auto& waiter : completed) {
+    Respond(waiter);
+  }
+}
+
+bool RecvTensorBatcher::TryCompleteLocked(
+    const std::shared_ptr<Waiter>& waiter) {
+  auto step_it = steps_.find(waiter->step_id);
+  if (step_it == steps_.end()) return false;
+  StepSlots& slots = step_it->second;
+  const auto& keys = waiter->request->rendezvous_key();
+  for (int i = 0; i < keys.size(); ++i) {
+    auto slot_it = slots.find(keys[i]);
+    if (slot_it == slots.end() || !slot_it->second.ready) continue;
+    Slot& slot = slot_it->second;
+    waiter->results.push_back(
+        {i, std::move(slot.status), std::move(slot.tensor), slot.is_dead});
+    slots.erase(slot_it);
+  }
+  if (waiter->results.empty()) return false;
+  waiter->completed = true;
+  DetachLocked(waiter);
+  return true;
+}
+
+void RecvTensorBatcher::DetachLocked(const std::shared_ptr<Waiter>& waiter) {
+  auto step_it = steps_.find(waiter->step_id);
+  if (step_it == steps_.end()) return;
+  for (const string& key : waiter->request->rendezvous_key()) {
+    auto slot_it = step_it->second.find(key);
+    if (slot_it == step_it->second.end()) continue;
+    auto& waiters = slot_it->second.waiters;
+    waiters.erase(std::remove(waiters.begin(), waiters.end(), waiter),
+                  waiters.end());
+  }
+}
+
+void RecvTensorBatcher::Respond(const std::shared_ptr<Waiter>& waiter) {
+  waiter->opts->ClearCancelCallback();
+  RecvTensorBatchResponse* response = waiter->response;
+  response->set_send_start_micros(env_->env->NowMicros());
+  for (Ready& ready : waiter->results) {
+    RecvTensorBatchResponse::Entry* entry = response->add_entry();
+    entry->set_index(ready.index);
+    if (ready.status.ok()) {
+      entry->set_is_dead(ready.is_dead);
+      if (!ready.is_dead) {
+        ready.tensor.AsProtoTensorContent(entry->mutable_tensor());
+      }
+    } else {
+      entry->set_status_code(ready.status.code());
+      entry->set_status_error_message(ready.status.error_message());
+    }
+  }
+  waiter->results.clear();
+  waiter->done(Status::OK());
+}
+
+void RecvTensorBatcher::CleanupStep(int64 step_id) {
+  std::vector<std::shared_ptr<Waiter>> aborted;
+  {
+    mutex_lock l(mu_);
+    if (cleaned_up_steps_.insert(step_id).second) {
+      cleaned_up_order_.push_back(step_id);
+      if (cleaned_up_order_.size() > kMaxCleanedUpSteps) {
+        cleaned_up_steps_.erase(cleaned_up_order_.front());
+        cleaned_up_order_.pop_front();
+      }
+    }
+    auto step_it = steps_.find(step_id);
+    if (step_it == steps_.end()) return;
+    for (auto& key_and_slot : step_it->second) {
+      for (const auto& waiter : key_and_slot.second.waiters) {
+        if (!waiter->completed) {
+          waiter->completed = true;
+          aborted.push_back(waiter);
+        }
+      }
+    }
+    steps_.erase(step_it);
+  }
+  for (const auto& waiter : aborted) {
+    waiter->opts->ClearCancelCallback();
+    waiter->done(errors::Aborted("Step ", step_id,
+                                 " was cleaned up before its tensors were "
+                                 "received by RecvTensorBatch."));
+  }
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,134 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RECV_TENSOR_BATCHER_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RECV_TENSOR_BATCHER_H_
+
+#include <functional>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/distributed_runtime/call_options.h"
+#include "tensorflow/core/distributed_runtime/worker_env.h"
+#include "tensorflow/core/distributed_runtime/worker_interface.h"
+#include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+
+class Device;
+
+// Serves RecvTensorBatch requests on the worker that produces the tensors.
+//
+// Every requested rendezvous key is received from the local rendezvous
+// exactly once.  A request is answered as soon as at least one of its tensors
+// is available, with all of its tensors that are available at that time.
+// Tensors that become available later are buffered here until a subsequent
+// request for the same key picks them up, or until the step is cleaned up.
+// Cancelling a request before it is answered does not drop any tensor, but
+// the tensors of a request that was answered are dropped even if the
+// response does not reach the client.  Requests for a step that was recently
+// cleaned up fail.
+class RecvTensorBatcher {
+ public:
+  // Validates the source device of a rendezvous key and returns it.
+  typedef std::function<Status(const Rendezvous::ParsedKey&, Device**)>
+      PrepareRecvFn;
+
+  RecvTensorBatcher(const WorkerEnv* env, PrepareRecvFn prepare_recv);
+
+  void RecvAsync(CallOptions* opts, const RecvTensorBatchRequest* request,
+                 RecvTensorBatchResponse* response, StatusCallback done);
+
+  // Discards the tensors buffered for `step_id`, fails the requests still
+  // waiting for them and fails the requests for `step_id` that arrive later.
+  void CleanupStep(int64 step_id);
+
+ private:
+  struct Waiter;
+
+  struct Slot {
+    bool ready = false;
+    Status status;
+    Tensor tensor;
+    bool is_dead = false;
+    // Requests waiting for this tensor.
+    std::vector<std::shared_ptr<Waiter>> waiters;
+  };
+
+  // A tensor taken out of its slot to be returned.
+  struct Ready {
+    int index;
+    Status status;
+    Tensor tensor;
+    bool is_dead;
+  };
+
+  struct Waiter {
+    int64 step_id;
+    const RecvTensorBatchRequest* request;
+    RecvTensorBatchResponse* response;
+    CallOptions* opts;
+    StatusCallback done;
+    // Set while the request registers its keys, so that tensors which are
+    // already available are returned together.
+    bool registering = true;
+    bool completed = false;
+    std::vector<Ready> results;
+  };
+
+  typedef std::unordered_map<string, Slot> StepSlots;
+
+  // Starts receiving `key` from the local rendezvous.
+  void StartRecv(int64 step_id, const string& key);
+
+  // Records the outcome of receiving `key`, and completes the requests that
+  // were waiting for it.
+  void SlotReady(int64 step_id, const string& key, const Status& status,
+                 const Tensor& tensor, bool is_dead);
+
+  // Moves the available tensors of `waiter` out of their slots and detaches
+  // it from the others.  Returns false if nothing is available yet.
+  bool TryCompleteLocked(const std::shared_ptr<Waiter>& waiter)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void DetachLocked(const std::shared_ptr<Waiter>& waiter)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Fills the response of a completed `waiter` and runs its callback.
+  void Respond(const std::shared_ptr<Waiter>& waiter);
+
+  const WorkerEnv* const env_;  // Not owned.
+  const PrepareRecvFn prepare_recv_;
+
+  mutex mu_;
+  std::unordered_map<int64, StepSlots> steps_ GUARDED_BY(mu_);
+  // The most recently cleaned up steps, oldest first.
+  std::deque<int64> cleaned_up_order_ GUARDED_BY(mu_);
+  std::unordered_set<int64> cleaned_up_steps_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RecvTensorBatcher);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RECV_TENSOR_BATCHER_H_
@@ -0,0 +1,187 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/recv_tensor_batcher.h"
+
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
+#include "tensorflow/core/distributed_runtime/worker_session.h"
+#include "tensorflow/core/framework/control_flow.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+const char kWorker[] = "/job:mnist/replica:1/task:2";
+const int64 kStepId = 123;
+
+string Key(const string& name) {
+  return Rendezvous::CreateKey("/job:mnist/replica:1/task:2/cpu:0", 7890,
+                               "/job:mnist/replica:1/task:3/cpu:0", name,
+                               FrameAndIter(0, 0));
+}
+
+// Issues a RecvTensorBatch request and records its outcome.
+struct BatchCall {
+  CallOptions opts;
+  RecvTensorBatchRequest request;
+  RecvTensorBatchResponse response;
+  Status status;
+  Notification done;
+
+  BatchCall(RecvTensorBatcher* batcher, const std::vector<string>& names) {
+    request.set_step_id(kStepId);
+    for (const string& name : names) {
+      request.add_rendezvous_key(Key(name));
+    }
+    batcher->RecvAsync(&opts, &request, &response, [this](const Status& s) {
+      status = s;
+      done.Notify();
+    });
+  }
+
+  float Value(int entry) {
+    Tensor t;
+    CHECK(t.FromProto(response.entry(entry).tensor()));
+    return t.scalar<float>()();
+  }
+};
+
+class RecvTensorBatcherTest : public ::testing::Test {
+ protected:
+  RecvTensorBatcherTest()
+      : device_(DeviceFactory::NewDevice("CPU", {}, kWorker)),
+        worker_session_("rpc_session", kWorker,
+                        std::unique_ptr<WorkerCacheInterface>(),
+                        std::unique_ptr<DeviceMgr>(),
+                        std::unique_ptr<GraphMgr>(), nullptr),
+        rmgr_(&env_),
+        batcher_(&env_, [this](const Rendezvous::ParsedKey& parsed,
+                               Device** src_dev) {
+          if (parsed.edge_name == "bad") {
+            return errors::InvalidArgument("Bad key");
+          }
+          *src_dev = device_.get();
+          return Status::OK();
+        }) {
+    env_.env = Env::Default();
+    env_.rendezvous_mgr = &rmgr_;
+    rendez_ = rmgr_.Find(kStepId);
+    TF_CHECK_OK(rendez_->Initialize(&worker_session_));
+  }
+
+  ~RecvTensorBatcherTest() override {
+    rendez_->Unref();
+    rmgr_.Cleanup(kStepId);
+  }
+
+  void Send(const string& name, float value) {
+    Rendezvous::ParsedKey parsed;
+    TF_ASSERT_OK(Rendezvous::ParseKey(Key(name), &parsed));
+    TF_ASSERT_OK(rendez_->Send(parsed, Rendezvous::Args(),
+                               test::AsScalar<float>(value), false));
+  }
+
+  WorkerEnv env_;
+  std::unique_ptr<Device> device_;
+  WorkerSession worker_session_;
+  RpcRendezvousMgr rmgr_;
+  RecvTensorBatcher batcher_;
+  RemoteRendezvous* rendez_;
+};
+
+TEST_F(RecvTensorBatcherTest, ReturnsAvailableTensorsTogether) {
+  Send("a", 1.0);
+  Send("b", 2.0);
+  BatchCall first(&batcher_, {"a", "b", "c"});
+  ASSERT_TRUE(first.done.HasBeenNotified());
+  TF_ASSERT_OK(first.status);
+  ASSERT_EQ(2, first.response.entry_size());
+  EXPECT_EQ(0, first.response.entry(0).index());
+  EXPECT_EQ(1.0, first.Value(0));
+  EXPECT_EQ(1, first.response.entry(1).index());
+  EXPECT_EQ(2.0, first.Value(1));
+
+  // "c" stays buffered until it is requested again.
+  Send("c", 3.0);
+  BatchCall second(&batcher_, {"c"});
+  ASSERT_TRUE(second.done.HasBeenNotified());
+  TF_ASSERT_OK(second.status);
+  ASSERT_EQ(1, second.response.entry_size());
+  EXPECT_EQ(3.0, second.Value(0));
+}
+
+TEST_F(RecvTensorBatcherTest, WaitsForFirstTensor) {
+  BatchCall call(&batcher_, {"a", "b"});
+  EXPECT_FALSE(call.done.HasBeenNotified());
+  Send("b", 2.0);
+  call.done.WaitForNotification();
+  TF_ASSERT_OK(call.status);
+  ASSERT_EQ(1, call.response.entry_size());
+  EXPECT_EQ(1, call.response.entry(0).index());
+  EXPECT_EQ(2.0, call.Value(0));
+}
+
+TEST_F(RecvTensorBatcherTest, PerTensorError) {
+  Send("a", 1.0);
+  BatchCall call(&batcher_, {"bad", "a"});
+  ASSERT_TRUE(call.done.HasBeenNotified());
+  TF_ASSERT_OK(call.status);
+  ASSERT_EQ(2, call.response.entry_size());
+  EXPECT_EQ(0, call.response.entry(0).index());
+  EXPECT_EQ(error::INVALID_ARGUMENT, call.response.entry(0).status_code());
+  EXPECT_EQ(1, call.response.entry(1).index());
+  EXPECT_EQ(error::OK, call.response.entry(1).status_code());
+  EXPECT_EQ(1.0, call.Value(1));
+}
+
+TEST_F(RecvTensorBatcherTest, CancellationKeepsTensor) {
+  BatchCall cancelled(&batcher_, {"a"});
+  cancelled.opts.StartCancel();
+  cancelled.done.WaitForNotification();
+  EXPECT_TRUE(errors::IsCancelled(cancelled.status));
+
+  Send("a", 1.0);
+  BatchCall retried(&batcher_, {"a"});
+  ASSERT_TRUE(retried.done.HasBeenNotified());
+  TF_ASSERT_OK(retried.status);
+  ASSERT_EQ(1, retried.response.entry_size());
+  EXPECT_EQ(1.0, retried.Value(0));
+}
+
+TEST_F(RecvTensorBatcherTest, CleanupStepAbortsWaiters) {
+  BatchCall call(&batcher_, {"a"});
+  EXPECT_FALSE(call.done.HasBeenNotified());
+  batcher_.CleanupStep(kStepId);
+  ASSERT_TRUE(call.done.HasBeenNotified());
+  EXPECT_TRUE(errors::IsAborted(call.status));
+}
+
+TEST_F(RecvTensorBatcherTest, RequestAfterCleanupStepFails) {
+  batcher_.CleanupStep(kStepId);
+  Send("a", 1.0);
+  BatchCall late(&batcher_, {"a"});
+  ASSERT_TRUE(late.done.HasBeenNotified());
+  EXPECT_TRUE(errors::IsAborted(late.status));
+  EXPECT_EQ(0, late.response.entry_size());
+}
+
+}  // namespace
+}  // namespace tensorflow
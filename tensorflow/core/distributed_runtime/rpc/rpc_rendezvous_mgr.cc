@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <algorithm>
+#include <deque>
+#include <memory>
 #include <unordered_set>
 
 #include "tensorflow/core/common_runtime/device.h"
@@ -27,20 +30,26 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/worker_interface.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/refcount.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
 namespace {
 
+class BatchedRecvTensorCall;
+
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
-  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id)
-      : BaseRemoteRendezvous(env, step_id) {}
+  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id,
+                      int64 recv_tensor_batch_size)
+      : BaseRemoteRendezvous(env, step_id),
+        recv_tensor_batch_size_(recv_tensor_batch_size) {}
 
  protected:
   void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
@@ -48,8 +57,71 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
                            DoneCallback done) override;
 
  private:
+  friend class BatchedRecvTensorCall;
+
+  // State of one RecvTensorBatch call.
+  struct RecvBatch {
+    string src_worker;
+    WorkerInterface* wi = nullptr;
+    CallOptions opts;
+    RecvTensorBatchRequest req;
+    RecvTensorBatchResponse resp;
+    // One call per key in `req`, in the same order.  Each holds a reference.
+    std::vector<BatchedRecvTensorCall*> calls;
+    // Set when one of `calls` was aborted, so that the RPC is cancelled and
+    // the remaining calls fail with the same status.  They are not requested
+    // again, since the remote worker may have taken their tensors for the
+    // response that was cancelled.
+    Status abort_status;
+  };
+
+  // Receives from a single remote worker that are waiting to be batched.
+  struct RecvBatchPeer {
+    std::deque<BatchedRecvTensorCall*> queued;
+    bool flush_scheduled = false;
+    // Set once the remote worker rejected RecvTensorBatch.
+    bool unsupported = false;
+  };
+
   ~RpcRemoteRendezvous() override {}
 
+  // Receives "parsed" with a RecvTensor call of its own.
+  void RecvTensorAsync(const Rendezvous::ParsedKey& parsed,
+                       const Rendezvous::Args& recv_args, DoneCallback done);
+
+  // Queues "parsed" to be received from "src_worker" with other tensors of
+  // the same step in a RecvTensorBatch call.
+  void RecvBatchedAsync(const Rendezvous::ParsedKey& parsed,
+                        const string& src_worker, Device* dst_device,
+                        const Rendezvous::Args& recv_args, DoneCallback done);
+
+  void MaybeScheduleFlushLocked(const string& src_worker, RecvBatchPeer* peer)
+      EXCLUSIVE_LOCKS_REQUIRED(batch_mu_);
+  void FlushBatch(const string& src_worker);
+  void BatchDone(RecvBatch* batch, const Status& s);
+
+  // Falls back to a RecvTensor call for a receive that was queued for
+  // batching, unless it has already finished.
+  void UnbatchRecv(BatchedRecvTensorCall* call);
+
+  // Runs the callback of "call" unless it has already run.
+  void FinishBatchedRecv(BatchedRecvTensorCall* call, const Status& s,
+                         const Tensor& val, bool is_dead);
+
+  // Aborts "call" from a separate closure, since BaseRemoteRendezvous holds
+  // its lock while aborting calls, and cancels the RecvTensorBatch call that
+  // is waiting for it.  Otherwise an aborted step could leave that call
+  // pending forever on the remote worker.
+  void AbortBatchedRecv(BatchedRecvTensorCall* call, const Status& s);
+
+  // Maximum number of tensors per RecvTensorBatch call.  Batching is
+  // disabled if this is not positive.
+  const int64 recv_tensor_batch_size_;
+
+  mutex batch_mu_;
+  std::unordered_map<string, RecvBatchPeer> batch_peers_ GUARDED_BY(batch_mu_);
+  std::unordered_set<RecvBatch*> batches_in_flight_ GUARDED_BY(batch_mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
@@ -208,10 +280,9 @@ static RpcRecvTensorFreeList* get_call_freelist() {
   return call_freelist;
 }
 
-void RpcRemoteRendezvous::RecvFromRemoteAsync(
-    const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
-    DoneCallback done) {
-  CHECK(is_initialized());
+void RpcRemoteRendezvous::RecvTensorAsync(const Rendezvous::ParsedKey& parsed,
+                                          const Rendezvous::Args& recv_args,
+                                          DoneCallback done) {
   Status s;
 
   // Prepare a RecvTensor call that can handle being aborted.
@@ -281,14 +352,330 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
   });
 }
 
+// A receive that is issued as part of a RecvTensorBatch call.  Registered
+// with the rendezvous like any other call, so that it is aborted and
+// cancelled individually.
+class BatchedRecvTensorCall : public BaseRecvTensorCall,
+                              public core::RefCounted {
+ public:
+  BatchedRecvTensorCall(RpcRemoteRendezvous* rendezvous,
+                        const Rendezvous::ParsedKey& parsed,
+                        Device* dst_device, const Rendezvous::Args& recv_args,
+                        Rendezvous::DoneCallback done)
+      : rendezvous_(rendezvous),
+        parsed_(parsed),
+        dst_device_(dst_device),
+        recv_args_(recv_args),
+        done_(std::move(done)) {}
+
+  // Batched calls are issued by RpcRemoteRendezvous::FlushBatch().
+  void Start(std::function<void()> recv_done) override {}
+
+  void StartAbort(const Status& s) override {
+    {
+      mutex_lock l(mu_);
+      status_.Update(s);
+    }
+    rendezvous_->AbortBatchedRecv(this, s);
+  }
+
+  Status status() const override {
+    mutex_lock l(mu_);
+    return status_;
+  }
+
+  // Moves the callback into "*done" and returns true, unless it has already
+  // been taken.
+  bool TakeDone(Rendezvous::DoneCallback* done) {
+    mutex_lock l(mu_);
+    if (done_ == nullptr) return false;
+    *done = std::move(done_);
+    done_ = nullptr;
+    return true;
+  }
+
+  bool finished() const {
+    mutex_lock l(mu_);
+    return done_ == nullptr;
+  }
+
+  const Rendezvous::ParsedKey& parsed() const { return parsed_; }
+  Device* dst_device() const { return dst_device_; }
+  const Rendezvous::Args& recv_args() const { return recv_args_; }
+
+ private:
+  ~BatchedRecvTensorCall() override {}
+
+  RpcRemoteRendezvous* const rendezvous_;  // Not owned.
+  const Rendezvous::ParsedKey parsed_;
+  Device* const dst_device_;
+  const Rendezvous::Args recv_args_;
+
+  mutable mutex mu_;
+  Status status_ GUARDED_BY(mu_);
+  Rendezvous::DoneCallback done_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BatchedRecvTensorCall);
+};
+
+void RpcRemoteRendezvous::RecvFromRemoteAsync(
+    const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
+    DoneCallback done) {
+  CHECK(is_initialized());
+  if (recv_tensor_batch_size_ > 0 && env_->compute_pool != nullptr) {
+    // Batched tensors travel in the response proto and are parsed into host
+    // memory, so only receives into host memory are batched.
+    string src_worker;
+    string src_rel_device;
+    Device* dst_device = nullptr;
+    if (DeviceNameUtils::SplitDeviceName(parsed.src_device, &src_worker,
+                                         &src_rel_device) &&
+        session()->device_mgr()->LookupDevice(parsed.dst_device, &dst_device)
+            .ok() &&
+        (dst_device->device_type() == DEVICE_CPU ||
+         recv_args.alloc_attrs.on_host())) {
+      RecvBatchedAsync(parsed, src_worker, dst_device, recv_args,
+                       std::move(done));
+      return;
+    }
+  }
+  RecvTensorAsync(parsed, recv_args, std::move(done));
+}
+
+void RpcRemoteRendezvous::RecvBatchedAsync(const Rendezvous::ParsedKey& parsed,
+                                           const string& src_worker,
+                                           Device* dst_device,
+                                           const Rendezvous::Args& recv_args,
+                                           DoneCallback done) {
+  bool unsupported;
+  {
+    mutex_lock l(batch_mu_);
+    unsupported = batch_peers_[src_worker].unsupported;
+  }
+  if (unsupported) {
+    RecvTensorAsync(parsed, recv_args, std::move(done));
+    return;
+  }
+
+  BatchedRecvTensorCall* call = new BatchedRecvTensorCall(
+      this, parsed, dst_device, recv_args, std::move(done));
+  // Record "call" in active_ so that it can be aborted cleanly.  If the
+  // rendezvous is already aborted, StartAbort() finishes the call.
+  RegisterCall(call, recv_args);
+  if (!call->status().ok()) {
+    call->Unref();
+    return;
+  }
+
+  mutex_lock l(batch_mu_);
+  RecvBatchPeer* peer = &batch_peers_[src_worker];
+  peer->queued.push_back(call);
+  MaybeScheduleFlushLocked(src_worker, peer);
+}
+
+void RpcRemoteRendezvous::MaybeScheduleFlushLocked(const string& src_worker,
+                                                   RecvBatchPeer* peer) {
+  // The number of calls in flight is not limited: each call waits on the
+  // remote worker until one of its tensors is produced, and that may depend
+  // on a tensor that is still queued here.
+  if (peer->flush_scheduled || peer->queued.empty()) return;
+  // Flushing from a closure lets the receives issued by the executor in the
+  // meantime join the batch.
+  peer->flush_scheduled = true;
+  Ref();
+  env_->compute_pool->Schedule([this, src_worker]() {
+    FlushBatch(src_worker);
+    Unref();
+  });
+}
+
+void RpcRemoteRendezvous::FlushBatch(const string& src_worker) {
+  std::shared_ptr<RecvBatch> batch = std::make_shared<RecvBatch>();
+  std::vector<BatchedRecvTensorCall*> unbatched;
+  {
+    mutex_lock l(batch_mu_);
+    RecvBatchPeer* peer = &batch_peers_[src_worker];
+    peer->flush_scheduled = false;
+    if (peer->unsupported) {
+      unbatched.assign(peer->queued.begin(), peer->queued.end());
+      peer->queued.clear();
+    }
+    while (!peer->queued.empty() &&
+           static_cast<int64>(batch->calls.size()) < recv_tensor_batch_size_) {
+      BatchedRecvTensorCall* call = peer->queued.front();
+      peer->queued.pop_front();
+      if (call->finished()) {
+        call->Unref();
+        continue;
+      }
+      batch->calls.push_back(call);
+    }
+    if (!batch->calls.empty()) {
+      batches_in_flight_.insert(batch.get());
+    }
+    MaybeScheduleFlushLocked(src_worker, peer);
+  }
+  for (BatchedRecvTensorCall* call : unbatched) {
+    UnbatchRecv(call);
+  }
+  if (batch->calls.empty()) return;
+
+  batch->src_worker = src_worker;
+  batch->wi = session()->worker_cache()->GetOrCreateWorker(src_worker);
+  if (batch->wi == nullptr) {
+    BatchDone(batch.get(), errors::Internal("No worker known as ", src_worker));
+    return;
+  }
+  batch->req.set_step_id(step_id_);
+  for (BatchedRecvTensorCall* call : batch->calls) {
+    const StringPiece key = call->parsed().FullKey();
+    batch->req.add_rendezvous_key(key.data(), key.size());
+  }
+  batch->req.set_request_id(GetUniqueRequestId());
+
+  Ref();
+  batch->wi->RecvTensorBatchAsync(&batch->opts, &batch->req, &batch->resp,
+                                  [this, batch](const Status& s) {
+                                    BatchDone(batch.get(), s);
+                                    Unref();
+                                  });
+
+  // A call aborted before the RPC installed its cancellation callback did not
+  // cancel it.
+  mutex_lock l(batch_mu_);
+  if (!batch->abort_status.ok() &&
+      batches_in_flight_.count(batch.get()) > 0) {
+    batch->opts.StartCancel();
+  }
+}
+
+void RpcRemoteRendezvous::BatchDone(RecvBatch* batch, const Status& s) {
+  Status abort_status;
+  {
+    mutex_lock l(batch_mu_);
+    batches_in_flight_.erase(batch);
+    abort_status = batch->abort_status;
+  }
+  // NOTE: `*session()` can potentially be deleted before we return from the
+  // callbacks, so we must release the worker before calling them.
+  if (batch->wi != nullptr) {
+    session()->worker_cache()->ReleaseWorker(batch->src_worker, batch->wi);
+    batch->wi = nullptr;
+  }
+
+  const int num_calls = batch->calls.size();
+  std::vector<bool> delivered(num_calls, false);
+  if (s.ok()) {
+    for (const auto& entry : batch->resp.entry()) {
+      const int index = entry.index();
+      if (index < 0 || index >= num_calls || delivered[index]) continue;
+      delivered[index] = true;
+      BatchedRecvTensorCall* call = batch->calls[index];
+      Status entry_status;
+      if (entry.status_code() != error::OK) {
+        entry_status =
+            Status(entry.status_code(), entry.status_error_message());
+      }
+      Tensor val;
+      if (entry_status.ok() && !entry.is_dead()) {
+        Allocator* allocator =
+            call->dst_device()->GetAllocator(call->recv_args().alloc_attrs);
+        if (!val.FromProto(allocator, entry.tensor())) {
+          entry_status = errors::Internal("Invalid tensor received for ",
+                                          call->parsed().FullKey());
+        }
+      }
+      FinishBatchedRecv(call, entry_status, val, entry.is_dead());
+    }
+  }
+
+  // Tensors that were not ready yet stay buffered on the remote worker and
+  // are requested again.
+  const bool unsupported = errors::IsUnimplemented(s);
+  const Status& failure =
+      !abort_status.ok() && errors::IsCancelled(s) ? abort_status : s;
+  std::vector<BatchedRecvTensorCall*> retry;
+  for (int i = 0; i < num_calls; ++i) {
+    BatchedRecvTensorCall* call = batch->calls[i];
+    if (delivered[i]) {
+      call->Unref();
+    } else if (unsupported) {
+      UnbatchRecv(call);
+    } else if (!s.ok()) {
+      FinishBatchedRecv(call, failure, Tensor(), false);
+      call->Unref();
+    } else {
+      retry.push_back(call);
+    }
+  }
+
+  mutex_lock l(batch_mu_);
+  RecvBatchPeer* peer = &batch_peers_[batch->src_worker];
+  if (unsupported) {
+    VLOG(1) << batch->src_worker
+            << " does not support RecvTensorBatch, using RecvTensor.";
+    peer->unsupported = true;
+  }
+  peer->queued.insert(peer->queued.begin(), retry.begin(), retry.end());
+  MaybeScheduleFlushLocked(batch->src_worker, peer);
+}
+
+void RpcRemoteRendezvous::UnbatchRecv(BatchedRecvTensorCall* call) {
+  DoneCallback done;
+  if (call->TakeDone(&done)) {
+    DeregisterCall(call);
+    RecvTensorAsync(call->parsed(), call->recv_args(), std::move(done));
+  }
+  call->Unref();
+}
+
+void RpcRemoteRendezvous::FinishBatchedRecv(BatchedRecvTensorCall* call,
+                                            const Status& s,
+                                            const Tensor& val, bool is_dead) {
+  DoneCallback done;
+  if (!call->TakeDone(&done)) return;
+  DeregisterCall(call);
+  done(s, Args(), call->recv_args(), val, is_dead);
+}
+
+void RpcRemoteRendezvous::AbortBatchedRecv(BatchedRecvTensorCall* call,
+                                           const Status& s) {
+  Ref();
+  call->Ref();
+  env_->compute_pool->Schedule([this, call, s]() {
+    FinishBatchedRecv(call, s, Tensor(), false);
+    {
+      // Cancellation completes the RPC asynchronously, so BatchDone() does
+      // not run while batch_mu_ is held here.
+      mutex_lock l(batch_mu_);
+      for (RecvBatch* batch : batches_in_flight_) {
+        if (std::find(batch->calls.begin(), batch->calls.end(), call) !=
+            batch->calls.end()) {
+          batch->abort_status.Update(s);
+          batch->opts.StartCancel();
+        }
+      }
+    }
+    call->Unref();
+    Unref();
+  });
+}
+
 }  // namespace
 
 RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env)
-    : BaseRendezvousMgr(env) {}
+    : BaseRendezvousMgr(env) {
+  Status s = ReadInt64FromEnvVar("TF_RPC_RECV_TENSOR_BATCH_SIZE", 0,
+                                 &recv_tensor_batch_size_);
+  if (!s.ok()) {
+    LOG(WARNING) << "Not batching RecvTensor calls: " << s;
+    recv_tensor_batch_size_ = 0;
+  }
+}
 
 BaseRemoteRendezvous* RpcRendezvousMgr::Create(int64 step_id,
                                                const WorkerEnv* worker_env) {
-  return new RpcRemoteRendezvous(worker_env, step_id);
+  return new RpcRemoteRendezvous(worker_env, step_id, recv_tensor_batch_size_);
 }
 
 }  // end namespace tensorflow
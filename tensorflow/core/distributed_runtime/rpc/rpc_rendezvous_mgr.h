@@ -42,6 +42,12 @@ class DeviceMgr;
 //
 // Tensors sent and recved through rendezvous managed by this
 // RendezvousMgr must have keys generated by Rendezvous::CreateKey.
+//
+// Setting the environment variable TF_RPC_RECV_TENSOR_BATCH_SIZE to a
+// positive value makes receives into host memory from the same remote worker
+// share RecvTensorBatch calls of up to that many tensors, which reduces the
+// per-RPC overhead of partitions exchanging many small tensors.  A value that
+// is not an integer is ignored with a warning.
 class RpcRendezvousMgr : public BaseRendezvousMgr {
  public:
   explicit RpcRendezvousMgr(const WorkerEnv* env);
@@ -50,6 +56,8 @@ class RpcRendezvousMgr : public BaseRendezvousMgr {
   BaseRemoteRendezvous* Create(int64 step_id, const WorkerEnv* worker_env);
 
  private:
+  int64 recv_tensor_batch_size_ = 0;
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRendezvousMgr);
 };
 
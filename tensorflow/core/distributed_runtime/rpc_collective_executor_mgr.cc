@@ -50,7 +50,7 @@ CollectiveExecutor* RpcCollectiveExecutorMgr::Create(int64 step_id) {
       new CollectiveRemoteAccessDistributed(
           dev_mgr_, dev_resolver_.get(), work_queue_, worker_cache_, step_id);
   return new BaseCollectiveExecutor(this, rma, step_id, dev_mgr_,
-                                    &gpu_ring_order_);
+                                    &gpu_ring_order_, bucketer_.get());
 }
 
 namespace {
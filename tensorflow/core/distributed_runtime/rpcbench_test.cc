@@ -13,7 +13,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <functional>
 #include <string>
 #include <vector>
@@ -104,11 +106,11 @@ struct Cluster {
   std::vector<string> workers;
   std::vector<DeviceAttributes> devices;  // One per process
 
-  Cluster() {
+  explicit Cluster(int num_workers = kWorkers) {
     (*options.config.mutable_device_count())["CPU"] = 1;
     options.config.set_intra_op_parallelism_threads(1);
     options.config.set_inter_op_parallelism_threads(1);
-    MakeGRPCCluster(options, kWorkers, &workers, &devices);
+    MakeGRPCCluster(options, num_workers, &workers, &devices);
     LOG(ERROR) << "C " << workers.size() << " " << devices.size() << " "
                << workers[0] << " " << workers[1];
     options.target = workers[0];
@@ -120,6 +122,21 @@ static const Cluster* GetCluster() {
   return result;
 }
 
+// A two worker cluster whose workers receive tensors from each other with
+// RecvTensorBatch calls of up to `kRecvTensorBatchSize` tensors.
+static const int kRecvTensorBatchSize = 256;
+static const Cluster* GetBatchedRecvCluster() {
+  static Cluster* result = [] {
+    // The rendezvous managers read this when the servers are created.
+    setenv("TF_RPC_RECV_TENSOR_BATCH_SIZE",
+           strings::StrCat(kRecvTensorBatchSize).c_str(), 1);
+    Cluster* cluster = new Cluster(2);
+    unsetenv("TF_RPC_RECV_TENSOR_BATCH_SIZE");
+    return cluster;
+  }();
+  return result;
+}
+
 // Make a program with specified number of stages and "width" ops per stage.
 GraphDef CreateGraphDef(int num_stages, int width, int tensor_size,
                         bool use_multiple_devices, const Cluster* cluster) {
@@ -248,4 +265,149 @@ BENCHMARK(BM_SingleDevice)
     ->ArgPair(4, 10000)
     ->ArgPair(1, 1000000);
 
+// Make a program in which one partition sends "num_tensors" small tensors to
+// another, as in parameter server training with many small variables.
+GraphDef CreateFanInGraphDef(int num_tensors, int tensor_size,
+                             const Cluster* cluster) {
+  CHECK_GE(cluster->devices.size(), 2);
+
+  using namespace ::tensorflow::ops;  // NOLINT(build/namespaces)
+
+  Scope s = Scope::NewRootScope();
+  Output x = Const(s.WithOpName("x"), 0.0f, {tensor_size, 1});
+
+  std::vector<Output> remote;
+  for (int i = 0; i < num_tensors; i++) {
+    remote.push_back(
+        Add(s.WithDevice(cluster->devices[1].name()), x,
+            Const(s.WithDevice(cluster->devices[1].name()),
+                  static_cast<float>(i), {tensor_size, 1})));
+  }
+  /* Output y =*/AddN(s.WithOpName("y"), remote);
+
+  GraphDef def;
+  TF_CHECK_OK(s.ToGraphDef(&def));
+  return def;
+}
+
+static void BM_ManySmallTensors(int iters, int num_tensors, int batched) {
+  testing::StopTiming();
+  const Cluster* cluster = batched ? GetBatchedRecvCluster() : GetCluster();
+  const int tensor_size = 2;
+
+  std::unique_ptr<Session> session(NewSession(cluster->options));
+  GraphDef def = CreateFanInGraphDef(num_tensors, tensor_size, cluster);
+  graph::SetDefaultDevice(cluster->devices[0].name(), &def);
+  TF_CHECK_OK(session->Create(def));
+
+  Tensor x(DT_FLOAT, TensorShape({tensor_size, 1}));
+  x.flat<float>().setZero();
+  testing::SetLabel(
+      strings::StrCat(num_tensors, " tensors/step; ",
+                      batched ? "RecvTensorBatch" : "RecvTensor"));
+
+  std::vector<Tensor> outputs;
+  for (int i = 0; i < 3; i++) {
+    outputs.clear();
+    TF_CHECK_OK(session->Run({{"x", x}}, {"y:0"}, {}, &outputs));
+    CHECK_EQ(size_t{1}, outputs.size());
+  }
+
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    outputs.clear();
+    TF_CHECK_OK(session->Run({{"x", x}}, {"y:0"}, {}, &outputs));
+  }
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_tensors);
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_ManySmallTensors)
+    ->ArgPair(100, 0)
+    ->ArgPair(100, 1)
+    ->ArgPair(1000, 0)
+    ->ArgPair(1000, 1);
+
+// Make a program that simulates a parameter server step: the worker applies
+// "num_layers" layers whose weights live on the parameter server, and only
+// at the end reads a large embedding table from it. Without recv scheduling
+// the transfer of the table competes with the weights the layers wait on.
+GraphDef CreateParameterServerGraphDef(int num_layers, int layer_width,
+                                       int table_size,
+                                       const Cluster* cluster) {
+  CHECK_GE(cluster->devices.size(), 2);
+
+  using namespace ::tensorflow::ops;  // NOLINT(build/namespaces)
+
+  Scope s = Scope::NewRootScope();
+  Scope ps = s.WithDevice(cluster->devices[1].name());
+  Output x = Const(s.WithOpName("x"), 0.0f, {1, layer_width});
+
+  Output table = RandomUniform(ps, Const(ps, {table_size}), DT_FLOAT);
+  Output h = x;
+  for (int i = 0; i < num_layers; i++) {
+    Output weights =
+        RandomUniform(ps, Const(ps, {layer_width, layer_width}), DT_FLOAT);
+    h = Relu(s, MatMul(s, h, weights));
+  }
+  /* Output y =*/Add(s.WithOpName("y"), Sum(s, h, {0, 1}),
+                     Sum(s, table, {0}));
+
+  GraphDef def;
+  TF_CHECK_OK(s.ToGraphDef(&def));
+  return def;
+}
+
+// "max_outstanding_recvs" < 0 disables recv scheduling, 0 schedules recvs
+// with unit costs and a positive value orders them by the op-level cost model
+// with at most that many in flight.
+static void BM_ParameterServerStep(int iters, int num_layers,
+                                   int max_outstanding_recvs) {
+  testing::StopTiming();
+  const Cluster* cluster = GetCluster();
+  const int layer_width = 256;
+  const int table_size = 4 << 20;
+
+  SessionOptions options = cluster->options;
+  options.config.mutable_graph_options()->set_enable_recv_scheduling(
+      max_outstanding_recvs >= 0);
+  options.config.mutable_experimental()->set_recv_scheduling_max_outstanding(
+      std::max(0, max_outstanding_recvs));
+  std::unique_ptr<Session> session(NewSession(options));
+  GraphDef def = CreateParameterServerGraphDef(num_layers, layer_width,
+                                               table_size, cluster);
+  graph::SetDefaultDevice(cluster->devices[0].name(), &def);
+  TF_CHECK_OK(session->Create(def));
+
+  Tensor x(DT_FLOAT, TensorShape({1, layer_width}));
+  x.flat<float>().setZero();
+  testing::SetLabel(strings::StrCat(
+      num_layers, " layers; ",
+      max_outstanding_recvs < 0
+          ? "no recv scheduling"
+          : strings::StrCat(max_outstanding_recvs, " outstanding recvs")));
+
+  std::vector<Tensor> outputs;
+  for (int i = 0; i < 3; i++) {
+    outputs.clear();
+    TF_CHECK_OK(session->Run({{"x", x}}, {"y:0"}, {}, &outputs));
+    CHECK_EQ(size_t{1}, outputs.size());
+  }
+
+  testing::StartTiming();
+  for (int i = 0; i < iters; i++) {
+    outputs.clear();
+    TF_CHECK_OK(session->Run({{"x", x}}, {"y:0"}, {}, &outputs));
+  }
+  testing::StopTiming();
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_ParameterServerStep)
+    ->ArgPair(16, -1)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 8)
+    ->ArgPair(64, -1)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 8);
+
 }  // namespace tensorflow
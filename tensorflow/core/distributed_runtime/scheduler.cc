@@ -15,17 +15,26 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/scheduler.h"
 
+#include <algorithm>
 #include <queue>
 
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_set.h"
 #include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/op_context.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/utils.h"
+#include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/util/util.h"
 
 namespace tensorflow {
 
 namespace {
 
+// The bandwidth assumed for copies between devices.
+const double kEstimatedCopyGbps = 10.0;
+
 // Initialize the pending count for each node.
 void InitializePending(const Graph* graph, std::vector<int>* pending) {
   pending->resize(graph->num_node_ids());
@@ -71,6 +80,58 @@ bool UpdatePending(const Edge* edge, std::vector<int>* pending_count) {
 
 }  // end namespace
 
+Status EstimateCostsWithOpLevelCostModel(const Graph& g,
+                                         CostModel* cost_model) {
+  grappler::GrapplerItem item;
+  item.id = "slack_analysis";
+  g.ToGraphDef(&item.graph);
+  grappler::GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(
+      /*assume_valid_feeds=*/false));
+
+  std::unordered_map<string, const NodeDef*> name_to_node;
+  for (const NodeDef& node : item.graph.node()) {
+    name_to_node[node.name()] = &node;
+  }
+  std::unordered_map<string, DeviceProperties> device_properties;
+  grappler::OpLevelCostEstimator estimator;
+  for (Node* n : g.op_nodes()) {
+    auto node_it = name_to_node.find(n->name());
+    if (node_it == name_to_node.end()) continue;
+
+    const string& device = n->assigned_device_name();
+    auto device_it = device_properties.find(device);
+    if (device_it == device_properties.end()) {
+      device_it =
+          device_properties.emplace(device, grappler::GetDeviceInfo(device))
+              .first;
+    }
+    grappler::OpContext op_context;
+    op_context.name = n->name();
+    op_context.device_name = device;
+    op_context.op_info = grappler::BuildOpInfoWithoutDevice(
+        *node_it->second, name_to_node,
+        properties.GetInputProperties(n->name()));
+    *op_context.op_info.mutable_device() = device_it->second;
+    op_context.function_library = &item.graph.library();
+
+    const grappler::Costs costs = estimator.PredictCosts(op_context);
+    cost_model->RecordCount(n, 1);
+    cost_model->RecordTime(
+        n, Microseconds(std::max<int64>(
+               1, costs.execution_time.asMicroSeconds().count())));
+
+    const auto& outputs = properties.GetOutputProperties(n->name());
+    const int num_outputs =
+        std::min(n->num_outputs(), static_cast<int>(outputs.size()));
+    for (int i = 0; i < num_outputs; ++i) {
+      const int64 size = grappler::CalculateTensorSize(outputs[i]);
+      if (size > 0) cost_model->RecordSize(n, i, Bytes(size));
+    }
+  }
+  return Status::OK();
+}
+
 SlackAnalysis::SlackAnalysis(const Graph* g, const CostModel* cost_model)
     : graph_(g), cost_model_(cost_model) {}
 
@@ -95,12 +156,7 @@ Microseconds SlackAnalysis::ComputeAsap(std::vector<Microseconds>* asap_times) {
       const Node* out = out_edge->dst();
       if (!out_edge->IsControlEdge() &&
           curr->assigned_device_name() != out->assigned_device_name()) {
-        // Add an arbitrary 10microsecs for each copy.
-        // TODO(yuanbyu): Use below with the real cost model.
-        // int index = out_edge->src_output();
-        // Bytes nb = cost_model_->SizeEstimate(curr, index);
-        // copy_time = CostModel::CopyTimeEstimate(nb);
-        copy_time = 10;
+        copy_time = CopyTime(out_edge);
       }
       Microseconds new_asap = (*asap_times)[curr->id()] + ctime + copy_time;
       if ((*asap_times)[out->id()] < new_asap) {
@@ -151,11 +207,7 @@ Microseconds SlackAnalysis::ComputeAlap(std::vector<Microseconds>* alap_times) {
       const Node* src = in_edge->src();
       if (!in_edge->IsControlEdge() &&
           src->assigned_device_name() != curr->assigned_device_name()) {
-        // TODO(yuanbyu): Use the real cost model
-        // int index = out_edge->src_output();
-        // Bytes nb = cost_model_->SizeEstimate(curr, index);
-        // copy_time = CostModel::CopyTimeEstimate(nb);
-        copy_time = 10;
+        copy_time = CopyTime(in_edge);
       }
       Microseconds ctime = cost_model_->TimeEstimate(src);
       Microseconds new_latest = (*alap_times)[curr->id()] - ctime - copy_time;
@@ -172,6 +224,14 @@ Microseconds SlackAnalysis::ComputeAlap(std::vector<Microseconds>* alap_times) {
   return (*alap_times)[graph_->source_node()->id()];
 }
 
+Microseconds SlackAnalysis::CopyTime(const Edge* edge) const {
+  // Add an arbitrary 10microsecs for each copy, plus the transfer time of
+  // the estimated output size.
+  const Bytes nb = cost_model_->SizeEstimate(edge->src(), edge->src_output());
+  return Microseconds(10) +
+         CostModel::CopyTimeEstimate(nb, 0.0, kEstimatedCopyGbps);
+}
+
 void SlackAnalysis::ComputeSlack(std::vector<int64>* slacks) {
   std::vector<Microseconds> asap_times;
   std::vector<Microseconds> alap_times;
@@ -25,9 +25,18 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_set.h"
 #include "tensorflow/core/graph/costmodel.h"
+#include "tensorflow/core/lib/core/status.h"
 
 namespace tensorflow {
 
+// Records in 'cost_model' a compute time and output size estimate for every
+// op node of 'g', using grappler's analytical per-op cost model on statically
+// inferred shapes. 'cost_model' must be a global cost model initialized from
+// 'g'. Nodes whose inputs have unknown shapes are estimated from whatever
+// shape information is available.
+Status EstimateCostsWithOpLevelCostModel(const Graph& g,
+                                         CostModel* cost_model);
+
 class SlackAnalysis {
  public:
   SlackAnalysis(const Graph* g, const CostModel* cost_model);
@@ -46,6 +55,10 @@ class SlackAnalysis {
   void ComputeSlack(std::vector<int64>* slacks);
 
  private:
+  // The time needed to copy the output of 'edge' to a consumer on another
+  // device.
+  Microseconds CopyTime(const Edge* edge) const;
+
   const Graph* graph_;
   const CostModel* cost_model_;
 
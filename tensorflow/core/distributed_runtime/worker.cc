@@ -28,7 +28,13 @@ limitations under the License.
 
 namespace tensorflow {
 
-Worker::Worker(WorkerEnv* env) : env_(env), recent_request_ids_(100000) {
+Worker::Worker(WorkerEnv* env)
+    : env_(env),
+      recent_request_ids_(100000),
+      recv_tensor_batcher_(env, [this](const Rendezvous::ParsedKey& parsed,
+                                       Device** src_dev) {
+        return PrepareRecvTensor(parsed, src_dev);
+      }) {
   // Enable log history collection in StatusGroup so that recent warning and
   // error log messages will be attached to the root error status to be
   // forwarded to the master.
@@ -77,8 +83,24 @@ void Worker::RegisterGraphAsync(const RegisterGraphRequest* request,
     session = env_->session_mgr->LegacySession();
   }
   if (s.ok()) {
+    const GraphDef* graph_def = &request->graph_def();
+    GraphDef chunked_graph_def;
+    if (request->chunked_registration_id() != 0) {
+      bool complete;
+      s = session->graph_mgr()->AddGraphChunk(
+          request->chunked_registration_id(), request->chunk_index(),
+          request->graph_def(), !request->has_more_chunks(), &complete,
+          &chunked_graph_def);
+      if (!s.ok() || !complete) {
+        // Wait for the remaining chunks, which the master expects to reply
+        // without a graph handle.
+        done(s);
+        return;
+      }
+      graph_def = &chunked_graph_def;
+    }
     s = session->graph_mgr()->Register(
-        request->session_handle(), request->graph_def(), session.get(),
+        request->session_handle(), *graph_def, session.get(),
         request->graph_options(), request->debug_options(),
         request->collective_graph_key(), session->cluster_flr(),
         response->mutable_graph_handle());
@@ -350,6 +372,7 @@ void Worker::CleanupGraphAsync(const CleanupGraphRequest* request,
                                StatusCallback done) {
   const int64 step_id = request->step_id();
   env_->rendezvous_mgr->Cleanup(step_id);
+  recv_tensor_batcher_.CleanupStep(step_id);
   if (env_->collective_executor_mgr) {
     env_->collective_executor_mgr->Cleanup(step_id);
   }
@@ -460,4 +483,18 @@ void Worker::RecvTensorAsync(CallOptions* opts,
   done(errors::Unimplemented("Worker::RecvTensorAsync()"));
 }
 
+void Worker::RecvTensorBatchAsync(CallOptions* opts,
+                                  const RecvTensorBatchRequest* request,
+                                  RecvTensorBatchResponse* response,
+                                  StatusCallback done) {
+  Status s = recent_request_ids_.TrackUnique(request->request_id(),
+                                             "RecvTensorBatch (Worker)",
+                                             *request);
+  if (!s.ok()) {
+    done(s);
+    return;
+  }
+  recv_tensor_batcher_.RecvAsync(opts, request, response, std::move(done));
+}
+
 }  // namespace tensorflow
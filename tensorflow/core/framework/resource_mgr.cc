@@ -82,6 +82,7 @@ Status ValidateDevice(OpKernelContext* ctx, const ResourceHandle& p) {
 
 Status ResourceMgr::InsertDebugTypeName(uint64 hash_code,
                                         const string& type_name) {
+  mutex_lock l(debug_type_names_mu_);
   auto iter = debug_type_names_.emplace(hash_code, type_name);
   if (iter.first->second != type_name) {
     return errors::AlreadyExists("Duplicate hash code found for type ",
@@ -91,6 +92,7 @@ Status ResourceMgr::InsertDebugTypeName(uint64 hash_code,
 }
 
 const char* ResourceMgr::DebugTypeName(uint64 hash_code) const {
+  mutex_lock l(debug_type_names_mu_);
   auto type_name_iter = debug_type_names_.find(hash_code);
   if (type_name_iter == debug_type_names_.end()) {
     return "<unknown>";
@@ -106,57 +108,88 @@ ResourceMgr::ResourceMgr(const string& default_container)
 
 ResourceMgr::~ResourceMgr() { Clear(); }
 
+ResourceMgr::Shard& ResourceMgr::GetShard(const string& container,
+                                          const string& name) const {
+  const uint64 h =
+      Hash64Combine(Hash64(container), Hash64(name.data(), name.size()));
+  return shards_[h % kNumShards];
+}
+
+bool ResourceMgr::ContainerExists(const string& container) const {
+  for (const Shard& shard : shards_) {
+    tf_shared_lock l(shard.mu);
+    if (shard.containers.count(container) > 0) return true;
+  }
+  return false;
+}
+
+Status ResourceMgr::NotFound(const string& container, const string& name,
+                             const string& type_name) const {
+  if (!ContainerExists(container)) {
+    return errors::NotFound("Container ", container,
+                            " does not exist. (Could not find resource: ",
+                            container, "/", name, ")");
+  }
+  return errors::NotFound("Resource ", container, "/", name, "/", type_name,
+                          " does not exist.");
+}
+
 void ResourceMgr::Clear() {
   // We do the deallocation outside of the lock to avoid a potential deadlock
   // in case any of the destructors access the resource manager.
-  std::unordered_map<string, Container*> tmp_containers;
-  {
-    mutex_lock l(mu_);
-    tmp_containers = std::move(containers_);
+  std::vector<Container*> tmp_containers;
+  for (Shard& shard : shards_) {
+    mutex_lock l(shard.mu);
+    for (const auto& p : shard.containers) {
+      tmp_containers.push_back(p.second);
+    }
+    shard.containers.clear();
   }
-  for (const auto& p : tmp_containers) {
-    for (const auto& q : *p.second) {
+  for (Container* c : tmp_containers) {
+    for (const auto& q : *c) {
       q.second->Unref();
     }
-    delete p.second;
+    delete c;
   }
-  tmp_containers.clear();
 }
 
 string ResourceMgr::DebugString() const {
-  mutex_lock l(mu_);
   struct Line {
-    const string* container;
+    const string container;
     const string type;
-    const string* resource;
+    const string resource;
     const string detail;
   };
   std::vector<Line> lines;
-  for (const auto& p : containers_) {
-    const string& container = p.first;
-    for (const auto& q : *p.second) {
-      const Key& key = q.first;
-      const char* type = DebugTypeName(key.first);
-      const string& resource = key.second;
-      Line l{&container, port::Demangle(type), &resource,
-             q.second->DebugString()};
-      lines.push_back(l);
+  for (const Shard& shard : shards_) {
+    tf_shared_lock l(shard.mu);
+    for (const auto& p : shard.containers) {
+      const string& container = p.first;
+      for (const auto& q : *p.second) {
+        const Key& key = q.first;
+        const char* type = DebugTypeName(key.first);
+        const string& resource = key.second;
+        Line l{container, port::Demangle(type), resource,
+               q.second->DebugString()};
+        lines.push_back(l);
+      }
     }
   }
   std::vector<string> text;
   text.reserve(lines.size());
   for (const Line& line : lines) {
     text.push_back(strings::Printf(
-        "%-20s | %-40s | %-40s | %-s", line.container->c_str(),
-        line.type.c_str(), line.resource->c_str(), line.detail.c_str()));
+        "%-20s | %-40s | %-40s | %-s", line.container.c_str(),
+        line.type.c_str(), line.resource.c_str(), line.detail.c_str()));
   }
   std::sort(text.begin(), text.end());
   return absl::StrJoin(text, "\n");
 }
 
-Status ResourceMgr::DoCreate(const string& container, TypeIndex type,
-                             const string& name, ResourceBase* resource) {
-  Container** b = &containers_[container];
+Status ResourceMgr::DoCreate(Shard* shard, const string& container,
+                             TypeIndex type, const string& name,
+                             ResourceBase* resource) {
+  Container** b = &shard->containers[container];
   if (*b == nullptr) {
     *b = new Container;
   }
@@ -169,14 +202,13 @@ Status ResourceMgr::DoCreate(const string& container, TypeIndex type,
                                type.name());
 }
 
-Status ResourceMgr::DoLookup(const string& container, TypeIndex type,
-                             const string& name,
+Status ResourceMgr::DoLookup(const Shard& shard, const string& container,
+                             TypeIndex type, const string& name,
                              ResourceBase** resource) const {
-  const Container* b = gtl::FindPtrOrNull(containers_, container);
+  const Container* b = gtl::FindPtrOrNull(shard.containers, container);
   if (b == nullptr) {
-    return errors::NotFound("Container ", container,
-                            " does not exist. (Could not find resource: ",
-                            container, "/", name, ")");
+    return errors::NotFound("Resource ", container, "/", name, "/", type.name(),
+                            " does not exist.");
   }
   auto r = gtl::FindPtrOrNull(*b, {type.hash_code(), name});
   if (r == nullptr) {
@@ -192,21 +224,25 @@ Status ResourceMgr::DoDelete(const string& container, uint64 type_hash_code,
                              const string& resource_name,
                              const string& type_name) {
   ResourceBase* base = nullptr;
+  Shard& shard = GetShard(container, resource_name);
   {
-    mutex_lock l(mu_);
-    Container* b = gtl::FindPtrOrNull(containers_, container);
-    if (b == nullptr) {
-      return errors::NotFound("Container ", container, " does not exist.");
+    mutex_lock l(shard.mu);
+    Container* b = gtl::FindPtrOrNull(shard.containers, container);
+    if (b != nullptr) {
+      auto iter = b->find({type_hash_code, resource_name});
+      if (iter != b->end()) {
+        base = iter->second;
+        b->erase(iter);
+      }
     }
-    auto iter = b->find({type_hash_code, resource_name});
-    if (iter == b->end()) {
-      return errors::NotFound("Resource ", container, "/", resource_name, "/",
-                              type_name, " does not exist.");
+  }
+  if (base == nullptr) {
+    if (!ContainerExists(container)) {
+      return errors::NotFound("Container ", container, " does not exist.");
     }
-    base = iter->second;
-    b->erase(iter);
+    return errors::NotFound("Resource ", container, "/", resource_name, "/",
+                            type_name, " does not exist.");
   }
-  CHECK(base != nullptr);
   base->Unref();
   return Status::OK();
 }
@@ -222,29 +258,27 @@ Status ResourceMgr::Delete(const ResourceHandle& handle) {
 }
 
 Status ResourceMgr::Cleanup(const string& container) {
-  {
-    tf_shared_lock l(mu_);
-    if (!gtl::FindOrNull(containers_, container)) {
-      // Nothing to cleanup.
-      return Status::OK();
+  std::vector<Container*> removed;
+  for (Shard& shard : shards_) {
+    {
+      tf_shared_lock l(shard.mu);
+      if (!gtl::FindOrNull(shard.containers, container)) continue;
     }
-  }
-  Container* b = nullptr;
-  {
-    mutex_lock l(mu_);
-    auto iter = containers_.find(container);
-    if (iter == containers_.end()) {
+    mutex_lock l(shard.mu);
+    auto iter = shard.containers.find(container);
+    if (iter == shard.containers.end()) {
       // Nothing to cleanup, it's OK (concurrent cleanup).
-      return Status::OK();
+      continue;
     }
-    b = iter->second;
-    containers_.erase(iter);
+    removed.push_back(iter->second);
+    shard.containers.erase(iter);
   }
-  CHECK(b != nullptr);
-  for (const auto& p : *b) {
-    p.second->Unref();
+  for (Container* b : removed) {
+    for (const auto& p : *b) {
+      p.second->Unref();
+    }
+    delete b;
   }
-  delete b;
   return Status::OK();
 }
 
@@ -198,22 +198,43 @@ class ResourceMgr {
   };
   typedef std::unordered_map<Key, ResourceBase*, KeyHash, KeyEqual> Container;
 
+  // Resources are spread over shards by (container, name) so that concurrent
+  // lookups of unrelated resources do not contend on a single lock.  A
+  // container exists if any shard has an entry for it.
+  static constexpr int kNumShards = 16;
+  struct Shard {
+    mutable mutex mu;
+    std::unordered_map<string, Container*> containers GUARDED_BY(mu);
+  };
+
   const string default_container_;
-  mutable mutex mu_;
-  std::unordered_map<string, Container*> containers_ GUARDED_BY(mu_);
+  mutable Shard shards_[kNumShards];
+
+  Shard& GetShard(const string& container, const string& name) const;
+
+  // Returns true if any shard has an entry for "container".
+  bool ContainerExists(const string& container) const;
+
+  // Returns the NotFound error for a missing resource, distinguishing a
+  // missing container from a missing resource.  Must be called without
+  // holding any shard lock.
+  Status NotFound(const string& container, const string& name,
+                  const string& type_name) const;
 
   template <typename T, bool use_dynamic_cast = false>
-  Status LookupInternal(const string& container, const string& name,
-                        T** resource) const
-      SHARED_LOCKS_REQUIRED(mu_) TF_MUST_USE_RESULT;
+  Status LookupInternal(const Shard& shard, const string& container,
+                        const string& name, T** resource) const
+      SHARED_LOCKS_REQUIRED(shard.mu) TF_MUST_USE_RESULT;
 
-  Status DoCreate(const string& container, TypeIndex type, const string& name,
-                  ResourceBase* resource)
-      EXCLUSIVE_LOCKS_REQUIRED(mu_) TF_MUST_USE_RESULT;
+  Status DoCreate(Shard* shard, const string& container, TypeIndex type,
+                  const string& name, ResourceBase* resource)
+      EXCLUSIVE_LOCKS_REQUIRED(shard->mu) TF_MUST_USE_RESULT;
 
-  Status DoLookup(const string& container, TypeIndex type, const string& name,
-                  ResourceBase** resource) const
-      SHARED_LOCKS_REQUIRED(mu_) TF_MUST_USE_RESULT;
+  // Returns NotFound with an unspecific message if the resource does not
+  // exist; callers that surface the error should use NotFound() instead.
+  Status DoLookup(const Shard& shard, const string& container, TypeIndex type,
+                  const string& name, ResourceBase** resource) const
+      SHARED_LOCKS_REQUIRED(shard.mu) TF_MUST_USE_RESULT;
 
   Status DoDelete(const string& container, uint64 type_hash_code,
                   const string& resource_name,
@@ -223,16 +244,18 @@ class ResourceMgr {
 
   // Inserts the type name for 'hash_code' into the hash_code to type name map.
   Status InsertDebugTypeName(uint64 hash_code, const string& type_name)
-      EXCLUSIVE_LOCKS_REQUIRED(mu_) TF_MUST_USE_RESULT;
+      LOCKS_EXCLUDED(debug_type_names_mu_) TF_MUST_USE_RESULT;
 
   // Returns the type name for the 'hash_code'.
   // Returns "<unknown>" if a resource with such a type was never inserted into
   // the container.
   const char* DebugTypeName(uint64 hash_code) const
-      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+      LOCKS_EXCLUDED(debug_type_names_mu_);
 
-  // Map from type hash_code to type name.
-  std::unordered_map<uint64, string> debug_type_names_ GUARDED_BY(mu_);
+  // Map from type hash_code to type name.  Acquired after shard locks.
+  mutable mutex debug_type_names_mu_;
+  std::unordered_map<uint64, string> debug_type_names_
+      GUARDED_BY(debug_type_names_mu_);
 
   TF_DISALLOW_COPY_AND_ASSIGN(ResourceMgr);
 };
@@ -530,16 +553,23 @@ Status ResourceMgr::Create(const string& container, const string& name,
                            T* resource) {
   CheckDeriveFromResourceBase<T>();
   CHECK(resource != nullptr);
-  mutex_lock l(mu_);
-  return DoCreate(container, MakeTypeIndex<T>(), name, resource);
+  Shard& shard = GetShard(container, name);
+  mutex_lock l(shard.mu);
+  return DoCreate(&shard, container, MakeTypeIndex<T>(), name, resource);
 }
 
 template <typename T, bool use_dynamic_cast>
 Status ResourceMgr::Lookup(const string& container, const string& name,
                            T** resource) const {
   CheckDeriveFromResourceBase<T>();
-  tf_shared_lock l(mu_);
-  return LookupInternal<T, use_dynamic_cast>(container, name, resource);
+  const Shard& shard = GetShard(container, name);
+  {
+    tf_shared_lock l(shard.mu);
+    Status s =
+        LookupInternal<T, use_dynamic_cast>(shard, container, name, resource);
+    if (s.ok()) return s;
+  }
+  return NotFound(container, name, MakeTypeIndex<T>().name());
 }
 
 template <typename T, bool use_dynamic_cast>
@@ -548,13 +578,15 @@ Status ResourceMgr::LookupMany(
         containers_and_names,
     std::vector<std::unique_ptr<T, core::RefCountDeleter>>* resources) const {
   CheckDeriveFromResourceBase<T>();
-  tf_shared_lock l(mu_);
   resources->resize(containers_and_names.size());
   for (size_t i = 0; i < containers_and_names.size(); ++i) {
+    const string& container = *containers_and_names[i].first;
+    const string& name = *containers_and_names[i].second;
+    const Shard& shard = GetShard(container, name);
+    tf_shared_lock l(shard.mu);
     T* resource;
-    Status s = LookupInternal<T, use_dynamic_cast>(
-        *containers_and_names[i].first, *containers_and_names[i].second,
-        &resource);
+    Status s = LookupInternal<T, use_dynamic_cast>(shard, container, name,
+                                                   &resource);
     if (s.ok()) {
       (*resources)[i].reset(resource);
     }
@@ -574,10 +606,10 @@ struct TypeCastFunctor<T, true> {
 };
 
 template <typename T, bool use_dynamic_cast>
-Status ResourceMgr::LookupInternal(const string& container, const string& name,
-                                   T** resource) const {
+Status ResourceMgr::LookupInternal(const Shard& shard, const string& container,
+                                   const string& name, T** resource) const {
   ResourceBase* found = nullptr;
-  Status s = DoLookup(container, MakeTypeIndex<T>(), name, &found);
+  Status s = DoLookup(shard, container, MakeTypeIndex<T>(), name, &found);
   if (s.ok()) {
     // It's safe to down cast 'found' to T* since
     // typeid(T).hash_code() is part of the map key.
@@ -592,17 +624,18 @@ Status ResourceMgr::LookupOrCreate(const string& container, const string& name,
                                    std::function<Status(T**)> creator) {
   CheckDeriveFromResourceBase<T>();
   *resource = nullptr;
+  Shard& shard = GetShard(container, name);
   Status s;
   {
-    tf_shared_lock l(mu_);
-    s = LookupInternal<T, use_dynamic_cast>(container, name, resource);
+    tf_shared_lock l(shard.mu);
+    s = LookupInternal<T, use_dynamic_cast>(shard, container, name, resource);
     if (s.ok()) return s;
   }
-  mutex_lock l(mu_);
-  s = LookupInternal<T, use_dynamic_cast>(container, name, resource);
+  mutex_lock l(shard.mu);
+  s = LookupInternal<T, use_dynamic_cast>(shard, container, name, resource);
   if (s.ok()) return s;
   TF_RETURN_IF_ERROR(creator(resource));
-  s = DoCreate(container, MakeTypeIndex<T>(), name, *resource);
+  s = DoCreate(&shard, container, MakeTypeIndex<T>(), name, *resource);
   if (!s.ok()) {
     return errors::Internal("LookupOrCreate failed unexpectedly");
   }
@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow/core/framework/device_attributes.pb.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/refcount.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -25,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 
@@ -138,6 +140,48 @@ TEST(ResourceMgrTest, CreateOrLookup) {
   HasError(FindErr<Other>(rm, "foo", "bar"), "Not found: Resource foo/bar");
 }
 
+TEST(ResourceMgrTest, ContainerSpansShards) {
+  ResourceMgr rm;
+  // Enough resources to populate every shard of one container.
+  for (int i = 0; i < 64; ++i) {
+    TF_CHECK_OK(rm.Create("foo", strings::StrCat("r", i),
+                          new Resource(strings::StrCat(i))));
+  }
+  for (int i = 0; i < 64; ++i) {
+    EXPECT_EQ(strings::StrCat("R/", i),
+              Find<Resource>(rm, "foo", strings::StrCat("r", i)));
+  }
+  HasError(FindErr<Resource>(rm, "foo", "missing"),
+           "Not found: Resource foo/missing");
+  TF_CHECK_OK(rm.Cleanup("foo"));
+  for (int i = 0; i < 64; ++i) {
+    HasError(FindErr<Resource>(rm, "foo", strings::StrCat("r", i)),
+             "Not found: Container foo");
+  }
+}
+
+TEST(ResourceMgrTest, ConcurrentLookupAndCreate) {
+  ResourceMgr rm;
+  const int kNumResources = 128;
+  {
+    thread::ThreadPool threads(Env::Default(), "concurrent_rm", 8);
+    for (int t = 0; t < 8; ++t) {
+      threads.Schedule([&rm, t] {
+        for (int i = 0; i < kNumResources; ++i) {
+          const string name =
+              strings::StrCat("r", (i + t * 16) % kNumResources);
+          EXPECT_EQ(strings::StrCat("R/", name),
+                    LookupOrCreate<Resource>(&rm, "foo", name, name));
+        }
+      });
+    }
+  }
+  for (int i = 0; i < kNumResources; ++i) {
+    const string name = strings::StrCat("r", i);
+    EXPECT_EQ(strings::StrCat("R/", name), Find<Resource>(rm, "foo", name));
+  }
+}
+
 TEST(ResourceMgrTest, CreateOrLookupRaceCondition) {
   ResourceMgr rm;
   std::atomic<int> atomic_int(0);
@@ -346,4 +390,43 @@ TEST(ResourceHandleTest, DeleteUsingResourceHandle) {
   EXPECT_NE(LookupResource<StubResource>(&ctx, p, &lookup_r).ok(), true);
 }
 
+// Measures Lookup throughput with `num_threads` threads concurrently looking
+// up variables from one container, as parameter servers do for every step.
+static void BM_ResourceMgrConcurrentLookup(int iters, int num_threads) {
+  testing::StopTiming();
+  const int kNumResources = 1024;
+  ResourceMgr rm;
+  std::vector<string> names;
+  for (int i = 0; i < kNumResources; ++i) {
+    names.push_back(strings::StrCat("var", i));
+    TF_CHECK_OK(rm.Create("ps", names.back(), new Resource(names.back())));
+  }
+  thread::ThreadPool threads(Env::Default(), "lookup", num_threads);
+  const int lookups_per_thread = std::max(1, iters / num_threads);
+  testing::UseRealTime();
+  testing::StartTiming();
+  BlockingCounter done(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    threads.Schedule([&rm, &names, &done, t, lookups_per_thread] {
+      for (int i = 0; i < lookups_per_thread; ++i) {
+        Resource* r;
+        TF_CHECK_OK(rm.Lookup("ps", names[(i * 7 + t) % names.size()], &r));
+        r->Unref();
+      }
+      done.DecrementCount();
+    });
+  }
+  done.Wait();
+  testing::StopTiming();
+  testing::ItemsProcessed(static_cast<int64>(lookups_per_thread) *
+                          num_threads);
+}
+BENCHMARK(BM_ResourceMgrConcurrentLookup)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Arg(16)
+    ->Arg(32);
+
 }  // end namespace tensorflow
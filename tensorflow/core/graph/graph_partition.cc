@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/graph/graph_partition.h"
 
+#include <algorithm>
 #include <deque>
 #include <queue>
 #include <unordered_map>
@@ -35,10 +36,12 @@ limitations under the License.
 #include "tensorflow/core/graph/graph_def_builder.h"
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/util/device_name_utils.h"
 #include "tensorflow/core/util/dump_graph.h"
 
@@ -58,25 +61,26 @@ inline bool IsNextIteration(const NodeDef& node_def) {
 struct DupRecvKey {
   int src_node_id;           // Edge's src node id
   int src_output_slot;       // Edge's src node output slot
-  GraphDef* dst_graph;       // Edge's dst node is in this subgraph
+  int dst_partition;         // Edge's dst node is in this partition
   bool recv_output_on_host;  // The output of recv is on host
 
   template <typename H>
   friend H AbslHashValue(H h, const DupRecvKey& c) {
     return H::combine(std::move(h), c.src_node_id, c.src_output_slot,
-                      reinterpret_cast<std::uintptr_t>(c.dst_graph),
+                      c.dst_partition,
                       c.recv_output_on_host);
   }
 
   friend bool operator==(const DupRecvKey& x, const DupRecvKey& y) {
     return (x.src_node_id == y.src_node_id) &&
            (x.src_output_slot == y.src_output_slot) &&
-           (x.dst_graph == y.dst_graph) &&
+           (x.dst_partition == y.dst_partition) &&
            (x.recv_output_on_host == y.recv_output_on_host);
   }
 };
 
-// struct used to store the recvs, so that start times can be properly updated
+// struct used to store the recvs, so that start times can be properly updated.
+// The recvs are null if the partition of the consumer is not being built.
 struct RecvInfo {
   NodeDef* recv;
   NodeDef* real_recv;
@@ -358,6 +362,48 @@ NodeDef* AddControlTrigger(const PartitionOptions& opts, GraphDef* gdef,
   return result;
 }
 
+// Chains the recvs of 'gdef' that have no inputs in the order of their start
+// times, 'opts.max_outstanding_recvs' at a time. Every recv is preceded by a
+// ControlTrigger on the recv that is 'opts.max_outstanding_recvs' positions
+// earlier, so that a dead recv does not propagate its deadness.
+Status OrderRecvsByStartTime(const PartitionOptions& opts, GraphDef* gdef) {
+  std::vector<std::pair<int64, NodeDef*>> recvs;
+  for (NodeDef& ndef : *gdef->mutable_node()) {
+    // Recvs with inputs are in a loop or read a ref, and are already
+    // controlled.
+    if ((ndef.op() != "_Recv" && ndef.op() != "_HostRecv") ||
+        ndef.input_size() > 0) {
+      continue;
+    }
+    int64 start_time;
+    if (!TryGetNodeAttr(ndef, "_start_time", &start_time)) continue;
+    recvs.emplace_back(start_time, &ndef);
+  }
+  const size_t window = opts.max_outstanding_recvs;
+  if (recvs.size() <= window) return Status::OK();
+
+  // Break ties by name so that the order is deterministic.
+  std::sort(recvs.begin(), recvs.end(),
+            [](const std::pair<int64, NodeDef*>& a,
+               const std::pair<int64, NodeDef*>& b) {
+              if (a.first != b.first) return a.first < b.first;
+              return a.second->name() < b.second->name();
+            });
+  Status status;
+  for (size_t i = window; i < recvs.size(); ++i) {
+    const NodeDef* prev = recvs[i - window].second;
+    NodeDef* recv = recvs[i].second;
+    // NOTE: Adding nodes to 'gdef' does not invalidate the pointers in
+    // 'recvs'.
+    NodeDef* trigger = AddControlTrigger(opts, gdef, recv->device(), i,
+                                         recvs[i - window].first, &status);
+    if (!status.ok()) return status;
+    AddInput(trigger, prev->name(), Graph::kControlSlot);
+    AddInput(recv, trigger->name(), Graph::kControlSlot);
+  }
+  return Status::OK();
+}
+
 // Optimize colocation for control flow nodes. For cond, we want the
 // switch nodes to colocate with its data input. This is particularly
 // needed for conditional reading of a remote variable. It may also
@@ -974,30 +1020,41 @@ void SetIncarnation(const PartitionOptions& opts, GraphDef* gdef) {
   }
 }
 
-Status Partition(const PartitionOptions& opts, Graph* g,
-                 std::unordered_map<string, GraphDef>* partitions) {
-  Status status;
-  partitions->clear();
+namespace {
 
-  GraphInfo g_info;
+// Adds the "code" for distributed execution of control flow if needed, and
+// collects the memory and device type info of 'g'.
+Status PrepareForPartitioning(const PartitionOptions& opts, Graph* g,
+                              GraphInfo* g_info) {
   if (!opts.control_flow_added) {
     // Add the "code" for distributed execution of control flow. Code is
     // added only for the frames that are placed on multiple devices. The
     // new graph is an equivalent transformation of the original graph and
     // has the property that it can be subsequently partitioned arbitrarily
     // (down to the level of individual device) for distributed execution.
-    status = AddControlFlow(opts, g, &g_info);
-    if (!status.ok()) return status;
+    TF_RETURN_IF_ERROR(AddControlFlow(opts, g, g_info));
   }
 
   // At this point, all the graph mutations have been done. Build memory
   // and device type info for every node and edge in the graph.
-  status = BuildMemoryDeviceInfo(*g, &g_info);
-  if (!status.ok()) return status;
+  return BuildMemoryDeviceInfo(*g, g_info);
+}
 
-  string dstp;
+// Returns the index of the partition of a node, and sets '*graph' to the
+// GraphDef in which that partition is built, or to null if it is not built.
+typedef std::function<int(const Node*, GraphDef**)> NodeToPartitionFunc;
+
+// Adds the nodes in 'dst_nodes' and the send/recv pairs for their inputs to
+// the partitions that are built. Sends and recvs are only added to the side
+// of an edge whose partition is built, but 'dup_recv' shares them between
+// consumers in the same way regardless.
+Status AddPartitionNodes(const PartitionOptions& opts, const GraphInfo& g_info,
+                         const std::vector<const Node*>& dst_nodes,
+                         const NodeToPartitionFunc& node_to_partition,
+                         DupRecvTable* dup_recv, int32* num_data,
+                         int32* num_control) {
+  Status status;
   std::vector<const Edge*> inputs;
-  DupRecvTable dup_recv(3);
   // For a node dst, 'ref_recvs' remembers the recvs introduced by a ref
   // edge to dst. 'ref_control_inputs' remembers the inputs by a non-ref
   // edge to dst. We will add a control edge for every pair in
@@ -1005,24 +1062,25 @@ Status Partition(const PartitionOptions& opts, Graph* g,
   std::vector<NodeDef*> ref_recvs;
   std::vector<string> ref_control_inputs;
 
-  int32 num_data = 0;
-  int32 num_control = 0;
-  for (const Node* dst : g->op_nodes()) {
-    dstp = opts.node_to_loc(dst);
-    GraphDef* dst_graph = &(*partitions)[dstp];
-    NodeDef* dst_def = dst_graph->add_node();
-    *dst_def = dst->def();
-    MergeDebugInfo(NodeDebugInfo(dst->def()), dst_def);
-    dst_def->set_device(dst->assigned_device_name());
-    dst_def->clear_input();  // Inputs are filled below
-    if (opts.need_to_record_start_times) {
-      int64 start_time;
-      status = GetNodeAttr(*dst_def, "_start_time", &start_time);
-      if (errors::IsNotFound(status)) {
-        start_time = opts.start_times[dst->id()].value();
-        AddNodeAttr("_start_time", start_time, dst_def);
-      } else if (!status.ok()) {
-        return status;
+  for (const Node* dst : dst_nodes) {
+    GraphDef* dst_graph = nullptr;
+    const int dstp = node_to_partition(dst, &dst_graph);
+    NodeDef* dst_def = nullptr;
+    if (dst_graph != nullptr) {
+      dst_def = dst_graph->add_node();
+      *dst_def = dst->def();
+      MergeDebugInfo(NodeDebugInfo(dst->def()), dst_def);
+      dst_def->set_device(dst->assigned_device_name());
+      dst_def->clear_input();  // Inputs are filled below
+      if (opts.need_to_record_start_times) {
+        int64 start_time;
+        status = GetNodeAttr(*dst_def, "_start_time", &start_time);
+        if (errors::IsNotFound(status)) {
+          start_time = opts.start_times[dst->id()].value();
+          AddNodeAttr("_start_time", start_time, dst_def);
+        } else if (!status.ok()) {
+          return status;
+        }
       }
     }
 
@@ -1066,13 +1124,16 @@ Status Partition(const PartitionOptions& opts, Graph* g,
       const Node* src = edge->src();
       if (!src->IsOp()) continue;  // Skip Sink/Source nodes.
 
-      GraphDef* src_graph = &(*partitions)[opts.node_to_loc(src)];
-      if (src_graph == dst_graph && !NeedSameDeviceSendRecv(edge, g_info)) {
+      GraphDef* src_graph = nullptr;
+      const int srcp = node_to_partition(src, &src_graph);
+      if (srcp == dstp && !NeedSameDeviceSendRecv(edge, g_info)) {
         // Same partition and compatible memory types:
-        AddInput(dst_def, src->name(), edge->src_output());
-        if (edge->IsControlEdge() ||
-            !IsRefType(src->output_type(edge->src_output()))) {
-          ref_control_inputs.push_back(src->name());
+        if (dst_def != nullptr) {
+          AddInput(dst_def, src->name(), edge->src_output());
+          if (edge->IsControlEdge() ||
+              !IsRefType(src->output_type(edge->src_output()))) {
+            ref_control_inputs.push_back(src->name());
+          }
         }
         continue;
       }
@@ -1098,17 +1159,19 @@ Status Partition(const PartitionOptions& opts, Graph* g,
       // Check whether there is already a send/recv pair transferring
       // the same tensor/control from the src to dst partition.
       const bool on_host = IsDstInputOnHost(edge, g_info);
-      DupRecvKey key{src->id(), edge->src_output(), dst_graph, on_host};
-      auto iter = dup_recv.find(key);
-      if (iter != dup_recv.end()) {
+      DupRecvKey key{src->id(), edge->src_output(), dstp, on_host};
+      auto iter = dup_recv->find(key);
+      if (iter != dup_recv->end()) {
         // We found one. Reuse the data/control transferred already.
-        const string& recv_node_name = iter->second.recv->name();
-        if (edge->IsControlEdge()) {
-          AddInput(dst_def, recv_node_name, Graph::kControlSlot);
-        } else {
-          AddInput(dst_def, recv_node_name, 0);
+        if (dst_def != nullptr) {
+          const string& recv_node_name = iter->second.recv->name();
+          if (edge->IsControlEdge()) {
+            AddInput(dst_def, recv_node_name, Graph::kControlSlot);
+          } else {
+            AddInput(dst_def, recv_node_name, 0);
+          }
+          ref_control_inputs.push_back(recv_node_name);
         }
-        ref_control_inputs.push_back(recv_node_name);
 
         // We want the start_time for the recv to be the smallest of the start
         // times of it's consumers. So we update this whenever we use a recv,
@@ -1119,73 +1182,85 @@ Status Partition(const PartitionOptions& opts, Graph* g,
         continue;
       }
 
-      NodeDefBuilder::NodeOut send_from;
-      if (edge->IsControlEdge()) {
-        // Insert a dummy const node that will generate a tiny
-        // data element to be sent from send to recv.
-        VLOG(1) << "Send/Recv control: " << src->assigned_device_name() << "["
-                << src->name() << "] -> " << dst->assigned_device_name() << "["
-                << dst->name() << "]";
-        NodeDef* dummy = AddDummyConst(opts, src_graph, edge, &status);
-        if (!status.ok()) return status;
-        // Set the start time for this dummy node.
-        if (opts.scheduling_for_recvs) {
-          AddNodeAttr("_start_time", send_start_time, dummy);
-        }
-        AddInput(dummy, src->name(), Graph::kControlSlot);
-        send_from.Reset(dummy->name(), 0, DT_FLOAT);
-      } else {
-        send_from.Reset(src->name(), edge->src_output(), EdgeType(edge));
-      }
-
       // Need to split edge by placing matching send/recv nodes on
       // the src/dst sides of the edge.
-      NodeDef* send = AddSend(opts, g_info, src_graph, edge, send_from,
-                              send_start_time, &status);
-      if (!status.ok()) return status;
+      NodeDef* send = nullptr;
+      if (src_graph != nullptr) {
+        NodeDefBuilder::NodeOut send_from;
+        if (edge->IsControlEdge()) {
+          // Insert a dummy const node that will generate a tiny
+          // data element to be sent from send to recv.
+          VLOG(1) << "Send/Recv control: " << src->assigned_device_name()
+                  << "[" << src->name() << "] -> "
+                  << dst->assigned_device_name() << "[" << dst->name() << "]";
+          NodeDef* dummy = AddDummyConst(opts, src_graph, edge, &status);
+          if (!status.ok()) return status;
+          // Set the start time for this dummy node.
+          if (opts.scheduling_for_recvs) {
+            AddNodeAttr("_start_time", send_start_time, dummy);
+          }
+          AddInput(dummy, src->name(), Graph::kControlSlot);
+          send_from.Reset(dummy->name(), 0, DT_FLOAT);
+        } else {
+          send_from.Reset(src->name(), edge->src_output(), EdgeType(edge));
+        }
+
+        send = AddSend(opts, g_info, src_graph, edge, send_from,
+                       send_start_time, &status);
+        if (!status.ok()) return status;
+      }
 
       NodeDef* real_recv = nullptr;
-      NodeDef* recv =
-          AddRecv(opts, g_info, dst_graph, edge, &real_recv, &status);
-      if (!status.ok()) return status;
+      NodeDef* recv = nullptr;
+      if (dst_graph != nullptr) {
+        recv = AddRecv(opts, g_info, dst_graph, edge, &real_recv, &status);
+        if (!status.ok()) return status;
+      }
 
       // Fix up the control flow edge.
       // NOTE(yuanbyu): 'real_recv' must be the real recv node.
-      if (src_graph == dst_graph) {
+      if (srcp == dstp) {
         // For same device send/recv, add a control edge from send to recv.
         // This prevents the asynchronous recv kernel from being scheduled
         // before the data is available.
-        AddInput(real_recv, send->name(), Graph::kControlSlot);
+        if (real_recv != nullptr) {
+          AddInput(real_recv, send->name(), Graph::kControlSlot);
+        }
       } else if (control_flow_edge != nullptr) {
         // Redirect control edge to the real recv since this is not the same
         // device send/recv.
         --num_control_flow_edges;
-        AddInput(real_recv, control_flow_edge->src()->name(),
-                 Graph::kControlSlot);
+        if (real_recv != nullptr) {
+          AddInput(real_recv, control_flow_edge->src()->name(),
+                   Graph::kControlSlot);
+        }
       }
 
       if (!edge->IsControlEdge() &&
           IsRefType(src->output_type(edge->src_output()))) {
-        AddNodeAttr("_start_time", recv_start_time, recv);
-        if (real_recv != recv) {
-          AddNodeAttr("_start_time", recv_start_time, real_recv);
+        if (recv != nullptr) {
+          AddNodeAttr("_start_time", recv_start_time, recv);
+          if (real_recv != recv) {
+            AddNodeAttr("_start_time", recv_start_time, real_recv);
+          }
+          // If src is of ref type and the edge is not a control edge, dst
+          // has read semantics and therefore we must control the recv.
+          ref_recvs.push_back(real_recv);
         }
-        // If src is of ref type and the edge is not a control edge, dst has
-        // read semantics and therefore we must control the recv.
-        ref_recvs.push_back(real_recv);
       } else {
         // Memorize the send/recv pair, only if this is not a "ref" edge.
         // NOTE(yuanbyu): Collapsing ref edges requires extreme care so
         // for now we don't do it.
-        dup_recv[key] = {recv, real_recv, recv_start_time};
-        ref_control_inputs.push_back(recv->name());
+        (*dup_recv)[key] = {recv, real_recv, recv_start_time};
+        if (recv != nullptr) ref_control_inputs.push_back(recv->name());
       }
 
+      if (recv == nullptr) continue;
       if (edge->IsControlEdge()) {
-        ++num_control;
+        ++*num_control;
         AddInput(dst_def, recv->name(), Graph::kControlSlot);
       } else {
-        ++num_data;
+        ++*num_data;
         AddInput(dst_def, recv->name(), 0);
       }
     }
@@ -1201,7 +1276,7 @@ Status Partition(const PartitionOptions& opts, Graph* g,
     AddReadControl(ref_recvs, ref_control_inputs);
 
     // Add back the control edges for control flow that are not used.
-    if (control_flow_edge != nullptr) {
+    if (dst_def != nullptr && control_flow_edge != nullptr) {
       for (int i = 0; i < num_control_flow_edges; ++i) {
         AddInput(dst_def, control_flow_edge->src()->name(),
                  Graph::kControlSlot);
@@ -1209,31 +1284,76 @@ Status Partition(const PartitionOptions& opts, Graph* g,
     }
   }
 
+  return Status::OK();
+}
+
+// Sets the start times of the recvs in 'dup_recv' that were built.
+void SetRecvStartTimes(const PartitionOptions& opts,
+                       const DupRecvTable& dup_recv) {
+  if (!opts.scheduling_for_recvs) return;
+  for (auto& it : dup_recv) {
+    if (it.second.recv == nullptr) continue;
+    AddNodeAttr("_start_time", it.second.start_time, it.second.recv);
+    if (it.second.real_recv != it.second.recv) {
+      AddNodeAttr("_start_time", it.second.start_time, it.second.real_recv);
+    }
+  }
+}
+
+// Sets the versions, function library and send/recv incarnations of a
+// partition of 'g', and orders its recvs if requested.
+Status FinishPartition(const PartitionOptions& opts, const Graph& g,
+                       GraphDef* gdef) {
   const FunctionLibraryDefinition* flib_def = opts.flib_def;
   if (flib_def == nullptr) {
-    flib_def = &g->flib_def();
+    flib_def = &g.flib_def();
   }
+  *gdef->mutable_versions() = g.versions();
+  // Prune unreachable functions from `flib_def` before adding them to `gdef`.
+  *gdef->mutable_library() = flib_def->ReachableDefinitions(*gdef).ToProto();
 
-  // Set versions, function library and send/recv incarnation.
-  for (auto& it : *partitions) {
-    GraphDef* gdef = &it.second;
-    *gdef->mutable_versions() = g->versions();
-    // Prune unreachable functions from `flib_def` before adding them to `gdef`.
-    *gdef->mutable_library() = flib_def->ReachableDefinitions(*gdef).ToProto();
-
-    // Traverse the graph to fill every send/recv op's incarnation
-    // information.
-    SetIncarnation(opts, gdef);
+  // Traverse the graph to fill every send/recv op's incarnation
+  // information.
+  SetIncarnation(opts, gdef);
+
+  if (opts.scheduling_for_recvs && opts.max_outstanding_recvs > 0) {
+    TF_RETURN_IF_ERROR(OrderRecvsByStartTime(opts, gdef));
   }
+  return Status::OK();
+}
 
-  // Set the start times for recvs at the very end.
-  if (opts.scheduling_for_recvs) {
-    for (auto& it : dup_recv) {
-      AddNodeAttr("_start_time", it.second.start_time, it.second.recv);
-      if (it.second.real_recv != it.second.recv) {
-        AddNodeAttr("_start_time", it.second.start_time, it.second.real_recv);
-      }
+}  // namespace
+
+Status Partition(const PartitionOptions& opts, Graph* g,
+                 std::unordered_map<string, GraphDef>* partitions) {
+  partitions->clear();
+
+  GraphInfo g_info;
+  TF_RETURN_IF_ERROR(PrepareForPartitioning(opts, g, &g_info));
+
+  std::unordered_map<string, int> loc_to_partition;
+  std::vector<GraphDef*> graphs;
+  auto node_to_partition = [&](const Node* node, GraphDef** graph) {
+    auto it = loc_to_partition.emplace(opts.node_to_loc(node), graphs.size());
+    if (it.second) {
+      graphs.push_back(&(*partitions)[it.first->first]);
     }
+    *graph = graphs[it.first->second];
+    return it.first->second;
+  };
+  const std::vector<const Node*> dst_nodes(g->op_nodes().begin(),
+                                           g->op_nodes().end());
+  DupRecvTable dup_recv(3);
+  int32 num_data = 0;
+  int32 num_control = 0;
+  TF_RETURN_IF_ERROR(AddPartitionNodes(opts, g_info, dst_nodes,
+                                       node_to_partition, &dup_recv,
+                                       &num_data, &num_control));
+
+  // Set the start times for recvs at the very end.
+  SetRecvStartTimes(opts, dup_recv);
+  for (auto& it : *partitions) {
+    TF_RETURN_IF_ERROR(FinishPartition(opts, *g, &it.second));
   }
 
   VLOG(1) << "Added send/recv: controls=" << num_control
@@ -1249,4 +1369,86 @@ Status Partition(const PartitionOptions& opts, Graph* g,
   return Status::OK();
 }
 
+Status StreamPartitions(const PartitionOptions& opts, Graph* g,
+                        const PartitionRunner& runner,
+                        const PartitionConsumer& consume) {
+  GraphInfo g_info;
+  TF_RETURN_IF_ERROR(PrepareForPartitioning(opts, g, &g_info));
+
+  // Number the locations.
+  std::vector<string> locations;
+  std::unordered_map<string, int> loc_to_partition;
+  std::vector<int> node_partition(g->num_node_ids(), -1);
+  for (const Node* node : g->op_nodes()) {
+    auto it = loc_to_partition.emplace(opts.node_to_loc(node),
+                                       locations.size());
+    if (it.second) {
+      locations.push_back(it.first->first);
+    }
+    node_partition[node->id()] = it.first->second;
+  }
+
+  // Building a partition visits the nodes placed in it, and the consumers
+  // of its nodes elsewhere, which need sends.
+  std::vector<std::vector<const Node*>> partition_nodes(locations.size());
+  for (const Node* dst : g->op_nodes()) {
+    partition_nodes[node_partition[dst->id()]].push_back(dst);
+    for (const Edge* edge : dst->in_edges()) {
+      if (!edge->src()->IsOp()) continue;
+      std::vector<const Node*>* nodes =
+          &partition_nodes[node_partition[edge->src()->id()]];
+      if (nodes->empty() || nodes->back() != dst) {
+        nodes->push_back(dst);
+      }
+    }
+  }
+
+  auto build = [&](int part) -> Status {
+    GraphDef gdef;
+    auto node_to_partition = [&node_partition, &gdef, part](
+                                 const Node* node, GraphDef** graph) {
+      const int p = node_partition[node->id()];
+      *graph = (p == part) ? &gdef : nullptr;
+      return p;
+    };
+    DupRecvTable dup_recv(3);
+    int32 num_data = 0;
+    int32 num_control = 0;
+    Status s = AddPartitionNodes(opts, g_info, partition_nodes[part],
+                                 node_to_partition, &dup_recv, &num_data,
+                                 &num_control);
+    std::vector<const Node*>().swap(partition_nodes[part]);
+    TF_RETURN_IF_ERROR(s);
+    SetRecvStartTimes(opts, dup_recv);
+    TF_RETURN_IF_ERROR(FinishPartition(opts, *g, &gdef));
+    VLOG(1) << "Partition " << locations[part] << ": " << gdef.node_size()
+            << " nodes, received controls=" << num_control
+            << ", data=" << num_data;
+    return consume(locations[part], &gdef);
+  };
+
+  const int num_partitions = locations.size();
+  if (!runner) {
+    for (int part = 0; part < num_partitions; ++part) {
+      TF_RETURN_IF_ERROR(build(part));
+    }
+    return Status::OK();
+  }
+  mutex mu;
+  Status status;
+  BlockingCounter pending(num_partitions);
+  for (int part = 0; part < num_partitions; ++part) {
+    runner([&, part]() {
+      Status s = build(part);
+      if (!s.ok()) {
+        mutex_lock l(mu);
+        status.Update(s);
+      }
+      pending.DecrementCount();
+    });
+  }
+  pending.Wait();
+  return status;
+}
+
 }  // namespace tensorflow
@@ -76,6 +76,13 @@ struct PartitionOptions {
   // in the graph as a node attribute.
   bool need_to_record_start_times = false;
   std::vector<Microseconds> start_times;
+
+  // If positive and 'scheduling_for_recvs' is true, the root-frame recvs of
+  // each partition are chained in the order of their start times: a recv is
+  // activated only once the recv 'max_outstanding_recvs' positions before it
+  // has completed, so that tensors needed early are not queued behind large
+  // transfers that are needed late.
+  int max_outstanding_recvs = 0;
 };
 
 // Partition "input" graph into a set of graphs, one per location.
@@ -87,6 +94,26 @@ struct PartitionOptions {
 Status Partition(const PartitionOptions& opts, Graph* input,
                  std::unordered_map<string, GraphDef>* partitions);
 
+// Runs a closure, possibly on another thread.
+typedef std::function<void(std::function<void()>)> PartitionRunner;
+
+// Takes a completed partition for location 'loc'. The partition may be
+// modified or consumed.
+typedef std::function<Status(const string& loc, GraphDef* partition)>
+    PartitionConsumer;
+
+// Like Partition(), but builds one location at a time and hands each
+// partition to 'consume' as soon as it is complete, so that no more than the
+// partitions being built at once are held in memory. Building a partition
+// only visits the nodes placed in it and the consumers of their outputs.
+//
+// If 'runner' is non-null, the partitions are built concurrently on it, so
+// 'consume' and opts.new_name must be thread-safe. The generated node names
+// may differ from those of Partition().
+Status StreamPartitions(const PartitionOptions& opts, Graph* input,
+                        const PartitionRunner& runner,
+                        const PartitionConsumer& consume);
+
 // Add control edges to the partitions to control the ordering
 // and timing of the recv nodes based on the start times calculated
 // using some scheduling algorithm.
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/graph/graph_partition.h"
 
+#include <algorithm>
 #include <unordered_map>
 #include <utility>
 
@@ -35,8 +36,11 @@ limitations under the License.
 #include "tensorflow/core/graph/graph_def_builder.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/public/version.h"
@@ -458,6 +462,123 @@ TEST_F(GraphPartitionTest, PartitionIncompleteGraph) {
   EXPECT_EQ(error::INVALID_ARGUMENT, status.code()) << status;
 }
 
+TEST_F(GraphPartitionTest, OrderRecvsByStartTime) {
+  auto a1 = FloatInput(in_.WithOpName("A1"));
+  auto a2 = FloatInput(in_.WithOpName("A2"));
+  auto a3 = FloatInput(in_.WithOpName("A3"));
+  auto b1 = Combine(in_.WithOpName("B1"), a3, a3);
+  auto b2 = Combine(in_.WithOpName("B2"), b1, a1);
+  Combine(in_.WithOpName("B3"), b2, a2);
+
+  Graph g(OpRegistry::Global());
+  TF_ASSERT_OK(
+      ConvertGraphDefToGraph(GraphConstructorOptions(), ToGraphDef(), &g));
+  // The consumers on B need A3 first, then A1, then A2.
+  std::vector<Microseconds> start_times(g.num_node_ids());
+  for (Node* node : g.op_nodes()) {
+    node->set_assigned_device_name(DeviceName(node));
+    if (node->name()[0] == 'B') {
+      start_times[node->id()] = 10 * (node->name()[1] - '0');
+    }
+  }
+
+  PartitionOptions popts;
+  popts.node_to_loc = SplitByDevice;
+  popts.new_name = [&g](const string& prefix) { return g.NewName(prefix); };
+  popts.get_incarnation = [](const string&) { return 1; };
+  popts.scheduling_for_recvs = true;
+  popts.need_to_record_start_times = true;
+  popts.start_times = start_times;
+  popts.max_outstanding_recvs = 1;
+  TF_ASSERT_OK(Partition(popts, &g, &partitions_));
+
+  std::unordered_map<string, const NodeDef*> recvs;
+  std::unordered_map<string, const NodeDef*> nodes;
+  const string b = "/job:a/replica:0/task:0/cpu:1";
+  for (const NodeDef& ndef : partitions_[b].node()) {
+    nodes[ndef.name()] = &ndef;
+    if (ndef.op() == "_Recv") recvs[ndef.name().substr(0, 2)] = &ndef;
+  }
+  ASSERT_EQ(3, recvs.size());
+  // Returns the recv that must complete before 'recv' is activated.
+  auto predecessor = [&nodes](const NodeDef* recv) -> string {
+    if (recv->input_size() != 1) return "";
+    const NodeDef* trigger = nodes[recv->input(0).substr(1)];
+    EXPECT_EQ("ControlTrigger", trigger->op());
+    EXPECT_EQ(1, trigger->input_size());
+    return trigger->input(0).substr(1);
+  };
+  EXPECT_EQ(0, recvs["A3"]->input_size());
+  EXPECT_EQ(recvs["A3"]->name(), predecessor(recvs["A1"]));
+  EXPECT_EQ(recvs["A1"]->name(), predecessor(recvs["A2"]));
+}
+
+// Returns the ops and the number of inputs of the nodes in 'gdef', with the
+// tensor names of sends and recvs, which do not depend on generated names.
+std::vector<string> NodeSignatures(const GraphDef& gdef) {
+  std::vector<string> signatures;
+  for (const NodeDef& ndef : gdef.node()) {
+    string tensor_name;
+    if (ndef.op() == "_Send" || ndef.op() == "_Recv") {
+      TF_CHECK_OK(GetNodeAttr(ndef, "tensor_name", &tensor_name));
+    }
+    signatures.push_back(
+        strings::StrCat(ndef.op(), ":", tensor_name, ":", ndef.input_size()));
+  }
+  std::sort(signatures.begin(), signatures.end());
+  return signatures;
+}
+
+TEST_F(GraphPartitionTest, StreamPartitions) {
+  auto a1 = FloatInput(in_.WithOpName("A1"));
+  auto b1 = FloatInput(in_.WithOpName("B1"));
+  auto c1 = FloatInput(in_.WithOpName("C1"));
+  auto b2 = Combine(in_.WithOpName("B2"), a1, c1);
+  Combine(in_.WithOpName("B3"), a1, a1);
+  auto c2 = Combine(in_.WithOpName("C2").WithControlDependencies(b1.op()),
+                    a1, b2);
+  Combine(in_.WithOpName("A2"), c2, b2);
+  const GraphDef& graph_def = ToGraphDef();
+  Partition(graph_def, &partitions_);
+  ASSERT_EQ(3, partitions_.size());
+
+  thread::ThreadPool pool(Env::Default(), "partition", 2);
+  const PartitionRunner runners[] = {
+      nullptr, [&pool](std::function<void()> fn) { pool.Schedule(fn); }};
+  for (const PartitionRunner& runner : runners) {
+    Graph g(OpRegistry::Global());
+    TF_ASSERT_OK(
+        ConvertGraphDefToGraph(GraphConstructorOptions(), graph_def, &g));
+    for (Node* node : g.nodes()) {
+      node->set_assigned_device_name(DeviceName(node));
+    }
+    mutex mu;
+    PartitionOptions popts;
+    popts.node_to_loc = SplitByDevice;
+    popts.new_name = [&g, &mu](const string& prefix) {
+      mutex_lock l(mu);
+      return g.NewName(prefix);
+    };
+    popts.get_incarnation = [](const string& name) {
+      return (name[0] - 'A') + 100;
+    };
+    std::unordered_map<string, GraphDef> streamed;
+    TF_ASSERT_OK(StreamPartitions(
+        popts, &g, runner, [&mu, &streamed](const string& loc, GraphDef* gdef) {
+          mutex_lock l(mu);
+          streamed[loc].Swap(gdef);
+          return Status::OK();
+        }));
+    ASSERT_EQ(partitions_.size(), streamed.size());
+    for (const auto& kv : partitions_) {
+      EXPECT_EQ(NodeSignatures(kv.second), NodeSignatures(streamed[kv.first]))
+          << kv.first;
+      EXPECT_EQ(kv.second.versions().producer(),
+                streamed[kv.first].versions().producer());
+    }
+  }
+}
+
 TEST_F(GraphPartitionTest, Functions) {
   FunctionDefLibrary fdef_lib;
   *fdef_lib.add_function() = test::function::XTimesTwo();
@@ -15,7 +15,10 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
 #include "absl/types/optional.h"
+#include "tensorflow/core/framework/attr_value_util.h"
 #include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/function.pb.h"
 #include "tensorflow/core/framework/node_def_util.h"
@@ -35,6 +38,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/topological_sort.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/flatset.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 
 namespace tensorflow {
@@ -550,7 +554,7 @@ class SymbolicShapeRefiner {
       const GraphView& graph,
       const std::unordered_map<string, std::unordered_set<int>>& fed_ports,
       const bool aggressive_shape_inference)
-      : graph_(graph),
+      : graph_(&graph),
         function_library_(OpRegistry::Global(), graph.graph()->library()),
         fed_ports_(fed_ports),
         aggressive_shape_inference_(aggressive_shape_inference) {
@@ -558,7 +562,10 @@ class SymbolicShapeRefiner {
     node_to_context_.reserve(graph.graph()->node_size());
   }
 
-  const GraphView& graph() const { return graph_; }
+  const GraphView& graph() const { return *graph_; }
+  // Points the refiner to a new view of the same graph, e.g. after the graph
+  // was edited.
+  void set_graph(const GraphView* graph) { graph_ = graph; }
 
   struct NodeContext {
     const OpRegistrationData* op_data;
@@ -639,7 +646,7 @@ class SymbolicShapeRefiner {
             "Function inputs should not contain control nodes.");
       }
 
-      const NodeDef* input_node = graph_.GetNode(input_tensor.node());
+      const NodeDef* input_node = graph_->GetNode(input_tensor.node());
       if (input_node == nullptr) {
         return errors::FailedPrecondition(input_tensor.node(),
                                           " was not found in the graph.");
@@ -680,7 +687,7 @@ class SymbolicShapeRefiner {
     for (int i = grappler_function_item.inputs().size() - 1; i >= 0; --i) {
       const string& input = function_node->input(i);
       const string& node_name = NodeName(input);
-      const NodeDef* input_node = graph_.GetNode(node_name);
+      const NodeDef* input_node = graph_->GetNode(node_name);
       if (IsConstant(*input_node)) {
         TF_CHECK_OK(
             ReplaceInputWithConst(*input_node, i, &grappler_function_item));
@@ -779,7 +786,7 @@ class SymbolicShapeRefiner {
 
     for (int dst_input = 0; dst_input < ic->num_inputs(); ++dst_input) {
       const GraphView::InputPort port(node, dst_input);
-      const GraphView::OutputPort fanin = graph_.GetRegularFanin(port);
+      const GraphView::OutputPort fanin = graph_->GetRegularFanin(port);
       int src_output = fanin.port_id;
       const NodeDef* src = fanin.node;
       NodeContext* src_ctx = GetNodeContext(src);
@@ -1177,6 +1184,33 @@ class SymbolicShapeRefiner {
     return s;
   }
 
+  // Forgets everything inferred about the nodes for which `should_remove`
+  // returns true, so that they are added again by the next UpdateNode(). The
+  // nodes reading the shapes of a removed node must be removed as well.
+  void RemoveNodes(const std::function<bool(const NodeDef*)>& should_remove) {
+    for (auto it = unknown_shapes_.begin(); it != unknown_shapes_.end();) {
+      if (should_remove(it->first.node)) {
+        it = unknown_shapes_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (auto it = unknown_dims_.begin(); it != unknown_dims_.end();) {
+      if (should_remove(it->first.node)) {
+        it = unknown_dims_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (auto it = node_to_context_.begin(); it != node_to_context_.end();) {
+      if (should_remove(it->first)) {
+        it = node_to_context_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
  private:
   // Return the one ShapeHandle used to denote a fully unknown shape for a node
   // output.
@@ -1801,7 +1835,7 @@ class SymbolicShapeRefiner {
     return false;
   }
 
-  const GraphView& graph_;
+  const GraphView* graph_;  // Not owned.
   int graph_def_version_;
   std::unordered_map<const NodeDef*, NodeContext> node_to_context_;
   std::unordered_map<ShapeId, ShapeHandle, HashShapeId> unknown_shapes_;
@@ -1872,6 +1906,26 @@ class SymbolicShapeManager {
   DisjointSet<shape_inference::DimensionHandle> dims_;
 };
 
+// What InferStatically() learned about the graph, kept around so that
+// UpdateStatically() only has to revisit the nodes affected by an edit.
+struct GraphProperties::InferenceState {
+  std::unordered_map<string, std::unordered_set<int>> fed_ports;
+  std::unique_ptr<GraphView> graph_view;
+  std::unique_ptr<SymbolicShapeRefiner> refiner;
+  // The refiner instantiates the functions of the library it was created
+  // with, which is identified by its fingerprint.
+  uint64 library_fingerprint = 0;
+
+  bool assume_valid_feeds = false;
+  bool aggressive_shape_inference = false;
+  bool include_input_tensor_values = false;
+  bool include_output_tensor_values = false;
+};
+
+GraphProperties::GraphProperties(const GrapplerItem& item) : item_(item) {}
+
+GraphProperties::~GraphProperties() {}
+
 Status GraphProperties::RelaxEnqueueShapesAndMergeTypes(
     SymbolicShapeRefiner* shape_refiner, const NodeDef* qnode,
     const std::vector<ShapeAndType>& shapes_and_types,
@@ -2156,9 +2210,16 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
                                         bool aggressive_shape_inference,
                                         bool include_input_tensor_values,
                                         bool include_output_tensor_values) {
-  FunctionLibraryDefinition function_library(OpRegistry::Global(),
-                                             item_.graph.library());
-  std::unordered_map<string, std::unordered_set<int>> fed_ports;
+  auto state = absl::make_unique<InferenceState>();
+  state->assume_valid_feeds = assume_valid_feeds;
+  state->aggressive_shape_inference = aggressive_shape_inference;
+  state->include_input_tensor_values = include_input_tensor_values;
+  state->include_output_tensor_values = include_output_tensor_values;
+  state->library_fingerprint =
+      DeterministicProtoHash64(item_.graph.library());
+
+  std::unordered_map<string, std::unordered_set<int>>& fed_ports =
+      state->fed_ports;
   if (!assume_valid_feeds) {
     for (const auto& feed : item_.feed) {
       SafeTensorId tensor_id = ParseTensorName(feed.first);
@@ -2166,7 +2227,8 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
     }
   }
 
-  GraphView graph_view(&item_.graph);
+  state->graph_view = absl::make_unique<GraphView>(&item_.graph);
+  const GraphView& graph_view = *state->graph_view;
 
   // List the resources and the nodes using them. Also collect the Merge nodes,
   // fed nodes, and primary inputs.
@@ -2242,8 +2304,9 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
 
   // Heap-allocate SymbolicShapeRefiner in order to not consume a large amount
   // of stack space.
-  auto refiner = absl::make_unique<SymbolicShapeRefiner>(
+  state->refiner = absl::make_unique<SymbolicShapeRefiner>(
       graph_view, fed_ports, aggressive_shape_inference);
+  SymbolicShapeRefiner* refiner = state->refiner.get();
 
   TopoQueue new_shapes(topo_order);
   // Also seed the propagation of shapes in the fanout of primary inputs.
@@ -2256,7 +2319,23 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
   }
   // Propagate shapes normally.
   TF_RETURN_IF_ERROR(
-      PropagateShapes(refiner.get(), &new_shapes, resource_handles, num_loops));
+      PropagateShapes(refiner, &new_shapes, resource_handles, num_loops));
+
+  FillProperties(*state);
+  if (incremental_updates_) {
+    inference_state_ = std::move(state);
+  }
+  return Status::OK();
+}
+
+void GraphProperties::FillProperties(const InferenceState& state) {
+  const GraphView& graph_view = *state.graph_view;
+  const std::unordered_map<string, std::unordered_set<int>>& fed_ports =
+      state.fed_ports;
+  SymbolicShapeRefiner* refiner = state.refiner.get();
+  const bool aggressive_shape_inference = state.aggressive_shape_inference;
+  const bool include_input_tensor_values = state.include_input_tensor_values;
+  const bool include_output_tensor_values = state.include_output_tensor_values;
 
   // Track shapes globally across the graph.
   std::unique_ptr<SymbolicShapeManager> shape_manager =
@@ -2381,7 +2460,87 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
   // Help trace the unknown dimensions to their origins.
   VerboseLogUnknownDimensionSources(item_.graph, input_properties_,
                                     output_properties_);
+}
+
+Status GraphProperties::UpdateStatically() {
+  if (inference_state_ == nullptr) {
+    return errors::FailedPrecondition(
+        "UpdateStatically() requires a successful call to InferStatically() "
+        "with incremental updates enabled.");
+  }
+  std::unordered_set<string> updated_nodes;
+  updated_nodes.swap(edit_tracker_.updated_nodes);
 
+  bool has_queues = false;
+  int num_loops = 0;
+  std::unordered_set<const NodeDef*> live_nodes;
+  live_nodes.reserve(item_.graph.node_size());
+  for (const NodeDef& node : item_.graph.node()) {
+    has_queues |= IsQueue(node);
+    if (IsNextIteration(node)) ++num_loops;
+    live_nodes.insert(&node);
+  }
+
+  std::unique_ptr<InferenceState> state = std::move(inference_state_);
+  input_properties_.clear();
+  output_properties_.clear();
+  incompatible_shape_nodes_.clear();
+
+  // Shapes flow from enqueue to dequeue nodes through the queues outside of
+  // the graph edges, and new or rewritten functions aren't known to the
+  // refiner: start over in these (rare) cases.
+  if (has_queues || state->library_fingerprint !=
+                        DeterministicProtoHash64(item_.graph.library())) {
+    VLOG(1) << "Inferring the shapes of the whole graph again";
+    return InferStatically(state->assume_valid_feeds,
+                           state->aggressive_shape_inference,
+                           state->include_input_tensor_values,
+                           state->include_output_tensor_values);
+  }
+
+  state->graph_view = absl::make_unique<GraphView>(&item_.graph);
+  state->refiner->set_graph(state->graph_view.get());
+  std::vector<const NodeDef*> topo_order;
+  TF_RETURN_IF_ERROR(ComputeTopologicalOrder(item_.graph, &topo_order));
+
+  // The shapes of the updated nodes and of their transitive fanout may have
+  // changed. Everything else was inferred from unchanged inputs.
+  std::unordered_set<const NodeDef*> stale_nodes;
+  std::vector<const NodeDef*> to_visit;
+  for (const string& node_name : updated_nodes) {
+    const NodeDef* node = state->graph_view->GetNode(node_name);
+    if (node != nullptr && stale_nodes.insert(node).second) {
+      to_visit.push_back(node);
+    }
+  }
+  while (!to_visit.empty()) {
+    const NodeDef* node = to_visit.back();
+    to_visit.pop_back();
+    for (const auto& fanout : state->graph_view->GetFanouts(
+             *node, /*include_controlled_nodes=*/false)) {
+      if (stale_nodes.insert(fanout.node).second) {
+        to_visit.push_back(fanout.node);
+      }
+    }
+  }
+  VLOG(1) << "Updating the shapes of " << stale_nodes.size() << " out of "
+          << item_.graph.node_size() << " nodes";
+
+  // Deleted nodes are forgotten as well, since their addresses may be reused
+  // by new nodes.
+  state->refiner->RemoveNodes([&](const NodeDef* node) {
+    return stale_nodes.count(node) > 0 || live_nodes.count(node) == 0;
+  });
+
+  TopoQueue new_shapes(topo_order);
+  for (const NodeDef* node : stale_nodes) {
+    new_shapes.push(node);
+  }
+  TF_RETURN_IF_ERROR(PropagateShapes(state->refiner.get(), &new_shapes,
+                                     /*resource_handles=*/{}, num_loops));
+
+  FillProperties(*state);
+  inference_state_ = std::move(state);
   return Status::OK();
 }
 
@@ -2479,5 +2638,87 @@ void GraphProperties::ClearOutputProperties(const string& node_name) {
   output_properties_.erase(node_name);
 }
 
+namespace {
+
+// Returns true if `a` and `b`, which have the same name, have the same op,
+// device, inputs and attributes.
+bool SameNode(const NodeDef& a, const NodeDef& b) {
+  if (a.op() != b.op() || a.device() != b.device() ||
+      a.input_size() != b.input_size() || a.attr_size() != b.attr_size()) {
+    return false;
+  }
+  for (int i = 0; i < a.input_size(); ++i) {
+    if (a.input(i) != b.input(i)) return false;
+  }
+  for (const auto& attr : a.attr()) {
+    auto it = b.attr().find(attr.first);
+    if (it == b.attr().end() || !FastAreAttrValuesEqual(attr.second,
+                                                        it->second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+IncrementalGraphProperties::IncrementalGraphProperties(const GrapplerItem& item)
+    : item_(item.WithGraph(GraphDef())) {}
+
+Status IncrementalGraphProperties::Update(const GraphDef& graph) {
+  if (!inferred_) {
+    item_.graph = graph;
+    properties_ = absl::make_unique<GraphProperties>(item_);
+    properties_->EnableIncrementalUpdates();
+    TF_RETURN_IF_ERROR(
+        properties_->InferStatically(/*assume_valid_feeds=*/false,
+                                     /*aggressive_shape_inference=*/false,
+                                     /*include_tensor_values=*/false));
+    inferred_ = true;
+    return Status::OK();
+  }
+
+  // Brings the tracked graph up to date with `graph`. The nodes which did not
+  // change are left in place, since the shape refiner knows them by address.
+  inferred_ = false;
+  absl::flat_hash_map<string, const NodeDef*> nodes;
+  nodes.reserve(graph.node_size());
+  for (const NodeDef& node : graph.node()) {
+    nodes.emplace(node.name(), &node);
+  }
+  MutableGraphView::Listener* listener = properties_->edit_listener();
+  auto* tracked_nodes = item_.graph.mutable_node();
+  for (int i = 0; i < tracked_nodes->size();) {
+    NodeDef* tracked = tracked_nodes->Mutable(i);
+    auto it = nodes.find(tracked->name());
+    if (it == nodes.end()) {
+      listener->NodeRemoved(tracked->name());
+      tracked_nodes->SwapElements(i, tracked_nodes->size() - 1);
+      tracked_nodes->RemoveLast();
+      continue;
+    }
+    if (!SameNode(*tracked, *it->second)) {
+      *tracked = *it->second;
+      listener->NodeUpdated(*tracked);
+    }
+    nodes.erase(it);
+    ++i;
+  }
+  // The nodes left were added.
+  for (const NodeDef& node : graph.node()) {
+    if (nodes.contains(node.name())) {
+      NodeDef* added = item_.graph.add_node();
+      *added = node;
+      listener->NodeUpdated(*added);
+    }
+  }
+  *item_.graph.mutable_versions() = graph.versions();
+  *item_.graph.mutable_library() = graph.library();
+
+  TF_RETURN_IF_ERROR(properties_->UpdateStatically());
+  inferred_ = true;
+  return Status::OK();
+}
+
 }  // end namespace grappler
 }  // end namespace tensorflow
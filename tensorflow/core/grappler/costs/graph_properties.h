@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_PROPERTIES_H_
 #define TENSORFLOW_CORE_GRAPPLER_COSTS_GRAPH_PROPERTIES_H_
 
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -24,6 +25,8 @@ limitations under the License.
 #include "tensorflow/core/grappler/clusters/cluster.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
 #include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
+#include "tensorflow/core/platform/macros.h"
 
 namespace tensorflow {
 
@@ -80,7 +83,13 @@ class TopoQueue;
 class GraphProperties {
  public:
   // The item must outlive the properties
-  explicit GraphProperties(const GrapplerItem& item) : item_(item) {}
+  explicit GraphProperties(const GrapplerItem& item);
+  ~GraphProperties();
+
+  // Keeps the state of shape inference after InferStatically() so that
+  // UpdateStatically() can be used once the graph is edited. This trades
+  // memory for the cost of inferring the shapes of the whole graph again.
+  void EnableIncrementalUpdates() { incremental_updates_ = true; }
 
   // Infer the shapes through abstract interpretation. Feed information can be
   // incorrect so it should be discarded to ensure correctness of the analysis.
@@ -113,6 +122,17 @@ class GraphProperties {
                            /*aggressive_shape_inference=*/false,
                            /*include_tensor_values=*/true);
   }
+  // Updates the properties after the graph of the item was edited, by only
+  // inferring the shapes of the edited nodes and of their transitive fanout.
+  // The edits must be reported to edit_listener(), e.g. by making it the
+  // listener of the MutableGraphView used to edit the graph. Uses the options
+  // of the last call to InferStatically(), which must have succeeded with
+  // incremental updates enabled. Up to the numbering of the symbolic
+  // dimensions, the resulting properties are the ones InferStatically() would
+  // compute.
+  Status UpdateStatically();
+  MutableGraphView::Listener* edit_listener() { return &edit_tracker_; }
+
   // Infer the shape by running the graph on the specified cluster and recording
   // the shapes of the processed tensors.
   Status InferDynamically(Cluster* cluster);
@@ -152,6 +172,24 @@ class GraphProperties {
   }
 
  private:
+  struct InferenceState;
+
+  // Records the names of the nodes that were added or modified.
+  class EditTracker : public MutableGraphView::Listener {
+   public:
+    void NodeUpdated(const NodeDef& node) override {
+      updated_nodes.insert(node.name());
+    }
+    // What was inferred about deleted nodes is discarded by
+    // UpdateStatically(), and their fanouts are reported as updated.
+    void NodeRemoved(absl::string_view node_name) override {}
+
+    std::unordered_set<string> updated_nodes;
+  };
+
+  // Fills the input and output properties from the inferred shapes.
+  void FillProperties(const InferenceState& state);
+
   // Relaxes shapes <shapes_and_types>, determined from an EnqueueV2 node, into
   // <*queue_shapes_and_types>.
   static Status RelaxEnqueueShapesAndMergeTypes(
@@ -204,6 +242,37 @@ class GraphProperties {
   // Nodes with output shape incompatible between shape inference and
   // annotation.
   std::unordered_set<string> incompatible_shape_nodes_;
+
+  bool incremental_updates_ = false;
+  std::unique_ptr<InferenceState> inference_state_;
+  EditTracker edit_tracker_;
+};
+
+// Keeps the properties of a graph rewritten by a sequence of optimizers up to
+// date, by only inferring the shapes of the nodes that the rewrites changed
+// and of their fanout (see GraphProperties::UpdateStatically()). The shapes
+// are inferred statically, without assuming valid feeds, without aggressive
+// shape inference and without tensor values.
+class IncrementalGraphProperties {
+ public:
+  // Uses the feeds and fetches of `item`.
+  explicit IncrementalGraphProperties(const GrapplerItem& item);
+
+  // Infers the properties of `graph`. The nodes are matched by name with the
+  // graph of the last successful call, if any.
+  Status Update(const GraphDef& graph);
+
+  // The properties of the graph of the last successful Update(). The caller
+  // can modify them, e.g. clear the properties of the nodes it rewrites, until
+  // the next Update().
+  GraphProperties* properties() { return properties_.get(); }
+
+ private:
+  GrapplerItem item_;
+  std::unique_ptr<GraphProperties> properties_;
+  bool inferred_ = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(IncrementalGraphProperties);
 };
 
 }  // end namespace grappler
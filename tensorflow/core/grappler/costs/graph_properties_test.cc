@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "tensorflow/cc/framework/scope.h"
 #include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/graph_def_util.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.pb.h"  // NOLINT
@@ -28,11 +29,14 @@ limitations under the License.
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
 #include "tensorflow/core/grappler/inputs/utils.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -2064,6 +2068,206 @@ TEST_F(GraphPropertiesTest, ShapeAnnotatedFunctionOp) {
     EXPECT_EQ("float: [1,2,3,4]", PropToString(out_prop0));
   }
 }
+
+// Checks that `properties` match the ones inferred from scratch.
+void ExpectSameAsInferStatically(const GrapplerItem& item,
+                                 const GraphProperties& properties,
+                                 bool include_tensor_values = true) {
+  GraphProperties expected(item);
+  TF_ASSERT_OK(expected.InferStatically(/*assume_valid_feeds=*/false,
+                                        /*aggressive_shape_inference=*/false,
+                                        include_tensor_values));
+  for (const NodeDef& node : item.graph.node()) {
+    ASSERT_EQ(expected.HasOutputProperties(node.name()),
+              properties.HasOutputProperties(node.name()))
+        << node.name();
+    for (bool inputs : {true, false}) {
+      const auto& expected_props =
+          inputs ? expected.GetInputProperties(node.name())
+                 : expected.GetOutputProperties(node.name());
+      const auto& props = inputs ? properties.GetInputProperties(node.name())
+                                 : properties.GetOutputProperties(node.name());
+      ASSERT_EQ(expected_props.size(), props.size()) << node.name();
+      for (int i = 0; i < props.size(); ++i) {
+        EXPECT_EQ(expected_props[i].DebugString(), props[i].DebugString())
+            << node.name();
+      }
+    }
+  }
+}
+
+TEST_F(GraphPropertiesTest, UpdateStaticallyAfterEdits) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({2, 3}));
+  Output y = ops::Const(s.WithOpName("y"), 1.0f, {3, 4});
+  Output m = ops::MatMul(s.WithOpName("m"), x, y);
+  Output r = ops::Relu(s.WithOpName("r"), m);
+  ops::Shape(s.WithOpName("shape"), r);
+  Output z = ops::Placeholder(s.WithOpName("z"), DT_FLOAT,
+                              ops::Placeholder::Shape({5}));
+  ops::Neg(s.WithOpName("neg"), z);
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  GraphProperties properties(item);
+  properties.EnableIncrementalUpdates();
+  TF_ASSERT_OK(properties.InferStatically(/*assume_valid_feeds=*/false));
+  EXPECT_EQ("float: [2,4]",
+            PropToString(properties.GetOutputProperties("r")[0]));
+
+  MutableGraphView graph(&item.graph);
+  graph.set_listener(properties.edit_listener());
+
+  // Multiply by a different matrix.
+  NodeDef w;
+  w.set_name("w");
+  w.set_op("Const");
+  (*w.mutable_attr())["dtype"].set_type(DT_FLOAT);
+  test::AsTensor<float>(std::vector<float>(21, 1.0f), TensorShape({3, 7}))
+      .AsProtoTensorContent((*w.mutable_attr())["value"].mutable_tensor());
+  graph.AddNode(std::move(w));
+  TF_ASSERT_OK(graph.UpdateRegularFaninByPort("m", 1, {"w", 0}));
+  TF_ASSERT_OK(properties.UpdateStatically());
+  EXPECT_EQ("float: [2,7]",
+            PropToString(properties.GetOutputProperties("r")[0]));
+  ExpectTensorValues({2, 7},
+                     properties.GetOutputProperties("shape")[0].value());
+  ExpectSameAsInferStatically(item, properties);
+
+  // Delete the matrix that is no longer used, and rename a node.
+  TF_ASSERT_OK(graph.DeleteNodes({"y"}));
+  TF_ASSERT_OK(graph.UpdateNodeName("neg", "negated", false));
+  TF_ASSERT_OK(properties.UpdateStatically());
+  EXPECT_FALSE(properties.HasOutputProperties("y"));
+  EXPECT_FALSE(properties.HasOutputProperties("neg"));
+  EXPECT_EQ("float: [5]",
+            PropToString(properties.GetOutputProperties("negated")[0]));
+  ExpectSameAsInferStatically(item, properties);
+
+  // Feed the relu from the other placeholder.
+  TF_ASSERT_OK(graph.UpdateRegularFaninByPort("r", 0, {"z", 0}));
+  TF_ASSERT_OK(properties.UpdateStatically());
+  ExpectTensorValues({5}, properties.GetOutputProperties("shape")[0].value());
+  ExpectSameAsInferStatically(item, properties);
+}
+
+TEST_F(GraphPropertiesTest, UpdateStaticallyRequiresIncrementalUpdates) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  ops::Const(s.WithOpName("c"), 1.0f, {2});
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  GraphProperties properties(item);
+  TF_ASSERT_OK(properties.InferStatically(/*assume_valid_feeds=*/false));
+  EXPECT_TRUE(errors::IsFailedPrecondition(properties.UpdateStatically()));
+}
+
+TEST_F(GraphPropertiesTest, IncrementalGraphPropertiesFollowRewrites) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({2, 3}));
+  Output y = ops::Const(s.WithOpName("y"), 1.0f, {3, 4});
+  Output m = ops::MatMul(s.WithOpName("m"), x, y);
+  ops::Relu(s.WithOpName("r"), m);
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  IncrementalGraphProperties incremental(item);
+  TF_ASSERT_OK(incremental.Update(item.graph));
+  EXPECT_EQ("float: [2,4]", PropToString(
+                                incremental.properties()->GetOutputProperties(
+                                    "r")[0]));
+
+  // Rewrite a copy of the graph, as an optimizer would: multiply by a
+  // different matrix, and delete the one that is no longer used.
+  GrapplerItem rewritten = item;
+  MutableGraphView graph(&rewritten.graph);
+  NodeDef w;
+  w.set_name("w");
+  w.set_op("Const");
+  (*w.mutable_attr())["dtype"].set_type(DT_FLOAT);
+  test::AsTensor<float>(std::vector<float>(21, 1.0f), TensorShape({3, 7}))
+      .AsProtoTensorContent((*w.mutable_attr())["value"].mutable_tensor());
+  graph.AddNode(std::move(w));
+  TF_ASSERT_OK(graph.UpdateRegularFaninByPort("m", 1, {"w", 0}));
+  TF_ASSERT_OK(graph.DeleteNodes({"y"}));
+  TF_ASSERT_OK(incremental.Update(rewritten.graph));
+  EXPECT_EQ("float: [2,7]", PropToString(
+                                incremental.properties()->GetOutputProperties(
+                                    "r")[0]));
+  EXPECT_FALSE(incremental.properties()->HasOutputProperties("y"));
+  ExpectSameAsInferStatically(rewritten, *incremental.properties(),
+                              /*include_tensor_values=*/false);
+
+  // Changing the function library infers the shapes from scratch.
+  *rewritten.graph.mutable_library()->add_function() =
+      FunctionDefHelper::Create("MyNeg", {"x:float"}, {"y:float"}, {},
+                                {{{"neg"}, "Neg", {"x"}, {{"T", DT_FLOAT}}}},
+                                /*ret_def=*/{{"y", "neg:y:0"}});
+  TF_ASSERT_OK(incremental.Update(rewritten.graph));
+  ExpectSameAsInferStatically(rewritten, *incremental.properties(),
+                              /*include_tensor_values=*/false);
+}
+
+// Returns a graph of independent towers of `kTowerDepth` element-wise ops,
+// whose first op reads "x" and either "small" or "large".
+constexpr int kTowerDepth = 10;
+GrapplerItem MakeTowers(int num_nodes) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({8, 16}));
+  ops::Const(s.WithOpName("small"), 1.0f, {8, 1});
+  Output large = ops::Const(s.WithOpName("large"), 1.0f, {8, 16});
+  for (int t = 0; t * kTowerDepth < num_nodes; ++t) {
+    Output y = ops::Add(s.WithOpName(strings::StrCat("tower", t, "_0")), x,
+                        large);
+    for (int i = 1; i < kTowerDepth; ++i) {
+      y = ops::Relu(s.WithOpName(strings::StrCat("tower", t, "_", i)), y);
+    }
+  }
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  return item;
+}
+
+// Switches the second input of the first tower between "small" and "large".
+void EditTowers(int iter, MutableGraphView* graph) {
+  TF_CHECK_OK(graph->UpdateRegularFaninByPort(
+      "tower0_0", 1, {iter % 2 == 0 ? "small" : "large", 0}));
+}
+
+// Inferring the shapes of the whole graph after every edit.
+static void BM_InferStaticallyAfterEdit(int iters, int num_nodes) {
+  testing::StopTiming();
+  GrapplerItem item = MakeTowers(num_nodes);
+  MutableGraphView graph(&item.graph);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    EditTowers(i, &graph);
+    GraphProperties properties(item);
+    TF_CHECK_OK(properties.InferStatically(/*assume_valid_feeds=*/false));
+  }
+}
+BENCHMARK(BM_InferStaticallyAfterEdit)->Arg(10000)->Arg(100000);
+
+// Only inferring the shapes of the edited tower.
+static void BM_UpdateStaticallyAfterEdit(int iters, int num_nodes) {
+  testing::StopTiming();
+  GrapplerItem item = MakeTowers(num_nodes);
+  GraphProperties properties(item);
+  properties.EnableIncrementalUpdates();
+  TF_CHECK_OK(properties.InferStatically(/*assume_valid_feeds=*/false));
+  MutableGraphView graph(&item.graph);
+  graph.set_listener(properties.edit_listener());
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    EditTowers(i, &graph);
+    TF_CHECK_OK(properties.UpdateStatically());
+  }
+}
+BENCHMARK(BM_UpdateStaticallyAfterEdit)->Arg(10000)->Arg(100000);
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
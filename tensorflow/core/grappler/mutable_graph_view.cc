@@ -439,6 +439,7 @@ NodeDef* MutableGraphView::AddNode(NodeDef&& node) {
   AddUniqueNodeOrDie(node_in_graph);
 
   AddAndDedupFanouts(node_in_graph);
+  NotifyNodeUpdated(node_in_graph);
   return node_in_graph;
 }
 
@@ -486,6 +487,7 @@ Status MutableGraphView::AddSubgraph(GraphDef&& subgraph) {
   for (int i = node_size_before; i < graph()->node_size(); ++i) {
     NodeDef* node = graph()->mutable_node(i);
     AddAndDedupFanouts(node);
+    NotifyNodeUpdated(node);
   }
 
   return Status::OK();
@@ -529,6 +531,7 @@ Status MutableGraphView::UpdateNode(
   }
 
   if (node->op() == op) {
+    NotifyNodeUpdated(node);
     return Status::OK();
   }
 
@@ -538,10 +541,12 @@ Status MutableGraphView::UpdateNode(
     for (const auto& control_fanout : control_fanouts) {
       if (HasRegularFaninNode(*this, *control_fanout.node, node->name())) {
         RemoveControllingFaninInternal(control_fanout.node, node);
+        NotifyNodeUpdated(control_fanout.node);
       }
     }
   }
 
+  NotifyNodeUpdated(node);
   return Status::OK();
 }
 
@@ -582,9 +587,11 @@ Status MutableGraphView::UpdateNodeName(absl::string_view from_node_name,
     return error_status("can't update node name because node has fanouts");
   }
 
+  NotifyNodeRemoved(node->name());
   nodes().erase(node->name());
   node->set_name(string(to_node_name));
   nodes().emplace(node->name(), node);
+  NotifyNodeUpdated(node);
   return Status::OK();
 }
 
@@ -619,6 +626,8 @@ Status MutableGraphView::SwapNodeNames(absl::string_view from_node_name,
     SwapFanoutInputs(*this, &fanouts(), &max_regular_output_port(), from_node,
                      to_node);
     swap_names();
+    NotifyNodeUpdated(from_node);
+    NotifyNodeUpdated(to_node);
     return Status::OK();
   }
 
@@ -727,6 +736,14 @@ Status MutableGraphView::SwapNodeNames(absl::string_view from_node_name,
     }
   }
 
+  // The fanouts of both nodes now read from the other node.
+  for (NodeDef* node : {from_node, to_node}) {
+    NotifyNodeUpdated(node);
+    for (const InputPort& fanout :
+         GetFanouts(*node, /*include_controlled_nodes=*/true)) {
+      NotifyNodeUpdated(fanout.node);
+    }
+  }
   return Status::OK();
 }
 
@@ -787,6 +804,7 @@ Status MutableGraphView::UpdateFanoutsInternal(NodeDef* from_node,
     NodeDef* node = control_port.node;
     RemoveControllingFaninInternal(node, from_node);
     AddFaninInternal(node, {to_node, Graph::kControlSlot});
+    NotifyNodeUpdated(node);
   }
 
   // First we update regular fanouts. For the regular fanouts
@@ -824,6 +842,7 @@ Status MutableGraphView::UpdateFanoutsInternal(NodeDef* from_node,
     if (CanDedupControlWithRegularInput(*this, *to_node)) {
       RemoveControllingFaninInternal(input_port.node, to_node);
     }
+    NotifyNodeUpdated(input_port.node);
   }
 
   // Because we update all regular fanouts of `from_node`, we can just copy
@@ -904,6 +923,7 @@ Status MutableGraphView::AddRegularFanin(absl::string_view node_name,
   TF_RETURN_IF_ERROR(CheckNodeExists(fanin.node(), fanin_node, error_status));
 
   AddFaninInternal(node, {fanin_node, fanin.index()});
+  NotifyNodeUpdated(node);
   return Status::OK();
 }
 
@@ -948,6 +968,7 @@ Status MutableGraphView::AddRegularFaninByPort(absl::string_view node_name,
     RemoveControllingFaninInternal(node, fanin_node);
   }
 
+  NotifyNodeUpdated(node);
   return Status::OK();
 }
 
@@ -1036,7 +1057,9 @@ Status MutableGraphView::AddControllingFanin(absl::string_view node_name,
   if (control_node == nullptr) {
     control_node = GetOrCreateIdentityConsumingSwitch(fanin_port);
   }
-  AddFaninInternal(node, {control_node, Graph::kControlSlot});
+  if (AddFaninInternal(node, {control_node, Graph::kControlSlot})) {
+    NotifyNodeUpdated(node);
+  }
 
   return Status::OK();
 }
@@ -1113,7 +1136,9 @@ Status MutableGraphView::RemoveRegularFanin(absl::string_view node_name,
   NodeDef* fanin_node = GetNode(fanin.node());
   TF_RETURN_IF_ERROR(CheckNodeExists(fanin.node(), fanin_node, error_status));
 
-  RemoveRegularFaninInternal(node, {fanin_node, fanin.index()});
+  if (RemoveRegularFaninInternal(node, {fanin_node, fanin.index()})) {
+    NotifyNodeUpdated(node);
+  }
   return Status::OK();
 }
 
@@ -1157,6 +1182,7 @@ Status MutableGraphView::RemoveRegularFaninByPort(absl::string_view node_name,
     max_regular_input_port()[node] = updated_last_regular_input_port;
   }
 
+  NotifyNodeUpdated(node);
   return Status::OK();
 }
 
@@ -1194,7 +1220,9 @@ Status MutableGraphView::RemoveControllingFanin(
   TF_RETURN_IF_ERROR(
       CheckNodeExists(fanin_node_name, fanin_node, error_status));
 
-  RemoveControllingFaninInternal(node, fanin_node);
+  if (RemoveControllingFaninInternal(node, fanin_node)) {
+    NotifyNodeUpdated(node);
+  }
   return Status::OK();
 }
 
@@ -1227,6 +1255,7 @@ Status MutableGraphView::RemoveAllFanins(absl::string_view node_name,
   } else {
     node->clear_input();
   }
+  NotifyNodeUpdated(node);
   return Status::OK();
 }
 
@@ -1280,6 +1309,7 @@ Status MutableGraphView::UpdateFanin(absl::string_view node_name,
     }
     if (modified) {
       AddFaninInternal(node, {to_fanin_node, to_fanin.index()});
+      NotifyNodeUpdated(node);
     }
     return Status::OK();
   }
@@ -1321,6 +1351,7 @@ Status MutableGraphView::UpdateFanin(absl::string_view node_name,
     if (CanDedupControlWithRegularInput(*this, *to_fanin_node)) {
       RemoveControllingFaninInternal(node, to_fanin_node);
     }
+    NotifyNodeUpdated(node);
   }
 
   return Status::OK();
@@ -1367,6 +1398,7 @@ Status MutableGraphView::UpdateRegularFaninByPort(absl::string_view node_name,
     RemoveControllingFaninInternal(node, fanin_node);
   }
 
+  NotifyNodeUpdated(node);
   return Status::OK();
 }
 
@@ -1411,6 +1443,7 @@ Status MutableGraphView::SwapRegularFaninsByPorts(absl::string_view node_name,
 
   node->mutable_input()->SwapElements(from_port, to_port);
 
+  NotifyNodeUpdated(node);
   return Status::OK();
 }
 
@@ -1482,6 +1515,7 @@ Status MutableGraphView::UpdateAllRegularFaninsToControlling(
   node->mutable_input()->DeleteSubrange(pos, node->input_size() - pos);
   max_regular_input_port().erase(node);
 
+  NotifyNodeUpdated(node);
   return Status::OK();
 }
 
@@ -1561,7 +1595,9 @@ Status MutableGraphView::DeleteNodes(
     }
   }
   for (const string& node_name_to_delete : nodes_to_delete) {
-    nodes().erase(node_name_to_delete);
+    if (nodes().erase(node_name_to_delete) > 0) {
+      NotifyNodeRemoved(node_name_to_delete);
+    }
   }
 
   // Find nodes in graph and delete by partitioning into nodes to retain and
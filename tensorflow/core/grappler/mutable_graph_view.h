@@ -42,11 +42,28 @@ const char kMutableGraphViewCtrl[] = "ConstantFoldingCtrl";
 
 class MutableGraphView : public internal::GraphViewInternal<GraphDef, NodeDef> {
  public:
+  // Receives notifications of the changes made to the graph through the view,
+  // e.g. to update information derived from the graph incrementally.
+  class Listener {
+   public:
+    virtual ~Listener() = default;
+    // Called after `node` was added to the graph, or after its name, op,
+    // device, attributes or fanins were updated.
+    virtual void NodeUpdated(const NodeDef& node) = 0;
+    // Called before the node named `node_name` is deleted from the graph, or
+    // before it's renamed.
+    virtual void NodeRemoved(absl::string_view node_name) = 0;
+  };
+
   explicit MutableGraphView(GraphDef* graph) : GraphViewInternal(graph) {
     for (NodeDef& node : *graph->mutable_node()) AddUniqueNodeOrDie(&node);
     for (NodeDef& node : *graph->mutable_node()) AddAndDedupFanouts(&node);
   }
 
+  // Notifies `listener` of the subsequent changes made through the view. The
+  // listener is not owned, and can be reset with nullptr.
+  void set_listener(Listener* listener) { listener_ = listener; }
+
   // Lookup fanouts/fanins using immutable ports.
   using GraphViewInternal::GetFanout;
   const absl::flat_hash_set<InputPort>& GetFanout(
@@ -249,6 +266,13 @@ class MutableGraphView : public internal::GraphViewInternal<GraphDef, NodeDef> {
   Status DeleteNodes(const absl::flat_hash_set<string>& nodes_to_delete);
 
  private:
+  void NotifyNodeUpdated(const NodeDef* node) {
+    if (listener_ != nullptr) listener_->NodeUpdated(*node);
+  }
+  void NotifyNodeRemoved(absl::string_view node_name) {
+    if (listener_ != nullptr) listener_->NodeRemoved(node_name);
+  }
+
   // Adds fanouts for fanins of node to graph, while deduping control
   // dependencies from existing control dependencies and regular fanins. Note,
   // node inputs will be mutated if control dependencies can be deduped.
@@ -323,6 +347,8 @@ class MutableGraphView : public internal::GraphViewInternal<GraphDef, NodeDef> {
 
   // Removes fanouts of the deleted node from internal state.
   void RemoveFanoutsInternal(NodeDef* deleted_node);
+
+  Listener* listener_ = nullptr;  // Not owned.
 };
 
 }  // end namespace grappler
@@ -3407,7 +3407,9 @@ bool UniqueNodes::SameNode(const NodeDef& node1, const NodeDef& node2) const {
   return true;
 }
 
-bool ArithmeticOptimizer::CanDedup(const NodeDef& node) const {
+bool ArithmeticOptimizer::CanDedup(
+    const NodeDef& node,
+    const FunctionLibraryDefinition& function_library) const {
   if (nodes_to_preserve_.find(node.name()) != nodes_to_preserve_.end()) {
     return false;
   }
@@ -3421,7 +3423,17 @@ bool ArithmeticOptimizer::CanDedup(const NodeDef& node) const {
   if (IsAssert(node) || IsPrint(node)) {
     return true;
   }
-  return IsFreeOfSideEffect(node);
+  // PartitionedCall is stateless, but the function it calls may not be.
+  if (IsPartitionedCall(node)) {
+    const AttrValue* f = AttrSlice(node).Find("f");
+    const OpDef* signature = nullptr;
+    if (f == nullptr ||
+        !function_library.LookUpOpDef(f->func().name(), &signature).ok() ||
+        signature->is_stateful()) {
+      return false;
+    }
+  }
+  return IsFreeOfSideEffect(node, &function_library);
 }
 
 void ArithmeticOptimizer::DedupComputations() {
@@ -3451,6 +3463,11 @@ void ArithmeticOptimizer::DedupComputations() {
     }
   }
 
+  // Direct function calls are deduped like ops when their function is
+  // stateless.
+  const FunctionLibraryDefinition function_library(
+      OpRegistry::Global(), optimized_graph_->library());
+
   bool stop = true;
   std::set<int> duplicates;
   UniqueNodes nodes;
@@ -3461,7 +3478,7 @@ void ArithmeticOptimizer::DedupComputations() {
         continue;
       }
       NodeDef* node = optimized_graph_->mutable_node(i);
-      if (!CanDedup(*node) ||
+      if (!CanDedup(*node, function_library) ||
           feeds_inplace_op.find(node) != feeds_inplace_op.end()) {
         continue;
       }
@@ -3531,7 +3548,7 @@ Status ArithmeticOptimizer::SimplifyArithmeticOps(bool can_use_shapes) {
   }
 
   const GraphOptimizerContext ctx(&nodes_to_preserve_, optimized_graph_,
-                                  graph_properties_.get(), node_map_.get(),
+                                  graph_properties_, node_map_.get(),
                                   &feed_nodes_, opt_level_);
   const ArithmeticOptimizerContext ctx_ext(&nodes_to_simplify);
 
@@ -3675,12 +3692,21 @@ Status ArithmeticOptimizer::Optimize(Cluster* /*cluster*/,
     GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
   }
 
-  graph_properties_.reset(new GraphProperties(optimized_item));
   const bool assume_valid_feeds = opt_level_ == RewriterConfig::AGGRESSIVE;
-  const Status status =
-      graph_properties_->InferStatically(assume_valid_feeds,
-                                         /*aggressive_shape_inference=*/false,
-                                         /*include_tensor_values=*/false);
+  IncrementalGraphProperties* shared_properties = shared_graph_properties();
+  Status status;
+  if (shared_properties != nullptr && !assume_valid_feeds) {
+    // Only infers the shapes of the nodes changed since the last time.
+    status = shared_properties->Update(*optimized_graph_);
+    graph_properties_ = shared_properties->properties();
+  } else {
+    owned_graph_properties_.reset(new GraphProperties(optimized_item));
+    graph_properties_ = owned_graph_properties_.get();
+    status =
+        graph_properties_->InferStatically(assume_valid_feeds,
+                                           /*aggressive_shape_inference=*/false,
+                                           /*include_tensor_values=*/false);
+  }
   const bool can_use_shapes = status.ok();
   if (!can_use_shapes) {
     VLOG(1) << "Shape inference failed." << status.error_message();
@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_ARITHMETIC_OPTIMIZER_H_
 
 #include <unordered_set>
+#include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
 #include "tensorflow/core/grappler/utils.h"
@@ -95,8 +96,10 @@ class ArithmeticOptimizer : public GraphOptimizer {
     }
   };
 
-  // Returns true if it is safe to dedup node from the graph.
-  bool CanDedup(const NodeDef& node) const;
+  // Returns true if it is safe to dedup node from the graph. Function calls
+  // are looked up in `function_library`.
+  bool CanDedup(const NodeDef& node,
+                const FunctionLibraryDefinition& function_library) const;
 
   // Dedup redundant nodes in the graph.
   void DedupComputations();
@@ -132,7 +135,8 @@ class ArithmeticOptimizer : public GraphOptimizer {
   bool fetch_nodes_known_ = false;
   std::unordered_set<string> nodes_to_preserve_;
   std::unique_ptr<NodeMap> node_map_;
-  std::unique_ptr<GraphProperties> graph_properties_;
+  std::unique_ptr<GraphProperties> owned_graph_properties_;
+  GraphProperties* graph_properties_ = nullptr;  // Not owned.
   GraphDef* optimized_graph_ = nullptr;  // Not owned.
   gtl::FlatSet<string> feed_nodes_;
 };
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/cc/ops/array_ops.h"
 #include "tensorflow/cc/ops/math_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/function_testlib.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/grappler/grappler_item.h"
@@ -173,6 +174,53 @@ TEST_F(ArithmeticOptimizerTest, OpDeduppingAssertAndCheckNumerics) {
   test::ExpectTensorNear<double>(tensors[0], tensors_expected[0], 1e-6);
 }
 
+TEST_F(ArithmeticOptimizerTest, OpDeduppingFunctionCalls) {
+  using test::function::NDef;
+  using FDH = FunctionDefHelper;
+
+  FunctionDef stateless = FDH::Create(
+      "Stateless", {"x: float"}, {"y: float"}, {},
+      {{{"y"}, "Square", {"x"}, {{"T", DT_FLOAT}}}}, {{"y", "y:y:0"}});
+  FunctionDef stateful = FDH::Create(
+      "Stateful", {"x: int32"}, {"y: float"}, {},
+      {{{"y"}, "RandomUniform", {"x"}, {{"T", DT_INT32}, {"dtype", DT_FLOAT}}}},
+      {{"y", "y:output:0"}});
+  ASSERT_TRUE(stateful.signature().is_stateful());
+
+  const auto call = [](const string& name, const string& input,
+                       const string& func, DataType in_type) {
+    return NDef(name, "PartitionedCall", {input},
+                {{"Tin", DataTypeSlice{in_type}},
+                 {"Tout", DataTypeSlice{DT_FLOAT}},
+                 {"f", FDH::FunctionRef(func, {})}});
+  };
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("shape", "Placeholder", {}, {{"dtype", DT_INT32}}),
+       call("a1", "x", "Stateless", DT_FLOAT),
+       call("a2", "x", "Stateless", DT_FLOAT),
+       call("b1", "shape", "Stateful", DT_INT32),
+       call("b2", "shape", "Stateful", DT_INT32),
+       NDef("a", "Add", {"a1", "a2"}, {{"T", DT_FLOAT}}),
+       NDef("b", "Add", {"b1", "b2"}, {{"T", DT_FLOAT}})},
+      {stateless, stateful});
+  item.fetch = {"a", "b"};
+
+  ArithmeticOptimizer optimizer;
+  GraphDef output;
+  OptimizeTwice(&optimizer, &item, &output);
+  NodeMap node_map(&output);
+
+  // Only the calls to the stateless function are deduped.
+  EXPECT_EQ(node_map.GetNode("a2"), nullptr);
+  EXPECT_NE(node_map.GetNode("b2"), nullptr);
+  const NodeDef* b = node_map.GetNode("b");
+  ASSERT_NE(b, nullptr);
+  ASSERT_EQ(b->input_size(), 2);
+  EXPECT_NE(b->input(0), b->input(1));
+}
+
 TEST_F(ArithmeticOptimizerTest, OpDedupCommutative) {
   tensorflow::Scope s = tensorflow::Scope::NewRootScope();
   Output c1 = ops::Const(s.WithOpName("c1"), {1.0f, 2.0f}, {1, 2});
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
 #include "tensorflow/core/framework/attr_value_util.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/op.h"
@@ -48,6 +49,7 @@ const std::pair<int, int> kMinGPUArch = {7, 0};
 
 const char kSuffix[] = "AutoMixedPrecision";
 const char kCastToFp16[] = "CastToFp16";
+const char kCastToBf16[] = "CastToBf16";
 const char kCastToFp32[] = "CastToFp32";
 
 // Instances of this class represent unique type attribute identifiers within a
@@ -833,9 +835,13 @@ DataTypeSet AllowedDataTypes(const OpDef& op_def, const TypeAttrId& t_attr_id) {
   return AllowedDataTypes(*attr_def);
 }
 
-NodeDef BuildCastNode(const MutableGraphView::OutputPort& src, bool to_fp16,
-                      const string& device) {
-  const char* cast_string = to_fp16 ? kCastToFp16 : kCastToFp32;
+// Builds a Cast between float32 and `f16_type`, which is DT_HALF or
+// DT_BFLOAT16.
+NodeDef BuildCastNode(const MutableGraphView::OutputPort& src, bool to_f16,
+                      DataType f16_type, const string& device) {
+  const char* cast_string =
+      !to_f16 ? kCastToFp32
+              : f16_type == DT_BFLOAT16 ? kCastToBf16 : kCastToFp16;
   string name = strings::StrCat(src.node->name(), "-", src.port_id, "-",
                                 cast_string, "-", kSuffix);
   NodeDef node;
@@ -843,8 +849,8 @@ NodeDef BuildCastNode(const MutableGraphView::OutputPort& src, bool to_fp16,
   node.set_op("Cast");
   node.set_device(device);
   node.add_input(strings::StrCat(src.node->name(), ":", src.port_id));
-  (*node.mutable_attr())["SrcT"].set_type(to_fp16 ? DT_FLOAT : DT_HALF);
-  (*node.mutable_attr())["DstT"].set_type(to_fp16 ? DT_HALF : DT_FLOAT);
+  (*node.mutable_attr())["SrcT"].set_type(to_f16 ? DT_FLOAT : f16_type);
+  (*node.mutable_attr())["DstT"].set_type(to_f16 ? f16_type : DT_FLOAT);
   (*node.mutable_attr())["Truncate"].set_b(false);
   return node;
 }
@@ -914,17 +920,30 @@ int GetCudaVersion(const Cluster& cluster) {
   return 0;
 }
 
+std::unique_ptr<AutoMixedPrecisionLists> GetMixedPrecisionLists(
+    AutoMixedPrecisionMode mode, int cuda_version) {
+  if (mode == AutoMixedPrecisionMode::CUDA) {
+    return absl::make_unique<AutoMixedPrecisionListsCuda>(cuda_version);
+  }
+  return absl::make_unique<AutoMixedPrecisionListsCpu>();
+}
+
 class AutoMixedPrecisionImpl {
  public:
   AutoMixedPrecisionImpl(Cluster* cluster,
                          const std::unordered_set<string>& nodes_to_preserve,
-                         GraphDef* graph, string id)
+                         GraphDef* graph, string id,
+                         AutoMixedPrecisionMode mode)
       : virtual_placer_(cluster->GetDevices()),
         nodes_to_preserve_(nodes_to_preserve),
         graph_(graph),
         id_(id),
         graph_view_(graph),
-        cuda_version_(GetCudaVersion(*cluster)) {}
+        cuda_version_(GetCudaVersion(*cluster)),
+        mode_(mode),
+        target_dtype_(mode == AutoMixedPrecisionMode::CUDA ? DT_HALF
+                                                           : DT_BFLOAT16),
+        mp_lists_(GetMixedPrecisionLists(mode, cuda_version_)) {}
 
   Status Optimize();
 
@@ -939,7 +958,7 @@ class AutoMixedPrecisionImpl {
   Status PrintDebugLogs(bool preop, size_t timestamp);
   void LogSkippedNode(const NodeDef& node) const;
   bool MustPreserve(const NodeDef& node) const;
-  bool IsOnGPU(const NodeDef& node) const;
+  bool IsOnDevice(const NodeDef& node, const string& device_type) const;
   bool IsOnSuitableGPUArch(const NodeDef& node) const;
   bool ShouldProcess(const NodeDef& node) const;
   bool NodeHasFP16KernelForTypeAttr(const NodeDef& node, TypeAttrId taid) const;
@@ -978,6 +997,10 @@ class AutoMixedPrecisionImpl {
   string id_;
   MutableGraphView graph_view_;
   int cuda_version_;
+  AutoMixedPrecisionMode mode_;
+  // DT_HALF or DT_BFLOAT16, depending on mode_.
+  DataType target_dtype_;
+  std::unique_ptr<AutoMixedPrecisionLists> mp_lists_;
   NodeTypeAttrMap node_type_map_;
   GraphTypeTopologyView graph_type_view_;
   bool force_all_fp16_;
@@ -995,7 +1018,7 @@ bool AutoMixedPrecisionImpl::NodeHasFP16KernelForTypeAttr(
     string device_name = virtual_placer_.get_canonical_device_name(node);
     node_copy.set_device(device_name);
   }
-  if (!SetDataType(&node_copy, taid, DataType::DT_HALF)) {
+  if (!SetDataType(&node_copy, taid, target_dtype_)) {
     return false;
   }
   return IsKernelRegisteredForNode(node_copy).ok();
@@ -1032,19 +1055,19 @@ Status AutoMixedPrecisionImpl::PrintDebugLogs(bool preop, size_t timestamp) {
                          strings::StrCat("paintbuckets", suffix, ".txt"));
     f.open(fname.c_str(), std::fstream::out);
     f << "WhiteList:\n";
-    for (auto x : AutoMixedPrecisionLists::WhiteList(cuda_version_)) {
+    for (auto x : mp_lists_->WhiteList()) {
       f << x << "\n";
     }
     f << "\nBlackList:\n";
-    for (auto x : AutoMixedPrecisionLists::BlackList()) {
+    for (auto x : mp_lists_->BlackList()) {
       f << x << "\n";
     }
     f << "\nGrayList:\n";
-    for (auto x : AutoMixedPrecisionLists::GrayList()) {
+    for (auto x : mp_lists_->GrayList()) {
       f << x << "\n";
     }
     f << "\nClearList:\n";
-    for (auto x : AutoMixedPrecisionLists::ClearList()) {
+    for (auto x : mp_lists_->ClearList()) {
       f << x << "\n";
     }
     f.close();
@@ -1054,18 +1077,24 @@ Status AutoMixedPrecisionImpl::PrintDebugLogs(bool preop, size_t timestamp) {
 }
 
 void AutoMixedPrecisionImpl::LogSkippedNode(const NodeDef& node) const {
+  const char* reason;
+  if (MustPreserve(node)) {
+    reason = "must be preserved";
+  } else if (mode_ == AutoMixedPrecisionMode::CUDA) {
+    reason = "is not on the GPU, or the GPU arch is not suitable";
+  } else {
+    reason = "is not on the CPU";
+  }
   VLOG(2) << "Skipping " << node.op() << " node " << node.name()
-          << " because it "
-          << (MustPreserve(node)
-                  ? "must be preserved"
-                  : "is not on the GPU, or the GPU arch is not suitable");
+          << " because it " << reason;
 }
 
 bool AutoMixedPrecisionImpl::MustPreserve(const NodeDef& node) const {
   return nodes_to_preserve_.count(node.name());
 }
 
-bool AutoMixedPrecisionImpl::IsOnGPU(const NodeDef& node) const {
+bool AutoMixedPrecisionImpl::IsOnDevice(const NodeDef& node,
+                                        const string& device_type) const {
   string device_name;
   if (node.device().empty()) {
     device_name = virtual_placer_.get_canonical_device_name(node);
@@ -1076,7 +1105,7 @@ bool AutoMixedPrecisionImpl::IsOnGPU(const NodeDef& node) const {
   string not_used;
   if (DeviceNameUtils::SplitDeviceName(device_name, &not_used, &device) &&
       absl::StrContains(absl::AsciiStrToLower(device),
-                        absl::AsciiStrToLower(DEVICE_GPU))) {
+                        absl::AsciiStrToLower(device_type))) {
     return true;
   }
   return false;
@@ -1128,7 +1157,7 @@ bool AutoMixedPrecisionImpl::SupportsFloat16(
       OpRegistry::Global()->LookUpOpDef(node_type.node->op(), &op_def);
   if (!status.ok()) return false;
   return AllowedDataTypes(*op_def, node_type.type_attr)
-             .Contains(DataType::DT_HALF) &&
+             .Contains(target_dtype_) &&
          NodeHasFP16KernelForTypeAttr(*node_type.node, node_type.type_attr);
 }
 
@@ -1177,10 +1206,10 @@ Status AutoMixedPrecisionImpl::Optimize() {
   optimization_level = absl::AsciiStrToUpper(optimization_level);
   force_all_fp16_ = optimization_level == "UNSAFE_FORCE_ALL";
 
-  fp16_whitelist_ = AutoMixedPrecisionLists::WhiteList(cuda_version_);
-  fp16_blacklist_ = AutoMixedPrecisionLists::BlackList();
-  fp16_graylist_ = AutoMixedPrecisionLists::GrayList();
-  fp16_clearlist_ = AutoMixedPrecisionLists::ClearList();
+  fp16_whitelist_ = mp_lists_->WhiteList();
+  fp16_blacklist_ = mp_lists_->BlackList();
+  fp16_graylist_ = mp_lists_->GrayList();
+  fp16_clearlist_ = mp_lists_->ClearList();
   TF_RETURN_IF_ERROR(ValidateLists(fp16_whitelist_, fp16_blacklist_,
                                    fp16_graylist_, fp16_clearlist_));
 
@@ -1189,16 +1218,27 @@ Status AutoMixedPrecisionImpl::Optimize() {
 
   VLOG(2) << "Identifying nodes that should be processed";
   for (const NodeDef& node : graph_->node()) {
-    if (!MustPreserve(node) && IsOnGPU(node) &&
-        (ShouldIgnorePerformance() || IsOnSuitableGPUArch(node))) {
+    bool should_process;
+    if (mode_ == AutoMixedPrecisionMode::CUDA) {
+      should_process =
+          !MustPreserve(node) && IsOnDevice(node, DEVICE_GPU) &&
+          (ShouldIgnorePerformance() || IsOnSuitableGPUArch(node));
+    } else {
+      should_process = !MustPreserve(node) && IsOnDevice(node, DEVICE_CPU);
+    }
+    if (should_process) {
       should_process_nodes_.insert(&node);
     } else {
       LogSkippedNode(node);
     }
   }
 
-  VLOG(2) << "Converting FusedBatchNorm* ops to V2";
-  ConvertBatchNormOpsToV2();
+  if (mode_ == AutoMixedPrecisionMode::CUDA) {
+    // Only the V2 ops accept float16 inputs with float32 statistics. None of
+    // the batch norm ops are converted to bfloat16 on the CPU.
+    VLOG(2) << "Converting FusedBatchNorm* ops to V2";
+    ConvertBatchNormOpsToV2();
+  }
 
   VLOG(2) << "Building node type map for graph";
   TF_RETURN_IF_ERROR(node_type_map_.Init(*graph_));
@@ -1766,7 +1806,8 @@ void AutoMixedPrecisionImpl::MakeCastsWhiteIfAllOutputsWhite(
   }
 }
 
-// Changes all white-painted type attributes to DT_HALF, and inserts Cast nodes
+// Changes all white-painted type attributes to target_dtype_ (DT_HALF or
+// DT_BFLOAT16), and inserts Cast nodes
 // at node outputs for all edges that connect white-painted <->
 // non-white-painted type attributes.
 Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
@@ -1789,8 +1830,9 @@ Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
       bool src_is_white = white_set.count(node_type_idx);
       if (src_is_white) {
         VLOG(1) << "Changing type " << type_attr.DebugString() << " of "
-                << node->op() << " node " << node->name() << " to DT_HALF";
-        if (!SetDataType(node, type_attr, DT_HALF)) {
+                << node->op() << " node " << node->name() << " to "
+                << DataTypeString(target_dtype_);
+        if (!SetDataType(node, type_attr, target_dtype_)) {
           return errors::Internal("Failed to set type attribute");
         }
         ++num_nodes_changed;
@@ -1817,11 +1859,11 @@ Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
             if (!added_cast_node) {
               bool to_fp16 = dst_is_white;
               VLOG(1) << "Inserting cast to "
-                      << (to_fp16 ? "DT_HALF" : "DT_FLOAT") << " at "
-                      << src.node->op() << " " << src.node->name() << ":"
-                      << src.port_id;
-              added_cast_node = graph_view_.AddNode(
-                  BuildCastNode(src, to_fp16, src.node->device()));
+                      << DataTypeString(to_fp16 ? target_dtype_ : DT_FLOAT)
+                      << " at " << src.node->op() << " " << src.node->name()
+                      << ":" << src.port_id;
+              added_cast_node = graph_view_.AddNode(BuildCastNode(
+                  src, to_fp16, target_dtype_, src.node->device()));
               if (to_fp16 && !IsConstant(*node) && !IsVariable(*node) &&
                   !NodeImplicitlyReadsNonResourceVariable(*node)) {
                 ++num_nonvar_casts_to_fp16;
@@ -1835,8 +1877,10 @@ Status AutoMixedPrecisionImpl::ChangeTypeAttrsAndAddCasts(
     }
   }
   LOG(INFO) << "Converted " << num_nodes_changed << "/" << num_nodes_preop
-            << " nodes to float16 precision using " << num_nonvar_casts_to_fp16
-            << " cast(s) to float16 (excluding Const and Variable casts)";
+            << " nodes to " << DataTypeString(target_dtype_)
+            << " precision using " << num_nonvar_casts_to_fp16 << " cast(s) to "
+            << DataTypeString(target_dtype_)
+            << " (excluding Const and Variable casts)";
   return Status::OK();
 }
 
@@ -1865,18 +1909,21 @@ Status AutoMixedPrecision::Optimize(Cluster* cluster, const GrapplerItem& item,
   // Start by copying input graph to output.
   *output = item.graph;
 
-  int num_gpus = ShouldIgnorePerformance() ? GetNumGPUs(*cluster)
-                                           : GetNumGPUs(*cluster, kMinGPUArch);
-  if (num_gpus < 1) {
-    // AutoMixedPrecision is currently only tuned for GPU.
-    LOG(WARNING) << "No (suitable) GPUs detected, skipping " << name()
-                 << " graph optimizer";
-    return Status::OK();
+  if (mode_ == AutoMixedPrecisionMode::CUDA) {
+    int num_gpus = ShouldIgnorePerformance()
+                       ? GetNumGPUs(*cluster)
+                       : GetNumGPUs(*cluster, kMinGPUArch);
+    if (num_gpus < 1) {
+      // The float16 rewrite is only tuned for GPU.
+      LOG(WARNING) << "No (suitable) GPUs detected, skipping " << name()
+                   << " graph optimizer";
+      return Status::OK();
+    }
   }
 
   // Optimize the output graph in-place.
   AutoMixedPrecisionImpl optimizer(cluster, item.NodesToPreserve(), output,
-                                   item.id);
+                                   item.id, mode_);
   if (item.id == "tf_graph") {
     LOG(INFO) << "Running " << name() << " graph optimizer";
   } else {
@@ -22,16 +22,29 @@ limitations under the License.
 namespace tensorflow {
 namespace grappler {
 
-// Convert data types to float16 where appropriate to improve performance on
-// GPUs.
+// The reduced precision type and devices targeted by AutoMixedPrecision.
+enum class AutoMixedPrecisionMode {
+  // Converts to float16 on CUDA GPUs.
+  CUDA,
+  // Converts to bfloat16 on CPUs.
+  CPU,
+};
+
+// Convert data types to float16 (on GPUs) or bfloat16 (on CPUs) where
+// appropriate to improve performance.
 class AutoMixedPrecision : public GraphOptimizer {
  public:
   explicit AutoMixedPrecision(
-      RewriterConfig::Toggle opt_level = RewriterConfig::ON) {}
+      RewriterConfig::Toggle opt_level = RewriterConfig::ON,
+      AutoMixedPrecisionMode mode = AutoMixedPrecisionMode::CUDA)
+      : mode_(mode) {}
 
   ~AutoMixedPrecision() override {}
 
-  string name() const override { return "auto_mixed_precision"; };
+  string name() const override {
+    return mode_ == AutoMixedPrecisionMode::CUDA ? "auto_mixed_precision"
+                                                 : "auto_mixed_precision_cpu";
+  };
 
   bool UsesFunctionLibrary() const override { return false; }
 
@@ -40,6 +53,9 @@ class AutoMixedPrecision : public GraphOptimizer {
 
   void Feedback(Cluster* cluster, const GrapplerItem& item,
                 const GraphDef& optimize_output, double result) override;
+
+ private:
+  const AutoMixedPrecisionMode mode_;
 };
 
 }  // end namespace grappler
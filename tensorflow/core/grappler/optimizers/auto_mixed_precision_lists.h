@@ -23,8 +23,32 @@ limitations under the License.
 namespace tensorflow {
 namespace grappler {
 
+// Represents the four lists of ops that determine which nodes the
+// AutoMixedPrecision optimizer converts to a reduced precision type. Each
+// list can be extended or reduced through environment variables.
 class AutoMixedPrecisionLists {
- private:
+ public:
+  virtual ~AutoMixedPrecisionLists() {}
+
+  // Returns the set of ops that are considered numerically-safe (for execution
+  // in reduced precision) and performance-critical. These ops are always
+  // converted to reduced precision.
+  virtual gtl::FlatSet<string> WhiteList() = 0;
+  // Returns the set of ops that are considered numerically-safe (for execution
+  // in reduced precision), but which may be made unsafe by an upstream
+  // blacklist op.
+  virtual gtl::FlatSet<string> GrayList() = 0;
+  // Returns the set of ops that are considered numerically-dangerous (i.e.,
+  // unsafe for execution in reduced precision) and whose effects may also be
+  // observed in downstream nodes (e.g., in Exp -> Add, the Add is unsafe due to
+  // the Exp).
+  virtual gtl::FlatSet<string> BlackList() = 0;
+  // Returns the set of ops that do not have numerically-significant effects
+  // (i.e., they are always considered safe for execution in reduced
+  // precision).
+  virtual gtl::FlatSet<string> ClearList() = 0;
+
+ protected:
   static void UpdateList(gtl::FlatSet<string>* list, const string& to_add,
                          const string& to_remove) {
     for (auto x : str_util::Split(to_add, ",")) {
@@ -35,6 +59,125 @@ class AutoMixedPrecisionLists {
     }
   }
 
+  // Returns the clearlist shared by all the target types.
+  static gtl::FlatSet<string> DefaultClearList() {
+    // Note: if a data structure op (such as TensorListPopBack) is added to the
+    // clearlist, the AutoMixedPrecisionImpl class must also be modified to call
+    // AddDataStructureOpsToMap() with that op.
+    return gtl::FlatSet<string>{
+        "Abs",
+        "ArgMax",
+        "ArgMin",
+        "BatchToSpace",
+        "BatchToSpaceND",
+        "BroadcastTo",
+        "Ceil",
+        "CheckNumerics",
+        "ClipByValue",
+        "Concat",
+        "ConcatV2",
+        "DepthToSpace",
+        "DynamicPartition",
+        "DynamicStitch",
+        "Enter",
+        "EnsureShape",
+        "Equal",
+        "Exit",
+        "ExpandDims",
+        "Fill",
+        "Floor",
+        "Gather",
+        "GatherNd",
+        "GatherV2",
+        "Greater",
+        "GreaterEqual",
+        "Identity",
+        "IdentityN",
+        "IsFinite",
+        "IsInf",
+        "IsNan",
+        "Less",
+        "LessEqual",
+        "Max",
+        "MaxPool",
+        "MaxPool3D",
+        "MaxPool3DGrad",
+        "MaxPool3DGradGrad",
+        "MaxPoolGrad",
+        "MaxPoolGradGrad",
+        "MaxPoolGradGradV2",
+        "MaxPoolGradV2",
+        "MaxPoolV2",
+        "Maximum",
+        "Merge",
+        "Min",
+        "Minimum",
+        "MirrorPad",
+        "MirrorPadGrad",
+        "Neg",
+        "NextIteration",
+        "NotEqual",
+        "OneHot",
+        "OnesLike",
+        "Pack",
+        "Pad",
+        "PadV2",
+        "PreventGradient",
+        "Rank",
+        "Relu",
+        "Relu6",
+        "Relu6Grad",
+        "ReluGrad",
+        "Reshape",
+        "ResizeNearestNeighbor",
+        "ResizeNearestNeighborGrad",
+        "Reverse",
+        "ReverseSequence",
+        "ReverseV2",
+        "Round",
+        "Select",
+        "Shape",
+        "ShapeN",
+        "Sign",
+        "Size",
+        "Slice",
+        "Snapshot",
+        "SpaceToBatch",
+        "SpaceToBatchND",
+        "SpaceToDepth",
+        "Split",
+        "SplitV",
+        "Squeeze",
+        "StopGradient",
+        "StridedSlice",
+        "StridedSliceGrad",
+        "Switch",
+        "TensorListConcat",
+        "TensorListConcatV2",
+        "TensorListGather",
+        "TensorListGetItem",
+        "TensorListPopBack",
+        "TensorListPushBack",
+        "TensorListFromTensor",
+        "TensorListScatter",
+        "TensorListScatterV2",
+        "TensorListScatterIntoExistingList",
+        "TensorListSetItem",
+        "TensorListSplit",
+        "TensorListStack",
+        "Tile",
+        "TopK",
+        "TopKV2",
+        "Transpose",
+        "Where",
+        "ZerosLike",
+    };
+  }
+};
+
+// The lists used when converting to float16 on CUDA GPUs.
+class AutoMixedPrecisionListsCuda : public AutoMixedPrecisionLists {
+ private:
   static bool IsPseudoFastMath() {
     string optimization_level;
     TF_CHECK_OK(
@@ -45,9 +188,10 @@ class AutoMixedPrecisionLists {
   }
 
  public:
-  // Returns the set of ops that are considered numerically-safe (for execution
-  // in fp16) and performance-critical. These ops are always converted to fp16.
-  static gtl::FlatSet<string> WhiteList(int cuda_version) {
+  explicit AutoMixedPrecisionListsCuda(int cuda_version)
+      : cuda_version_(cuda_version) {}
+
+  gtl::FlatSet<string> WhiteList() override {
     string to_add, to_remove;
     TF_CHECK_OK(ReadStringFromEnvVar(
         "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_WHITELIST_ADD", "", &to_add));
@@ -75,7 +219,7 @@ class AutoMixedPrecisionLists {
           // "DepthwiseConv2dNativeBackpropInput",
           "MatMul",
     };
-    if (cuda_version >= 9010) {
+    if (cuda_version_ >= 9010) {
       // Fp16 BatchMatMul is slow before CUDA 9.1.
       list.insert("BatchMatMul");
       list.insert("BatchMatMulV2");
@@ -84,9 +228,7 @@ class AutoMixedPrecisionLists {
     return list;
   }
 
-  // Returns the set of ops that are considered numerically-safe (for execution
-  // in fp16), but which may be made unsafe by an upstream blacklist op.
-  static gtl::FlatSet<string> GrayList() {
+  gtl::FlatSet<string> GrayList() override {
     if (IsPseudoFastMath()) {
       return gtl::FlatSet<string>{};
     }
@@ -142,10 +284,7 @@ class AutoMixedPrecisionLists {
     return list;
   }
 
-  // Returns the set of ops that are considered numerically-dangerous (i.e.,
-  // unsafe for execution in fp16) and whose effects may also be observed in
-  // downstream nodes (e.g., in Exp -> Add, the Add is unsafe due to the Exp).
-  static gtl::FlatSet<string> BlackList() {
+  gtl::FlatSet<string> BlackList() override {
     if (IsPseudoFastMath()) {
       return gtl::FlatSet<string>{};
     }
@@ -171,15 +310,10 @@ class AutoMixedPrecisionLists {
     return list;
   }
 
-  // Returns the set of ops that do not have numerically-significant effects
-  // (i.e., they are always considered safe for execution in fp16 precision).
-  static gtl::FlatSet<string> ClearList() {
+  gtl::FlatSet<string> ClearList() override {
     if (IsPseudoFastMath()) {
       return gtl::FlatSet<string>{};
     }
-    // Note: if a data structure op (such as TensorListPopBack) is added to the
-    // clearlist, the AutoMixedPrecisionImpl class must also be modified to call
-    // AddDataStructureOpsToMap() with that op.
     string to_add, to_remove;
     TF_CHECK_OK(ReadStringFromEnvVar(
         "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CLEARLIST_ADD", "", &to_add));
@@ -187,117 +321,118 @@ class AutoMixedPrecisionLists {
         "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CLEARLIST_REMOVE", "",
         &to_remove));
 
+    auto list = DefaultClearList();
+    UpdateList(&list, to_add, to_remove);
+    return list;
+  }
+
+ private:
+  int cuda_version_;
+};
+
+// The lists used when converting to bfloat16 on CPUs. Bfloat16 has the same
+// exponent range as float32, so ops are kept in float32 because of their loss
+// of precision rather than overflow, which is mostly a concern for reductions.
+class AutoMixedPrecisionListsCpu : public AutoMixedPrecisionLists {
+ public:
+  AutoMixedPrecisionListsCpu() {}
+
+  gtl::FlatSet<string> WhiteList() override {
+    string to_add, to_remove;
+    TF_CHECK_OK(ReadStringFromEnvVar(
+        "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CPU_WHITELIST_ADD", "",
+        &to_add));
+    TF_CHECK_OK(ReadStringFromEnvVar(
+        "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CPU_WHITELIST_REMOVE", "",
+        &to_remove));
+
+    // BatchMatMul has no bfloat16 kernel on the CPU.
     auto list = gtl::FlatSet<string>{
-        "Abs",
-        "ArgMax",
-        "ArgMin",
-        "BatchToSpace",
-        "BatchToSpaceND",
-        "BroadcastTo",
-        "Ceil",
-        "CheckNumerics",
-        "ClipByValue",
-        "Concat",
-        "ConcatV2",
-        "DepthToSpace",
-        "DynamicPartition",
-        "DynamicStitch",
-        "Enter",
-        "EnsureShape",
-        "Equal",
-        "Exit",
-        "ExpandDims",
-        "Fill",
-        "Floor",
-        "Gather",
-        "GatherNd",
-        "GatherV2",
-        "Greater",
-        "GreaterEqual",
-        "Identity",
-        "IdentityN",
-        "IsFinite",
-        "IsInf",
-        "IsNan",
-        "Less",
-        "LessEqual",
-        "Max",
-        "MaxPool",
-        "MaxPool3D",
-        "MaxPool3DGrad",
-        "MaxPool3DGradGrad",
-        "MaxPoolGrad",
-        "MaxPoolGradGrad",
-        "MaxPoolGradGradV2",
-        "MaxPoolGradV2",
-        "MaxPoolV2",
-        "Maximum",
-        "Merge",
-        "Min",
-        "Minimum",
-        "MirrorPad",
-        "MirrorPadGrad",
-        "Neg",
-        "NextIteration",
-        "NotEqual",
-        "OneHot",
-        "OnesLike",
-        "Pack",
-        "Pad",
-        "PadV2",
-        "PreventGradient",
-        "Rank",
-        "Relu",
-        "Relu6",
-        "Relu6Grad",
-        "ReluGrad",
-        "Reshape",
-        "ResizeNearestNeighbor",
-        "ResizeNearestNeighborGrad",
-        "Reverse",
-        "ReverseSequence",
-        "ReverseV2",
-        "Round",
-        "Select",
-        "Shape",
-        "ShapeN",
-        "Sign",
-        "Size",
-        "Slice",
-        "Snapshot",
-        "SpaceToBatch",
-        "SpaceToBatchND",
-        "SpaceToDepth",
-        "Split",
-        "SplitV",
-        "Squeeze",
-        "StopGradient",
-        "StridedSlice",
-        "StridedSliceGrad",
-        "Switch",
-        "TensorListConcat",
-        "TensorListConcatV2",
-        "TensorListGather",
-        "TensorListGetItem",
-        "TensorListPopBack",
-        "TensorListPushBack",
-        "TensorListFromTensor",
-        "TensorListScatter",
-        "TensorListScatterV2",
-        "TensorListScatterIntoExistingList",
-        "TensorListSetItem",
-        "TensorListSplit",
-        "TensorListStack",
-        "Tile",
-        "TopK",
-        "TopKV2",
-        "Transpose",
-        "Where",
-        "ZerosLike",
+        "Conv2D",
+        "MatMul",
+    };
+    UpdateList(&list, to_add, to_remove);
+    return list;
+  }
+
+  gtl::FlatSet<string> GrayList() override {
+    string to_add, to_remove;
+    TF_CHECK_OK(ReadStringFromEnvVar(
+        "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CPU_GRAYLIST_ADD", "",
+        &to_add));
+    TF_CHECK_OK(ReadStringFromEnvVar(
+        "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CPU_GRAYLIST_REMOVE", "",
+        &to_remove));
+
+    auto list = gtl::FlatSet<string>{
+        "Add",
+        "AddN",
+        "AddV2",
+        "AvgPool",
+        "BiasAdd",
+        "BiasAddGrad",
+        "BiasAddV1",
+        "Elu",
+        "EluGrad",
+        "Erf",
+        "LeakyRelu",
+        "LeakyReluGrad",
+        "Mul",
+        "Sigmoid",
+        "SigmoidGrad",
+        "Square",
+        "SquaredDifference",
+        "Sub",
+        "Tanh",
+        "TanhGrad",
     };
     UpdateList(&list, to_add, to_remove);
     return list;
   }
+
+  gtl::FlatSet<string> BlackList() override {
+    string to_add, to_remove;
+    TF_CHECK_OK(ReadStringFromEnvVar(
+        "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CPU_BLACKLIST_ADD", "",
+        &to_add));
+    TF_CHECK_OK(ReadStringFromEnvVar(
+        "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CPU_BLACKLIST_REMOVE", "",
+        &to_remove));
+
+    auto list = gtl::FlatSet<string>{
+        "Exp",
+        "Expm1",
+        "L2Loss",
+        "Log",
+        "Log1p",
+        "LogSoftmax",
+        "Mean",
+        "Pow",
+        "Prod",
+        "Rsqrt",
+        "SaveV2",
+        "Softmax",
+        "SoftmaxCrossEntropyWithLogits",
+        "SparseSoftmaxCrossEntropyWithLogits",
+        "Sum",
+    };
+    UpdateList(&list, to_add, to_remove);
+    return list;
+  }
+
+  gtl::FlatSet<string> ClearList() override {
+    string to_add, to_remove;
+    TF_CHECK_OK(ReadStringFromEnvVar(
+        "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CPU_CLEARLIST_ADD", "",
+        &to_add));
+    TF_CHECK_OK(ReadStringFromEnvVar(
+        "TF_AUTO_MIXED_PRECISION_GRAPH_REWRITE_CPU_CLEARLIST_REMOVE", "",
+        &to_remove));
+
+    auto list = DefaultClearList();
+    UpdateList(&list, to_add, to_remove);
+    return list;
+  }
 };
 
 }  // end namespace grappler
@@ -13,14 +13,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
-// Currently, this test only passes when TensorFlow passes with CUDA, because
-// otherwise the optimizer will not turn clearlist nodes to float16. When
-// looking at clearlist nodes, this optimizer checks if the nodes have a float16
-// GPU OpKernel, but without CUDA there are no GPU OpKernels at all.
-#if GOOGLE_CUDA
-
 #include "tensorflow/core/grappler/optimizers/auto_mixed_precision.h"
 
+#include <algorithm>
+#include <cmath>
 #include <utility>
 #include <vector>
 
@@ -37,6 +33,9 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/grappler_test.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
 
 // TODO(benbarsdell): Improve the numerical checks in these tests. The tests
 // were originally written only to check the graph coloring, so the graphs do
@@ -69,6 +68,12 @@ Tensor GenerateRandomTensorInRange(const TensorShape& shape, double minval,
   return tensor;
 }
 
+// Currently, the float16 tests only pass when TensorFlow passes with CUDA,
+// because otherwise the optimizer will not turn clearlist nodes to float16.
+// When looking at clearlist nodes, this optimizer checks if the nodes have a
+// float16 GPU OpKernel, but without CUDA there are no GPU OpKernels at all.
+#if GOOGLE_CUDA
+
 const std::pair<int, int> kMinGPUArch = {7, 0};
 
 class AutoMixedPrecisionTest : public GrapplerTest {
@@ -1074,8 +1079,196 @@ TEST_F(AutoMixedPrecisionTest, TanhOp) {
       });
 }
 
+#endif  // GOOGLE_CUDA
+
+const char kCpuDevice[] = "/job:localhost/replica:0/task:0/device:CPU:0";
+
+class AutoMixedPrecisionCpuTest : public GrapplerTest {
+ protected:
+  void SetUp() override {
+    DeviceProperties device_properties;
+    device_properties.set_type("CPU");
+    virtual_cluster_.reset(
+        new VirtualCluster({{kCpuDevice, device_properties}}));
+    TF_CHECK_OK(virtual_cluster_->Provision());
+  }
+
+  void TearDown() override { TF_CHECK_OK(virtual_cluster_->Shutdown()); }
+
+  std::unique_ptr<Cluster> virtual_cluster_;
+};
+
+TEST_F(AutoMixedPrecisionCpuTest, Simple) {
+  tensorflow::Scope s =
+      tensorflow::Scope::NewRootScope().WithDevice(kCpuDevice);
+  Output input = ops::Const(s.WithOpName("input"), 1.f / 32, {32, 32});
+  Output bias = ops::Const(s.WithOpName("bias"), 0.5f, {32});
+  Output wht1 = ops::MatMul(s.WithOpName("wht1"), input, input);
+  Output gry1 = ops::BiasAdd(s.WithOpName("gry1"), wht1, bias);
+  Output clr1 = ops::Relu(s.WithOpName("clr1"), gry1);
+  Output wht2 = ops::MatMul(s.WithOpName("wht2"), clr1, clr1);
+  Output blk1 = ops::Softmax(s.WithOpName("blk1"), wht2);
+  Output fetch = ops::Identity(s.WithOpName("fetch"), blk1);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+
+  AutoMixedPrecision optimizer(RewriterConfig::ON,
+                               AutoMixedPrecisionMode::CPU);
+  EXPECT_EQ(optimizer.name(), "auto_mixed_precision_cpu");
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(virtual_cluster_.get(), item, &output));
+
+  VLOG(1) << output.DebugString();
+
+  // Casts are added after input, bias and wht2.
+  GraphView output_view(&output);
+  EXPECT_EQ(output.node_size(), item.graph.node_size() + 3);
+  EXPECT_EQ(output_view.GetNode("input")->attr().at("dtype").type(), DT_FLOAT);
+  EXPECT_EQ(output_view.GetNode("bias")->attr().at("dtype").type(), DT_FLOAT);
+  EXPECT_EQ(output_view.GetNode("wht1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("gry1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("clr1")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("wht2")->attr().at("T").type(), DT_BFLOAT16);
+  EXPECT_EQ(output_view.GetNode("blk1")->attr().at("T").type(), DT_FLOAT);
+
+  auto tensors = EvaluateNodes(output, item.fetch);
+  EXPECT_EQ(tensors.size(), tensors_expected.size());
+  EXPECT_EQ(tensors.size(), item.fetch.size());
+  for (int i = 0; i < item.fetch.size(); ++i) {
+    test::ExpectClose(tensors_expected[i], tensors[i], -1, 1e-2);
+  }
+}
+
+TEST_F(AutoMixedPrecisionCpuTest, PreserveGPUNodes) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+      "/job:localhost/replica:0/task:0/device:GPU:0");
+  Output input = ops::Const(s.WithOpName("input"), 1.f / 32, {32, 32});
+  Output wht1 = ops::MatMul(s.WithOpName("wht1"), input, input);
+  Output clr1 = ops::Relu(s.WithOpName("clr1"), wht1);
+  Output fetch = ops::Identity(s.WithOpName("fetch"), clr1);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  AutoMixedPrecision optimizer(RewriterConfig::ON,
+                               AutoMixedPrecisionMode::CPU);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(virtual_cluster_.get(), item, &output));
+
+  VLOG(1) << output.DebugString();
+
+  GraphView output_view(&output);
+  EXPECT_EQ(output.node_size(), item.graph.node_size());
+  EXPECT_EQ(output_view.GetNode("wht1")->attr().at("T").type(), DT_FLOAT);
+  EXPECT_EQ(output_view.GetNode("clr1")->attr().at("T").type(), DT_FLOAT);
+}
+
+// A stack of BERT-like feed-forward blocks: a MatMul and BiasAdd that expand
+// the hidden size 4x, a Tanh, a MatMul and BiasAdd that project back, and a
+// residual Add.
+GraphDef MakeFeedForwardGraph(int hidden, int num_layers) {
+  tensorflow::Scope s =
+      tensorflow::Scope::NewRootScope().WithDevice(kCpuDevice);
+  Output x = ops::Placeholder(s.WithOpName("input"), DT_FLOAT);
+  for (int i = 0; i < num_layers; ++i) {
+    auto name = [i](const char* op) { return strings::StrCat(op, "_", i); };
+    Output w1 = ops::Const(s.WithOpName(name("w1")),
+                           GenerateRandomTensorInRange<DT_FLOAT>(
+                               TensorShape({hidden, 4 * hidden}), -0.05, 0.05));
+    Output b1 = ops::Const(s.WithOpName(name("b1")), 0.01f, {4 * hidden});
+    Output w2 = ops::Const(s.WithOpName(name("w2")),
+                           GenerateRandomTensorInRange<DT_FLOAT>(
+                               TensorShape({4 * hidden, hidden}), -0.05, 0.05));
+    Output b2 = ops::Const(s.WithOpName(name("b2")), 0.01f, {hidden});
+    Output h = ops::BiasAdd(s.WithOpName(name("bias1")),
+                            ops::MatMul(s.WithOpName(name("matmul1")), x, w1),
+                            b1);
+    h = ops::Tanh(s.WithOpName(name("tanh")), h);
+    h = ops::BiasAdd(s.WithOpName(name("bias2")),
+                     ops::MatMul(s.WithOpName(name("matmul2")), h, w2), b2);
+    x = ops::AddV2(s.WithOpName(name("residual")), x, h);
+  }
+  ops::Identity(s.WithOpName("fetch"), x);
+
+  GraphDef graph;
+  TF_CHECK_OK(s.ToGraphDef(&graph));
+  return graph;
+}
+
+std::unique_ptr<Session> CreateSession(const GraphDef& graph) {
+  // The graph has already been optimized.
+  SessionOptions options;
+  options.config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_disable_meta_optimizer(true);
+  std::unique_ptr<Session> session(NewSession(options));
+  TF_CHECK_OK(session->Create(graph));
+  return session;
+}
+
+Tensor RunFeedForward(Session* session, const Tensor& input) {
+  std::vector<Tensor> outputs;
+  TF_CHECK_OK(session->Run({{"input", input}}, {"fetch"}, {}, &outputs));
+  return outputs[0];
+}
+
+// Compares the throughput of a float32 BERT-like model with that of the same
+// model rewritten to bfloat16. The label of the bfloat16 runs records the
+// largest relative difference between the outputs of the two models.
+static void BM_FeedForward(int iters, int batch, int use_bfloat16) {
+  testing::StopTiming();
+  const int kHidden = 768;
+  const int kNumLayers = 4;
+  GraphDef graph = MakeFeedForwardGraph(kHidden, kNumLayers);
+  Tensor input = GenerateRandomTensorInRange<DT_FLOAT>(
+      TensorShape({batch, kHidden}), -1.0, 1.0);
+  std::unique_ptr<Session> session = CreateSession(graph);
+
+  if (use_bfloat16) {
+    const Tensor expected = RunFeedForward(session.get(), input);
+    DeviceProperties device_properties;
+    device_properties.set_type("CPU");
+    VirtualCluster cluster({{kCpuDevice, device_properties}});
+    TF_CHECK_OK(cluster.Provision());
+    GrapplerItem item;
+    item.graph = graph;
+    item.fetch = {"fetch"};
+    AutoMixedPrecision optimizer(RewriterConfig::ON,
+                                 AutoMixedPrecisionMode::CPU);
+    GraphDef optimized;
+    TF_CHECK_OK(optimizer.Optimize(&cluster, item, &optimized));
+    session = CreateSession(optimized);
+
+    const Tensor actual = RunFeedForward(session.get(), input);
+    double max_error = 0;
+    for (int64 i = 0; i < expected.NumElements(); ++i) {
+      const float e = expected.flat<float>()(i);
+      const float a = actual.flat<float>()(i);
+      max_error = std::max<double>(max_error,
+                                   std::abs(e - a) / (std::abs(e) + 1e-3));
+    }
+    testing::SetLabel(strings::StrCat("max_rel_error=", max_error));
+  }
+
+  RunFeedForward(session.get(), input);  // Warm up.
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    RunFeedForward(session.get(), input);
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch);
+}
+BENCHMARK(BM_FeedForward)
+    ->ArgPair(1, 0)
+    ->ArgPair(1, 1)
+    ->ArgPair(32, 0)
+    ->ArgPair(32, 1)
+    ->ArgPair(128, 0)
+    ->ArgPair(128, 1);
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
-
-#endif  // GOOGLE_CUDA
@@ -133,6 +133,48 @@ FunctionDef* AddVectorizedFunction(const NodeDef& map_node,
   return result;
 }
 
+// Returns true for ops that do no real work, and that are therefore ignored
+// when estimating whether vectorization pays off.
+bool IsFreeOp(const string& op) {
+  return op == "Const" || op == "Identity" || op == "IdentityN" ||
+         op == "NoOp" || op == "_Arg" || op == "_Retval";
+}
+
+int CountNonFreeOps(const FunctionDef& func) {
+  int count = 0;
+  for (const NodeDef& node : func.node_def()) {
+    if (!IsFreeOp(node.op())) ++count;
+  }
+  return count;
+}
+
+// Returns true if rewriting map(orig_func)->batch into
+// batch->map(vectorized_func) is expected to be profitable. Ops that could not
+// be vectorized are left in the body of a MapDefun, where they still run once
+// per element and additionally pay the cost of slicing their inputs and
+// stacking their outputs. The rewrite only pays off if a large enough share of
+// the work of `orig_func` was vectorized.
+bool IsVectorizationProfitable(const FunctionDef& orig_func,
+                               const FunctionDef& vectorized_func,
+                               const FunctionLibraryDefinition& library) {
+  // At most this fraction of the ops of `orig_func` can remain unvectorized.
+  constexpr float kMaxUnvectorizedFraction = 0.5;
+
+  const int num_ops = CountNonFreeOps(orig_func);
+  if (num_ops == 0) return true;
+  int num_unvectorized_ops = 0;
+  for (const NodeDef& node : vectorized_func.node_def()) {
+    if (node.op() != "MapDefun") continue;
+    const FunctionDef* body =
+        library.Find(node.attr().at("f").func().name());
+    // Be conservative if the body can't be found.
+    num_unvectorized_ops += body ? CountNonFreeOps(*body) : num_ops;
+  }
+  VLOG(2) << num_unvectorized_ops << " of the " << num_ops << " ops of "
+          << orig_func.signature().name() << " were not vectorized.";
+  return num_unvectorized_ops <= kMaxUnvectorizedFraction * num_ops;
+}
+
 bool IsOutputShapesFullyDefined(const NodeDef& node) {
   auto* shapes_attr = gtl::FindOrNull(node.attr(), "output_shapes");
   if (shapes_attr == nullptr) return false;
@@ -531,10 +573,25 @@ Status MapVectorization::OptimizeAndCollectStats(Cluster* cluster,
       continue;
     }
 
+    const int num_functions = library->function_size();
     FunctionDef* vectorized_func =
         AddVectorizedFunction(*map_node, *map_func, library);
     CHECK_NOTNULL(vectorized_func);
 
+    // ChooseFastestBranch guards against regressions at runtime. Without it,
+    // only rewrite the pipeline if asked to and vectorization is expected to
+    // pay off.
+    if (!use_choose_fastest_ && check_profitability_ &&
+        !IsVectorizationProfitable(
+            *map_func, *vectorized_func,
+            FunctionLibraryDefinition(OpRegistry::Global(), *library))) {
+      VLOG(1) << "Not vectorizing " << map_node->name()
+              << " because too few of its ops can be vectorized.";
+      library->mutable_function()->DeleteSubrange(
+          num_functions, library->function_size() - num_functions);
+      continue;
+    }
+
     NodeDef* new_batch_node;
     TF_RETURN_IF_ERROR(AddNewBatchNode(
         *batch_node, *input_node, *vectorized_func, &graph, &new_batch_node));
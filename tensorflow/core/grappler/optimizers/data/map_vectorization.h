@@ -38,7 +38,10 @@ namespace grappler {
 //
 // If the "ChooseFastest" configuration is enabled, it adds a
 // ChooseFastestBranch dataset node to pick between the original map->batch
-// branch and the vectorized batch->map branch.
+// branch and the vectorized batch->map branch. Otherwise, if the
+// "check_profitability" configuration is enabled, the rewrite only happens if
+// most of the ops of map_fn can be vectorized, since the ops that can't be are
+// still run once per element inside a MapDefun op.
 //
 class MapVectorization : public TFDataOptimizerBase {
  public:
@@ -64,6 +67,20 @@ class MapVectorization : public TFDataOptimizerBase {
           "Received an invalid value for parameter \"use_choose_fastest\"",
           choose_fastest_param);
     }
+
+    auto it = config->parameter_map().find("check_profitability");
+    if (it != config->parameter_map().end()) {
+      const string& check_profitability_param = it->second.s();
+      if (check_profitability_param == "true") {
+        check_profitability_ = true;
+      } else if (check_profitability_param == "false") {
+        check_profitability_ = false;
+      } else {
+        return errors::Internal(
+            "Received an invalid value for parameter \"check_profitability\"",
+            check_profitability_param);
+      }
+    }
     return Status::OK();
   }
 
@@ -76,6 +93,7 @@ class MapVectorization : public TFDataOptimizerBase {
 
  private:
   bool use_choose_fastest_ = false;
+  bool check_profitability_ = false;
 };
 
 }  // namespace grappler
@@ -54,7 +54,8 @@ constexpr char kAttrNameDtype[] = "dtype";
 using test::function::NDef;
 
 Status OptimizeWithMapVectorization(const GrapplerItem& item, GraphDef* output,
-                                    bool use_choose_fastest) {
+                                    bool use_choose_fastest,
+                                    bool check_profitability = false) {
   MapVectorization optimizer;
   RewriterConfig_CustomGraphOptimizer config;
   if (use_choose_fastest) {
@@ -62,6 +63,9 @@ Status OptimizeWithMapVectorization(const GrapplerItem& item, GraphDef* output,
   } else {
     (*config.mutable_parameter_map())["use_choose_fastest"].set_s("false");
   }
+  if (check_profitability) {
+    (*config.mutable_parameter_map())["check_profitability"].set_s("true");
+  }
   TF_RETURN_IF_ERROR(optimizer.Init(&config));
   return optimizer.Optimize(nullptr, item, output);
 }
@@ -586,6 +590,57 @@ TEST(MapVectorizationTest, VectorizeWithUndefinedOutputTypes) {
       input_node->name());
 }
 
+// Adds a map function whose only op can't be vectorized, and therefore stays
+// in a MapDefun op after vectorization.
+FunctionDef* AddUnvectorizableMapFn(MutableGraphView* graph) {
+  FunctionDef* map_fn = graph->graph()->mutable_library()->add_function();
+  *map_fn = FunctionDefHelper::Create(
+      /*function_name=*/"unvectorizable_map_fn",
+      /*in_def=*/{"x: int64"},
+      /*out_def=*/{"res: int64"},
+      /*attr_def=*/{},
+      /*node_def=*/
+      {{{"node"}, "Unique", {"x"}, {{"T", DT_INT64}, {"out_idx", DT_INT32}}}},
+      /*ret_def=*/{{"res", "node:y"}});
+
+  return map_fn;
+}
+
+TEST(MapVectorizationTest, DoNotVectorizeUnprofitableMapFn) {
+  // Tests that with the profitability check and without ChooseFastestBranch,
+  // the pipeline is not rewritten when most of the map function would still
+  // run once per element.
+  GrapplerItem item;
+  MutableGraphView graph(&item.graph);
+  std::vector<PartialTensorShape> input_shapes({{}});
+  std::vector<DataType> input_types({DT_INT64});
+  auto input_node = AddArbitraryInputNode(&graph, &input_shapes, &input_types);
+  auto map_fn = AddUnvectorizableMapFn(&graph);
+  auto map_node =
+      AddMapNode(&graph, input_node->name(), map_fn->signature().name());
+  auto batch_node = AddBatchNode(&graph, map_node->name());
+  GraphDef output;
+  TF_ASSERT_OK(OptimizeWithMapVectorization(item, &output, false,
+                                            /*check_profitability=*/true));
+  CheckNotVectorized(output, map_node->op(), batch_node->op(),
+                     input_node->name());
+  EXPECT_EQ(output.library().function_size(), 1);
+
+  // The check is off by default.
+  TF_ASSERT_OK(OptimizeWithMapVectorization(item, &output, false));
+  CheckVectorizedWithoutChooseFastest(
+      output, /*expected_vectorized_branch=*/{batch_node->op(), map_node->op()},
+      input_node->name());
+
+  // ChooseFastestBranch decides at runtime instead.
+  TF_ASSERT_OK(OptimizeWithMapVectorization(item, &output, true,
+                                            /*check_profitability=*/true));
+  CheckVectorizedWithChooseFastest(
+      output, /*expected_vectorized_branch=*/{batch_node->op(), map_node->op()},
+      /*expected_original_branch=*/{map_node->op(), batch_node->op()},
+      input_node->name());
+}
+
 // TODO(rachelim): Add test that has a polymorphic function.
 
 }  // namespace
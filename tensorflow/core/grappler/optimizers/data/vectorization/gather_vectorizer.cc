@@ -0,0 +1,133 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/framework/scope_internal.h"
+#include "tensorflow/cc/ops/array_ops.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/cc/ops/math_ops.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+const char* const kGatherPrefix = "vectorized/gather";
+
+// Gets the value of `tensor` if it is an unstacked integer scalar constant.
+Status GetConstantScalar(const WrappedTensor& tensor, int64* value) {
+  if (tensor.stacked || !tensor.node->IsConstant()) {
+    return errors::Unimplemented("Expected a constant input.");
+  }
+  Tensor t;
+  TF_RETURN_IF_ERROR(GetNodeAttr(tensor.node->attrs(), "value", &t));
+  if (!TensorShapeUtils::IsScalar(t.shape())) {
+    return errors::InvalidArgument("Expected a scalar input.");
+  }
+  if (t.dtype() == DT_INT32) {
+    *value = t.scalar<int32>()();
+  } else if (t.dtype() == DT_INT64) {
+    *value = t.scalar<int64>()();
+  } else {
+    return errors::InvalidArgument("Expected an integer input.");
+  }
+  return Status::OK();
+}
+
+// Handles Gather and GatherV2. The output of the vectorized op is always a
+// GatherV2, whose shape is params.shape[:axis] + indices.shape +
+// params.shape[axis + 1:] (ignoring batch_dims).
+class GatherVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    const bool params_stacked = inputs.at(0).stacked;
+    const bool indices_stacked = inputs.at(1).stacked;
+    if (!params_stacked && !indices_stacked) {
+      return errors::Internal("Expected params or indices to be stacked.");
+    }
+
+    int batch_dims = 0;
+    if (HasNodeAttr(node.def(), "batch_dims")) {
+      TF_RETURN_IF_ERROR(GetNodeAttr(node.attrs(), "batch_dims", &batch_dims));
+    }
+    const bool is_v2 = node.type_string() == "GatherV2";
+
+    Status status;
+    Scope parent = NewInternalScope(outer_scope, &status, nullptr);
+    Scope s = parent.NewSubScope(kGatherPrefix);
+
+    Output params = {inputs.at(0).node, inputs.at(0).output_index};
+    Output indices = {inputs.at(1).node, inputs.at(1).output_index};
+    Output axis;
+    if (is_v2) {
+      TF_RETURN_IF_ERROR(inputs.unstacked(2, &axis));
+    } else {
+      axis = ops::Const(s, 0);
+    }
+
+    Output vectorized_gather;
+    if (!params_stacked) {
+      // The leading dimension of the stacked indices is only the leading
+      // dimension of the output if the gather is along the first axis.
+      int64 axis_value = 0;
+      if (is_v2) {
+        TF_RETURN_IF_ERROR(GetConstantScalar(inputs.at(2), &axis_value));
+      }
+      if (axis_value != 0 || batch_dims != 0) {
+        return errors::Unimplemented(
+            "Vectorizing a gather with stacked indices is only supported "
+            "along axis 0 and without batch_dims.");
+      }
+      vectorized_gather = ops::GatherV2(s, params, indices, axis);
+    } else {
+      // Stacked indices have the same leading dimension as the stacked params,
+      // which makes it an additional batch dimension.
+      if (batch_dims < 0 || (!indices_stacked && batch_dims != 0)) {
+        return errors::Unimplemented(
+            "Vectorizing a gather with batch_dims = ", batch_dims,
+            " is only supported with stacked indices and non-negative "
+            "batch_dims.");
+      }
+      // Non-negative axis values are shifted by the new leading dimension of
+      // params. Negative axis values wrap around.
+      Output shifted_axis = ops::Add(
+          s, axis,
+          ops::Cast(s, ops::GreaterEqual(s, axis, ops::ZerosLike(s, axis)),
+                    axis.type()));
+      vectorized_gather = ops::GatherV2(
+          s, params, indices, shifted_axis,
+          ops::GatherV2::Attrs().BatchDims(indices_stacked ? batch_dims + 1
+                                                           : 0));
+    }
+
+    TF_RETURN_IF_ERROR(status);
+
+    // Add output mappings
+    outputs->push_back({vectorized_gather.node(), 0, true});
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("Gather", GatherVectorizer);
+REGISTER_VECTORIZER("GatherV2", GatherVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
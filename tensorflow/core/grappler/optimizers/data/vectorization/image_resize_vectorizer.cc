@@ -0,0 +1,91 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/framework/scope_internal.h"
+#include "tensorflow/cc/ops/array_ops.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+const char* const kImageResizePrefix = "vectorized/image_resize";
+
+// The resize ops require 4-D images, so the stacked [B, n, h, w, c] images
+// are merged into a single batch of [B * n, h, w, c] images, resized, and
+// split into [B, n, new_h, new_w, c] again.
+class ImageResizeVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    Status status;
+    Scope parent = NewInternalScope(outer_scope, &status, nullptr);
+    Scope s = parent.NewSubScope(kImageResizePrefix);
+
+    Output images;
+    NodeBuilder::NodeOut size;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &images));
+    TF_RETURN_IF_ERROR(inputs.unstacked(1, &size));
+
+    // [B * n, h, w, c]
+    Output shape = ops::Shape(s, images);
+    Output merged_shape = ops::Concat(
+        s, {ops::Const(s, {-1}), ops::Slice(s, shape, {2}, {-1})},
+        ops::Const(s, 0));
+    Output merged_images = ops::Reshape(s, images, merged_shape);
+    TF_RETURN_IF_ERROR(status);
+
+    NodeBuilder node_builder(strings::StrCat("vectorized/", node.name()),
+                             node.type_string());
+    node_builder.Input(merged_images.node(), merged_images.index())
+        .Input(size);
+    for (const auto& attr : node.def().attr()) {
+      node_builder.Attr(attr.first, attr.second);
+    }
+    Node* resize_node;
+    TF_RETURN_IF_ERROR(node_builder.Finalize(outer_scope, &resize_node));
+    Output resized_images(resize_node, 0);
+
+    // [B, n, new_h, new_w, c]
+    Output vectorized_shape = ops::Concat(
+        s,
+        {ops::Slice(s, shape, {0}, {2}),
+         ops::Slice(s, ops::Shape(s, resized_images), {1}, {-1})},
+        ops::Const(s, 0));
+    Output vectorized_resize =
+        ops::Reshape(s, resized_images, vectorized_shape);
+
+    TF_RETURN_IF_ERROR(status);
+
+    // Add output mappings
+    outputs->push_back({vectorized_resize.node(), 0, true});
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("ResizeArea", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeBicubic", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeBilinear", ImageResizeVectorizer);
+REGISTER_VECTORIZER("ResizeNearestNeighbor", ImageResizeVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,121 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/framework/scope_internal.h"
+#include "tensorflow/cc/ops/array_ops.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+const char* const kParseExamplePrefix = "vectorized/parse_example";
+
+// The stacked [B, n] batch of serialized examples is parsed as a single batch
+// of B * n examples, and each dense output is reshaped from
+// [B * n] + dense_shape to [B, n] + dense_shape. Sparse outputs aren't
+// supported, because their indices would have to be remapped as well.
+class ParseExampleVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    int num_sparse, num_dense;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node.attrs(), "Nsparse", &num_sparse));
+    TF_RETURN_IF_ERROR(GetNodeAttr(node.attrs(), "Ndense", &num_dense));
+    if (num_sparse != 0) {
+      return errors::Unimplemented(
+          "Vectorizing ParseExample with sparse features is not supported.");
+    }
+    std::vector<PartialTensorShape> dense_shapes;
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(node.attrs(), "dense_shapes", &dense_shapes));
+    for (const PartialTensorShape& dense_shape : dense_shapes) {
+      // Variable length features are padded to the longest one in the batch,
+      // which differs between the original and the vectorized op.
+      if (!dense_shape.IsFullyDefined()) {
+        return errors::Unimplemented(
+            "Vectorizing ParseExample requires fully defined dense_shapes.");
+      }
+    }
+
+    Output serialized;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &serialized));
+    // Inputs are serialized, names, dense_keys and dense_defaults.
+    std::vector<NodeBuilder::NodeOut> dense_keys(num_dense);
+    std::vector<NodeBuilder::NodeOut> dense_defaults(num_dense);
+    for (int i = 0; i < num_dense; ++i) {
+      TF_RETURN_IF_ERROR(inputs.unstacked(2 + i, &dense_keys[i]));
+      TF_RETURN_IF_ERROR(
+          inputs.unstacked(2 + num_dense + i, &dense_defaults[i]));
+    }
+
+    Status status;
+    Scope parent = NewInternalScope(outer_scope, &status, nullptr);
+    Scope s = parent.NewSubScope(kParseExamplePrefix);
+
+    Output batch_shape =
+        ops::Shape(s, serialized, ops::Shape::OutType(DT_INT64));
+    Output flat_serialized = ops::Reshape(s, serialized, ops::Const(s, {-1}));
+    // Names are only used in error messages, and are dropped since they
+    // don't match the flattened batch.
+    Output names = ops::Const(s, std::initializer_list<string>({}));
+    TF_RETURN_IF_ERROR(status);
+
+    Node* new_node;
+    auto node_builder =
+        NodeBuilder(strings::StrCat("vectorized/", node.name()), "ParseExample")
+            .Input(NodeBuilder::NodeOut(flat_serialized.node(),
+                                        flat_serialized.index()))
+            .Input(NodeBuilder::NodeOut(names.node(), names.index()))
+            .Input(std::vector<NodeBuilder::NodeOut>())
+            .Input(dense_keys)
+            .Input(dense_defaults);
+    for (const auto& attr : {"sparse_types", "dense_shapes"}) {
+      // Copy attrs if they exist
+      const AttrValue* val;
+      TF_RETURN_IF_ERROR(node.attrs().Find(attr, &val));
+      node_builder = node_builder.Attr(attr, *val);
+    }
+    TF_RETURN_IF_ERROR(node_builder.Finalize(outer_scope, &new_node));
+
+    // Add output mappings
+    for (int i = 0; i < num_dense; ++i) {
+      Tensor dense_shape(DT_INT64, TensorShape({dense_shapes[i].dims()}));
+      for (int d = 0; d < dense_shapes[i].dims(); ++d) {
+        dense_shape.vec<int64>()(d) = dense_shapes[i].dim_size(d);
+      }
+      Output vectorized_shape = ops::Concat(
+          s, {batch_shape, ops::Const(s, Input::Initializer(dense_shape))},
+          ops::Const(s, 0));
+      Output dense_value =
+          ops::Reshape(s, Output(new_node, i), vectorized_shape);
+      outputs->push_back({dense_value.node(), 0, true});
+    }
+    return status;
+  }
+};
+
+REGISTER_VECTORIZER("ParseExample", ParseExampleVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,116 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/framework/scope_internal.h"
+#include "tensorflow/cc/ops/array_ops.h"
+#include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/cc/ops/math_ops.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+const char* const kSlicePrefix = "vectorized/slice";
+const char* const kStridedSlicePrefix = "vectorized/strided_slice";
+
+// Returns `vector` with `value` prepended, i.e. extends a per-dimension
+// argument to cover the leading dimension of a stacked input.
+Output Prepend(const Scope& s, Output vector, int value) {
+  Output head = ops::Cast(s, ops::Const(s, {value}), vector.type());
+  return ops::Concat(s, {head, vector}, ops::Const(s, 0));
+}
+
+// Slices the whole of the leading dimension, i.e. begin = 0 and size = -1 for
+// that dimension.
+class SliceVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    Status status;
+    Scope parent = NewInternalScope(outer_scope, &status, nullptr);
+    Scope s = parent.NewSubScope(kSlicePrefix);
+
+    Output input, begin, size;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &input));
+    TF_RETURN_IF_ERROR(inputs.unstacked(1, &begin));
+    TF_RETURN_IF_ERROR(inputs.unstacked(2, &size));
+
+    Output vectorized_slice =
+        ops::Slice(s, input, Prepend(s, begin, 0), Prepend(s, size, -1));
+
+    TF_RETURN_IF_ERROR(status);
+
+    // Add output mappings
+    outputs->push_back({vectorized_slice.node(), 0, true});
+    return Status::OK();
+  }
+};
+
+// Slices the whole of the leading dimension by setting the first bit of
+// begin_mask and end_mask. The bits of the other masks are shifted by one
+// dimension.
+class StridedSliceVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    Status status;
+    Scope parent = NewInternalScope(outer_scope, &status, nullptr);
+    Scope s = parent.NewSubScope(kStridedSlicePrefix);
+
+    Output input, begin, end, strides;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &input));
+    TF_RETURN_IF_ERROR(inputs.unstacked(1, &begin));
+    TF_RETURN_IF_ERROR(inputs.unstacked(2, &end));
+    TF_RETURN_IF_ERROR(inputs.unstacked(3, &strides));
+
+    int begin_mask, end_mask, ellipsis_mask, new_axis_mask, shrink_axis_mask;
+    TF_RETURN_IF_ERROR(GetNodeAttr(node.attrs(), "begin_mask", &begin_mask));
+    TF_RETURN_IF_ERROR(GetNodeAttr(node.attrs(), "end_mask", &end_mask));
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(node.attrs(), "ellipsis_mask", &ellipsis_mask));
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(node.attrs(), "new_axis_mask", &new_axis_mask));
+    TF_RETURN_IF_ERROR(
+        GetNodeAttr(node.attrs(), "shrink_axis_mask", &shrink_axis_mask));
+
+    Output vectorized_strided_slice = ops::StridedSlice(
+        s, input, Prepend(s, begin, 0), Prepend(s, end, 0),
+        Prepend(s, strides, 1),
+        ops::StridedSlice::Attrs()
+            .BeginMask((begin_mask << 1) | 1)
+            .EndMask((end_mask << 1) | 1)
+            .EllipsisMask(ellipsis_mask << 1)
+            .NewAxisMask(new_axis_mask << 1)
+            .ShrinkAxisMask(shrink_axis_mask << 1));
+
+    TF_RETURN_IF_ERROR(status);
+
+    // Add output mappings
+    outputs->push_back({vectorized_strided_slice.node(), 0, true});
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("Slice", SliceVectorizer);
+REGISTER_VECTORIZER("StridedSlice", StridedSliceVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
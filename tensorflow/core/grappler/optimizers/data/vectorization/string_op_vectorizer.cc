@@ -0,0 +1,77 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/grappler/optimizers/data/vectorization/vectorizer_registry.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+// Vectorizes ops that compute each element of their output from the element
+// at the same position of their first input, and whose remaining inputs
+// (e.g. regex patterns) are shared by all the elements. DecodeRaw also fits
+// this pattern: it appends a dimension to the shape of its input.
+class StringOpVectorizer : public Vectorizer {
+ public:
+  Status Vectorize(const Node& node, Graph* outer_scope,
+                   VectorizerInput&& inputs,
+                   VectorizerOutput* outputs) override {
+    NodeBuilder::NodeOut input;
+    TF_RETURN_IF_ERROR(inputs.stacked(0, &input));
+
+    NodeBuilder node_builder(strings::StrCat("vectorized/", node.name()),
+                             node.type_string());
+    node_builder.Input(input);
+    for (size_t i = 1; i < inputs.size(); ++i) {
+      NodeBuilder::NodeOut other_input;
+      TF_RETURN_IF_ERROR(inputs.unstacked(i, &other_input));
+      node_builder.Input(other_input);
+    }
+    for (const auto& attr : node.def().attr()) {
+      node_builder.Attr(attr.first, attr.second);
+    }
+
+    Node* new_node;
+    TF_RETURN_IF_ERROR(node_builder.Finalize(outer_scope, &new_node));
+
+    // Add output mappings
+    outputs->push_back({new_node, 0, true});
+    return Status::OK();
+  }
+};
+
+REGISTER_VECTORIZER("AsString", StringOpVectorizer);
+REGISTER_VECTORIZER("DecodeBase64", StringOpVectorizer);
+REGISTER_VECTORIZER("DecodeRaw", StringOpVectorizer);
+REGISTER_VECTORIZER("EncodeBase64", StringOpVectorizer);
+REGISTER_VECTORIZER("RegexFullMatch", StringOpVectorizer);
+REGISTER_VECTORIZER("RegexReplace", StringOpVectorizer);
+REGISTER_VECTORIZER("StaticRegexFullMatch", StringOpVectorizer);
+REGISTER_VECTORIZER("StaticRegexReplace", StringOpVectorizer);
+REGISTER_VECTORIZER("StringLength", StringOpVectorizer);
+REGISTER_VECTORIZER("StringLower", StringOpVectorizer);
+REGISTER_VECTORIZER("StringStrip", StringOpVectorizer);
+REGISTER_VECTORIZER("StringToHashBucket", StringOpVectorizer);
+REGISTER_VECTORIZER("StringToHashBucketFast", StringOpVectorizer);
+REGISTER_VECTORIZER("StringToHashBucketStrong", StringOpVectorizer);
+REGISTER_VECTORIZER("StringToNumber", StringOpVectorizer);
+REGISTER_VECTORIZER("StringUpper", StringOpVectorizer);
+REGISTER_VECTORIZER("UnicodeScript", StringOpVectorizer);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/function_optimizer.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "absl/algorithm/container.h"
@@ -22,7 +23,9 @@ limitations under the License.
 #include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_replace.h"
+#include "absl/strings/string_view.h"
 #include "absl/strings/substitute.h"
+#include "absl/types/optional.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/device_set.h"
@@ -39,15 +42,19 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op_def.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/control_flow.h"
 #include "tensorflow/core/graph/graph_constructor.h"
 #include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/graph_view.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/canonicalizer.h"
 #include "tensorflow/core/grappler/utils/functions.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 
@@ -1154,6 +1161,421 @@ void AddFrameForwardingControlEdge(const std::vector<ControlFlowInfo>& info,
   }
 }
 
+// Functional If/Case ops whose predicate is decided when the graph is
+// optimized are replaced by a call to the function of the branch that is
+// taken, which is then inlined like any other function call. Such predicates
+// are often computed from the shapes of tensors, e.g. `tf.shape(x)[0] > 0`,
+// so they are evaluated using the symbolic shapes inferred by
+// GraphProperties.
+
+// Bounds the length of the chain of ops a predicate is evaluated through.
+constexpr int kMaxPredicateDepth = 16;
+
+// A scalar that an If/Case predicate is computed from. It is either known, or
+// an unknown (but non-negative) tensor dimension. Unknown dimensions with the
+// same symbolic id, as assigned by GraphProperties, are equal.
+struct PredicateScalar {
+  bool is_known;
+  // The value if `is_known`, otherwise the symbolic id of the dimension,
+  // which is -1 if the dimension is not related to any other one.
+  int64 value;
+};
+
+PredicateScalar KnownScalar(int64 value) { return {true, value}; }
+
+PredicateScalar DimensionScalar(int64 dim) {
+  return dim >= 0 ? PredicateScalar{true, dim} : PredicateScalar{false, dim};
+}
+
+class PredicateEvaluator {
+ public:
+  PredicateEvaluator(const GraphDef& graph, const GraphProperties& properties)
+      : properties_(properties) {
+    for (const NodeDef& node : graph.node()) nodes_[node.name()] = &node;
+  }
+
+  // Returns the value of the scalar tensor `input`, if it can be decided.
+  absl::optional<PredicateScalar> Evaluate(const string& input) const {
+    return Evaluate(input, /*depth=*/0);
+  }
+
+ private:
+  absl::optional<PredicateScalar> Evaluate(const string& input,
+                                           int depth) const {
+    const TensorId tensor = ParseTensorName(input);
+    if (tensor.index() < 0 || depth > kMaxPredicateDepth) return absl::nullopt;
+    const NodeDef* node = gtl::FindPtrOrNull(nodes_, string(tensor.node()));
+    if (node == nullptr) return absl::nullopt;
+
+    absl::optional<PredicateScalar> value =
+        InferredValue(*node, tensor.index());
+    if (value.has_value()) return value;
+
+    if (IsIdentity(*node) || IsSnapshot(*node)) {
+      return Evaluate(node->input(0), depth + 1);
+    }
+    if (IsCast(*node)) {
+      value = Evaluate(node->input(0), depth + 1);
+      DataType dst_type;
+      if (!value.has_value() || !GetNodeAttr(*node, "DstT", &dst_type).ok()) {
+        return absl::nullopt;
+      }
+      if (dst_type == DT_BOOL) {
+        // Unknown dimensions might be zero.
+        if (!value->is_known) return absl::nullopt;
+        return KnownScalar(value->value != 0);
+      }
+      if (dst_type != DT_INT32 && dst_type != DT_INT64) return absl::nullopt;
+      return value;
+    }
+    if (IsRank(*node) || IsSize(*node)) return RankOrSize(*node);
+    if (IsStridedSlice(*node)) return ShapeDimension(*node);
+    if (IsLogicalNot(*node)) {
+      value = Evaluate(node->input(0), depth + 1);
+      if (!value.has_value() || !value->is_known) return absl::nullopt;
+      return KnownScalar(value->value == 0);
+    }
+    if (IsLogicalAnd(*node) || IsLogicalOr(*node)) {
+      // The result is decided by a single operand if it is false for
+      // LogicalAnd, or true for LogicalOr.
+      const bool deciding_value = IsLogicalOr(*node);
+      bool all_known = true;
+      for (int i = 0; i < 2; ++i) {
+        value = Evaluate(node->input(i), depth + 1);
+        if (!value.has_value() || !value->is_known) {
+          all_known = false;
+        } else if ((value->value != 0) == deciding_value) {
+          return KnownScalar(deciding_value);
+        }
+      }
+      if (!all_known) return absl::nullopt;
+      return KnownScalar(!deciding_value);
+    }
+    if (IsEqual(*node) || IsNotEqual(*node) || IsLess(*node) ||
+        IsLessEqual(*node) || IsGreater(*node) || IsGreaterEqual(*node)) {
+      const absl::optional<PredicateScalar> x =
+          Evaluate(node->input(0), depth + 1);
+      if (!x.has_value()) return absl::nullopt;
+      const absl::optional<PredicateScalar> y =
+          Evaluate(node->input(1), depth + 1);
+      if (!y.has_value()) return absl::nullopt;
+      return Compare(*node, *x, *y);
+    }
+    return absl::nullopt;
+  }
+
+  // Returns the value of a scalar output of `node` that shape inference
+  // computed, which covers constants and the ops folded from them.
+  absl::optional<PredicateScalar> InferredValue(const NodeDef& node,
+                                                int port) const {
+    if (!properties_.HasOutputProperties(node.name())) return absl::nullopt;
+    const auto& outputs = properties_.GetOutputProperties(node.name());
+    if (port >= static_cast<int>(outputs.size()) ||
+        !outputs[port].has_value()) {
+      return absl::nullopt;
+    }
+    Tensor value;
+    // Non-scalar predicates are true iff they are not empty, so they are
+    // never folded.
+    if (!value.FromProto(outputs[port].value()) || value.dims() != 0) {
+      return absl::nullopt;
+    }
+    switch (value.dtype()) {
+      case DT_BOOL:
+        return KnownScalar(value.scalar<bool>()());
+      case DT_INT32:
+        return KnownScalar(value.scalar<int32>()());
+      case DT_INT64:
+        return KnownScalar(value.scalar<int64>()());
+      default:
+        return absl::nullopt;
+    }
+  }
+
+  // Returns the shape of the input `port` of `node`, if it is known.
+  const TensorShapeProto* InputShape(const NodeDef& node, int port) const {
+    if (!properties_.HasInputProperties(node.name())) return nullptr;
+    const auto& inputs = properties_.GetInputProperties(node.name());
+    if (port >= static_cast<int>(inputs.size())) return nullptr;
+    return &inputs[port].shape();
+  }
+
+  // Rank(x) and Size(x), from the shape of x.
+  absl::optional<PredicateScalar> RankOrSize(const NodeDef& node) const {
+    const TensorShapeProto* shape = InputShape(node, 0);
+    if (shape == nullptr || shape->unknown_rank()) return absl::nullopt;
+    if (IsRank(node)) return KnownScalar(shape->dim_size());
+    // The size is only decided if all the dimensions but one are known.
+    int64 size = 1;
+    int64 unknown_dim = 0;
+    int num_unknown_dims = 0;
+    for (const auto& dim : shape->dim()) {
+      if (dim.size() == 0) return KnownScalar(0);
+      if (dim.size() > 0) {
+        size *= dim.size();
+      } else {
+        unknown_dim = dim.size();
+        ++num_unknown_dims;
+      }
+    }
+    if (num_unknown_dims == 0) return KnownScalar(size);
+    if (num_unknown_dims == 1 && size == 1) return DimensionScalar(unknown_dim);
+    return absl::nullopt;
+  }
+
+  // Returns the value of a 1-D tensor input of `node` that shape inference
+  // found to be constant.
+  bool GetConstantInput(const NodeDef& node, int port,
+                        std::vector<int64>* values) const {
+    const auto& inputs = properties_.GetInputProperties(node.name());
+    if (port >= static_cast<int>(inputs.size()) ||
+        !inputs[port].has_value()) {
+      return false;
+    }
+    Tensor value;
+    if (!value.FromProto(inputs[port].value()) || value.dims() != 1) {
+      return false;
+    }
+    values->clear();
+    for (int i = 0; i < value.NumElements(); ++i) {
+      if (value.dtype() == DT_INT32) {
+        values->push_back(value.vec<int32>()(i));
+      } else if (value.dtype() == DT_INT64) {
+        values->push_back(value.vec<int64>()(i));
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Shape(x)[i], from the shape of x.
+  absl::optional<PredicateScalar> ShapeDimension(const NodeDef& node) const {
+    const TensorId shape_tensor = ParseTensorName(node.input(0));
+    const NodeDef* shape_node =
+        gtl::FindPtrOrNull(nodes_, string(shape_tensor.node()));
+    if (shape_node == nullptr || !IsShape(*shape_node) ||
+        shape_tensor.index() != 0 ||
+        !properties_.HasInputProperties(node.name())) {
+      return absl::nullopt;
+    }
+    // Only x[i] is supported, which slices a single dimension.
+    int64 begin_mask, shrink_axis_mask, ellipsis_mask, new_axis_mask;
+    if (!GetNodeAttr(node, "begin_mask", &begin_mask).ok() ||
+        !GetNodeAttr(node, "shrink_axis_mask", &shrink_axis_mask).ok() ||
+        !GetNodeAttr(node, "ellipsis_mask", &ellipsis_mask).ok() ||
+        !GetNodeAttr(node, "new_axis_mask", &new_axis_mask).ok() ||
+        begin_mask != 0 || shrink_axis_mask != 1 || ellipsis_mask != 0 ||
+        new_axis_mask != 0) {
+      return absl::nullopt;
+    }
+    std::vector<int64> begin, strides;
+    if (!GetConstantInput(node, 1, &begin) || begin.size() != 1 ||
+        !GetConstantInput(node, 3, &strides) || strides.size() != 1 ||
+        strides[0] != 1) {
+      return absl::nullopt;
+    }
+    const TensorShapeProto* shape = InputShape(*shape_node, 0);
+    if (shape == nullptr || shape->unknown_rank()) return absl::nullopt;
+    const int64 index = begin[0] < 0 ? begin[0] + shape->dim_size() : begin[0];
+    if (index < 0 || index >= shape->dim_size()) return absl::nullopt;
+    return DimensionScalar(shape->dim(index).size());
+  }
+
+  static absl::optional<PredicateScalar> Compare(const NodeDef& node,
+                                                 const PredicateScalar& x,
+                                                 const PredicateScalar& y) {
+    // Bounds of `x - y`.
+    int64 min_diff, max_diff;
+    if (x.is_known && y.is_known) {
+      min_diff = max_diff = x.value - y.value;
+    } else if (!x.is_known && !y.is_known && x.value == y.value &&
+               x.value < -1) {
+      min_diff = max_diff = 0;
+    } else if (x.is_known) {
+      // x - y with y in [0, inf).
+      min_diff = kint64min;
+      max_diff = x.value;
+    } else if (y.is_known) {
+      // x - y with x in [0, inf).
+      min_diff = -y.value;
+      max_diff = kint64max;
+    } else {
+      return absl::nullopt;
+    }
+
+    bool always, never;
+    if (IsEqual(node) || IsNotEqual(node)) {
+      always = min_diff == 0 && max_diff == 0;
+      never = min_diff > 0 || max_diff < 0;
+      if (IsNotEqual(node)) std::swap(always, never);
+    } else if (IsLess(node) || IsGreaterEqual(node)) {
+      always = max_diff < 0;
+      never = min_diff >= 0;
+      if (IsGreaterEqual(node)) std::swap(always, never);
+    } else {
+      always = min_diff > 0;
+      never = max_diff <= 0;
+      if (IsLessEqual(node)) std::swap(always, never);
+    }
+    if (always) return KnownScalar(true);
+    if (never) return KnownScalar(false);
+    return absl::nullopt;
+  }
+
+  const GraphProperties& properties_;
+  absl::flat_hash_map<string, const NodeDef*> nodes_;
+};
+
+// Returns the branch of the If/Case `node` that is taken, or nullptr if it
+// can't be decided.
+const NameAttrList* FindTakenBranch(const NodeDef& node,
+                                    const PredicateEvaluator& evaluator) {
+  const absl::optional<PredicateScalar> predicate =
+      evaluator.Evaluate(node.input(0));
+  if (!predicate.has_value() || !predicate->is_known) return nullptr;
+  if (IsIf(node)) {
+    const char* branch =
+        predicate->value != 0 ? "then_branch" : "else_branch";
+    const AttrValue* attr = AttrSlice(node).Find(branch);
+    return attr != nullptr && attr->has_func() ? &attr->func() : nullptr;
+  }
+  const AttrValue* branches = AttrSlice(node).Find("branches");
+  if (branches == nullptr || branches->list().func_size() == 0) return nullptr;
+  // Out of range indices execute the last branch.
+  const int num_branches = branches->list().func_size();
+  const int64 index = predicate->value;
+  return &branches->list().func(index < 0 || index >= num_branches
+                                    ? num_branches - 1
+                                    : index);
+}
+
+// Replaces the If/Case `node` with a call to `branch`. The predicate becomes
+// a control dependency of the call.
+void ReplaceWithBranchCall(const NameAttrList& branch, NodeDef* node) {
+  NodeDef call;
+  call.set_name(node->name());
+  call.set_op(node->op() == "StatelessIf" ? "PartitionedCall"
+                                          : "StatefulPartitionedCall");
+  call.set_device(node->device());
+  std::vector<string> control_inputs;
+  for (int i = 1; i < node->input_size(); ++i) {
+    if (IsControlInput(node->input(i))) {
+      control_inputs.push_back(node->input(i));
+    } else {
+      call.add_input(node->input(i));
+    }
+  }
+  control_inputs.push_back(AsControlDependency(NodeName(node->input(0))));
+  for (const string& input : control_inputs) call.add_input(input);
+
+  auto& attr = *call.mutable_attr();
+  for (const auto& node_attr : node->attr()) {
+    const string& name = node_attr.first;
+    if (name == "Tin" || name == "Tout" ||
+        (name[0] == '_' && name != kLowerUsingSwitchMergeAttr)) {
+      attr[name] = node_attr.second;
+    }
+  }
+  *attr["f"].mutable_func() = branch;
+  node->Swap(&call);
+}
+
+using NodesByName = absl::flat_hash_map<absl::string_view, const NodeDef*>;
+
+// Returns true if `input`, in a GraphDef or a FunctionDef, is computed only
+// from constants and tensor shapes. Shape inference is needed to evaluate a
+// predicate, but only such predicates can be decided, so this cheap check
+// avoids it in the common case where no predicate is.
+bool MayBeDecided(absl::string_view input, const NodesByName& nodes,
+                  int depth) {
+  if (depth > kMaxPredicateDepth) return false;
+  const NodeDef* node =
+      gtl::FindPtrOrNull(nodes, input.substr(0, input.find(':')));
+  if (node == nullptr) return false;
+  if (IsConstant(*node) || IsShape(*node) || IsShapeN(*node) ||
+      IsRank(*node) || IsSize(*node)) {
+    return true;
+  }
+  // A single operand may decide LogicalAnd and LogicalOr.
+  const bool any_input = IsLogicalAnd(*node) || IsLogicalOr(*node);
+  bool has_input = false;
+  for (const string& node_input : node->input()) {
+    if (IsControlInput(node_input)) continue;
+    const bool decided = MayBeDecided(node_input, nodes, depth + 1);
+    if (decided && any_input) return true;
+    if (!decided && !any_input) return false;
+    has_input = true;
+  }
+  return has_input && !any_input;
+}
+
+bool MayFoldConditional(const NodeDef& node, const NodesByName& nodes) {
+  return (IsIf(node) || IsCase(node)) && node.input_size() > 0 &&
+         MayBeDecided(node.input(0), nodes, /*depth=*/0);
+}
+
+// Returns true if `graph`, or a function of its library that might be inlined
+// into it, has an If/Case node whose predicate might be decided.
+bool MayFoldConditionals(const GraphDef& graph) {
+  const auto may_fold_any =
+      [](const protobuf::RepeatedPtrField<NodeDef>& graph_nodes) {
+        NodesByName nodes;
+        for (const NodeDef& node : graph_nodes) nodes[node.name()] = &node;
+        return absl::c_any_of(graph_nodes, [&](const NodeDef& node) {
+          return MayFoldConditional(node, nodes);
+        });
+      };
+  if (may_fold_any(graph.node())) return true;
+  return absl::c_any_of(graph.library().function(),
+                        [&](const FunctionDef& func) {
+                          return may_fold_any(func.node_def());
+                        });
+}
+
+// Folds the If/Case nodes of `graph` whose predicate is decided.
+Status FoldFunctionalConditionals(const GrapplerItem& item, GraphDef* graph,
+                                  int* num_folded) {
+  *num_folded = 0;
+  NodesByName nodes;
+  for (const NodeDef& node : graph->node()) nodes[node.name()] = &node;
+  std::vector<int> conditionals;
+  for (int i = 0; i < graph->node_size(); ++i) {
+    if (MayFoldConditional(graph->node(i), nodes)) conditionals.push_back(i);
+  }
+  if (conditionals.empty()) return Status::OK();
+
+  // The properties refer to the item, which owns the graph while they are
+  // used.
+  GrapplerItem conditionals_item = item.WithGraph(std::move(*graph));
+  std::vector<std::pair<int, const NameAttrList*>> taken_branches;
+  {
+    GraphProperties properties(conditionals_item);
+    Status status = properties.InferStatically(/*assume_valid_feeds=*/false);
+    if (!status.ok()) {
+      VLOG(2) << "Skip folding If/Case ops: " << status.error_message();
+    } else {
+      PredicateEvaluator evaluator(conditionals_item.graph, properties);
+      for (int i : conditionals) {
+        const NameAttrList* branch =
+            FindTakenBranch(conditionals_item.graph.node(i), evaluator);
+        if (branch != nullptr) taken_branches.emplace_back(i, branch);
+      }
+    }
+  }
+  // The branches point into the attributes of the nodes being replaced.
+  for (const auto& taken_branch : taken_branches) {
+    const NameAttrList branch = *taken_branch.second;
+    ReplaceWithBranchCall(
+        branch, conditionals_item.graph.mutable_node(taken_branch.first));
+  }
+  *num_folded = taken_branches.size();
+  VLOG(1) << "Folded " << taken_branches.size() << " of "
+          << conditionals.size() << " If/Case ops";
+  *graph = std::move(conditionals_item.graph);
+  return Status::OK();
+}
+
 // Inlines all function calls that are safe for inlining into the main graph.
 // Also lowers control flow V2 ops (functional If/While) into the V1 low level
 // ops (Switch/Merge/...).
@@ -1380,17 +1802,154 @@ void RestoreTensorMapping(const FunctionOptimizerContext& ctx,
   }
 }
 
+// Maps the names of duplicate functions to the name of the function which
+// replaces them.
+using FunctionRenaming = absl::flat_hash_map<string, string>;
+
+// Returns true if `func` is stateful or has a node with side effects. Calls
+// to such functions must keep their own kernels, e.g. their own random number
+// generators or their own resources with an empty shared_name.
+bool HasSideEffects(const FunctionDef& func,
+                    const OpRegistryInterface& op_registry) {
+  if (func.signature().is_stateful()) return true;
+  for (const NodeDef& node : func.node_def()) {
+    if (!IsFreeOfSideEffect(node, &op_registry)) return true;
+  }
+  return false;
+}
+
+// Returns the functions of `library` which compute the same outputs from the
+// same inputs as another function of the library (see FunctionFingerprint),
+// mapped to the one with the smallest name. Functions with a custom gradient,
+// gradient functions and functions with side effects are never merged.
+FunctionRenaming FindDuplicateFunctions(const FunctionDefLibrary& library) {
+  absl::flat_hash_set<string> keep;
+  for (const GradientDef& grad : library.gradient()) {
+    keep.insert(grad.function_name());
+    keep.insert(grad.gradient_func());
+  }
+  // Resolves the calls to other functions of the library.
+  const FunctionLibraryDefinition flib(OpRegistry::Global(), library);
+  std::vector<const FunctionDef*> functions;
+  for (const FunctionDef& func : library.function()) {
+    if (!keep.contains(func.signature().name()) &&
+        !HasSideEffects(func, flib)) {
+      functions.push_back(&func);
+    }
+  }
+  std::sort(functions.begin(), functions.end(),
+            [](const FunctionDef* a, const FunctionDef* b) {
+              return a->signature().name() < b->signature().name();
+            });
+
+  FunctionRenaming renaming;
+  absl::flat_hash_map<string, string> representatives;
+  for (const FunctionDef* func : functions) {
+    const string fingerprint = FunctionFingerprint(*func);
+    if (fingerprint.empty()) continue;
+    const string& name = func->signature().name();
+    auto it = representatives.emplace(fingerprint, name);
+    if (!it.second) renaming.emplace(name, it.first->second);
+  }
+  return renaming;
+}
+
+void RenameFunctions(const FunctionRenaming& renaming, AttrValue* attr);
+
+void RenameFunctions(const FunctionRenaming& renaming, NameAttrList* func) {
+  auto it = renaming.find(func->name());
+  if (it != renaming.end()) func->set_name(it->second);
+  for (auto& attr : *func->mutable_attr()) {
+    RenameFunctions(renaming, &attr.second);
+  }
+}
+
+void RenameFunctions(const FunctionRenaming& renaming, AttrValue* attr) {
+  if (attr->has_func()) {
+    RenameFunctions(renaming, attr->mutable_func());
+  } else if (attr->has_list()) {
+    for (NameAttrList& func : *attr->mutable_list()->mutable_func()) {
+      RenameFunctions(renaming, &func);
+    }
+  }
+}
+
+// Updates the direct and indirect function calls of `node`.
+void RenameFunctions(const FunctionRenaming& renaming, NodeDef* node) {
+  auto it = renaming.find(node->op());
+  if (it != renaming.end()) node->set_op(it->second);
+  for (auto& attr : *node->mutable_attr()) {
+    RenameFunctions(renaming, &attr.second);
+  }
+}
+
+// Replaces the duplicate functions of the library of `graph` by the function
+// they are mapped to in `renaming`, in the graph and in the function bodies.
+void MergeFunctions(const FunctionRenaming& renaming, GraphDef* graph) {
+  for (NodeDef& node : *graph->mutable_node()) {
+    RenameFunctions(renaming, &node);
+  }
+  FunctionDefLibrary* library = graph->mutable_library();
+  protobuf::RepeatedPtrField<FunctionDef> functions;
+  for (FunctionDef& func : *library->mutable_function()) {
+    if (renaming.contains(func.signature().name())) continue;
+    for (NodeDef& node : *func.mutable_node_def()) {
+      RenameFunctions(renaming, &node);
+    }
+    functions.Add()->Swap(&func);
+  }
+  library->mutable_function()->Swap(&functions);
+}
+
 }  // namespace
 
+int MergeDuplicateFunctions(GraphDef* graph) {
+  int num_merged = 0;
+  FunctionRenaming duplicates = FindDuplicateFunctions(graph->library());
+  while (!duplicates.empty()) {
+    MergeFunctions(duplicates, graph);
+    num_merged += duplicates.size();
+    duplicates = FindDuplicateFunctions(graph->library());
+  }
+  return num_merged;
+}
+
 Status FunctionOptimizer::RunFunctionOptimizerPass(
     const GrapplerItem& item, GraphDef* optimized_graph) const {
   VLOG(3) << "Run function optimizer pass: grappler_item_id=" << item.id;
 
   // Inline all function calls into a graph using common_runtime/function
   // implementation (see `InlineFunctionBody` function documentation).
+  //
+  // If/Case ops with a decided predicate, including the ones exposed by
+  // inlining, are folded before they are lowered to Switch/Merge. This takes
+  // a second inlining pass, which also inlines the calls to their taken
+  // branches, so control flow is lowered in the first pass unless some
+  // predicate might be decided.
+  const bool may_fold_conditionals = MayFoldConditionals(item.graph);
   GraphDef graph_after_inlining;
-  TF_RETURN_IF_ERROR(InlineFunctionCalls(item, opt_level_, lower_control_flow_,
-                                         &graph_after_inlining));
+  TF_RETURN_IF_ERROR(InlineFunctionCalls(
+      item, opt_level_,
+      /*lower_control_flow=*/lower_control_flow_ && !may_fold_conditionals,
+      &graph_after_inlining));
+
+  if (may_fold_conditionals) {
+    int num_folded = 0;
+    TF_RETURN_IF_ERROR(
+        FoldFunctionalConditionals(item, &graph_after_inlining, &num_folded));
+    const bool has_control_flow =
+        lower_control_flow_ &&
+        absl::c_any_of(graph_after_inlining.node(), [](const NodeDef& node) {
+          return IsIf(node) || IsCase(node) || IsWhile(node);
+        });
+    if (num_folded > 0 || has_control_flow) {
+      GraphDef graph_after_lowering;
+      TF_RETURN_IF_ERROR(InlineFunctionCalls(
+          item.WithGraph(std::move(graph_after_inlining)), opt_level_,
+          lower_control_flow_, &graph_after_lowering));
+      graph_after_inlining = std::move(graph_after_lowering);
+    }
+  }
 
   // Specialize function calls that we could not inline.
   FunctionOptimizerContext ctx(item, opt_level_, graph_after_inlining);
@@ -1462,7 +2021,22 @@ Status FunctionOptimizer::Optimize(Cluster*, const GrapplerItem& item,
     return errors::Aborted("Nothing to do.");
   }
 
-  TF_RETURN_IF_ERROR(RunFunctionOptimizerPass(item, optimized_graph));
+  // Merge the functions which compute the same thing first, so that calls to
+  // them are specialized together and can be deduped like any other node,
+  // in the graph and in the function bodies. The subgraphs which only become
+  // identical once the calls are inlined are deduped by the arithmetic
+  // optimizer, and the function bodies which only become identical once they
+  // are optimized are merged by the meta optimizer.
+  if (FindDuplicateFunctions(item.graph.library()).empty()) {
+    TF_RETURN_IF_ERROR(RunFunctionOptimizerPass(item, optimized_graph));
+    return Status::OK();
+  }
+  GraphDef graph = item.graph;
+  const int num_merged = MergeDuplicateFunctions(&graph);
+  VLOG(1) << "Merged " << num_merged << " duplicate functions";
+
+  TF_RETURN_IF_ERROR(RunFunctionOptimizerPass(item.WithGraph(std::move(graph)),
+                                              optimized_graph));
 
   return Status::OK();
 }
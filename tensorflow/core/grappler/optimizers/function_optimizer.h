@@ -56,6 +56,13 @@ class FunctionOptimizer : public GraphOptimizer {
   bool lower_control_flow_;
 };
 
+// Merges the functions of the library of `graph` which compute the same
+// outputs from the same inputs, and updates their calls in the graph and in
+// the function bodies. Functions with a custom gradient, gradient functions
+// and functions with side effects are never merged. Returns the number of
+// functions removed from the library.
+int MergeDuplicateFunctions(GraphDef* graph);
+
 }  // end namespace grappler
 }  // end namespace tensorflow
 
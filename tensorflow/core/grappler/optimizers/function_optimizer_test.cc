@@ -1348,6 +1348,265 @@ TEST_F(FunctionOptimizerTest, InlineIndirectFunctionDontLowerControlFlow) {
   }
 }
 
+// Returns the functions that compute `x + y` and `x * y`.
+std::vector<FunctionDef> AddAndMulFunctions() {
+  using FDH = FunctionDefHelper;
+  return {FDH::Create("MyAdd", {"x:T", "y:T"}, {"z:T"}, {"T: {float, double}"},
+                      {{{"add"}, "Add", {"x", "y"}, {{"T", "$T"}}}},
+                      {{"z", "add:z:0"}}),
+          FDH::Create("MyMul", {"x:T", "y:T"}, {"z:T"}, {"T: {float, double}"},
+                      {{{"mul"}, "Mul", {"x", "y"}, {{"T", "$T"}}}},
+                      {{"z", "mul:z:0"}})};
+}
+
+// Returns the nodes that compute `Shape(input)[0]`.
+std::vector<NodeDef> FirstDimension(const string& name, const string& input) {
+  using test::function::NDef;
+  const Tensor zero = test::AsTensor<int32>({0});
+  const Tensor one = test::AsTensor<int32>({1});
+  return {
+      NDef(name + "/shape", "Shape", {input},
+           {{"T", DT_FLOAT}, {"out_type", DT_INT32}}, kDevice),
+      NDef(name + "/begin", "Const", {}, {{"dtype", DT_INT32}, {"value", zero}},
+           kDevice),
+      NDef(name + "/end", "Const", {}, {{"dtype", DT_INT32}, {"value", one}},
+           kDevice),
+      NDef(name + "/strides", "Const", {},
+           {{"dtype", DT_INT32}, {"value", one}}, kDevice),
+      NDef(name, "StridedSlice",
+           {name + "/shape", name + "/begin", name + "/end", name + "/strides"},
+           {{"T", DT_INT32},
+            {"Index", DT_INT32},
+            {"begin_mask", 0},
+            {"end_mask", 0},
+            {"ellipsis_mask", 0},
+            {"new_axis_mask", 0},
+            {"shrink_axis_mask", 1}},
+           kDevice)};
+}
+
+TEST_F(FunctionOptimizerTest, FoldIfWithShapePredicate) {
+  using test::function::NDef;
+  using FDH = FunctionDefHelper;
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  // Build a computation graph for:
+  //   x: float[2, 3]
+  //   c = Shape(x)[0] > 0 ? x + x : x * x
+  //   d = Identity(c)
+  //   return d
+  std::vector<NodeDef> nodes = FirstDimension("dim", "x");
+  nodes.push_back(NDef("x", "Placeholder", {},
+                       {{"dtype", DT_FLOAT},
+                        {"shape", PartialTensorShape({2, 3})}},
+                       kDevice));
+  nodes.push_back(NDef("zero", "Const", {},
+                       {{"dtype", DT_INT32},
+                        {"value", test::AsScalar<int32>(0)}},
+                       kDevice));
+  nodes.push_back(NDef("is_add", "Greater", {"dim", "zero"},
+                       {{"T", DT_INT32}}, kDevice));
+  nodes.push_back(
+      NDef("c", "If", {"is_add", "x", "x"},
+           {{"Tcond", DT_BOOL},
+            {"Tin", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+            {"Tout", DataTypeSlice{DT_FLOAT}},
+            {"then_branch", FDH::FunctionRef("MyAdd", {{"T", DT_FLOAT}})},
+            {"else_branch", FDH::FunctionRef("MyMul", {{"T", DT_FLOAT}})},
+            {"_lower_using_switch_merge", true}},
+           kDevice));
+  nodes.push_back(NDef("d", "Identity", {"c"}, {{"T", DT_FLOAT}}, kDevice));
+
+  GrapplerItem item;
+  item.fetch = {"d"};
+  item.graph = test::function::GDef(nodes, AddAndMulFunctions());
+
+  GraphDef optimized_graph;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &optimized_graph));
+
+  const auto count_nodes_with_op = [&](const string& op) {
+    return absl::c_count_if(optimized_graph.node(), [&](const NodeDef& node) {
+      return node.op() == op;
+    });
+  };
+
+  // The `If` node must be replaced by the inlined body of `MyAdd`.
+  EXPECT_EQ(count_nodes_with_op("If"), 0);
+  EXPECT_EQ(count_nodes_with_op("StatefulPartitionedCall"), 0);
+  EXPECT_EQ(count_nodes_with_op("Switch"), 0);
+  EXPECT_EQ(count_nodes_with_op("Merge"), 0);
+  EXPECT_EQ(count_nodes_with_op("Add"), 1);
+  EXPECT_EQ(count_nodes_with_op("Mul"), 0);
+
+  Tensor x = test::AsTensor<float>({1, 2, 3, 4, 5, 6}, {2, 3});
+  item.feed.emplace_back("x", x);
+  auto tensors_expected = EvaluateFetchNodes(item);
+  ASSERT_EQ(tensors_expected.size(), 1);
+
+  GrapplerItem optimized = item.WithGraph(std::move(optimized_graph));
+  auto tensors = EvaluateFetchNodes(optimized);
+  ASSERT_EQ(tensors.size(), tensors_expected.size());
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
+TEST_F(FunctionOptimizerTest, FoldCaseWithSymbolicShapePredicate) {
+  using test::function::NDef;
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  NameAttrList add_branch;
+  add_branch.set_name("MyAdd");
+  (*add_branch.mutable_attr())["T"].set_type(DT_FLOAT);
+  NameAttrList mul_branch;
+  mul_branch.set_name("MyMul");
+  (*mul_branch.mutable_attr())["T"].set_type(DT_FLOAT);
+
+  // Build a computation graph for:
+  //   x: float[?, 3]
+  //   y = Identity(x)
+  //   index = Cast(Shape(x)[0] == Shape(y)[0])
+  //   c = Case(index, [x * x, x + x])
+  //   d = Identity(c)
+  //   return d
+  //
+  // The first dimensions of `x` and `y` are unknown, but they are equal.
+  std::vector<NodeDef> nodes = FirstDimension("dim_x", "x");
+  for (NodeDef& node : FirstDimension("dim_y", "y")) nodes.push_back(node);
+  nodes.push_back(NDef("x", "Placeholder", {},
+                       {{"dtype", DT_FLOAT},
+                        {"shape", PartialTensorShape({-1, 3})}},
+                       kDevice));
+  nodes.push_back(NDef("y", "Identity", {"x"}, {{"T", DT_FLOAT}}, kDevice));
+  nodes.push_back(NDef("same", "Equal", {"dim_x", "dim_y"},
+                       {{"T", DT_INT32}, {"incompatible_shape_error", true}},
+                       kDevice));
+  nodes.push_back(NDef("index", "Cast", {"same"},
+                       {{"SrcT", DT_BOOL}, {"DstT", DT_INT32}}, kDevice));
+  nodes.push_back(NDef(
+      "c", "Case", {"index", "x", "x"},
+      {{"Tin", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+       {"Tout", DataTypeSlice{DT_FLOAT}},
+       {"branches", gtl::ArraySlice<NameAttrList>{mul_branch, add_branch}},
+       {"_lower_using_switch_merge", true}},
+      kDevice));
+  nodes.push_back(NDef("d", "Identity", {"c"}, {{"T", DT_FLOAT}}, kDevice));
+
+  GrapplerItem item;
+  item.fetch = {"d"};
+  item.graph = test::function::GDef(nodes, AddAndMulFunctions());
+
+  GraphDef optimized_graph;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &optimized_graph));
+
+  const auto count_nodes_with_op = [&](const string& op) {
+    return absl::c_count_if(optimized_graph.node(), [&](const NodeDef& node) {
+      return node.op() == op;
+    });
+  };
+
+  EXPECT_EQ(count_nodes_with_op("Case"), 0);
+  EXPECT_EQ(count_nodes_with_op("StatefulPartitionedCall"), 0);
+  EXPECT_EQ(count_nodes_with_op("Switch"), 0);
+  EXPECT_EQ(count_nodes_with_op("Add"), 1);
+  EXPECT_EQ(count_nodes_with_op("Mul"), 0);
+
+  Tensor x = test::AsTensor<float>({1, 2, 3, 4, 5, 6}, {2, 3});
+  item.feed.emplace_back("x", x);
+  auto tensors_expected = EvaluateFetchNodes(item);
+  ASSERT_EQ(tensors_expected.size(), 1);
+
+  GrapplerItem optimized = item.WithGraph(std::move(optimized_graph));
+  auto tensors = EvaluateFetchNodes(optimized);
+  ASSERT_EQ(tensors.size(), tensors_expected.size());
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
+TEST_F(FunctionOptimizerTest, DoNotFoldIfWithUnknownPredicate) {
+  using test::function::NDef;
+  using FDH = FunctionDefHelper;
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT,
+                              /*lower_control_flow=*/false);
+
+  // The first dimension of `x` might be zero.
+  std::vector<NodeDef> nodes = FirstDimension("dim", "x");
+  nodes.push_back(NDef("x", "Placeholder", {},
+                       {{"dtype", DT_FLOAT},
+                        {"shape", PartialTensorShape({-1, 3})}},
+                       kDevice));
+  nodes.push_back(NDef("zero", "Const", {},
+                       {{"dtype", DT_INT32},
+                        {"value", test::AsScalar<int32>(0)}},
+                       kDevice));
+  nodes.push_back(NDef("is_add", "Greater", {"dim", "zero"},
+                       {{"T", DT_INT32}}, kDevice));
+  nodes.push_back(
+      NDef("c", "If", {"is_add", "x", "x"},
+           {{"Tcond", DT_BOOL},
+            {"Tin", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+            {"Tout", DataTypeSlice{DT_FLOAT}},
+            {"then_branch", FDH::FunctionRef("MyAdd", {{"T", DT_FLOAT}})},
+            {"else_branch", FDH::FunctionRef("MyMul", {{"T", DT_FLOAT}})}},
+           kDevice));
+  nodes.push_back(NDef("d", "Identity", {"c"}, {{"T", DT_FLOAT}}, kDevice));
+
+  GrapplerItem item;
+  item.fetch = {"d"};
+  item.graph = test::function::GDef(nodes, AddAndMulFunctions());
+
+  GraphDef optimized_graph;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &optimized_graph));
+  EXPECT_EQ(absl::c_count_if(
+                optimized_graph.node(),
+                [](const NodeDef& node) { return node.op() == "If"; }),
+            1);
+}
+
+TEST_F(FunctionOptimizerTest, LowerIfWithFedPredicate) {
+  using test::function::NDef;
+  using FDH = FunctionDefHelper;
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  // The predicate is fed, so it can't be folded and the `If` node is lowered
+  // to Switch/Merge without evaluating it.
+  GrapplerItem item;
+  item.fetch = {"d"};
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("is_add", "Placeholder", {}, {{"dtype", DT_BOOL}}, kDevice),
+       NDef("c", "If", {"is_add", "x", "x"},
+            {{"Tcond", DT_BOOL},
+             {"Tin", DataTypeSlice{DT_FLOAT, DT_FLOAT}},
+             {"Tout", DataTypeSlice{DT_FLOAT}},
+             {"then_branch", FDH::FunctionRef("MyAdd", {{"T", DT_FLOAT}})},
+             {"else_branch", FDH::FunctionRef("MyMul", {{"T", DT_FLOAT}})},
+             {"_lower_using_switch_merge", true}},
+            kDevice),
+       NDef("d", "Identity", {"c"}, {{"T", DT_FLOAT}}, kDevice)},
+      AddAndMulFunctions());
+
+  GraphDef optimized_graph;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &optimized_graph));
+
+  const auto count_nodes_with_op = [&](const string& op) {
+    return absl::c_count_if(optimized_graph.node(), [&](const NodeDef& node) {
+      return node.op() == op;
+    });
+  };
+  EXPECT_EQ(count_nodes_with_op("If"), 0);
+  EXPECT_GT(count_nodes_with_op("Switch"), 0);
+  EXPECT_EQ(count_nodes_with_op("Add"), 1);
+  EXPECT_EQ(count_nodes_with_op("Mul"), 1);
+
+  item.feed.emplace_back("x", test::AsTensor<float>({1, 2, 3}, {3}));
+  item.feed.emplace_back("is_add", test::AsScalar<bool>(false));
+  auto tensors_expected = EvaluateFetchNodes(item);
+  ASSERT_EQ(tensors_expected.size(), 1);
+
+  GrapplerItem optimized = item.WithGraph(std::move(optimized_graph));
+  auto tensors = EvaluateFetchNodes(optimized);
+  ASSERT_EQ(tensors.size(), tensors_expected.size());
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
 TEST_F(FunctionOptimizerTest, SpecializeFunctionXTimesTwo) {
   using test::function::NDef;
 
@@ -2019,5 +2278,120 @@ TEST_F(FunctionOptimizerTest, PruningUselessLibraryFunctions) {
             "XTimesTwo_specialized_for_y_at_test_graph");
 }
 
+TEST_F(FunctionOptimizerTest, MergeDuplicateFunctions) {
+  using test::function::NDef;
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  // Two functions which only differ by their name.
+  FunctionDef x_times_two = test::function::XTimesTwo();
+  (*x_times_two.mutable_attr())["_noinline"].set_b(true);
+  FunctionDef x_times_two_copy = x_times_two;
+  x_times_two_copy.mutable_signature()->set_name("XTimesTwoCopy");
+
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("y1", "XTimesTwo", {"x"}, {{"T", DT_FLOAT}}, kDevice),
+       NDef("y2", "XTimesTwoCopy", {"x"}, {{"T", DT_FLOAT}}, kDevice),
+       NDef("z", "Add", {"y1", "y2"}, {{"T", DT_FLOAT}}, kDevice)},
+      {x_times_two, x_times_two_copy});
+
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // Both calls use the same specialized function.
+  ASSERT_EQ(1, output.library().function_size());
+  EXPECT_EQ("XTimesTwo_specialized_for_y1_at_tf_graph",
+            output.library().function(0).signature().name());
+  int count = 0;
+  for (const NodeDef& node : output.node()) {
+    if ((node.name() == "y1" || node.name() == "y2") && ++count) {
+      EXPECT_EQ("XTimesTwo_specialized_for_y1_at_tf_graph", node.op());
+    }
+  }
+  EXPECT_EQ(2, count);
+
+  Tensor pi = test::AsScalar<float>(3.14f);
+  item.fetch = {"z"};
+  item.feed.emplace_back("x", pi);
+
+  auto tensors_expected = EvaluateFetchNodes(item);
+  GrapplerItem optimized = item.WithGraph(std::move(output));
+  auto tensors = EvaluateFetchNodes(optimized);
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
+TEST_F(FunctionOptimizerTest, DoNotMergeStatefulFunctions) {
+  using test::function::NDef;
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  // Two seeded random number generators which only differ by their name, but
+  // must each draw from their own stream.
+  FunctionDef random = FunctionDefHelper::Create(
+      "RandomLike", {"x: float"}, {"y: float"}, {},
+      {{{"shape"}, "Shape", {"x"}, {{"T", DT_FLOAT}}},
+       {{"random"},
+        "RandomUniform",
+        {"shape:output:0"},
+        {{"T", DT_INT32}, {"dtype", DT_FLOAT}, {"seed", 1}, {"seed2", 2}}}},
+      {{"y", "random:output:0"}});
+  random.mutable_signature()->set_is_stateful(true);
+  (*random.mutable_attr())["_noinline"].set_b(true);
+  FunctionDef random_copy = random;
+  random_copy.mutable_signature()->set_name("RandomLikeCopy");
+
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("y1", "RandomLike", {"x"}, {}, kDevice),
+       NDef("y2", "RandomLikeCopy", {"x"}, {}, kDevice),
+       NDef("z", "Add", {"y1", "y2"}, {{"T", DT_FLOAT}}, kDevice)},
+      {random, random_copy});
+
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(2, output.library().function_size());
+  string y1_op, y2_op;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "y1") y1_op = node.op();
+    if (node.name() == "y2") y2_op = node.op();
+  }
+  EXPECT_NE(y1_op, y2_op);
+}
+
+TEST_F(FunctionOptimizerTest, DoNotMergeFunctionsWithGradients) {
+  using test::function::NDef;
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  FunctionDef x_times_two = test::function::XTimesTwo();
+  (*x_times_two.mutable_attr())["_noinline"].set_b(true);
+  FunctionDef x_times_two_copy = x_times_two;
+  x_times_two_copy.mutable_signature()->set_name("XTimesTwoCopy");
+
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("y1", "XTimesTwo", {"x"}, {{"T", DT_FLOAT}}, kDevice),
+       NDef("y2", "XTimesTwoCopy", {"x"}, {{"T", DT_FLOAT}}, kDevice),
+       NDef("z", "Add", {"y1", "y2"}, {{"T", DT_FLOAT}}, kDevice)},
+      {x_times_two, x_times_two_copy});
+  GradientDef* grad = item.graph.mutable_library()->add_gradient();
+  grad->set_function_name("XTimesTwoCopy");
+  grad->set_gradient_func("XTimesTwo");
+
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "y2") {
+      EXPECT_EQ("XTimesTwoCopy", node.op());
+    }
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
@@ -0,0 +1,210 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/graph_optimization_cache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+// The first line of every cache file is
+//   <kFileMagic> <key> <payload size> <payload fingerprint>
+// and is followed by the serialized GraphDef.
+constexpr char kFileMagic[] = "grappler_graph_cache_v1";
+
+// Appends `field` in a form that can't be confused with its neighbours.
+void AppendField(absl::string_view field, string* out) {
+  absl::StrAppend(out, field.size(), ":", field, ";");
+}
+
+void AppendProto(const protobuf::MessageLite& proto, string* out) {
+  string serialized;
+  SerializeToStringDeterministic(proto, &serialized);
+  AppendField(serialized, out);
+}
+
+void AppendSorted(std::vector<string> values, string* out) {
+  std::sort(values.begin(), values.end());
+  AppendField(absl::StrCat(values.size()), out);
+  for (const string& value : values) AppendField(value, out);
+}
+
+}  // namespace
+
+GraphOptimizationCache::GraphOptimizationCache(const string& directory,
+                                               Env* env)
+    : directory_(directory), env_(env) {}
+
+GraphOptimizationCache* GraphOptimizationCache::Global() {
+  static GraphOptimizationCache* cache = []() -> GraphOptimizationCache* {
+    string directory;
+    Status s = ReadStringFromEnvVar("TF_GRAPPLER_CACHE_DIR", "", &directory);
+    if (!s.ok()) {
+      LOG(WARNING) << "Not caching optimized graphs: " << s;
+      return nullptr;
+    }
+    if (directory.empty()) return nullptr;
+    VLOG(1) << "Caching optimized graphs in " << directory;
+    return new GraphOptimizationCache(directory);
+  }();
+  return cache;
+}
+
+string GraphOptimizationCache::ComputeKey(const GrapplerItem& item,
+                                          const ConfigProto& config,
+                                          const Cluster* cluster) {
+  // The graph dominates the cost of computing the key, so it is fingerprinted
+  // on its own and the much smaller metadata is appended to its fingerprint.
+  string serialized_graph;
+  SerializeToStringDeterministic(item.graph, &serialized_graph);
+  const Fprint128 graph_fp = Fingerprint128(serialized_graph);
+  serialized_graph.clear();
+
+  string metadata;
+  AppendField(strings::FpToString(graph_fp.low64), &metadata);
+  AppendField(strings::FpToString(graph_fp.high64), &metadata);
+
+  // Optimizers change from one build to the next.
+  AppendField(TF_VERSION_STRING, &metadata);
+  AppendField(tf_git_version(), &metadata);
+  AppendField(absl::StrCat(TF_GRAPH_DEF_VERSION), &metadata);
+
+  AppendProto(config.graph_options().rewrite_options(), &metadata);
+  // The executor decides whether function control flow is lowered, and the
+  // JIT level whether the memory optimizer runs.
+  AppendField(config.experimental().executor_type(), &metadata);
+  AppendProto(config.graph_options().optimizer_options(), &metadata);
+
+  // The nodes that must be preserved, in order.
+  for (const std::vector<string>* nodes :
+       {&item.fetch, &item.init_ops, &item.keep_ops}) {
+    AppendField(absl::StrCat(nodes->size()), &metadata);
+    for (const string& node : *nodes) AppendField(node, &metadata);
+  }
+  AppendField(item.save_op, &metadata);
+  AppendField(item.restore_op, &metadata);
+  AppendField(item.save_restore_loc_tensor, &metadata);
+  // Feeds are used for their shapes and types, not their values.
+  AppendField(absl::StrCat(item.feed.size()), &metadata);
+  for (const auto& feed : item.feed) {
+    AppendField(feed.first, &metadata);
+    AppendField(absl::StrCat(feed.second.dtype()), &metadata);
+    TensorShapeProto shape;
+    feed.second.shape().AsProto(&shape);
+    AppendProto(shape, &metadata);
+  }
+
+  const GrapplerItem::OptimizationOptions& options =
+      item.optimization_options();
+  AppendField(absl::StrCat(options.allow_non_differentiable_rewrites,
+                           options.allow_pruning_stateful_and_dataset_ops,
+                           options.optimize_function_library,
+                           options.is_eager_mode),
+              &metadata);
+
+  AppendSorted({item.devices().begin(), item.devices().end()}, &metadata);
+  if (cluster != nullptr) {
+    std::vector<string> names = cluster->GetDeviceNames();
+    std::sort(names.begin(), names.end());
+    AppendField(absl::StrCat(names.size()), &metadata);
+    for (const string& name : names) {
+      AppendField(name, &metadata);
+      AppendProto(cluster->GetDevices().at(name), &metadata);
+    }
+  }
+
+  const Fprint128 key = Fingerprint128(metadata);
+  return absl::StrCat(strings::FpToString(key.low64),
+                      strings::FpToString(key.high64));
+}
+
+string GraphOptimizationCache::FileName(const string& key) const {
+  return io::JoinPath(directory_, absl::StrCat(key, ".graph"));
+}
+
+bool GraphOptimizationCache::Lookup(const string& key,
+                                    GraphDef* optimized_graph) const {
+  const string file_name = FileName(key);
+  if (!env_->FileExists(file_name).ok()) return false;
+  string contents;
+  Status s = ReadFileToString(env_, file_name, &contents);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to read cached graph " << file_name << ": " << s;
+    return false;
+  }
+
+  // Check the header before parsing the payload.
+  const size_t header_end = contents.find('\n');
+  if (header_end == string::npos) return false;
+  const std::vector<absl::string_view> header = absl::StrSplit(
+      absl::string_view(contents.data(), header_end), ' ');
+  const absl::string_view payload =
+      absl::string_view(contents).substr(header_end + 1);
+  uint64 payload_size;
+  if (header.size() != 4 || header[0] != kFileMagic || header[1] != key ||
+      !strings::safe_strtou64(header[2], &payload_size) ||
+      payload_size != payload.size() ||
+      header[3] != strings::FpToString(Fingerprint64(payload))) {
+    LOG(WARNING) << "Ignoring invalid cached graph " << file_name;
+    return false;
+  }
+  if (!optimized_graph->ParseFromArray(payload.data(), payload.size())) {
+    LOG(WARNING) << "Ignoring unparsable cached graph " << file_name;
+    return false;
+  }
+  return true;
+}
+
+Status GraphOptimizationCache::Insert(const string& key,
+                                      const GraphDef& optimized_graph) const {
+  string payload;
+  if (!SerializeToStringDeterministic(optimized_graph, &payload)) {
+    return errors::Internal("Failed to serialize the optimized graph.");
+  }
+  TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(directory_));
+
+  const string file_name = FileName(key);
+  string tmp_name = file_name;
+  if (!env_->CreateUniqueFileName(&tmp_name, ".tmp")) {
+    return errors::Internal("Failed to create a temporary file name for ",
+                            file_name);
+  }
+  const string contents =
+      absl::StrCat(kFileMagic, " ", key, " ", payload.size(), " ",
+                   strings::FpToString(Fingerprint64(payload)), "\n", payload);
+  Status s = WriteStringToFile(env_, tmp_name, contents);
+  if (s.ok()) s = env_->RenameFile(tmp_name, file_name);
+  if (!s.ok()) env_->DeleteFile(tmp_name).IgnoreError();
+  return s;
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
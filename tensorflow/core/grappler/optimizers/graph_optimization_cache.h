@@ -0,0 +1,76 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_GRAPH_OPTIMIZATION_CACHE_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_GRAPH_OPTIMIZATION_CACHE_H_
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// A directory of graphs optimized by the MetaOptimizer, so that a process
+// which optimizes the same graph again (e.g. after a restart or a model
+// reload) can load the result instead of rerunning all the optimizers.
+//
+// Entries are keyed by a fingerprint of everything the optimizers depend on:
+// the GrapplerItem, the RewriterConfig and the session options that the
+// MetaOptimizer reads, the available devices and the TensorFlow build. Each
+// file records its key and a fingerprint of its contents, which are checked
+// before an entry is used, so that a stale, truncated or corrupted file is
+// treated as a cache miss.
+//
+// The cache is shared by all the processes that use the same directory.
+// Entries are written to a temporary file that is then renamed, so readers
+// never observe a partially written entry.
+class GraphOptimizationCache {
+ public:
+  explicit GraphOptimizationCache(const string& directory,
+                                  Env* env = Env::Default());
+
+  // Returns the cache in the directory named by the TF_GRAPPLER_CACHE_DIR
+  // environment variable, or nullptr if it is not set.
+  static GraphOptimizationCache* Global();
+
+  // Returns the key of the result of optimizing `item` with the options in
+  // `config`. `cluster` may be null.
+  static string ComputeKey(const GrapplerItem& item, const ConfigProto& config,
+                           const Cluster* cluster);
+
+  // Returns true and fills `optimized_graph` if a valid entry for `key`
+  // exists.
+  bool Lookup(const string& key, GraphDef* optimized_graph) const;
+
+  // Stores `optimized_graph` under `key`, replacing any previous entry.
+  Status Insert(const string& key, const GraphDef& optimized_graph) const;
+
+ private:
+  string FileName(const string& key) const;
+
+  const string directory_;
+  Env* const env_;  // Not owned.
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GraphOptimizationCache);
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_GRAPH_OPTIMIZATION_CACHE_H_
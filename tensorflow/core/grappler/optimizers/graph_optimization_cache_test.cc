@@ -0,0 +1,185 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/graph_optimization_cache.h"
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/meta_optimizer.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kDevice[] = "/device:CPU:0";
+
+// Returns a graph of `num_layers` layers that each scale and shift their
+// input, with constants that can be folded.
+GrapplerItem MakeItem(int num_layers) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(kDevice);
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT);
+  for (int i = 0; i < num_layers; ++i) {
+    Output a = ops::Const(s.WithOpName(absl::StrCat("a", i)), 2.0f, {});
+    Output b = ops::Const(s.WithOpName(absl::StrCat("b", i)), 3.0f, {});
+    Output scale = ops::Mul(s.WithOpName(absl::StrCat("scale", i)), a, b);
+    x = ops::Add(s.WithOpName(absl::StrCat("add", i)),
+                 ops::Mul(s.WithOpName(absl::StrCat("mul", i)), x, scale),
+                 ops::Identity(s.WithOpName(absl::StrCat("id", i)), b));
+  }
+  ops::Identity(s.WithOpName("y"), x);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"y"};
+  return item;
+}
+
+string CacheDirectory(const string& name) {
+  return io::JoinPath(testing::TmpDir(), "graph_optimization_cache", name);
+}
+
+class GraphOptimizationCacheTest : public GrapplerTest {};
+
+TEST_F(GraphOptimizationCacheTest, KeyDependsOnInputs) {
+  GrapplerItem item = MakeItem(3);
+  ConfigProto cfg;
+  const string key = GraphOptimizationCache::ComputeKey(item, cfg, nullptr);
+  EXPECT_EQ(key, GraphOptimizationCache::ComputeKey(item, cfg, nullptr));
+
+  ConfigProto other_cfg;
+  other_cfg.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_constant_folding(RewriterConfig::OFF);
+  EXPECT_NE(key, GraphOptimizationCache::ComputeKey(item, other_cfg, nullptr));
+
+  // Options outside the RewriterConfig that change the optimized graph.
+  ConfigProto other_executor;
+  other_executor.mutable_experimental()->set_executor_type(
+      "SINGLE_THREADED_EXECUTOR");
+  EXPECT_NE(key,
+            GraphOptimizationCache::ComputeKey(item, other_executor, nullptr));
+
+  ConfigProto other_jit;
+  other_jit.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_global_jit_level(OptimizerOptions::ON_1);
+  EXPECT_NE(key, GraphOptimizationCache::ComputeKey(item, other_jit, nullptr));
+
+  GrapplerItem other_fetch = item;
+  other_fetch.fetch = {"add2"};
+  EXPECT_NE(key,
+            GraphOptimizationCache::ComputeKey(other_fetch, cfg, nullptr));
+
+  GrapplerItem other_devices = item;
+  TF_ASSERT_OK(other_devices.AddDevice("/job:a/replica:0/task:0/cpu:0"));
+  EXPECT_NE(key,
+            GraphOptimizationCache::ComputeKey(other_devices, cfg, nullptr));
+
+  GrapplerItem other_graph = item;
+  other_graph.graph.mutable_node(0)->set_device("/device:CPU:1");
+  EXPECT_NE(key,
+            GraphOptimizationCache::ComputeKey(other_graph, cfg, nullptr));
+}
+
+TEST_F(GraphOptimizationCacheTest, InsertAndLookup) {
+  GraphOptimizationCache cache(CacheDirectory("insert_and_lookup"));
+  GrapplerItem item = MakeItem(3);
+  const string key =
+      GraphOptimizationCache::ComputeKey(item, ConfigProto(), nullptr);
+
+  GraphDef output;
+  EXPECT_FALSE(cache.Lookup(key, &output));
+  TF_ASSERT_OK(cache.Insert(key, item.graph));
+  ASSERT_TRUE(cache.Lookup(key, &output));
+  CompareGraphs(item.graph, output);
+  EXPECT_FALSE(cache.Lookup(absl::StrCat(key, "0"), &output));
+
+  // Entries are shared through the directory.
+  GraphOptimizationCache other_cache(CacheDirectory("insert_and_lookup"));
+  GraphDef other_output;
+  ASSERT_TRUE(other_cache.Lookup(key, &other_output));
+  CompareGraphs(item.graph, other_output);
+}
+
+TEST_F(GraphOptimizationCacheTest, IgnoresCorruptedEntries) {
+  const string directory = CacheDirectory("corrupted");
+  GraphOptimizationCache cache(directory);
+  GrapplerItem item = MakeItem(3);
+  const string key =
+      GraphOptimizationCache::ComputeKey(item, ConfigProto(), nullptr);
+  TF_ASSERT_OK(cache.Insert(key, item.graph));
+
+  const string file_name = io::JoinPath(directory, absl::StrCat(key, ".graph"));
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), file_name, &contents));
+
+  GraphDef output;
+  // A truncated entry.
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), file_name,
+                                 contents.substr(0, contents.size() - 1)));
+  EXPECT_FALSE(cache.Lookup(key, &output));
+  // A modified entry.
+  contents.back() ^= 1;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), file_name, contents));
+  EXPECT_FALSE(cache.Lookup(key, &output));
+}
+
+// Optimizing a graph from scratch, which is what every process start does
+// without the cache.
+static void BM_OptimizeGraph(int iters, int num_layers) {
+  testing::StopTiming();
+  GrapplerItem item = MakeItem(num_layers);
+  ConfigProto config;
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    GraphDef output;
+    TF_CHECK_OK(RunMetaOptimizer(item, config, nullptr, nullptr, &output));
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * item.graph.node_size());
+}
+BENCHMARK(BM_OptimizeGraph)->Arg(1000)->Arg(10000)->Arg(50000);
+
+// Loading the same graph from the cache, including computing its key.
+static void BM_LoadCachedGraph(int iters, int num_layers) {
+  testing::StopTiming();
+  GrapplerItem item = MakeItem(num_layers);
+  ConfigProto config;
+  GraphOptimizationCache cache(
+      CacheDirectory(absl::StrCat("benchmark_", num_layers)));
+  GraphDef optimized;
+  TF_CHECK_OK(RunMetaOptimizer(item, config, nullptr, nullptr, &optimized));
+  TF_CHECK_OK(cache.Insert(
+      GraphOptimizationCache::ComputeKey(item, config, nullptr), optimized));
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    GraphDef output;
+    CHECK(cache.Lookup(
+        GraphOptimizationCache::ComputeKey(item, config, nullptr), &output));
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * item.graph.node_size());
+}
+BENCHMARK(BM_LoadCachedGraph)->Arg(1000)->Arg(10000)->Arg(50000);
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -26,6 +26,7 @@ namespace grappler {
 
 class Cluster;
 struct GrapplerItem;
+class IncrementalGraphProperties;
 
 // An abstract interface for an algorithm for generating a candidate
 // optimization of a GrapplerItem for running on a cluster.
@@ -71,8 +72,20 @@ class GraphOptimizer {
     return deadline_usec_ > 0 && Env::Default()->NowMicros() > deadline_usec_;
   }
 
+  // Shapes of the graphs passed to Optimize(), which the meta optimizer shares
+  // between its optimizers so that only the shapes of the nodes changed since
+  // the last inference are inferred again. Not owned, and null when the shapes
+  // are not shared.
+  void set_shared_graph_properties(IncrementalGraphProperties* properties) {
+    shared_graph_properties_ = properties;
+  }
+  IncrementalGraphProperties* shared_graph_properties() const {
+    return shared_graph_properties_;
+  }
+
  private:
   uint64 deadline_usec_;
+  IncrementalGraphProperties* shared_graph_properties_ = nullptr;
 };
 
 #define GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED()                              \
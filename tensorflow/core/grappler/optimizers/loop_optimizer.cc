@@ -17,17 +17,23 @@ limitations under the License.
 
 #include <algorithm>
 #include <deque>
+#include <functional>
 #include <limits>
+#include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/types.h"
@@ -37,11 +43,15 @@ limitations under the License.
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/optimizers/constant_folding.h"
 #include "tensorflow/core/grappler/optimizers/evaluation_utils.h"
+#include "tensorflow/core/grappler/utils/canonicalizer.h"
 #include "tensorflow/core/grappler/utils/frame.h"
+#include "tensorflow/core/grappler/utils/functions.h"
 #include "tensorflow/core/grappler/utils/traversal.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/tensor_coding.h"
 #include "tensorflow/core/public/version.h"
@@ -715,6 +725,795 @@ Status CheckForDeadFanout(const MutableGraphView& view,
   return Status::OK();
 }
 
+// Functional While loops.
+
+// Returns the argument or node that `input`, an input in FunctionDef format
+// ("arg", "node:output:index" or "^node"), refers to.
+string FunctionInputName(const string& input) {
+  const size_t begin = IsControlInput(input) ? 1 : 0;
+  const size_t end = input.find(':', begin);
+  return input.substr(begin, end == string::npos ? end : end - begin);
+}
+
+// Returns `input`, in FunctionDef format, with `rename` applied to the
+// argument or node it refers to.
+string RenameFunctionInput(const string& input,
+                           const std::function<string(const string&)>& rename) {
+  const size_t end = input.find(':');
+  return StrCat(IsControlInput(input) ? "^" : "",
+                rename(FunctionInputName(input)),
+                end == string::npos ? "" : input.substr(end));
+}
+
+// Returns `input` as "node:output:index", so that inputs which refer to the
+// same node output compare equal.
+string CanonicalFunctionTensor(const string& input) {
+  return std::count(input.begin(), input.end(), ':') == 1 ? StrCat(input, ":0")
+                                                          : input;
+}
+
+// Returns the function that the func attr `attr_name` of `loop` refers to,
+// or nullptr if it can't be found or is parametrized.
+const FunctionDef* FindLoopFunction(const NodeDef& loop,
+                                    const string& attr_name,
+                                    const FunctionLibraryDefinition& flib) {
+  const AttrValue* attr = AttrSlice(loop).Find(attr_name);
+  if (attr == nullptr || !attr->has_func() || attr->func().attr_size() > 0) {
+    return nullptr;
+  }
+  const FunctionDef* func = flib.Find(attr->func().name());
+  return func == nullptr || IsParametrized(*func) ? nullptr : func;
+}
+
+// Finds the condition and body of the functional While loop `loop`. Returns
+// false if the loop can't be rewritten.
+bool GetLoopFunctions(const NodeDef& loop,
+                      const FunctionLibraryDefinition& flib,
+                      const FunctionDef** cond, const FunctionDef** body) {
+  *cond = FindLoopFunction(loop, "cond", flib);
+  *body = FindLoopFunction(loop, "body", flib);
+  if (*cond == nullptr || *body == nullptr) return false;
+  const int num_vars = (*body)->signature().input_arg_size();
+  if ((*body)->signature().output_arg_size() != num_vars ||
+      (*cond)->signature().input_arg_size() != num_vars ||
+      (*cond)->signature().output_arg_size() != 1 ||
+      loop.input_size() < num_vars) {
+    return false;
+  }
+  for (int i = 0; i < num_vars; ++i) {
+    if (IsControlInput(loop.input(i))) return false;
+  }
+  return true;
+}
+
+bool IsStatelessFunction(const FunctionDef& func) {
+  for (const NodeDef& node : func.node_def()) {
+    if (!IsFreeOfSideEffect(node)) return false;
+  }
+  return true;
+}
+
+string UniqueFunctionName(const string& prefix,
+                          const FunctionLibraryDefinition& flib) {
+  string name = prefix;
+  for (int i = 1; flib.Find(name) != nullptr; ++i) {
+    name = StrCat(prefix, "_", i);
+  }
+  return name;
+}
+
+// Returns a name starting with `prefix` that isn't used by any argument or
+// node of `func`.
+string UniqueArgName(const string& prefix, const FunctionDef& func) {
+  absl::flat_hash_set<string> names;
+  for (const auto& arg : func.signature().input_arg()) names.insert(arg.name());
+  for (const auto& arg : func.signature().output_arg()) {
+    names.insert(arg.name());
+  }
+  for (const NodeDef& node : func.node_def()) names.insert(node.name());
+  string name = prefix;
+  for (int i = 1; names.contains(name); ++i) {
+    name = StrCat(prefix, "_", i);
+  }
+  return name;
+}
+
+void AddInputArg(const string& name, DataType type, FunctionDef* func) {
+  OpDef::ArgDef* arg = func->mutable_signature()->add_input_arg();
+  arg->set_name(name);
+  arg->set_type(type);
+}
+
+void AddOutputArg(const string& name, DataType type, FunctionDef* func) {
+  OpDef::ArgDef* arg = func->mutable_signature()->add_output_arg();
+  arg->set_name(name);
+  arg->set_type(type);
+}
+
+// Appends input arguments of the given types, which `func` doesn't use.
+void AddUnusedInputArgs(const DataTypeVector& types, FunctionDef* func) {
+  for (DataType type : types) {
+    AddInputArg(UniqueArgName("unused", *func), type, func);
+  }
+}
+
+// Copies the nodes of `func` whose names are in `nodes`, or all of them if
+// `nodes` is null, to `output`, with `rename` applied to their names and to
+// the names of the arguments and nodes they refer to.
+void AddRenamedNodes(const FunctionDef& func,
+                     const absl::flat_hash_set<string>* nodes,
+                     const std::function<string(const string&)>& rename,
+                     FunctionDef* output) {
+  for (const NodeDef& node : func.node_def()) {
+    if (nodes != nullptr && !nodes->contains(node.name())) continue;
+    NodeDef* new_node = output->add_node_def();
+    *new_node = node;
+    new_node->set_name(rename(node.name()));
+    for (int i = 0; i < node.input_size(); ++i) {
+      new_node->set_input(i, RenameFunctionInput(node.input(i), rename));
+    }
+  }
+}
+
+// Appends the loop variables `inputs` of the given types to `loop`, after its
+// `num_vars` existing ones. Their shapes are unknown.
+void AddLoopVars(const std::vector<string>& inputs, const DataTypeVector& types,
+                 int num_vars, NodeDef* loop) {
+  // Loop variables are regular inputs, which precede the control inputs.
+  std::vector<string> control_inputs(loop->input().begin() + num_vars,
+                                     loop->input().end());
+  loop->mutable_input()->DeleteSubrange(num_vars,
+                                        loop->input_size() - num_vars);
+  for (const string& input : inputs) loop->add_input(input);
+  for (const string& input : control_inputs) loop->add_input(input);
+
+  AttrValue& type_attr = (*loop->mutable_attr())["T"];
+  for (DataType type : types) type_attr.mutable_list()->add_type(type);
+  for (const char* shapes_attr : {"output_shapes", "_output_shapes"}) {
+    auto it = loop->mutable_attr()->find(shapes_attr);
+    if (it == loop->mutable_attr()->end() ||
+        it->second.list().shape_size() == 0) {
+      continue;
+    }
+    for (size_t i = 0; i < types.size(); ++i) {
+      it->second.mutable_list()->add_shape()->set_unknown_rank(true);
+    }
+  }
+}
+
+void AddFunction(const FunctionDef& func, FunctionLibraryDefinition* flib,
+                 GraphDef* graph) {
+  TF_CHECK_OK(flib->AddFunctionDef(func));
+  *graph->mutable_library()->add_function() = func;
+}
+
+// Returns true if the function body input `input` is a scalar Const of the
+// body, which broadcasts to any shape.
+bool IsScalarConstantInput(
+    const string& input,
+    const absl::flat_hash_map<string, const NodeDef*>& body_nodes) {
+  auto it = body_nodes.find(FunctionInputName(input));
+  if (it == body_nodes.end() || !IsConstant(*it->second)) return false;
+  auto value = it->second->attr().find("value");
+  return value != it->second->attr().end() &&
+         value->second.tensor().tensor_shape().dim_size() == 0;
+}
+
+// Hoisted nodes also run for loops that don't run any iteration, so only ops
+// that are cheap and can not fail are hoisted. Binary ops fail on shapes that
+// don't broadcast, so they are only hoisted if their inputs are the same
+// tensor or one of them is a scalar constant.
+bool IsHoistable(
+    const NodeDef& node,
+    const absl::flat_hash_map<string, const NodeDef*>& body_nodes) {
+  static const auto* const kUnaryOps = new absl::flat_hash_set<string>{
+      "Abs",  "Cast",  "Identity", "LogicalNot", "Neg",    "OnesLike",
+      "Rank", "Shape", "Size",     "Snapshot",   "Square", "ZerosLike"};
+  static const auto* const kBinaryOps = new absl::flat_hash_set<string>{
+      "Add",     "AddV2",     "Equal",      "Greater",   "GreaterEqual",
+      "Less",    "LessEqual", "LogicalAnd", "LogicalOr", "Maximum",
+      "Minimum", "Mul",       "NotEqual",   "Sub"};
+  for (const auto& attr : node.attr()) {
+    if (!attr.second.placeholder().empty()) return false;
+  }
+  if (IsConstant(node) || kUnaryOps->contains(node.op())) return true;
+  if (!kBinaryOps->contains(node.op()) || node.input_size() != 2) return false;
+  return CanonicalFunctionTensor(node.input(0)) ==
+             CanonicalFunctionTensor(node.input(1)) ||
+         IsScalarConstantInput(node.input(0), body_nodes) ||
+         IsScalarConstantInput(node.input(1), body_nodes);
+}
+
+// Moves the nodes of the body of the functional While loop `loop` that only
+// depend on its loop invariants, i.e. the loop variables that the body returns
+// unchanged, out of the loop. The values that the rest of the body uses are
+// passed to the loop as new loop invariants, so they are computed once instead
+// of once per iteration.
+Status HoistLoopInvariants(NodeDef* loop, NodeMap* node_map,
+                           FunctionLibraryDefinition* flib, GraphDef* graph) {
+  const FunctionDef* cond;
+  const FunctionDef* body;
+  if (!GetLoopFunctions(*loop, *flib, &cond, &body)) return Status::OK();
+  const OpDef& signature = body->signature();
+  const int num_vars = signature.input_arg_size();
+
+  absl::flat_hash_map<string, int> invariant_args;
+  for (int i = 0; i < num_vars; ++i) {
+    const string& arg = signature.input_arg(i).name();
+    auto it = body->ret().find(signature.output_arg(i).name());
+    if (it != body->ret().end() && it->second == arg) invariant_args[arg] = i;
+  }
+  if (invariant_args.empty()) return Status::OK();
+
+  absl::flat_hash_set<string> control_rets;
+  for (const auto& control_ret : body->control_ret()) {
+    control_rets.insert(control_ret.second);
+  }
+
+  absl::flat_hash_map<string, const NodeDef*> body_nodes;
+  for (const NodeDef& node : body->node_def()) {
+    body_nodes.emplace(node.name(), &node);
+  }
+
+  // Find the hoistable nodes, in topological order.
+  absl::flat_hash_map<string, const NodeDef*> hoisted;
+  std::vector<const NodeDef*> hoisted_order;
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (const NodeDef& node : body->node_def()) {
+      if (hoisted.contains(node.name()) || control_rets.contains(node.name()) ||
+          !IsHoistable(node, body_nodes)) {
+        continue;
+      }
+      bool is_invariant = true;
+      for (const string& input : node.input()) {
+        const string name = FunctionInputName(input);
+        if (IsControlInput(input) ||
+            (!invariant_args.contains(name) && !hoisted.contains(name))) {
+          is_invariant = false;
+          break;
+        }
+      }
+      if (!is_invariant) continue;
+      hoisted.emplace(node.name(), &node);
+      hoisted_order.push_back(&node);
+      progress = true;
+    }
+  }
+
+  // The hoisted values used by the rest of the body become new loop
+  // invariants, except for constants, which are cheaper to copy.
+  auto is_new_invariant = [&hoisted](const string& input) {
+    if (IsControlInput(input)) return false;
+    auto it = hoisted.find(FunctionInputName(input));
+    return it != hoisted.end() && !IsConstant(*it->second);
+  };
+  std::vector<string> new_invariants;
+  absl::flat_hash_map<string, string> new_invariant_args;
+  auto add_new_invariant = [&](const string& input) {
+    if (!is_new_invariant(input)) return;
+    const string tensor = CanonicalFunctionTensor(input);
+    if (new_invariant_args.emplace(tensor, "").second) {
+      new_invariants.push_back(tensor);
+    }
+  };
+  absl::flat_hash_set<string> used_constants;
+  for (const NodeDef& node : body->node_def()) {
+    if (hoisted.contains(node.name())) continue;
+    for (const string& input : node.input()) {
+      add_new_invariant(input);
+      auto it = hoisted.find(FunctionInputName(input));
+      if (it != hoisted.end() && IsConstant(*it->second)) {
+        used_constants.insert(it->first);
+      }
+    }
+  }
+  for (const auto& output : signature.output_arg()) {
+    auto it = body->ret().find(output.name());
+    if (it != body->ret().end()) add_new_invariant(it->second);
+  }
+  if (new_invariants.empty()) return Status::OK();
+
+  // Only the hoisted nodes that the new loop invariants depend on are needed
+  // outside of the loop.
+  absl::flat_hash_set<string> needed;
+  std::vector<string> stack = new_invariants;
+  while (!stack.empty()) {
+    const string name = FunctionInputName(stack.back());
+    stack.pop_back();
+    auto it = hoisted.find(name);
+    if (it == hoisted.end() || !needed.insert(name).second) continue;
+    stack.insert(stack.end(), it->second->input().begin(),
+                 it->second->input().end());
+  }
+
+  // Copy the needed nodes to the graph. Arguments are replaced with the
+  // inputs of the loop, and function outputs with graph outputs.
+  std::vector<NodeDef> new_nodes;
+  new_nodes.reserve(needed.size());
+  absl::flat_hash_map<string, const NodeDef*> new_nodes_by_body_name;
+  absl::flat_hash_set<string> new_node_names;
+  auto graph_tensor = [&](const string& input, string* tensor,
+                          DataType* type) -> Status {
+    const string name = FunctionInputName(input);
+    auto arg = invariant_args.find(name);
+    if (arg != invariant_args.end()) {
+      *tensor = loop->input(arg->second);
+      *type = signature.input_arg(arg->second).type();
+      return Status::OK();
+    }
+    const NodeDef& node = *new_nodes_by_body_name.at(name);
+    const OpDef* op_def;
+    TF_RETURN_IF_ERROR(OpRegistry::Global()->LookUpOpDef(node.op(), &op_def));
+    NameRangeMap outputs;
+    TF_RETURN_IF_ERROR(
+        NameRangesForNode(AttrSlice(node), *op_def, nullptr, &outputs));
+    const std::vector<string> parts =
+        str_util::Split(CanonicalFunctionTensor(input), ':');
+    int index;
+    if (parts.size() != 3 || outputs.count(parts[1]) == 0 ||
+        !strings::safe_strto32(parts[2], &index)) {
+      return errors::InvalidArgument("Invalid function input ", input);
+    }
+    const int position = outputs.at(parts[1]).first + index;
+    *tensor = position == 0 ? node.name() : StrCat(node.name(), ":", position);
+    DataTypeVector input_types, output_types;
+    TF_RETURN_IF_ERROR(
+        InOutTypesForNode(node, *op_def, &input_types, &output_types));
+    if (position < 0 || position >= static_cast<int>(output_types.size())) {
+      return errors::InvalidArgument("Invalid function input ", input);
+    }
+    *type = output_types[position];
+    return Status::OK();
+  };
+  const string prefix = AddPrefixToNodeName("hoisted", loop->name());
+  for (const NodeDef* node : hoisted_order) {
+    if (!needed.contains(node->name())) continue;
+    const OpDef* op_def;
+    TF_RETURN_IF_ERROR(
+        OpRegistry::Global()->LookUpOpDef(node->op(), &op_def));
+    new_nodes.push_back(*node);
+    NodeDef& new_node = new_nodes.back();
+    AddDefaultsToNodeDef(*op_def, &new_node);
+    // Colocation constraints refer to the nodes of the body.
+    new_node.mutable_attr()->erase(kColocationAttrName);
+    string name = AddPrefixToNodeName(node->name(), prefix);
+    for (int i = 1;
+         node_map->NodeExists(name) || new_node_names.contains(name); ++i) {
+      name = StrCat(AddPrefixToNodeName(node->name(), prefix), "_", i);
+    }
+    new_node_names.insert(name);
+    new_node.set_name(name);
+    if (new_node.device().empty()) new_node.set_device(loop->device());
+    for (int i = 0; i < node->input_size(); ++i) {
+      string tensor;
+      DataType type;
+      TF_RETURN_IF_ERROR(graph_tensor(node->input(i), &tensor, &type));
+      new_node.set_input(i, tensor);
+    }
+    if (new_node.input_size() == 0) {
+      // Keep the node in the frame of the loop.
+      new_node.add_input(AsControlDependency(NodeName(loop->input(0))));
+    }
+    new_nodes_by_body_name[node->name()] = &new_node;
+  }
+  std::vector<string> new_inputs;
+  DataTypeVector new_types;
+  for (const string& tensor : new_invariants) {
+    string input;
+    DataType type;
+    TF_RETURN_IF_ERROR(graph_tensor(tensor, &input, &type));
+    new_inputs.push_back(input);
+    new_types.push_back(type);
+  }
+
+  // The body takes the new loop invariants as arguments instead.
+  FunctionDef new_body = *body;
+  new_body.mutable_signature()->set_name(
+      UniqueFunctionName(StrCat(signature.name(), "_hoisted"), *flib));
+  for (int i = 0; i < static_cast<int>(new_invariants.size()); ++i) {
+    const string input_name = UniqueArgName("hoisted", new_body);
+    AddInputArg(input_name, new_types[i], &new_body);
+    const string output_name = UniqueArgName("hoisted_output", new_body);
+    AddOutputArg(output_name, new_types[i], &new_body);
+    (*new_body.mutable_ret())[output_name] = input_name;
+    new_invariant_args[new_invariants[i]] = input_name;
+  }
+  auto rewire = [&](const string& input) {
+    return is_new_invariant(input)
+               ? new_invariant_args.at(CanonicalFunctionTensor(input))
+               : input;
+  };
+  new_body.clear_node_def();
+  for (const NodeDef& node : body->node_def()) {
+    if (hoisted.contains(node.name()) &&
+        !used_constants.contains(node.name())) {
+      continue;
+    }
+    NodeDef* new_node = new_body.add_node_def();
+    *new_node = node;
+    new_node->clear_input();
+    for (const string& input : node.input()) {
+      const string name = FunctionInputName(input);
+      // The hoisted nodes have no side effects, so control dependencies on
+      // them can be dropped.
+      if (IsControlInput(input) && hoisted.contains(name) &&
+          !used_constants.contains(name)) {
+        continue;
+      }
+      new_node->add_input(rewire(input));
+    }
+  }
+  for (const auto& output : signature.output_arg()) {
+    auto it = new_body.mutable_ret()->find(output.name());
+    if (it != new_body.mutable_ret()->end()) it->second = rewire(it->second);
+  }
+
+  FunctionDef new_cond = *cond;
+  new_cond.mutable_signature()->set_name(
+      UniqueFunctionName(StrCat(cond->signature().name(), "_hoisted"), *flib));
+  AddUnusedInputArgs(new_types, &new_cond);
+
+  VLOG(2) << "Hoisting " << needed.size() << " nodes out of "
+          << loop->name();
+  for (NodeDef& node : new_nodes) {
+    NodeDef* added = graph->add_node();
+    *added = std::move(node);
+    node_map->AddNode(added->name(), added);
+    for (const string& input : added->input()) {
+      node_map->AddOutput(NodeName(input), added->name());
+    }
+  }
+  AddLoopVars(new_inputs, new_types, num_vars, loop);
+  for (const string& input : new_inputs) {
+    node_map->AddOutput(NodeName(input), loop->name());
+  }
+  (*loop->mutable_attr())["cond"].mutable_func()->set_name(
+      new_cond.signature().name());
+  (*loop->mutable_attr())["body"].mutable_func()->set_name(
+      new_body.signature().name());
+  AddFunction(new_cond, flib, graph);
+  AddFunction(new_body, flib, graph);
+  return Status::OK();
+}
+
+Status HoistAllLoopInvariants(GraphDef* graph) {
+  FunctionLibraryDefinition flib(OpRegistry::Global(), graph->library());
+  NodeMap node_map(graph);
+  // Hoisted nodes are appended to the graph, and never contain loops.
+  const int num_nodes = graph->node_size();
+  for (int i = 0; i < num_nodes; ++i) {
+    NodeDef* node = graph->mutable_node(i);
+    if (!IsWhile(*node)) continue;
+    Status s = HoistLoopInvariants(node, &node_map, &flib, graph);
+    if (!s.ok()) {
+      VLOG(1) << "Failed to hoist the loop invariants of " << node->name()
+              << ": " << s;
+    }
+  }
+  return Status::OK();
+}
+
+// Collects the nodes of `func` in the transitive fanin of `inputs`, and the
+// indices of the arguments they depend on. Returns false if one of these nodes
+// has side effects.
+bool CollectFunctionFanin(const FunctionDef& func, std::vector<string> inputs,
+                          absl::flat_hash_set<string>* nodes,
+                          std::set<int>* args) {
+  absl::flat_hash_map<string, int> arg_indices;
+  for (int i = 0; i < func.signature().input_arg_size(); ++i) {
+    arg_indices[func.signature().input_arg(i).name()] = i;
+  }
+  absl::flat_hash_map<string, const NodeDef*> func_nodes;
+  for (const NodeDef& node : func.node_def()) func_nodes[node.name()] = &node;
+
+  while (!inputs.empty()) {
+    const string name = FunctionInputName(inputs.back());
+    inputs.pop_back();
+    auto arg = arg_indices.find(name);
+    if (arg != arg_indices.end()) {
+      args->insert(arg->second);
+      continue;
+    }
+    auto node = func_nodes.find(name);
+    if (node == func_nodes.end() || !IsFreeOfSideEffect(*node->second)) {
+      return false;
+    }
+    if (!nodes->insert(name).second) continue;
+    inputs.insert(inputs.end(), node->second->input().begin(),
+                  node->second->input().end());
+  }
+  return true;
+}
+
+// Returns a fingerprint of the computation that decides how many iterations
+// a loop with the given condition and body runs: the condition, and the part
+// of the body that updates the loop variables the condition depends on, which
+// are returned in `trip_vars`. Loops with the same fingerprint and equivalent
+// initial values of their `trip_vars` run the same number of iterations.
+// Returns an empty string if this computation can't be isolated.
+string TripCountFingerprint(const FunctionDef& cond, const FunctionDef& body,
+                            std::vector<int>* trip_vars) {
+  auto cond_ret = cond.ret().find(cond.signature().output_arg(0).name());
+  if (cond_ret == cond.ret().end()) return "";
+  absl::flat_hash_set<string> cond_nodes;
+  std::set<int> cond_vars;
+  if (!CollectFunctionFanin(cond, {cond_ret->second}, &cond_nodes,
+                            &cond_vars)) {
+    return "";
+  }
+
+  std::vector<string> body_rets;
+  std::set<int> vars;
+  std::vector<int> pending(cond_vars.begin(), cond_vars.end());
+  absl::flat_hash_set<string> body_nodes;
+  while (!pending.empty()) {
+    const int var = pending.back();
+    pending.pop_back();
+    if (!vars.insert(var).second) continue;
+    auto ret = body.ret().find(body.signature().output_arg(var).name());
+    if (ret == body.ret().end()) return "";
+    std::set<int> args;
+    if (!CollectFunctionFanin(body, {ret->second}, &body_nodes, &args)) {
+      return "";
+    }
+    pending.insert(pending.end(), args.begin(), args.end());
+  }
+  trip_vars->assign(vars.begin(), vars.end());
+
+  // Build a function from the trip variables to the condition and their next
+  // values, with names that don't depend on the loop.
+  FunctionDef trip_count;
+  absl::flat_hash_map<string, string> cond_args, body_args;
+  for (int i = 0; i < static_cast<int>(trip_vars->size()); ++i) {
+    const int var = (*trip_vars)[i];
+    const string arg = StrCat("arg", i);
+    AddInputArg(arg, body.signature().input_arg(var).type(), &trip_count);
+    cond_args[cond.signature().input_arg(var).name()] = arg;
+    body_args[body.signature().input_arg(var).name()] = arg;
+  }
+  auto cond_rename = [&cond_args](const string& name) {
+    auto it = cond_args.find(name);
+    return it != cond_args.end() ? it->second : StrCat("cond/", name);
+  };
+  auto body_rename = [&body_args](const string& name) {
+    auto it = body_args.find(name);
+    return it != body_args.end() ? it->second : StrCat("body/", name);
+  };
+  AddRenamedNodes(cond, &cond_nodes, cond_rename, &trip_count);
+  AddRenamedNodes(body, &body_nodes, body_rename, &trip_count);
+  AddOutputArg("cond", cond.signature().output_arg(0).type(), &trip_count);
+  (*trip_count.mutable_ret())["cond"] =
+      RenameFunctionInput(cond_ret->second, cond_rename);
+  for (int i = 0; i < static_cast<int>(trip_vars->size()); ++i) {
+    const OpDef::ArgDef& output = body.signature().output_arg((*trip_vars)[i]);
+    const string name = StrCat("next", i);
+    AddOutputArg(name, output.type(), &trip_count);
+    (*trip_count.mutable_ret())[name] =
+        RenameFunctionInput(body.ret().at(output.name()), body_rename);
+  }
+  return FunctionFingerprint(trip_count);
+}
+
+// Returns true if the graph inputs `a` and `b` have the same value.
+bool AreEquivalentInputs(const string& a, const string& b,
+                         const NodeMap& node_map) {
+  if (a == b) return true;
+  const NodeDef* node_a = node_map.GetNode(NodeName(a));
+  const NodeDef* node_b = node_map.GetNode(NodeName(b));
+  if (node_a == nullptr || node_b == nullptr || !IsConstant(*node_a) ||
+      !IsConstant(*node_b)) {
+    return false;
+  }
+  for (const char* attr : {"dtype", "value"}) {
+    const AttrValue* value_a = AttrSlice(*node_a).Find(attr);
+    const AttrValue* value_b = AttrSlice(*node_b).Find(attr);
+    if (value_a == nullptr || value_b == nullptr ||
+        !AreAttrValuesEqual(*value_a, *value_b)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if the node named `target` is in the transitive fanin of
+// `node`.
+bool IsInFanin(const NodeDef& node, const string& target,
+               const NodeMap& node_map) {
+  std::vector<const NodeDef*> stack = {&node};
+  absl::flat_hash_set<const NodeDef*> visited;
+  while (!stack.empty()) {
+    const NodeDef* current = stack.back();
+    stack.pop_back();
+    for (const string& input : current->input()) {
+      const NodeDef* fanin = node_map.GetNode(NodeName(input));
+      if (fanin == nullptr) continue;
+      if (fanin->name() == target) return true;
+      if (visited.insert(fanin).second) stack.push_back(fanin);
+    }
+  }
+  return false;
+}
+
+struct FusionCandidate {
+  NodeDef* node;
+  const FunctionDef* cond;
+  const FunctionDef* body;
+  string trip_count_fingerprint;
+  std::vector<int> trip_vars;
+  bool is_stateless;
+};
+
+bool CanFuseLoops(const FusionCandidate& a, const FusionCandidate& b,
+                  const std::unordered_set<string>& nodes_to_preserve,
+                  const NodeMap& node_map) {
+  if (a.trip_count_fingerprint != b.trip_count_fingerprint ||
+      a.trip_vars.size() != b.trip_vars.size() ||
+      a.node->device() != b.node->device() ||
+      nodes_to_preserve.count(b.node->name()) > 0) {
+    return false;
+  }
+  // The side effects of the two loops are interleaved once they are fused.
+  if (!a.is_stateless && !b.is_stateless) return false;
+  for (int i = 0; i < static_cast<int>(a.trip_vars.size()); ++i) {
+    if (!AreEquivalentInputs(a.node->input(a.trip_vars[i]),
+                             b.node->input(b.trip_vars[i]), node_map)) {
+      return false;
+    }
+  }
+  return !IsInFanin(*a.node, b.node->name(), node_map) &&
+         !IsInFanin(*b.node, a.node->name(), node_map);
+}
+
+// Appends the arguments, nodes and outputs of `func` to `output`, with
+// `prefix` prepended to their names.
+void AddPrefixedFunction(const FunctionDef& func, const string& prefix,
+                         FunctionDef* output) {
+  auto rename = [&prefix](const string& name) { return StrCat(prefix, name); };
+  const int arg_offset = output->signature().input_arg_size();
+  for (const auto& arg : func.signature().input_arg()) {
+    AddInputArg(rename(arg.name()), arg.type(), output);
+  }
+  for (const auto& arg_attr : func.arg_attr()) {
+    (*output->mutable_arg_attr())[arg_offset + arg_attr.first] =
+        arg_attr.second;
+  }
+  AddRenamedNodes(func, nullptr, rename, output);
+  for (const auto& arg : func.signature().output_arg()) {
+    AddOutputArg(rename(arg.name()), arg.type(), output);
+    (*output->mutable_ret())[rename(arg.name())] =
+        RenameFunctionInput(func.ret().at(arg.name()), rename);
+  }
+  for (const string& control_output : func.signature().control_output()) {
+    output->mutable_signature()->add_control_output(rename(control_output));
+  }
+  for (const auto& control_ret : func.control_ret()) {
+    (*output->mutable_control_ret())[rename(control_ret.first)] =
+        rename(control_ret.second);
+  }
+}
+
+// Fuses the loop `b` into the loop `a`: the loop variables of `b` are
+// appended to those of `a`, and the fused body runs both bodies.
+void FuseLoops(const FusionCandidate& a, const FusionCandidate& b,
+               FunctionLibraryDefinition* flib, GraphDef* graph) {
+  NodeDef* loop = a.node;
+  const int num_vars_a = a.body->signature().input_arg_size();
+  const int num_vars_b = b.body->signature().input_arg_size();
+  DataTypeVector types_b;
+  for (const auto& arg : b.body->signature().input_arg()) {
+    types_b.push_back(arg.type());
+  }
+
+  // Both loops run the same number of iterations, so the condition of `a`
+  // decides for both.
+  FunctionDef cond = *a.cond;
+  cond.mutable_signature()->set_name(
+      UniqueFunctionName(StrCat(a.cond->signature().name(), "_fused"), *flib));
+  AddUnusedInputArgs(types_b, &cond);
+
+  FunctionDef body;
+  body.mutable_signature()->set_name(
+      UniqueFunctionName(StrCat(a.body->signature().name(), "_fused"), *flib));
+  body.mutable_signature()->set_is_stateful(
+      a.body->signature().is_stateful() || b.body->signature().is_stateful());
+  *body.mutable_attr() = a.body->attr();
+  AddPrefixedFunction(*a.body, "loop0_", &body);
+  AddPrefixedFunction(*b.body, "loop1_", &body);
+
+  VLOG(2) << "Fusing loop " << b.node->name() << " into " << loop->name();
+  AddLoopVars({b.node->input().begin(), b.node->input().begin() + num_vars_b},
+              types_b, num_vars_a, loop);
+  for (int i = num_vars_b; i < b.node->input_size(); ++i) {
+    const string& input = b.node->input(i);
+    if (std::find(loop->input().begin(), loop->input().end(), input) ==
+        loop->input().end()) {
+      loop->add_input(input);
+    }
+  }
+  for (const char* shapes_attr : {"output_shapes", "_output_shapes"}) {
+    auto it = loop->mutable_attr()->find(shapes_attr);
+    const AttrValue* shapes_b = AttrSlice(*b.node).Find(shapes_attr);
+    if (it == loop->mutable_attr()->end() || shapes_b == nullptr ||
+        it->second.list().shape_size() != num_vars_a + num_vars_b ||
+        shapes_b->list().shape_size() != num_vars_b) {
+      continue;
+    }
+    for (int i = 0; i < num_vars_b; ++i) {
+      *it->second.mutable_list()->mutable_shape(num_vars_a + i) =
+          shapes_b->list().shape(i);
+    }
+  }
+  if (b.node->op() == "While") loop->set_op("While");
+  const AttrValue* iterations_b =
+      AttrSlice(*b.node).Find("parallel_iterations");
+  auto iterations = loop->mutable_attr()->find("parallel_iterations");
+  if (iterations_b != nullptr && iterations != loop->mutable_attr()->end()) {
+    iterations->second.set_i(
+        std::min(iterations->second.i(), iterations_b->i()));
+  }
+  (*loop->mutable_attr())["cond"].mutable_func()->set_name(
+      cond.signature().name());
+  (*loop->mutable_attr())["body"].mutable_func()->set_name(
+      body.signature().name());
+  AddFunction(cond, flib, graph);
+  AddFunction(body, flib, graph);
+
+  // The outputs of `b` are now the last outputs of `a`.
+  const string name_b = b.node->name();
+  for (NodeDef& node : *graph->mutable_node()) {
+    if (node.name() == name_b) continue;
+    for (int i = 0; i < node.input_size(); ++i) {
+      int position;
+      if (ParseNodeName(node.input(i), &position) != name_b) continue;
+      node.set_input(i, position < 0
+                            ? AsControlDependency(loop->name())
+                            : StrCat(loop->name(), ":", num_vars_a + position));
+    }
+  }
+  EraseNodesFromGraph(std::set<string>{name_b}, graph);
+}
+
+// Fuses independent functional While loops that run the same number of
+// iterations, which removes the per-iteration overhead of all but one of
+// them.
+Status FuseAllLoops(const std::unordered_set<string>& nodes_to_preserve,
+                    GraphDef* graph) {
+  FunctionLibraryDefinition flib(OpRegistry::Global(), graph->library());
+  bool fused = true;
+  while (fused) {
+    fused = false;
+    NodeMap node_map(graph);
+    std::vector<FusionCandidate> candidates;
+    for (NodeDef& node : *graph->mutable_node()) {
+      FusionCandidate candidate;
+      if (!IsWhile(node) ||
+          !GetLoopFunctions(node, flib, &candidate.cond, &candidate.body)) {
+        continue;
+      }
+      candidate.node = &node;
+      candidate.trip_count_fingerprint = TripCountFingerprint(
+          *candidate.cond, *candidate.body, &candidate.trip_vars);
+      if (candidate.trip_count_fingerprint.empty()) continue;
+      candidate.is_stateless = IsStatelessFunction(*candidate.cond) &&
+                               IsStatelessFunction(*candidate.body);
+      candidates.push_back(std::move(candidate));
+    }
+    const int num_candidates = candidates.size();
+    for (int i = 0; i < num_candidates && !fused; ++i) {
+      for (int j = i + 1; j < num_candidates && !fused; ++j) {
+        if (CanFuseLoops(candidates[i], candidates[j], nodes_to_preserve,
+                         node_map)) {
+          FuseLoops(candidates[i], candidates[j], &flib, graph);
+          fused = true;
+        }
+      }
+    }
+  }
+  return Status::OK();
+}
+
 }  // namespace
 
 LoopOptimizer::LoopOptimizer()
@@ -734,7 +1533,9 @@ Status LoopOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
                                GraphDef* optimized_graph) {
   if (!options_.enable_loop_invariant_node_motion &&
       !options_.enable_stack_push_removal &&
-      !options_.enable_dead_branch_removal) {
+      !options_.enable_dead_branch_removal &&
+      !options_.enable_while_loop_invariant_node_motion &&
+      !options_.enable_while_loop_fusion) {
     return errors::Aborted("Nothing to do.");
   }
   *optimized_graph = item.graph;
@@ -757,6 +1558,12 @@ Status LoopOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
     TF_RETURN_IF_ERROR(RemoveDeadBranches(item.NodesToPreserve(), node_map,
                                           feed_nodes, optimized_graph));
   }
+  if (options_.enable_while_loop_invariant_node_motion) {
+    TF_RETURN_IF_ERROR(HoistAllLoopInvariants(optimized_graph));
+  }
+  if (options_.enable_while_loop_fusion) {
+    TF_RETURN_IF_ERROR(FuseAllLoops(item.NodesToPreserve(), optimized_graph));
+  }
 
   return Status::OK();
 }
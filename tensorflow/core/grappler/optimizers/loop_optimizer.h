@@ -40,7 +40,11 @@ class LoopOptimizer : public GraphOptimizer {
 
   string name() const override { return "loop_optimizer"; };
 
-  bool UsesFunctionLibrary() const override { return false; }
+  // Functional While loops are rewritten along with their functions.
+  bool UsesFunctionLibrary() const override {
+    return options_.enable_while_loop_invariant_node_motion ||
+           options_.enable_while_loop_fusion;
+  }
 
   Status Optimize(Cluster* cluster, const GrapplerItem& item,
                   GraphDef* optimized_graph) override;
@@ -56,6 +60,12 @@ class LoopOptimizer : public GraphOptimizer {
     bool enable_loop_invariant_node_motion = false;
     bool enable_stack_push_removal = true;
     bool enable_dead_branch_removal = true;
+    // Hoists loop invariant computations out of the bodies of functional
+    // While loops.
+    bool enable_while_loop_invariant_node_motion = false;
+    // Fuses independent functional While loops that run the same number of
+    // iterations.
+    bool enable_while_loop_fusion = false;
 
     static LoopOptimizerOptions Default(RewriterConfig::Toggle opt_level) {
       LoopOptimizerOptions options;
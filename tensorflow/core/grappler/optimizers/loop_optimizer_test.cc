@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/loop_optimizer.h"
 
 #include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/function_testlib.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/grappler/grappler_item.h"
@@ -64,6 +65,8 @@ class LoopOptimizerTest : public GrapplerTest {
     LoopOptimizer::LoopOptimizerOptions options;
     options.enable_loop_invariant_node_motion = false;
     options.enable_stack_push_removal = false;
+    options.enable_while_loop_invariant_node_motion = false;
+    options.enable_while_loop_fusion = false;
     optimizer->options_ = options;
   }
 
@@ -76,6 +79,18 @@ class LoopOptimizerTest : public GrapplerTest {
     DisableAllStages(optimizer);
     optimizer->options_.enable_stack_push_removal = true;
   }
+
+  void EnableOnlyWhileLoopInvariantNodeMotion(LoopOptimizer* optimizer) {
+    DisableAllStages(optimizer);
+    optimizer->options_.enable_dead_branch_removal = false;
+    optimizer->options_.enable_while_loop_invariant_node_motion = true;
+  }
+
+  void EnableOnlyWhileLoopFusion(LoopOptimizer* optimizer) {
+    DisableAllStages(optimizer);
+    optimizer->options_.enable_dead_branch_removal = false;
+    optimizer->options_.enable_while_loop_fusion = true;
+  }
 };
 
 TEST_F(LoopOptimizerTest, Basic) {
@@ -1706,5 +1721,221 @@ versions {
   EXPECT_TRUE(found);
 }
 
+namespace {
+
+using test::function::NDef;
+
+// Returns a condition that runs 10 iterations, counted by its first argument.
+FunctionDef LoopCond(const string& name) {
+  return FunctionDefHelper::Create(
+      name, {"i: int32", "x: float", "c: float"}, {"pred: bool"}, {},
+      {{{"limit"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<int32>(10)}, {"dtype", DT_INT32}}},
+       {{"less"}, "Less", {"i", "limit:output:0"}, {{"T", DT_INT32}}}},
+      {{"pred", "less:z:0"}});
+}
+
+// Returns a body that updates `x` with `op`(x, c * c).
+FunctionDef LoopBody(const string& name, const string& op) {
+  return FunctionDefHelper::Create(
+      name, {"i: int32", "x: float", "c: float"},
+      {"i_out: int32", "x_out: float", "c_out: float"}, {},
+      {{{"one"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<int32>(1)}, {"dtype", DT_INT32}}},
+       {{"next_i"}, "Add", {"i", "one:output:0"}, {{"T", DT_INT32}}},
+       {{"scale"}, "Mul", {"c", "c"}, {{"T", DT_FLOAT}}},
+       {{"next_x"}, op, {"x", "scale:z:0"}, {{"T", DT_FLOAT}}}},
+      {{"i_out", "next_i:z:0"}, {"x_out", "next_x:z:0"}, {"c_out", "c"}});
+}
+
+NodeDef LoopNode(const string& name, const std::vector<string>& inputs,
+                 const string& cond, const string& body) {
+  return NDef(name, "StatelessWhile", inputs,
+              {{"T", DataTypeSlice{DT_INT32, DT_FLOAT, DT_FLOAT}},
+               {"cond", FunctionDefHelper::FunctionRef(cond)},
+               {"body", FunctionDefHelper::FunctionRef(body)}});
+}
+
+const FunctionDef* FindFunction(const GraphDef& graph, const string& name) {
+  for (const FunctionDef& func : graph.library().function()) {
+    if (func.signature().name() == name) return &func;
+  }
+  return nullptr;
+}
+
+const NodeDef* FindNode(const GraphDef& graph, const string& name) {
+  for (const NodeDef& node : graph.node()) {
+    if (node.name() == name) return &node;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+TEST_F(LoopOptimizerTest, HoistWhileLoopInvariants) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("i", "Const", {},
+            {{"value", test::AsScalar<int32>(0)}, {"dtype", DT_INT32}}),
+       NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("c", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       LoopNode("loop", {"i", "x", "c"}, "Cond", "Body"),
+       NDef("y", "Identity", {"loop:1"}, {{"T", DT_FLOAT}})},
+      {LoopCond("Cond"), LoopBody("Body", "Mul")});
+  item.fetch = {"y"};
+
+  LoopOptimizer optimizer;
+  EnableOnlyWhileLoopInvariantNodeMotion(&optimizer);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // c * c is computed once, before the loop.
+  const NodeDef* scale = FindNode(output, "loop/hoisted/scale");
+  ASSERT_NE(scale, nullptr);
+  EXPECT_EQ("Mul", scale->op());
+  ASSERT_EQ(2, scale->input_size());
+  EXPECT_EQ("c", scale->input(0));
+  EXPECT_EQ("c", scale->input(1));
+  EXPECT_EQ(nullptr, FindNode(output, "loop/hoisted/one"));
+
+  const NodeDef* loop = FindNode(output, "loop");
+  ASSERT_NE(loop, nullptr);
+  ASSERT_EQ(4, loop->input_size());
+  EXPECT_EQ("loop/hoisted/scale", loop->input(3));
+  EXPECT_EQ(4, loop->attr().at("T").list().type_size());
+
+  const FunctionDef* body =
+      FindFunction(output, loop->attr().at("body").func().name());
+  ASSERT_NE(body, nullptr);
+  EXPECT_EQ(4, body->signature().input_arg_size());
+  for (const NodeDef& node : body->node_def()) {
+    EXPECT_NE("scale", node.name());
+    if (node.name() == "next_x") EXPECT_EQ("hoisted", node.input(1));
+  }
+  const FunctionDef* cond =
+      FindFunction(output, loop->attr().at("cond").func().name());
+  ASSERT_NE(cond, nullptr);
+  EXPECT_EQ(4, cond->signature().input_arg_size());
+
+  const std::vector<std::pair<string, Tensor>> feed = {
+      {"x", test::AsScalar<float>(1.0f)}, {"c", test::AsScalar<float>(1.1f)}};
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, feed);
+  auto tensors = EvaluateNodes(output, item.fetch, feed);
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
+TEST_F(LoopOptimizerTest, DontHoistWhileLoopInvariantsThatCanFail) {
+  // CheckNumerics can fail, and c + d fails if the shapes don't broadcast,
+  // which must not happen if the loop runs no iteration.
+  FunctionDef body = FunctionDefHelper::Create(
+      "Body", {"i: int32", "x: float", "c: float"},
+      {"i_out: int32", "x_out: float", "c_out: float"}, {},
+      {{{"one"},
+        "Const",
+        {},
+        {{"value", test::AsScalar<int32>(1)}, {"dtype", DT_INT32}}},
+       {{"next_i"}, "Add", {"i", "one:output:0"}, {{"T", DT_INT32}}},
+       {{"checked"},
+        "CheckNumerics",
+        {"c"},
+        {{"T", DT_FLOAT}, {"message", "c"}}},
+       {{"next_x"}, "Add", {"x", "checked:output:0"}, {{"T", DT_FLOAT}}}},
+      {{"i_out", "next_i:z:0"}, {"x_out", "next_x:z:0"}, {"c_out", "c"}});
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("i", "Const", {},
+            {{"value", test::AsScalar<int32>(0)}, {"dtype", DT_INT32}}),
+       NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("c", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       LoopNode("loop", {"i", "x", "c"}, "Cond", "Body"),
+       NDef("y", "Identity", {"loop:1"}, {{"T", DT_FLOAT}})},
+      {LoopCond("Cond"), body});
+  item.fetch = {"y"};
+
+  LoopOptimizer optimizer;
+  EnableOnlyWhileLoopInvariantNodeMotion(&optimizer);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(nullptr, FindNode(output, "loop/hoisted/checked"));
+  const NodeDef* loop = FindNode(output, "loop");
+  ASSERT_NE(loop, nullptr);
+  EXPECT_EQ(3, loop->input_size());
+}
+
+TEST_F(LoopOptimizerTest, WhileLoopStagesAreOffByDefault) {
+  LoopOptimizer optimizer;
+  EXPECT_FALSE(optimizer.UsesFunctionLibrary());
+  EnableOnlyWhileLoopFusion(&optimizer);
+  EXPECT_TRUE(optimizer.UsesFunctionLibrary());
+}
+
+TEST_F(LoopOptimizerTest, FuseWhileLoops) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("i", "Const", {},
+            {{"value", test::AsScalar<int32>(0)}, {"dtype", DT_INT32}}),
+       NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("c", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       LoopNode("loop0", {"i", "x", "c"}, "Cond", "MulBody"),
+       LoopNode("loop1", {"i", "x", "c"}, "Cond", "AddBody"),
+       NDef("y0", "Identity", {"loop0:1"}, {{"T", DT_FLOAT}}),
+       NDef("y1", "Identity", {"loop1:1"}, {{"T", DT_FLOAT}})},
+      {LoopCond("Cond"), LoopBody("MulBody", "Mul"),
+       LoopBody("AddBody", "Add")});
+  item.fetch = {"y0", "y1"};
+
+  LoopOptimizer optimizer;
+  EnableOnlyWhileLoopFusion(&optimizer);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(nullptr, FindNode(output, "loop1"));
+  const NodeDef* loop = FindNode(output, "loop0");
+  ASSERT_NE(loop, nullptr);
+  EXPECT_EQ("StatelessWhile", loop->op());
+  EXPECT_EQ(6, loop->input_size());
+  EXPECT_EQ(6, loop->attr().at("T").list().type_size());
+  const NodeDef* y1 = FindNode(output, "y1");
+  ASSERT_NE(y1, nullptr);
+  EXPECT_EQ("loop0:4", y1->input(0));
+
+  const std::vector<std::pair<string, Tensor>> feed = {
+      {"x", test::AsScalar<float>(1.0f)}, {"c", test::AsScalar<float>(1.1f)}};
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, feed);
+  auto tensors = EvaluateNodes(output, item.fetch, feed);
+  ASSERT_EQ(2, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+  test::ExpectTensorNear<float>(tensors_expected[1], tensors[1], 1e-6);
+}
+
+TEST_F(LoopOptimizerTest, DontFuseDependentWhileLoops) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("i", "Const", {},
+            {{"value", test::AsScalar<int32>(0)}, {"dtype", DT_INT32}}),
+       NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       NDef("c", "Placeholder", {}, {{"dtype", DT_FLOAT}}),
+       LoopNode("loop0", {"i", "x", "c"}, "Cond", "MulBody"),
+       LoopNode("loop1", {"i", "loop0:1", "c"}, "Cond", "AddBody"),
+       NDef("y", "Identity", {"loop1:1"}, {{"T", DT_FLOAT}})},
+      {LoopCond("Cond"), LoopBody("MulBody", "Mul"),
+       LoopBody("AddBody", "Add")});
+  item.fetch = {"y"};
+
+  LoopOptimizer optimizer;
+  EnableOnlyWhileLoopFusion(&optimizer);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_NE(nullptr, FindNode(output, "loop0"));
+  EXPECT_NE(nullptr, FindNode(output, "loop1"));
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
@@ -440,9 +440,36 @@ void RecomputeSubgraph(
   }
 }
 
-void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
-                                const string& recomputation_targets_name_scope,
-                                GraphDef* graph, const GrapplerItem& item) {
+// Returns a predicate matching the nodes whose inputs we may want to
+// recompute. This matches node names that contain
+// recomputation_targets_name_scope as a name scope, meaning it either begins
+// with or contains the name scope. Defaults to "gradients/" which will match
+// any node names that begins with "gradients/" or contains "/gradients/".
+std::function<bool(const NodeDef&)> RecomputationTargets(
+    const string& recomputation_targets_name_scope) {
+  return [recomputation_targets_name_scope](const NodeDef& node) {
+    return node.name().find(recomputation_targets_name_scope) == 0 ||
+           node.name().find("/" + recomputation_targets_name_scope) != -1;
+  };
+}
+
+// Returns the names of the nodes which are fed. These are never recomputed,
+// since the recomputed node would not take on the fed value (i.e. gradients
+// would be incorrect).
+std::unordered_set<string> FedNodes(const GrapplerItem& item) {
+  std::unordered_set<string> feeds;
+  for (const auto& feed : item.feed) {
+    feeds.insert(NodeName(feed.first));
+  }
+  return feeds;
+}
+
+// Duplicates the groups of nodes selected by `should_recompute` that feed
+// target nodes, so that the targets read recomputed values instead of keeping
+// the original ones alive. Returns the number of recomputed subgraphs.
+int RecomputeNodes(const std::function<bool(const NodeDef&)>& should_recompute,
+                   const std::function<bool(const NodeDef&)>& is_target,
+                   GraphDef* graph) {
   // The topological numberings and NodeMap will be stale as soon as we start
   // modifying the graph in RecomputeSubgraph. However, RecomputeSubgraph only
   // looks up nodes which were in the original graph, and preserves the graph
@@ -452,23 +479,30 @@ void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
   // start collecting those.
   TF_CHECK_OK(TopologicalSort(graph));
   NodeMap node_map(graph);
-  std::vector<RecomputedSubGraph> recomputed_subgraphs;
-  // Do not recompute nodes which are fed, since the recomputed node would not
-  // take on the fed value (i.e. gradients would be incorrect).
-  std::unordered_set<string> feeds;
-  for (const auto& feed : item.feed) {
-    feeds.insert(NodeName(feed.first));
+  std::vector<RecomputedSubGraph> recomputed_subgraphs =
+      GetOpGroupsToRecompute(graph, node_map, should_recompute, is_target);
+  if (!recomputed_subgraphs.empty()) {
+    std::unordered_map<const NodeDef*, int> topological_numbering;
+    for (int node_number = 0; node_number < graph->node().size();
+         ++node_number) {
+      topological_numbering[graph->mutable_node(node_number)] =
+          graph->node().size() - node_number - 1;
+    }
+    // Duplicate the indicated sub-graphs and set up control dependencies
+    for (const RecomputedSubGraph& subgraph : recomputed_subgraphs) {
+      RecomputeSubgraph(subgraph.recomputed_source_nodes, subgraph.target_nodes,
+                        node_map, topological_numbering, graph);
+    }
   }
+  return recomputed_subgraphs.size();
+}
+
+void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
+                                const string& recomputation_targets_name_scope,
+                                GraphDef* graph, const GrapplerItem& item) {
+  const std::unordered_set<string> feeds = FedNodes(item);
   std::function<bool(const NodeDef&)> is_target =
-      [&recomputation_targets_name_scope](const NodeDef& node) {
-        // Nodes whose inputs we may want to recompute. This matches node names
-        // that contain recomputation_targets_name_scope as a name scope,
-        // meaning it either begins with or contains the name scope.
-        // Defaults to "gradients/" which will match any node names that begins
-        // with "gradients/" or contains "/gradients/".
-        return node.name().find(recomputation_targets_name_scope) == 0 ||
-               node.name().find("/" + recomputation_targets_name_scope) != -1;
-      };
+      RecomputationTargets(recomputation_targets_name_scope);
 
   if (optimization_level == RewriterConfig::RECOMPUTATION_HEURISTICS ||
       optimization_level == RewriterConfig::HEURISTICS) {
@@ -478,36 +512,274 @@ void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
     // separated by identity ops).
     std::unordered_set<string> cheap_to_recompute_ops =
         GetCheapToRecomputeOps();
-    recomputed_subgraphs = GetOpGroupsToRecompute(
-        graph, node_map,
+    RecomputeNodes(
         [&cheap_to_recompute_ops, &feeds, &is_target](const NodeDef& node) {
           return !is_target(node) && feeds.count(node.name()) == 0 &&
                  (cheap_to_recompute_ops.count(node.op()) > 0 ||
                   node.attr().count(kRecomputeHint) > 0);
         },
-        is_target);
+        is_target, graph);
   } else if (optimization_level == RewriterConfig::MANUAL) {
-    recomputed_subgraphs = GetOpGroupsToRecompute(
-        graph, node_map,
+    RecomputeNodes(
         [&feeds, &is_target](const NodeDef& node) {
           return !is_target(node) && feeds.count(node.name()) == 0 &&
                  node.attr().count(kRecomputeHint) > 0;
         },
-        is_target);
+        is_target, graph);
   }
-  if (!recomputed_subgraphs.empty()) {
-    std::unordered_map<const NodeDef*, int> topological_numbering;
-    for (int node_number = 0; node_number < graph->node().size();
-         ++node_number) {
-      topological_numbering[graph->mutable_node(node_number)] =
-          graph->node().size() - node_number - 1;
+}
+
+// Returns the total number of bytes by which the simulated peak memory usage
+// of the devices exceeds `budget_bytes` (the memory size of each device if 0).
+// If `live_at_peak` isn't null, records the size of the tensors that are live
+// at the peak of these devices, keyed by tensor name.
+int64 BytesOverBudget(
+    const GraphMemory& memory,
+    const std::unordered_map<string, DeviceProperties>& devices,
+    int64 budget_bytes, std::unordered_map<string, int64>* live_at_peak) {
+  int64 bytes_over_budget = 0;
+  for (const auto& device : devices) {
+    const int64 budget =
+        budget_bytes > 0 ? budget_bytes : device.second.memory_size();
+    if (budget <= 0) {
+      VLOG(1) << "No memory budget for device " << device.first;
+      continue;
     }
-    // Duplicate the indicated sub-graphs and set up control dependencies
-    for (const RecomputedSubGraph& subgraph : recomputed_subgraphs) {
-      RecomputeSubgraph(subgraph.recomputed_source_nodes, subgraph.target_nodes,
-                        node_map, topological_numbering, graph);
+    const GraphMemory::MemoryUsage& mem_usage =
+        memory.GetPeakMemoryUsage(device.first);
+    if (mem_usage.used_memory <= budget) {
+      continue;
+    }
+    bytes_over_budget += mem_usage.used_memory - budget;
+    if (live_at_peak == nullptr) {
+      continue;
+    }
+    for (const auto& live_tensor : mem_usage.live_tensors) {
+      (*live_at_peak)[strings::StrCat(live_tensor.node, ":",
+                                      live_tensor.output_id)] =
+          live_tensor.memory_used;
+    }
+  }
+  return bytes_over_budget;
+}
+
+// A node whose outputs may be recomputed for the target nodes instead of being
+// kept alive until they run.
+struct RecomputationCandidate {
+  const NodeDef* node;
+  // Bytes of the outputs of the node that are live at the peak.
+  int64 bytes_freed;
+  // Simulated execution time of the node.
+  int64 cost_micros;
+  // The inputs of the node which are not live at the peak, and their size:
+  // recomputing the node keeps them alive instead.
+  std::vector<std::pair<string, int64>> extended_inputs;
+};
+
+// Recomputes activations until the simulated peak memory usage of every
+// device of the cluster fits in `budget_bytes`.
+//
+// The candidates are the side-effect free nodes whose outputs are live at the
+// peak and read by target nodes. Recomputing one frees its outputs, but keeps
+// its inputs alive until the targets run, unless they are live at the peak
+// anyway or recomputed too. Candidates are picked greedily by decreasing ratio
+// of net bytes freed to recomputation time, which approximates the optimal
+// (knapsack) choice of checkpoints, until the required savings are reached.
+// The rewritten graph is only kept if its simulated peak memory usage is lower.
+// Returns true if the graph was updated.
+bool BudgetedRecomputationPass(const string& recomputation_targets_name_scope,
+                               int64 budget_bytes, Cluster* cluster,
+                               GrapplerItem* item) {
+  const std::unordered_map<string, DeviceProperties>& devices =
+      cluster->GetDevices();
+  GraphMemory memory(*item);
+  Status s = memory.InferStatically(devices);
+  if (!s.ok()) {
+    VLOG(1) << "Failed to infer memory usage: " << s.error_message();
+    return false;
+  }
+  std::unordered_map<string, int64> live_at_peak;
+  const int64 required_savings =
+      BytesOverBudget(memory, devices, budget_bytes, &live_at_peak);
+  if (required_savings <= 0) {
+    return false;
+  }
+
+  std::unordered_map<string, int64> op_times_micros;
+  {
+    VirtualCluster vcluster(devices);
+    if (!vcluster.Provision().ok() || !vcluster.Initialize(*item).ok()) {
+      return false;
     }
+    RunMetadata metadata;
+    s = vcluster.Run(item->graph, item->feed, item->fetch, &metadata);
+    if (!s.ok() && s.code() != error::RESOURCE_EXHAUSTED) {
+      return false;
+    }
+    for (const auto& dev_stats : metadata.step_stats().dev_stats()) {
+      for (const auto& node_stats : dev_stats.node_stats()) {
+        const int64 exec_micros =
+            node_stats.op_end_rel_micros() - node_stats.op_start_rel_micros();
+        op_times_micros[node_stats.node_name()] =
+            std::max<int64>(1, exec_micros);
+      }
+    }
+  }
+
+  GraphProperties properties(*item);
+  s = properties.InferStatically(/*assume_valid_feeds=*/false);
+  if (!s.ok()) {
+    VLOG(1) << "Failed to infer shapes: " << s.error_message();
+    return false;
+  }
+
+  const std::unordered_set<string> feeds = FedNodes(*item);
+  std::function<bool(const NodeDef&)> is_target =
+      RecomputationTargets(recomputation_targets_name_scope);
+  NodeMap node_map(&item->graph);
+  std::vector<RecomputationCandidate> candidates;
+  for (const NodeDef& node : item->graph.node()) {
+    if (is_target(node) || feeds.count(node.name()) > 0 ||
+        node.input_size() == 0 || IsControlFlow(node) ||
+        !IsFreeOfSideEffect(node) ||
+        str_util::StartsWith(node.name(), kRecomputedNodePrefix)) {
+      continue;
+    }
+    bool has_target_output = false;
+    for (const NodeDef* output : node_map.GetOutputs(node.name())) {
+      if (is_target(*output)) {
+        has_target_output = true;
+        break;
+      }
+    }
+    if (!has_target_output) {
+      continue;
+    }
+    RecomputationCandidate candidate;
+    candidate.node = &node;
+    candidate.bytes_freed = 0;
+    const int num_outputs = properties.GetOutputProperties(node.name()).size();
+    for (int port = 0; port < num_outputs; ++port) {
+      auto it = live_at_peak.find(strings::StrCat(node.name(), ":", port));
+      if (it != live_at_peak.end()) {
+        candidate.bytes_freed += it->second;
+      }
+    }
+    if (candidate.bytes_freed == 0) {
+      continue;
+    }
+    auto time_it = op_times_micros.find(node.name());
+    candidate.cost_micros =
+        time_it == op_times_micros.end() ? 1 : time_it->second;
+
+    bool valid = true;
+    for (const string& input : node.input()) {
+      int port;
+      const string input_node_name = ParseNodeName(input, &port);
+      const NodeDef* input_node = node_map.GetNode(input_node_name);
+      if (input_node == nullptr || is_target(*input_node)) {
+        // Don't recompute nodes which depend on target nodes.
+        valid = false;
+        break;
+      }
+      const string tensor = strings::StrCat(input_node_name, ":", port);
+      if (port < 0 || live_at_peak.count(tensor) > 0) {
+        continue;
+      }
+      const std::vector<OpInfo::TensorProperties>& input_props =
+          properties.GetOutputProperties(input_node_name);
+      const int64 input_size =
+          port < static_cast<int>(input_props.size())
+              ? CalculateTensorSize(input_props[port])
+              : -1;
+      if (input_size < 0) {
+        // The cost of recomputing the node is unknown.
+        valid = false;
+        break;
+      }
+      candidate.extended_inputs.emplace_back(tensor, input_size);
+    }
+    if (valid) {
+      candidates.push_back(std::move(candidate));
+    }
+  }
+
+  std::unordered_set<string> nodes_to_recompute;
+  std::unordered_set<string> extended_tensors;
+  int64 savings = 0;
+  while (savings < required_savings) {
+    int best = -1;
+    int64 best_net_bytes = 0;
+    double best_score = 0;
+    for (int i = 0; i < static_cast<int>(candidates.size()); ++i) {
+      const RecomputationCandidate& candidate = candidates[i];
+      if (nodes_to_recompute.count(candidate.node->name()) > 0) {
+        continue;
+      }
+      int64 net_bytes = candidate.bytes_freed;
+      for (const auto& input : candidate.extended_inputs) {
+        // Inputs which are recomputed or already kept alive for another
+        // recomputation cost nothing more.
+        if (nodes_to_recompute.count(NodeName(input.first)) == 0 &&
+            extended_tensors.count(input.first) == 0) {
+          net_bytes -= input.second;
+        }
+      }
+      if (net_bytes <= 0) {
+        continue;
+      }
+      const double score =
+          static_cast<double>(net_bytes) / candidate.cost_micros;
+      if (best < 0 || score > best_score) {
+        best = i;
+        best_net_bytes = net_bytes;
+        best_score = score;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    const RecomputationCandidate& candidate = candidates[best];
+    VLOG(1) << "Recomputing " << candidate.node->name() << " to save "
+            << best_net_bytes << " bytes";
+    nodes_to_recompute.insert(candidate.node->name());
+    for (const auto& input : candidate.extended_inputs) {
+      extended_tensors.insert(input.first);
+    }
+    savings += best_net_bytes;
+  }
+  if (nodes_to_recompute.empty()) {
+    VLOG(1) << "No activation to recompute to save " << required_savings
+            << " bytes";
+    return false;
   }
+
+  GraphDef rewritten_graph = item->graph;
+  if (RecomputeNodes(
+          [&nodes_to_recompute](const NodeDef& node) {
+            return nodes_to_recompute.count(node.name()) > 0;
+          },
+          is_target, &rewritten_graph) == 0) {
+    return false;
+  }
+  GrapplerItem rewritten_item = item->WithGraph(std::move(rewritten_graph));
+  GraphMemory rewritten_memory(rewritten_item);
+  s = rewritten_memory.InferStatically(devices);
+  if (!s.ok()) {
+    VLOG(1) << "Failed to infer memory usage: " << s.error_message();
+    return false;
+  }
+  const int64 remaining_bytes =
+      BytesOverBudget(rewritten_memory, devices, budget_bytes, nullptr);
+  if (remaining_bytes >= required_savings) {
+    VLOG(1) << "Recomputation didn't reduce the peak memory usage";
+    return false;
+  }
+  VLOG(1) << "Recomputed " << nodes_to_recompute.size()
+          << " nodes, peak memory usage is now " << remaining_bytes
+          << " bytes over budget";
+  item->graph.Swap(&rewritten_item.graph);
+  return true;
 }
 
 bool SchedulingPass(Cluster* cluster, GrapplerItem* item) {
@@ -1390,6 +1662,21 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
                                &optimized_item.graph, item);
   }
 
+  // The budgeted recomputation pass relies on the fetches to simulate the
+  // memory usage. Each round recomputes more activations, so bound their
+  // number in case the budget can't be met.
+  if (optimization_level_ == RewriterConfig::BUDGETED_RECOMPUTATION &&
+      cluster != nullptr && !item.fetch.empty()) {
+    for (int i = 0; i < 3; ++i) {
+      GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
+      if (!BudgetedRecomputationPass(recomputation_targets_name_scope_,
+                                     memory_budget_bytes_, cluster,
+                                     &optimized_item)) {
+        break;
+      }
+    }
+  }
+
   std::unordered_set<string> skip_list;
   // Bound the number of rewrite passes to avoid long processing times on graphs
   // that simply won't fit in memory.
@@ -26,10 +26,13 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/costs/graph_memory.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/grappler_test.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/protobuf/device_properties.pb.h"
 
@@ -448,6 +451,81 @@ TEST_F(MemoryOptimizerTest, AccumulationRewrites) {
   }
 }
 
+TEST_F(MemoryOptimizerTest, BudgetedRecomputation) {
+  // A forward chain whose activations are all kept alive for backprop.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice("/cpu:0");
+  Output v = ops::Variable(s.WithOpName("v"), {64, 1024}, DT_FLOAT);
+  std::vector<Output> activations = {v};
+  for (int i = 1; i <= 4; ++i) {
+    activations.push_back(ops::Tanh(s.WithOpName(strings::StrCat("h", i)),
+                                    activations.back()));
+  }
+  Output grad = activations.back();
+  for (int i = 4; i >= 1; --i) {
+    grad = ops::Mul(s.WithOpName(strings::StrCat("gradients/g", i)), grad,
+                    activations[i]);
+  }
+  Output constant = ops::Const(
+      s.WithOpName("constant"),
+      Input::Initializer(GenerateRandomTensor<DT_FLOAT>({64, 1024})));
+  Output init = ops::Assign(s.WithOpName("init"), v, constant);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"gradients/g1"};
+  item.init_ops = {init.name()};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  GraphMemory memory(item);
+  TF_ASSERT_OK(memory.InferStatically(cluster->GetDevices()));
+  const string cpu = "/job:localhost/replica:0/task:0/cpu:0";
+  const int64 peak = memory.GetPeakMemoryUsage(cpu).used_memory;
+  ASSERT_GT(peak, 0);
+  const int64 budget = peak * 3 / 4;
+
+  MemoryOptimizer optimizer(RewriterConfig::BUDGETED_RECOMPUTATION,
+                            "gradients/", budget);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  int num_recomputed = 0;
+  int num_recomputed_inputs = 0;
+  for (const NodeDef& node : output.node()) {
+    if (str_util::StartsWith(node.name(), "Recomputed/")) {
+      EXPECT_EQ("Tanh", node.op());
+      ++num_recomputed;
+    } else if (str_util::StartsWith(node.name(), "gradients/")) {
+      for (const string& input : node.input()) {
+        if (str_util::StartsWith(input, "Recomputed/")) {
+          ++num_recomputed_inputs;
+        }
+      }
+    }
+  }
+  EXPECT_GT(num_recomputed, 0);
+  // The gradients must read the recomputed activations.
+  EXPECT_GT(num_recomputed_inputs, 0);
+
+  GrapplerItem optimized = item.WithGraph(std::move(output));
+  GraphMemory optimized_memory(optimized);
+  TF_ASSERT_OK(optimized_memory.InferStatically(cluster->GetDevices()));
+  EXPECT_LT(optimized_memory.GetPeakMemoryUsage(cpu).used_memory, peak);
+
+  // A budget that is already met leaves the graph alone.
+  MemoryOptimizer no_op_optimizer(RewriterConfig::BUDGETED_RECOMPUTATION,
+                                  "gradients/", 2 * peak);
+  GraphDef unchanged;
+  TF_EXPECT_OK(no_op_optimizer.Optimize(cluster.get(), item, &unchanged));
+  EXPECT_EQ(item.graph.node_size(), unchanged.node_size());
+
+  // The recomputed graph computes the same gradients.
+  auto tensors_expected = EvaluateFetchNodes(item);
+  ASSERT_EQ(1, tensors_expected.size());
+  auto tensors = EvaluateFetchNodes(optimized);
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
 class RelaxAllocatorConstraintsTest : public GrapplerTest {};
 
 TEST_F(RelaxAllocatorConstraintsTest, SameDevice) {
@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/graph_constructor.h"
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/optimizers/arithmetic_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/auto_mixed_precision.h"
 #include "tensorflow/core/grappler/optimizers/auto_parallel.h"
@@ -33,6 +34,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/dependency_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/function_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/generic_layout_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/graph_optimization_cache.h"
 #include "tensorflow/core/grappler/optimizers/implementation_selector.h"
 #include "tensorflow/core/grappler/optimizers/loop_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/memory_optimizer.h"
@@ -47,9 +49,13 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/topological_sort.h"
 #include "tensorflow/core/grappler/utils/tpu.h"
 #include "tensorflow/core/grappler/verifiers/structure_verifier.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/util/dump_graph.h"
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/ptr_util.h"
 #include "tensorflow/core/util/xla_config_registry.h"
 
@@ -60,6 +66,8 @@ namespace {
 
 constexpr int kDefaultNumberOfIterations = 2;
 constexpr int kDefaultMinGraphNodes = 4;
+// Smaller graphs are optimized faster than they are loaded from the cache.
+constexpr int kMinCachedGraphNodes = 1000;
 
 int64 NumEdges(const GraphDef& graph) {
   int64 num_edges = 0;
@@ -82,10 +90,27 @@ int NumIterations(const RewriterConfig& cfg) {
              : cfg.meta_optimizer_iterations();
 }
 
+// Returns true if the optimizers share the shapes of the graph, so that they
+// only infer the shapes of the nodes changed since the last inference. This
+// keeps a copy of the graph and the state of shape inference alive while the
+// graph is optimized, which only pays off over several iterations.
+bool ShareGraphProperties(const RewriterConfig& cfg) {
+  if (NumIterations(cfg) < 2) return false;
+  bool incremental;
+  Status s = ReadBoolFromEnvVar("TF_GRAPPLER_INCREMENTAL_SHAPE_INFERENCE",
+                                /*default_val=*/true, &incremental);
+  if (!s.ok()) {
+    LOG(WARNING) << "Inferring shapes from scratch in every optimizer: " << s;
+    return false;
+  }
+  return incremental;
+}
+
 // Check if optimizer is allowed to run only once.
 bool IsRunOnceOptimizer(const string& name) {
   return name == "layout" || name == "memory_optimizer" ||
-         name == "loop_optimizer" || name == "auto_mixed_precision";
+         name == "loop_optimizer" || name == "auto_mixed_precision" ||
+         name == "auto_mixed_precision_cpu";
 }
 
 // Creates a function library stub from a real function library: copy only
@@ -181,6 +206,9 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
   MK_OPT("layout", new GenericLayoutOptimizer());
   MK_OPT("auto_mixed_precision",
          new AutoMixedPrecision(cfg_.auto_mixed_precision()));
+  MK_OPT("auto_mixed_precision_cpu",
+         new AutoMixedPrecision(cfg_.auto_mixed_precision_cpu(),
+                                AutoMixedPrecisionMode::CPU));
   MK_OPT("memory", new MemoryOptimizer(RewriterConfig::MANUAL));
   MK_OPT("arithmetic", new ArithmeticOptimizer(cfg_.arithmetic_optimization()));
   MK_OPT("autoparallel", new AutoParallel(cfg_.auto_parallel().num_replicas()));
@@ -236,6 +264,10 @@ Status MetaOptimizer::InitializeOptimizers(
     optimizers->push_back(
         MakeUnique<AutoMixedPrecision>(cfg_.auto_mixed_precision()));
   }
+  if (AutoMixedPrecisionEnabled(cfg_.auto_mixed_precision_cpu())) {
+    optimizers->push_back(MakeUnique<AutoMixedPrecision>(
+        cfg_.auto_mixed_precision_cpu(), AutoMixedPrecisionMode::CPU));
+  }
   if (cfg_.pin_to_host_optimization() == RewriterConfig::ON) {
     optimizers->push_back(MakeUnique<PinToHostOptimizer>());
   }
@@ -261,13 +293,15 @@ Status MetaOptimizer::InitializeOptimizers(
       config_proto_.graph_options().optimizer_options().global_jit_level();
   if (MemoryOptimizerEnabled(cfg_.memory_optimization(), global_jit_level)) {
     if (cfg_.memory_optimizer_target_node_name_scope().empty()) {
-      optimizers->push_back(
+      optimizers->push_back(MakeUnique<MemoryOptimizer>(
           // Use the default target node name prefix "gradients/"
-          MakeUnique<MemoryOptimizer>(cfg_.memory_optimization()));
+          cfg_.memory_optimization(), "gradients/",
+          cfg_.memory_optimizer_budget_bytes()));
     } else {
       optimizers->push_back(MakeUnique<MemoryOptimizer>(
           cfg_.memory_optimization(),
-          cfg_.memory_optimizer_target_node_name_scope()));
+          cfg_.memory_optimizer_target_node_name_scope(),
+          cfg_.memory_optimizer_budget_bytes()));
     }
   }
   if (cfg_.auto_parallel().enable()) {
@@ -368,6 +402,22 @@ void MetaOptimizer::InitializeVerifiers(
   }
 }
 
+int MetaOptimizer::NumFunctionOptimizationThreads() const {
+  // Custom optimizers aren't required to be thread-safe.
+  if (!cfg_.custom_optimizers().empty()) return 1;
+  for (const string& optimizer_name : cfg_.optimizers()) {
+    if (MakeNewOptimizer(optimizer_name) == nullptr) return 1;
+  }
+  int64 num_threads;
+  Status s = ReadInt64FromEnvVar("TF_GRAPPLER_FUNCTION_OPTIMIZATION_THREADS",
+                                 port::NumSchedulableCPUs(), &num_threads);
+  if (!s.ok()) {
+    LOG(WARNING) << "Optimizing functions on a single thread: " << s;
+    return 1;
+  }
+  return std::max<int64>(1, num_threads);
+}
+
 Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
                                     GraphDef* optimized_graph) {
   int min_graph_nodes = cfg_.min_graph_nodes() == 0 ? kDefaultMinGraphNodes
@@ -418,6 +468,14 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
   GrapplerItem optimized_item = item;
   optimized_graph->Swap(&optimized_item.graph);
 
+  std::unique_ptr<IncrementalGraphProperties> shared_graph_properties;
+  if (ShareGraphProperties(cfg_)) {
+    shared_graph_properties = MakeUnique<IncrementalGraphProperties>(item);
+  }
+  for (const auto& optimizer : optimizers) {
+    optimizer->set_shared_graph_properties(shared_graph_properties.get());
+  }
+
   GraphOptimizationResult optimization_result(item.id);
   GraphOptimizer* fusion_optimizer = nullptr;
   GraphOptimizer* sa_optimizer = nullptr;
@@ -516,7 +574,10 @@ Status MetaOptimizer::OptimizeGraph(Cluster* cluster, const GrapplerItem& item,
                                    }) != optimization_result.results.end();
 
   // Record graph optimization result.
-  optimization_results_.push_back(optimization_result);
+  {
+    mutex_lock l(optimization_results_mu_);
+    optimization_results_.push_back(optimization_result);
+  }
 
   if (is_optimized) {
     TF_RETURN_IF_ERROR(TopologicalSort(optimized_graph));
@@ -598,7 +659,23 @@ Status MetaOptimizer::RunOptimizer(
 Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
                                GraphDef* optimized_graph) {
   VLOG(1) << "Starting optimization for grappler item: " << item.id;
-  optimization_results_.clear();
+  {
+    mutex_lock l(optimization_results_mu_);
+    optimization_results_.clear();
+  }
+
+  GraphOptimizationCache* cache = item.graph.node_size() >= kMinCachedGraphNodes
+                                      ? GraphOptimizationCache::Global()
+                                      : nullptr;
+  string cache_key;
+  if (cache != nullptr) {
+    cache_key =
+        GraphOptimizationCache::ComputeKey(item, config_proto_, cluster);
+    if (cache->Lookup(cache_key, optimized_graph)) {
+      VLOG(1) << "Loaded optimized graph from the cache: key=" << cache_key;
+      return Status::OK();
+    }
+  }
 
   // Constructs a FunctionLibraryDefinition with functions that are reachable
   // from the nodes of the graph.
@@ -682,14 +759,97 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   absl::flat_hash_set<string> optimized_funcs;
   bool optimize_function_library =
       item.optimization_options().optimize_function_library;
+  const bool is_tpu_graph = IsTPUGraphDef(*optimized_graph);
+  const int num_threads = NumFunctionOptimizationThreads();
+
+  // Optimizes the body of `func` into `func_item`. Only reads `flib`, so that
+  // functions can be optimized concurrently.
+  const auto optimize_function =
+      [&](const FunctionDef& func, GrapplerFunctionItem* func_item) -> Status {
+    GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
+    const string& func_name = func.signature().name();
+
+    // Make a GrapplerItem from a FunctionDef.
+    TF_RETURN_IF_ERROR(MakeGrapplerFunctionItem(
+        func, flib, trimmed_item.graph.versions().producer(), func_item));
+
+    // If we need to compute the gradient of optimized function at runtime, we
+    // can't perform non-differentiable rewrites.
+    func_item->optimization_options().allow_non_differentiable_rewrites =
+        !differentiable_functions.contains(func_name);
+
+    // Device set available to the function is defined only by the runtime,
+    // when we instantiate and execute the function. We can't use all devices
+    // available to the main graph, because after partitioning the function
+    // call node might execute on a remote worker.
+    if (!func_item->devices().empty()) {
+      return errors::Internal("GrapplerFunctionItem devices must be empty.");
+    }
+
+    // We are not allowed to prune certain types of ops from the graph
+    // instantiated by the function definition, because we must guarantee
+    // function execution semantics wrt side effects (see
+    // function_optimizer.cc).
+    func_item->optimization_options().allow_pruning_stateful_and_dataset_ops =
+        false;
+
+    // TODO(b/129545186): Shape inference in GraphProperties doesn't work well
+    // with _Arg nodes. Replace them with Placeholders with unknown shape.
+    absl::flat_hash_set<absl::string_view> input_nodes;
+    for (auto& input_arg : func_item->inputs()) {
+      input_nodes.insert(input_arg.node_name);
+    }
+    for (NodeDef& func_node : *func_item->graph.mutable_node()) {
+      if (input_nodes.contains(func_node.name())) {
+        func_node.set_op("Placeholder");
+        auto& attrs = *func_node.mutable_attr();
+        attrs["dtype"] = attrs["T"];
+        attrs.erase("index");
+        attrs.erase("T");
+        TensorShapeProto unknown_shape;
+        unknown_shape.set_unknown_rank(true);
+        *(attrs["shape"].mutable_shape()) = unknown_shape;
+      }
+    }
+
+    // Optimize function body graph.
+    GraphDef optimized_func_graph;
+    if (is_tpu_graph) {
+      // Skip optimizing functions if this is a TPU graph. Currently, Grappler
+      // passes do not handle TPU functions correctly in a variety of ways
+      // (Note that due to the pre-placement TPU graph rewriting passes, the
+      // TPU-related ops are encapsulated away into functions). For example,
+      // TPU graphs contain TPUReplicateMetadata node that carries relevant
+      // TPU metadata and Grappler passes could prune that away. Grappler
+      // passes could also cause issues around shape inference. Since the
+      // desired and existing behavior is to not optimize TPU functions with
+      // Grappler, this check preserves that. The only execption is
+      // implementation selector what is required to swap in some TPU specific
+      // lowering code and is verified the work correctly on TPUs.
+      ImplementationSelector implementation_selector;
+
+      // Implementation selector needs to have access to valid function
+      // signature and attributes, and it doesn't need actual function body.
+      FunctionDefLibrary func_item_function_library;
+      func_item_function_library.Swap(func_item->graph.mutable_library());
+      *func_item->graph.mutable_library() =
+          GetFunctionDefLibraryStub(func_item_function_library);
+
+      TF_RETURN_IF_ERROR(implementation_selector.Optimize(
+          cluster, *func_item, &optimized_func_graph));
+    } else {
+      TF_RETURN_IF_ERROR(
+          OptimizeGraph(cluster, *func_item, &optimized_func_graph));
+    }
+    func_item->SwapFunctionBody(std::move(optimized_func_graph));
+    return Status::OK();
+  };
 
   while (optimize_function_library) {
     optimize_function_library = false;
 
-    int function_idx = 0;
+    std::vector<const FunctionDef*> funcs_to_optimize;
     for (const FunctionDef& func : optimized_graph->library().function()) {
-      GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
-
       const string& func_name = func.signature().name();
 
       // Skip functions that are not reachable from the optimized graph.
@@ -705,93 +865,53 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
       // the function optimizer, before we can optimize function body.
       if (IsParametrized(func)) continue;
 
-      VLOG(3) << "Optimize function: function=" << func_name << " ["
-              << function_idx++ << " of "
-              << optimized_graph->library().function_size() << "]";
-
       // Function optimization might specialize nested function calls, so we
       // have to reset the flag and do at least one more pass over the library.
       optimize_function_library = true;
       optimized_funcs.insert(func_name);
-
-      // Make a GrapplerItem from a FunctionDef.
-      GrapplerFunctionItem func_item;
-      TF_RETURN_IF_ERROR(MakeGrapplerFunctionItem(
-          func, flib, trimmed_item.graph.versions().producer(), &func_item));
-
-      // If we need to compute the gradient of optimized function at runtime, we
-      // can't perform non-differentiable rewrites.
-      func_item.optimization_options().allow_non_differentiable_rewrites =
-          !differentiable_functions.contains(func_name);
-
-      // Device set available to the function is defined only by the runtime,
-      // when we instantiate and execute the function. We can't use all devices
-      // available to the main graph, because after partitioning the function
-      // call node might execute on a remote worker.
-      if (!func_item.devices().empty()) {
-        return errors::Internal("GrapplerFunctionItem devices must be empty.");
-      }
-
-      // We are not allowed to prune certain types of ops from the graph
-      // instantiated by the function definition, because we must guarantee
-      // function execution semantics wrt side effects (see
-      // function_optimizer.cc).
-      func_item.optimization_options().allow_pruning_stateful_and_dataset_ops =
-          false;
-
-      // TODO(b/129545186): Shape inference in GraphProperties doesn't work well
-      // with _Arg nodes. Replace them with Placeholders with unknown shape.
-      absl::flat_hash_set<absl::string_view> input_nodes;
-      for (auto& input_arg : func_item.inputs()) {
-        input_nodes.insert(input_arg.node_name);
+      funcs_to_optimize.push_back(&func);
+    }
+    if (funcs_to_optimize.empty()) break;
+
+    // All the functions of a pass are optimized against the library as it was
+    // at the start of the pass, and their results are merged back in library
+    // order. The optimized library therefore doesn't depend on the number of
+    // threads, or on the order in which the functions finish.
+    const int num_funcs = funcs_to_optimize.size();
+    std::vector<GrapplerFunctionItem> func_items(num_funcs);
+    std::vector<Status> statuses(num_funcs);
+    const int pool_size = std::min(num_threads, num_funcs);
+    if (pool_size > 1) {
+      VLOG(2) << "Optimize " << num_funcs << " functions on " << pool_size
+              << " threads";
+      thread::ThreadPool pool(Env::Default(), "grappler_function_optimizer",
+                              pool_size);
+      BlockingCounter counter(num_funcs);
+      for (int i = 0; i < num_funcs; ++i) {
+        pool.Schedule([&, i]() {
+          statuses[i] =
+              optimize_function(*funcs_to_optimize[i], &func_items[i]);
+          counter.DecrementCount();
+        });
       }
-      for (NodeDef& func_node : *func_item.graph.mutable_node()) {
-        if (input_nodes.contains(func_node.name())) {
-          func_node.set_op("Placeholder");
-          auto& attrs = *func_node.mutable_attr();
-          attrs["dtype"] = attrs["T"];
-          attrs.erase("index");
-          attrs.erase("T");
-          TensorShapeProto unknown_shape;
-          unknown_shape.set_unknown_rank(true);
-          *(attrs["shape"].mutable_shape()) = unknown_shape;
-        }
+      counter.Wait();
+    } else {
+      for (int i = 0; i < num_funcs; ++i) {
+        VLOG(3) << "Optimize function: function="
+                << funcs_to_optimize[i]->signature().name() << " [" << i
+                << " of " << num_funcs << "]";
+        statuses[i] = optimize_function(*funcs_to_optimize[i], &func_items[i]);
+        if (!statuses[i].ok()) break;
       }
+    }
 
-      // Optimize function body graph.
-      GraphDef optimized_func_graph;
-      if (IsTPUGraphDef(*optimized_graph)) {
-        // Skip optimizing functions if this is a TPU graph. Currently, Grappler
-        // passes do not handle TPU functions correctly in a variety of ways
-        // (Note that due to the pre-placement TPU graph rewriting passes, the
-        // TPU-related ops are encapsulated away into functions). For example,
-        // TPU graphs contain TPUReplicateMetadata node that carries relevant
-        // TPU metadata and Grappler passes could prune that away. Grappler
-        // passes could also cause issues around shape inference. Since the
-        // desired and existing behavior is to not optimize TPU functions with
-        // Grappler, this check preserves that. The only execption is
-        // implementation selector what is required to swap in some TPU specific
-        // lowering code and is verified the work correctly on TPUs.
-        ImplementationSelector implementation_selector;
-
-        // Implementation selector needs to have access to valid function
-        // signature and attributes, and it doesn't need actual function body.
-        FunctionDefLibrary func_item_function_library;
-        func_item_function_library.Swap(func_item.graph.mutable_library());
-        *func_item.graph.mutable_library() =
-            GetFunctionDefLibraryStub(func_item_function_library);
-
-        TF_RETURN_IF_ERROR(implementation_selector.Optimize(
-            cluster, func_item, &optimized_func_graph));
-      } else {
-        TF_RETURN_IF_ERROR(
-            OptimizeGraph(cluster, func_item, &optimized_func_graph));
-      }
+    for (int i = 0; i < num_funcs; ++i) {
+      TF_RETURN_IF_ERROR(statuses[i]);
+      GrapplerFunctionItem& func_item = func_items[i];
 
       // Function body optimization might have created new specialized
       // functions for each instantiation context. Add them to the library.
-      for (const FunctionDef& func_def :
-           optimized_func_graph.library().function()) {
+      for (const FunctionDef& func_def : func_item.graph.library().function()) {
         if (flib.Find(func_def.signature().name()) == nullptr) {
           TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
         }
@@ -799,17 +919,22 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
 
       // Convert optimized graph back to FunctionDef.
       FunctionDef optimized_func;
-      func_item.SwapFunctionBody(std::move(optimized_func_graph));
       TF_RETURN_IF_ERROR(MakeFunctionDef(func_item, flib, &optimized_func));
 
       // Replace optimized function with a new FunctionDef.
-      TF_RETURN_IF_ERROR(flib.ReplaceFunction(func_name, optimized_func));
+      TF_RETURN_IF_ERROR(flib.ReplaceFunction(
+          funcs_to_optimize[i]->signature().name(), optimized_func));
     }
 
     // If optimized at least one function, update the graph library.
-    if (optimize_function_library) {
-      *optimized_graph->mutable_library() = flib.ToProto();
-    }
+    *optimized_graph->mutable_library() = flib.ToProto();
+  }
+
+  // Inlining the calls and deduping the nodes of the function bodies can make
+  // different functions identical. Their calls then share one instantiation.
+  if (!optimized_funcs.empty()) {
+    const int num_merged = MergeDuplicateFunctions(optimized_graph);
+    VLOG(1) << "Merged " << num_merged << " optimized functions";
   }
 
   VLOG(1) << "Optimized " << optimized_funcs.size()
@@ -821,10 +946,27 @@ Status MetaOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
                         reinterpret_cast<uintptr_t>(optimized_graph)),
         *optimized_graph);
   }
+
+  if (cache != nullptr) {
+    // An optimizer that ran out of time left its part of the work undone, so
+    // the result is not worth caching.
+    bool deadline_exceeded = false;
+    mutex_lock l(optimization_results_mu_);
+    for (const GraphOptimizationResult& graph_result : optimization_results_) {
+      for (const OptimizerResult& result : graph_result.results) {
+        if (errors::IsDeadlineExceeded(result.status)) deadline_exceeded = true;
+      }
+    }
+    // Failing to cache the graph is not an error.
+    Status s = deadline_exceeded ? Status::OK()
+                                 : cache->Insert(cache_key, *optimized_graph);
+    if (!s.ok()) LOG(WARNING) << "Failed to cache the optimized graph: " << s;
+  }
   return Status::OK();
 }
 
 void MetaOptimizer::PrintResult() {
+  mutex_lock l(optimization_results_mu_);
   for (const GraphOptimizationResult& graph_result : optimization_results_) {
     LOG(INFO) << "Optimization results for grappler item: " << graph_result.id;
     for (const OptimizerResult& result : graph_result.results) {
@@ -858,6 +1000,7 @@ bool MetaOptimizerEnabled(const ConfigProto& cfg) {
          rewrite_cfg.scoped_allocator_optimization() == RewriterConfig::ON ||
          rewrite_cfg.pin_to_host_optimization() == RewriterConfig::ON ||
          AutoMixedPrecisionEnabled(rewrite_cfg.auto_mixed_precision()) ||
+         AutoMixedPrecisionEnabled(rewrite_cfg.auto_mixed_precision_cpu()) ||
          !rewrite_cfg.optimizers().empty() ||
          !rewrite_cfg.custom_optimizers().empty();
 }
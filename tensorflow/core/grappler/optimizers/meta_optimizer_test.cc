@@ -31,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 
 namespace tensorflow {
@@ -1013,6 +1014,220 @@ TEST_F(MetaOptimizerTest, CompressConstants) {
   }
 }
 
+// Returns a graph that calls `num_functions` distinct functions, each of which
+// computes `x * (c0 + c1) * ... * (c0 + c1)` with constants that can be
+// folded.
+GrapplerItem MakeFunctionLibraryItem(int num_functions) {
+  using test::function::NDef;
+  constexpr int kNumMuls = 8;
+  std::vector<FunctionDef> funcs;
+  std::vector<NodeDef> nodes = {
+      NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice)};
+  for (int f = 0; f < num_functions; ++f) {
+    std::vector<FunctionDefHelper::Node> body = {
+        {{"c0"},
+         "Const",
+         {},
+         {{"value", test::AsScalar<float>(2.0f)}, {"dtype", DT_FLOAT}}},
+        {{"c1"},
+         "Const",
+         {},
+         {{"value", test::AsScalar<float>(3.0f + f)}, {"dtype", DT_FLOAT}}},
+        {{"c"}, "Add", {"c0:output:0", "c1:output:0"}, {{"T", DT_FLOAT}}}};
+    string y = "x";
+    for (int i = 0; i < kNumMuls; ++i) {
+      const string mul = strings::StrCat("mul", i);
+      body.push_back({{mul}, "Mul", {y, "c:z:0"}, {{"T", DT_FLOAT}}});
+      y = strings::StrCat(mul, ":z:0");
+    }
+    const string name = strings::StrCat("MyFunc", f);
+    FunctionDef func = FunctionDefHelper::Create(
+        name, {"x:float"}, {"y:float"}, {}, body, /*ret_def=*/{{"y", y}});
+    (*func.mutable_attr())["_noinline"].set_b(true);
+    funcs.push_back(func);
+    nodes.push_back(NDef(strings::StrCat("call", f), name, {"x"}, {}, kDevice));
+  }
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.graph = test::function::GDef(nodes, funcs);
+  return item;
+}
+
+ConfigProto FunctionLibraryConfig() {
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.set_min_graph_nodes(-1);
+  return config_proto;
+}
+
+TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryInParallel) {
+  GrapplerItem item = MakeFunctionLibraryItem(16);
+  GraphDef outputs[2];
+  for (int i = 0; i < 2; ++i) {
+    setenv("TF_GRAPPLER_FUNCTION_OPTIMIZATION_THREADS", i == 0 ? "1" : "4",
+           /*overwrite=*/1);
+    MetaOptimizer optimizer(nullptr, FunctionLibraryConfig());
+    TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &outputs[i]));
+  }
+  unsetenv("TF_GRAPPLER_FUNCTION_OPTIMIZATION_THREADS");
+
+  // Optimizing the functions concurrently gives the same library.
+  CompareGraphs(outputs[0], outputs[1]);
+  FunctionLibraryDefinition serial(OpRegistry::Global(), outputs[0].library());
+  FunctionLibraryDefinition parallel(OpRegistry::Global(),
+                                     outputs[1].library());
+  ASSERT_EQ(serial.num_functions(), parallel.num_functions());
+  for (const string& name : serial.ListFunctionNames()) {
+    const FunctionDef* func = parallel.Find(name);
+    ASSERT_NE(func, nullptr) << name;
+    EXPECT_TRUE(FunctionDefsEqual(*serial.Find(name), *func)) << name;
+  }
+
+  // The constants were folded in the function bodies.
+  const FunctionDef* func = serial.Find("MyFunc0");
+  ASSERT_NE(func, nullptr);
+  for (const NodeDef& node : func->node_def()) {
+    EXPECT_NE("Add", node.op()) << node.name();
+  }
+}
+
+TEST_F(MetaOptimizerTest, MergeFunctionsIdenticalAfterOptimization) {
+  using test::function::NDef;
+
+  // Two functions which compute sin(x)^2, and only become identical once the
+  // duplicate Sin of the first one is deduped.
+  FunctionDef func_a = FunctionDefHelper::Create(
+      "SinSquaredA", {"x:float"}, {"y:float"}, {},
+      {{{"s1"}, "Sin", {"x"}, {{"T", DT_FLOAT}}},
+       {{"s2"}, "Sin", {"x"}, {{"T", DT_FLOAT}}},
+       {{"y"}, "Mul", {"s1:y:0", "s2:y:0"}, {{"T", DT_FLOAT}}}},
+      /*ret_def=*/{{"y", "y:z:0"}});
+  (*func_a.mutable_attr())["_noinline"].set_b(true);
+  FunctionDef func_b = FunctionDefHelper::Create(
+      "SinSquaredB", {"x:float"}, {"y:float"}, {},
+      {{{"s"}, "Sin", {"x"}, {{"T", DT_FLOAT}}},
+       {{"y"}, "Mul", {"s:y:0", "s:y:0"}, {{"T", DT_FLOAT}}}},
+      /*ret_def=*/{{"y", "y:z:0"}});
+  (*func_b.mutable_attr())["_noinline"].set_b(true);
+
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.graph = test::function::GDef(
+      {NDef("x", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("y1", "SinSquaredA", {"x"}, {}, kDevice),
+       NDef("y2", "SinSquaredB", {"x"}, {}, kDevice),
+       NDef("z", "Add", {"y1", "y2"}, {{"T", DT_FLOAT}}, kDevice)},
+      {func_a, func_b});
+  item.fetch = {"z"};
+
+  MetaOptimizer optimizer(nullptr, FunctionLibraryConfig());
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // Both calls use the function with the smallest name.
+  ASSERT_EQ(1, output.library().function_size());
+  EXPECT_EQ("SinSquaredA", output.library().function(0).signature().name());
+  int count = 0;
+  for (const NodeDef& node : output.node()) {
+    if ((node.name() == "y1" || node.name() == "y2") && ++count) {
+      EXPECT_EQ("SinSquaredA", node.op());
+    }
+  }
+  EXPECT_EQ(2, count);
+
+  item.feed.emplace_back("x", test::AsScalar<float>(0.5f));
+  auto tensors_expected = EvaluateFetchNodes(item);
+  GrapplerItem optimized = item.WithGraph(std::move(output));
+  auto tensors = EvaluateFetchNodes(optimized);
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
+// Optimizing a library of `num_functions` functions on `num_threads` threads.
+static void BM_OptimizeFunctionLibrary(int iters, int num_functions,
+                                       int num_threads) {
+  testing::StopTiming();
+  GrapplerItem item = MakeFunctionLibraryItem(num_functions);
+  setenv("TF_GRAPPLER_FUNCTION_OPTIMIZATION_THREADS",
+         strings::StrCat(num_threads).c_str(), /*overwrite=*/1);
+  const ConfigProto config_proto = FunctionLibraryConfig();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    MetaOptimizer optimizer(nullptr, config_proto);
+    GraphDef output;
+    TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+  }
+  testing::StopTiming();
+  unsetenv("TF_GRAPPLER_FUNCTION_OPTIMIZATION_THREADS");
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_functions);
+}
+BENCHMARK(BM_OptimizeFunctionLibrary)
+    ->ArgPair(1000, 1)
+    ->ArgPair(1000, 4)
+    ->ArgPair(1000, 16);
+
+// Returns a graph of about `num_nodes` nodes, made of independent chains of
+// element-wise ops that the arithmetic optimizer rewrites.
+GrapplerItem MakeChainsItem(int num_nodes) {
+  constexpr int kChainLength = 10;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  GrapplerItem item;
+  item.id = "tf_graph";
+  for (int c = 0; c * (3 * kChainLength + 2) < num_nodes; ++c) {
+    Output y = ops::Placeholder(s.WithOpName(strings::StrCat("x", c)),
+                                DT_FLOAT, ops::Placeholder::Shape({-1, 16}));
+    for (int i = 0; i < kChainLength; ++i) {
+      Output a = ops::Sqrt(s, y);
+      // Rewritten into Square(a).
+      Output b = ops::Mul(s, a, a);
+      y = ops::Add(s, a, b);
+    }
+    const string out = strings::StrCat("out", c);
+    ops::Identity(s.WithOpName(out), y);
+    item.fetch.push_back(out);
+  }
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  return item;
+}
+
+TEST_F(MetaOptimizerTest, SharedGraphPropertiesGiveTheSameGraph) {
+  GrapplerItem item = MakeChainsItem(1000);
+  GraphDef outputs[2];
+  for (int i = 0; i < 2; ++i) {
+    setenv("TF_GRAPPLER_INCREMENTAL_SHAPE_INFERENCE", i == 0 ? "0" : "1",
+           /*overwrite=*/1);
+    MetaOptimizer optimizer(nullptr, ConfigProto());
+    TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &outputs[i]));
+  }
+  unsetenv("TF_GRAPPLER_INCREMENTAL_SHAPE_INFERENCE");
+  CompareGraphs(outputs[0], outputs[1]);
+}
+
+// Optimizing a graph of `num_nodes` nodes with the default optimizers, with
+// the shapes inferred from scratch by every optimizer (0) or shared between
+// them (1).
+static void BM_OptimizeLargeGraph(int iters, int num_nodes, int shared) {
+  testing::StopTiming();
+  GrapplerItem item = MakeChainsItem(num_nodes);
+  setenv("TF_GRAPPLER_INCREMENTAL_SHAPE_INFERENCE", shared ? "1" : "0",
+         /*overwrite=*/1);
+  const ConfigProto config_proto;
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    MetaOptimizer optimizer(nullptr, config_proto);
+    GraphDef output;
+    TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+  }
+  testing::StopTiming();
+  unsetenv("TF_GRAPPLER_INCREMENTAL_SHAPE_INFERENCE");
+  testing::ItemsProcessed(static_cast<int64>(iters) * item.graph.node_size());
+}
+BENCHMARK(BM_OptimizeLargeGraph)
+    ->ArgPair(100000, 0)
+    ->ArgPair(100000, 1)
+    ->ArgPair(200000, 0)
+    ->ArgPair(200000, 1);
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 
 #include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/graph_view.h"
@@ -51,6 +52,19 @@ namespace grappler {
 //   (1) FusedBatchNorm + <Activation>
 //   (2) FusedBatchNorm + SideInput + <Activation>
 //
+// SparseSegment{Sum,Mean,SqrtN} + ... -> _FusedSparseEmbeddingLookupCombine:
+//   (1) Unique + GatherV2 + <Identity> + SparseSegment{Sum,Mean,SqrtN}
+//
+// UnsortedSegmentSum + ... -> _FusedSparseEmbeddingLookupCombineGrad:
+//   (1) GatherV2 + UnsortedSegmentSum
+//
+// BatchMatMul + ... -> _FusedMultiHeadAttention:
+//   (1) BatchMatMul + <Mul> + <Add> + Softmax + BatchMatMul
+//
+// In addition, CPU {MatMul,_FusedMatMul} nodes with a Const `b` input, and CPU
+// NHWC Conv2D nodes with a Const filter, are marked with `_b_is_const`, so that
+// their kernels pack (or Winograd-transform) the weights once.
+//
 // Both Conv2D and MatMul implemented as Tensor contraction (on CPU), so all the
 // patterns are "ContractionWith...".
 namespace {
@@ -58,9 +72,16 @@ namespace {
 constexpr char kFusedConv2D[] = "_FusedConv2D";
 constexpr char kFusedMatMul[] = "_FusedMatMul";
 constexpr char kFusedBatchNormEx[] = "_FusedBatchNormEx";
+constexpr char kFusedSparseEmbeddingLookupCombine[] =
+    "_FusedSparseEmbeddingLookupCombine";
+constexpr char kFusedSparseEmbeddingLookupCombineGrad[] =
+    "_FusedSparseEmbeddingLookupCombineGrad";
+constexpr char kFusedMultiHeadAttention[] = "_FusedMultiHeadAttention";
 
 constexpr char kDataFormat[] = "data_format";
 constexpr char kIsTraining[] = "is_training";
+// Same as kMatMulConstantRhsAttr in kernels/matmul_op_packed.h.
+constexpr char kBIsConst[] = "_b_is_const";
 
 constexpr int kMissingIndex = -1;
 
@@ -160,6 +181,44 @@ struct ContractionWithBatchNormAndActivation {
   float epsilon = 0.0;
 };
 
+// SparseSegment{Sum,Mean,SqrtN} of the rows gathered with the unique ids of a
+// Unique node, as built by embedding_lookup_sparse.
+struct SparseEmbeddingLookupCombine {
+  SparseEmbeddingLookupCombine() = default;
+
+  int unique = kMissingIndex;
+  int gather = kMissingIndex;
+  int identity = kMissingIndex;  // Optional.
+  int sparse_segment_reduction = kMissingIndex;
+  // Unique node can be removed if its outputs are used only by the pattern.
+  bool remove_unique = false;
+};
+
+// UnsortedSegmentSum of gathered rows, as built by the SparseSegmentSum
+// gradient.
+struct GatherWithUnsortedSegmentSum {
+  GatherWithUnsortedSegmentSum() = default;
+  GatherWithUnsortedSegmentSum(int gather, int unsorted_segment_sum)
+      : gather(gather), unsorted_segment_sum(unsorted_segment_sum) {}
+
+  int gather = kMissingIndex;
+  int unsorted_segment_sum = kMissingIndex;
+};
+
+// Scaled dot-product attention, as built by Keras and BERT:
+//   BatchMatMul(Softmax(BatchMatMul(query, key, adj_y) * scale + mask), value)
+struct MultiHeadAttention {
+  MultiHeadAttention() = default;
+
+  int scores = kMissingIndex;
+  int scale = kMissingIndex;     // Optional.
+  int mask_add = kMissingIndex;  // Optional.
+  int mask_port = kMissingIndex;
+  int softmax = kMissingIndex;
+  int output = kMissingIndex;
+  float scale_value = 1.0;
+};
+
 #ifdef INTEL_MKL
 // Contraction node followed by a BiasAdd and Add.
 struct ContractionWithBiasAddAndAdd {
@@ -843,6 +902,322 @@ bool FindFusedBatchNormEx(const RemapperContext& ctx, int node_index,
   return false;
 }
 
+// Returns the combiner of a SparseSegment{Sum,Mean,SqrtN} node, or an empty
+// string for any other node.
+string SparseSegmentReductionCombiner(const NodeDef& node) {
+  if (node.op() == "SparseSegmentSum") return "sum";
+  if (node.op() == "SparseSegmentMean") return "mean";
+  if (node.op() == "SparseSegmentSqrtN") return "sqrtn";
+  return "";
+}
+
+// Returns true if `gather_view` is a Gather or GatherV2 that gathers whole
+// rows of its params, i.e. along axis 0 and without batch dimensions.
+bool IsGatherOfRows(const utils::MutableNodeView& gather_view) {
+  const auto* gather = gather_view.node();
+  if (!IsGather(*gather)) return false;
+  if (gather->op() == "Gather") return true;
+
+  int batch_dims = 0;
+  if (TryGetNodeAttr(*gather, "batch_dims", &batch_dims) && batch_dims != 0)
+    return false;
+
+  if (gather_view.NumRegularFanins() < 3) return false;
+  const auto* axis = gather_view.GetRegularFanin(2).node_view()->node();
+  Tensor axis_value;
+  if (!IsConstant(*axis) || !GetNodeAttr(*axis, "value", &axis_value).ok() ||
+      axis_value.NumElements() != 1)
+    return false;
+  if (axis_value.dtype() == DT_INT32) {
+    return axis_value.flat<int32>()(0) == 0;
+  } else if (axis_value.dtype() == DT_INT64) {
+    return axis_value.flat<int64>()(0) == 0;
+  }
+  return false;
+}
+
+// Returns true if `node_view` is a gather whose output at port 0 is read only
+// by the pattern root, so that it can be removed once the pattern is fused.
+bool IsFusableGatherOfRows(const RemapperContext& ctx,
+                           const utils::MutableNodeView& node_view) {
+  return IsGatherOfRows(node_view) && !HasControlFaninOrFanout(node_view) &&
+         HasAtMostOneFanoutAtPort0(node_view) &&
+         node_view.NumRegularFanouts() == 1 &&
+         !IsInPreserveSet(ctx, node_view.node());
+}
+
+bool FindSparseEmbeddingLookupCombine(const RemapperContext& ctx,
+                                      int node_index,
+                                      SparseEmbeddingLookupCombine* matched) {
+  const auto* node_view = ctx.graph_view.GetNode(node_index);
+  // Root of the pattern must be a SparseSegment{Sum,Mean,SqrtN}.
+  if (HasControlFaninOrFanout(*node_view)) return false;
+
+  const auto* node_def = node_view->node();
+  if (SparseSegmentReductionCombiner(*node_def).empty()) return false;
+  if (!NodeIsOnCpu(node_def)) return false;
+  const DataType dtype = GetDataTypeFromAttr(*node_def, "T");
+  if (dtype != DT_FLOAT && dtype != DT_DOUBLE) return false;
+  if (node_view->NumRegularFanins() != 3) return false;
+
+  // Input to the reduction must be rows gathered from the params, optionally
+  // forwarded by an Identity.
+  SparseEmbeddingLookupCombine pattern;
+  pattern.sparse_segment_reduction = node_index;
+  const auto& data_fanin = node_view->GetRegularFanin(0);
+  if (data_fanin.index() != 0) return false;
+  const auto* gather_node_view = data_fanin.node_view();
+  if (IsIdentity(*gather_node_view->node())) {
+    if (HasControlFaninOrFanout(*gather_node_view) ||
+        gather_node_view->NumRegularFanouts() != 1 ||
+        IsInPreserveSet(ctx, gather_node_view->node()))
+      return false;
+    pattern.identity = gather_node_view->node_index();
+    const auto& identity_fanin = gather_node_view->GetRegularFanin(0);
+    if (identity_fanin.index() != 0) return false;
+    gather_node_view = identity_fanin.node_view();
+  }
+  // The fused node reads all of the params where the gather runs, which must
+  // be where the reduction runs. Otherwise it would read the whole params
+  // across devices, e.g. from a parameter server, instead of the gathered
+  // rows.
+  if (!IsFusableGatherOfRows(ctx, *gather_node_view) ||
+      !HasDataType(gather_node_view->node(), dtype, "Tparams") ||
+      gather_node_view->node()->device() != node_def->device())
+    return false;
+  pattern.gather = gather_node_view->node_index();
+
+  // The rows must be gathered with the unique ids of a Unique node, and
+  // reduced with the indices of the ids into the unique ids.
+  const auto& ids_fanin = gather_node_view->GetRegularFanin(1);
+  const auto* unique_node_view = ids_fanin.node_view();
+  const auto* unique_node_def = unique_node_view->node();
+  if (ids_fanin.index() != 0 || !IsUnique(*unique_node_def)) return false;
+  const DataType ids_dtype = GetDataTypeFromAttr(*unique_node_def, "T");
+  if (ids_dtype != DT_INT32 && ids_dtype != DT_INT64) return false;
+
+  const auto& idx_fanin = node_view->GetRegularFanin(1);
+  if (idx_fanin.index() != 1 ||
+      idx_fanin.node_view()->node_index() != unique_node_view->node_index())
+    return false;
+  pattern.unique = unique_node_view->node_index();
+  pattern.remove_unique = !HasControlFaninOrFanout(*unique_node_view) &&
+                          unique_node_view->NumRegularFanouts() == 2 &&
+                          !IsInPreserveSet(ctx, unique_node_def);
+
+  *matched = pattern;
+  return true;
+}
+
+bool FindGatherWithUnsortedSegmentSum(const RemapperContext& ctx,
+                                      int node_index,
+                                      GatherWithUnsortedSegmentSum* matched) {
+  const auto* node_view = ctx.graph_view.GetNode(node_index);
+  // Root of the pattern must be an UnsortedSegmentSum.
+  if (HasControlFaninOrFanout(*node_view)) return false;
+
+  const auto* node_def = node_view->node();
+  if (!IsUnsortedSegmentSum(*node_def) || !NodeIsOnCpu(node_def)) return false;
+  const DataType dtype = GetDataTypeFromAttr(*node_def, "T");
+  if (dtype != DT_FLOAT && dtype != DT_DOUBLE) return false;
+  const DataType indices_dtype = GetDataTypeFromAttr(*node_def, "Tindices");
+  if (indices_dtype != DT_INT32 && indices_dtype != DT_INT64) return false;
+  if (!HasDataType(node_def, DT_INT32, "Tnumsegments")) return false;
+  if (node_view->NumRegularFanins() != 3) return false;
+
+  // Input to the UnsortedSegmentSum must be rows gathered with int32 indices.
+  const auto& data_fanin = node_view->GetRegularFanin(0);
+  const auto* gather_node_view = data_fanin.node_view();
+  const auto* gather_node_def = gather_node_view->node();
+  if (data_fanin.index() != 0 ||
+      !IsFusableGatherOfRows(ctx, *gather_node_view) ||
+      !HasDataType(gather_node_def, dtype, "Tparams") ||
+      !HasDataType(gather_node_def, DT_INT32, "Tindices") ||
+      gather_node_def->device() != node_def->device())
+    return false;
+
+  // The fused kernel takes vectors of indices and segment ids, while both ops
+  // accept higher ranks.
+  const auto& gather_props =
+      ctx.graph_properties.GetInputProperties(gather_node_def->name());
+  const auto& props = ctx.graph_properties.GetInputProperties(node_def->name());
+  if (gather_props.size() < 2 || props.size() < 2 ||
+      Rank(gather_props[1].shape()) != 1 || Rank(props[1].shape()) != 1)
+    return false;
+
+  *matched = {gather_node_view->node_index(), node_index};
+  return true;
+}
+
+// Returns true if `node` is a BatchMatMul{V2} with the given adjoint flags.
+bool IsBatchMatMulWithAdjoints(const NodeDef& node, bool adj_x, bool adj_y) {
+  bool node_adj_x = false;
+  bool node_adj_y = false;
+  TryGetNodeAttr(node, "adj_x", &node_adj_x);
+  TryGetNodeAttr(node, "adj_y", &node_adj_y);
+  return IsBatchMatMul(node) && node_adj_x == adj_x && node_adj_y == adj_y;
+}
+
+// Returns true if `node` is a Const holding a single float or double value
+// that can be broadcast to a matrix without changing its shape.
+bool GetScalarConstantValue(const NodeDef& node, double* value) {
+  Tensor tensor;
+  if (!IsConstant(node) || !GetNodeAttr(node, "value", &tensor).ok() ||
+      tensor.NumElements() != 1 || tensor.dims() > 1)
+    return false;
+  if (tensor.dtype() == DT_FLOAT) {
+    *value = tensor.flat<float>()(0);
+    return true;
+  } else if (tensor.dtype() == DT_DOUBLE) {
+    *value = tensor.flat<double>()(0);
+    return true;
+  }
+  return false;
+}
+
+// Returns the batch dimensions of a [..., rows, cols] shape.
+TensorShapeProto BatchShape(const TensorShapeProto& shape) {
+  TensorShapeProto batch;
+  for (int i = 0; i < shape.dim_size() - 2; ++i) {
+    *batch.add_dim() = shape.dim(i);
+  }
+  return batch;
+}
+
+bool FindMultiHeadAttention(const RemapperContext& ctx, int node_index,
+                            MultiHeadAttention* matched) {
+  const auto* node_view = ctx.graph_view.GetNode(node_index);
+  // Root of the pattern must be a BatchMatMul of the attention probabilities
+  // and the values.
+  if (HasControlFaninOrFanout(*node_view)) return false;
+
+  const auto* node_def = node_view->node();
+  if (!IsBatchMatMulWithAdjoints(*node_def, false, false) ||
+      !NodeIsOnCpu(node_def))
+    return false;
+  const DataType dtype = GetDataTypeFromAttr(*node_def, "T");
+  if (dtype != DT_FLOAT && dtype != DT_DOUBLE) return false;
+  if (node_view->NumRegularFanins() != 2) return false;
+
+  // Returns the node that produces `fanin` if it is used only by the pattern,
+  // so that it can be removed once the pattern is fused.
+  const auto fusable_input = [&](const utils::MutableFaninView& fanin)
+      -> const utils::MutableNodeView* {
+    const auto* input = fanin.node_view();
+    if (fanin.index() != 0 || HasControlFaninOrFanout(*input) ||
+        input->NumRegularFanouts() != 1 ||
+        IsInPreserveSet(ctx, input->node()) ||
+        !HasDataType(input->node(), dtype) || !NodeIsOnCpu(input->node()))
+      return nullptr;
+    return input;
+  };
+
+  // Returns true if `node_view` is the BatchMatMul of the queries and the keys,
+  // possibly scaled. The mask can be computed with a Mul as well.
+  const auto is_scores = [](const utils::MutableNodeView& node_view) -> bool {
+    const auto* node = node_view.node();
+    if (IsBatchMatMul(*node)) return true;
+    if (!IsMul(*node) && !IsRealDiv(*node)) return false;
+    for (int i = 0; i < node_view.NumRegularFanins(); ++i) {
+      if (IsBatchMatMul(*node_view.GetRegularFanin(i).node_view()->node()))
+        return true;
+    }
+    return false;
+  };
+
+  MultiHeadAttention pattern;
+  pattern.output = node_index;
+  const auto* softmax = fusable_input(node_view->GetRegularFanin(0));
+  if (softmax == nullptr || !IsSoftmax(*softmax->node())) return false;
+  pattern.softmax = softmax->node_index();
+
+  // Input to the Softmax can be the scores with a mask added to them.
+  const auto* scores = fusable_input(softmax->GetRegularFanin(0));
+  if (scores != nullptr && IsAdd(*scores->node())) {
+    if (scores->NumRegularFanins() != 2) return false;
+    const auto* mask_add = scores;
+    for (int port = 0; port < 2; ++port) {
+      scores = fusable_input(mask_add->GetRegularFanin(port));
+      if (scores != nullptr && is_scores(*scores)) {
+        pattern.mask_add = mask_add->node_index();
+        pattern.mask_port = 1 - port;
+        break;
+      }
+    }
+    if (pattern.mask_add == kMissingIndex) return false;
+  }
+
+  // Scores can be scaled by a constant, which is the divisor of a RealDiv.
+  if (scores != nullptr &&
+      (IsMul(*scores->node()) || IsRealDiv(*scores->node()))) {
+    if (scores->NumRegularFanins() != 2) return false;
+    const auto* scale = scores;
+    const bool is_div = IsRealDiv(*scale->node());
+    const NodeDef& lhs = *scale->GetRegularFanin(0).node_view()->node();
+    const NodeDef& rhs = *scale->GetRegularFanin(1).node_view()->node();
+    double scale_value;
+    int scores_port;
+    if (GetScalarConstantValue(rhs, &scale_value)) {
+      scores_port = 0;
+    } else if (!is_div && GetScalarConstantValue(lhs, &scale_value)) {
+      scores_port = 1;
+    } else {
+      return false;
+    }
+    if (is_div) {
+      if (scale_value == 0) return false;
+      scale_value = 1.0 / scale_value;
+    }
+    pattern.scale = scale->node_index();
+    pattern.scale_value = static_cast<float>(scale_value);
+    scores = fusable_input(scale->GetRegularFanin(scores_port));
+  }
+
+  if (scores == nullptr || scores->NumRegularFanins() != 2 ||
+      !IsBatchMatMulWithAdjoints(*scores->node(), false, true))
+    return false;
+  pattern.scores = scores->node_index();
+
+  // The fused kernel does not broadcast the batch dimensions of the query,
+  // key and value, and needs them to have at least one.
+  const auto& scores_props =
+      ctx.graph_properties.GetInputProperties(scores->node()->name());
+  const auto& output_props =
+      ctx.graph_properties.GetInputProperties(node_def->name());
+  if (scores_props.size() != 2 || output_props.size() != 2) return false;
+  const TensorShapeProto& query = scores_props[0].shape();
+  const TensorShapeProto& key = scores_props[1].shape();
+  const TensorShapeProto& value = output_props[1].shape();
+  if (query.unknown_rank() || query.dim_size() < 3 || key.unknown_rank() ||
+      key.dim_size() != query.dim_size() || value.unknown_rank() ||
+      value.dim_size() != query.dim_size())
+    return false;
+  // BatchMatMul requires equal batch dimensions, BatchMatMulV2 broadcasts.
+  if (node_def->op() != "BatchMatMul" ||
+      scores->node()->op() != "BatchMatMul") {
+    const TensorShapeProto batch = BatchShape(query);
+    if (!ShapesSymbolicallyEqual(batch, BatchShape(key)) ||
+        !ShapesSymbolicallyEqual(batch, BatchShape(value)))
+      return false;
+  }
+
+  // The mask must be broadcast to the scores without changing their shape.
+  if (pattern.mask_add != kMissingIndex) {
+    const auto& props = ctx.graph_properties.GetInputProperties(
+        ctx.graph_view.GetNode(pattern.mask_add)->node()->name());
+    if (props.size() != 2) return false;
+    const TensorShapeProto& scores_shape = props[1 - pattern.mask_port].shape();
+    TensorShapeProto broadcast_shape;
+    if (!ShapeAfterBroadcast(scores_shape, props[pattern.mask_port].shape(),
+                             &broadcast_shape) ||
+        !ShapesSymbolicallyEqual(broadcast_shape, scores_shape))
+      return false;
+  }
+
+  *matched = pattern;
+  return true;
+}
+
 void CopyConv2DAttributes(const NodeDef& conv2d, NodeDef* fused_conv2d) {
   DCHECK(IsConv2D(conv2d)) << "Input node must be a Conv2D";
 
@@ -1199,6 +1574,137 @@ Status AddFusedContractionNode(
 }
 #endif
 
+Status AddFusedSparseEmbeddingLookupCombineNode(
+    RemapperContext* ctx, const SparseEmbeddingLookupCombine& matched,
+    std::vector<bool>* invalidated_nodes, std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& unique = graph->node(matched.unique);
+  const NodeDef& gather = graph->node(matched.gather);
+  const NodeDef& reduction = graph->node(matched.sparse_segment_reduction);
+
+  VLOG(2) << "Fuse " << reduction.op()
+          << " with Unique and Gather: reduction=" << reduction.name()
+          << " unique=" << unique.name() << " gather=" << gather.name();
+
+  NodeDef fused_op;
+  fused_op.set_name(reduction.name());
+  fused_op.set_op(kFusedSparseEmbeddingLookupCombine);
+  fused_op.set_device(reduction.device());
+  fused_op.add_input(gather.input(0));     // 0: params
+  fused_op.add_input(unique.input(0));     // 1: ids
+  fused_op.add_input(reduction.input(2));  // 2: segment_ids
+
+  auto* attr = fused_op.mutable_attr();
+  (*attr)["T"] = reduction.attr().at("T");
+  (*attr)["Tidx"] = unique.attr().at("T");
+  SetAttrValue(0, &(*attr)["num_weights"]);
+  SetAttrValue(SparseSegmentReductionCombiner(reduction),
+               &(*attr)["combiner"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.sparse_segment_reduction] = true;
+  (*nodes_to_delete)[matched.gather] = true;
+  if (matched.identity != kMissingIndex) {
+    (*nodes_to_delete)[matched.identity] = true;
+  }
+  if (matched.remove_unique) {
+    (*nodes_to_delete)[matched.unique] = true;
+  }
+
+  return Status::OK();
+}
+
+Status AddFusedSparseEmbeddingLookupCombineGradNode(
+    RemapperContext* ctx, const GatherWithUnsortedSegmentSum& matched,
+    std::vector<bool>* invalidated_nodes, std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& gather = graph->node(matched.gather);
+  const NodeDef& segment_sum = graph->node(matched.unsorted_segment_sum);
+
+  VLOG(2) << "Fuse " << gather.op()
+          << " with UnsortedSegmentSum: segment_sum=" << segment_sum.name()
+          << " gather=" << gather.name();
+
+  NodeDef fused_op;
+  fused_op.set_name(segment_sum.name());
+  fused_op.set_op(kFusedSparseEmbeddingLookupCombineGrad);
+  fused_op.set_device(segment_sum.device());
+  fused_op.add_input(gather.input(0));       // 0: grad
+  fused_op.add_input(segment_sum.input(1));  // 1: indices
+  fused_op.add_input(gather.input(1));       // 2: segment_ids
+  fused_op.add_input(segment_sum.input(2));  // 3: output_dim0
+
+  auto* attr = fused_op.mutable_attr();
+  (*attr)["T"] = segment_sum.attr().at("T");
+  (*attr)["Tidx"] = segment_sum.attr().at("Tindices");
+  SetAttrValue(0, &(*attr)["num_weights"]);
+  SetAttrValue("sum", &(*attr)["combiner"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.unsorted_segment_sum] = true;
+  (*nodes_to_delete)[matched.gather] = true;
+
+  return Status::OK();
+}
+
+Status AddFusedMultiHeadAttentionNode(RemapperContext* ctx,
+                                      const MultiHeadAttention& matched,
+                                      std::vector<bool>* invalidated_nodes,
+                                      std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& scores = graph->node(matched.scores);
+  const NodeDef& output = graph->node(matched.output);
+
+  VLOG(2) << "Fuse multi-head attention: output=" << output.name()
+          << " scores=" << scores.name();
+
+  NodeDef fused_op;
+  fused_op.set_name(output.name());
+  fused_op.set_op(kFusedMultiHeadAttention);
+  fused_op.set_device(output.device());
+  fused_op.add_input(scores.input(0));  // 0: query
+  fused_op.add_input(scores.input(1));  // 1: key
+  fused_op.add_input(output.input(1));  // 2: value
+  if (matched.mask_add != kMissingIndex) {
+    const NodeDef& mask_add = graph->node(matched.mask_add);
+    fused_op.add_input(mask_add.input(matched.mask_port));  // 3: mask
+  }
+
+  auto* attr = fused_op.mutable_attr();
+  (*attr)["T"] = output.attr().at("T");
+  SetAttrValue(matched.mask_add != kMissingIndex ? 1 : 0,
+               &(*attr)["num_masks"]);
+  SetAttrValue(matched.scale_value, &(*attr)["scale"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.output] = true;
+  (*nodes_to_delete)[matched.scores] = true;
+  (*nodes_to_delete)[matched.softmax] = true;
+  if (matched.scale != kMissingIndex) {
+    (*nodes_to_delete)[matched.scale] = true;
+  }
+  if (matched.mask_add != kMissingIndex) {
+    (*nodes_to_delete)[matched.mask_add] = true;
+  }
+
+  return Status::OK();
+}
+
 Status AddFusedBatchNormExNode(RemapperContext* ctx,
                                const FusedBatchNormEx& matched,
                                std::vector<bool>* invalidated_nodes,
@@ -1455,6 +1961,8 @@ Status AddBatchNormNodes(RemapperContext* ctx, const FusedBatchNorm& matched) {
 // shapes:
 //   (1) Splitting FusedBatchNorm into primitives.
 //   (2) Fusing side input and/or activation into FusedBatchNorm.
+//   (3) Fusing multi-head attention.
+//   (4) Fusing the SparseSegmentSum gradient.
 bool RequiresInferredShapes(const RemapperContext& ctx, int node_index) {
   // Candidate for a FusedBatchNorm splitting.
   const auto* node_view = ctx.graph_view.GetNode(node_index);
@@ -1500,7 +2008,47 @@ bool RequiresInferredShapes(const RemapperContext& ctx, int node_index) {
     return false;
   };
 
-  return is_batch_norm_candidate() || is_batch_norm_fusion_candidate();
+  // Candidate for a multi-head attention fusion.
+  const auto is_attention_candidate = [&]() -> bool {
+    if (!IsBatchMatMul(*node_def)) return false;
+    if (node_view->NumRegularFanins() < 1) return false;
+    return IsSoftmax(*node_view->GetRegularFanin(0).node_view()->node());
+  };
+
+  // Candidate for a SparseSegmentSum gradient fusion.
+  const auto is_segment_sum_grad_candidate = [&]() -> bool {
+    if (!IsUnsortedSegmentSum(*node_def)) return false;
+    if (node_view->NumRegularFanins() < 1) return false;
+    return IsGather(*node_view->GetRegularFanin(0).node_view()->node());
+  };
+
+  return is_batch_norm_candidate() || is_batch_norm_fusion_candidate() ||
+         is_attention_candidate() || is_segment_sum_grad_candidate();
+}
+
+// Marks a float MatMul or _FusedMatMul, or a bfloat16 MatMul, on CPU whose `b`
+// input is a Const, for the kernel to pack it once instead of on every step.
+// Same for a float NHWC Conv2D on CPU whose filter is a Const, for the kernel
+// to pack it, or cache its Winograd transform. The kernels check that they get
+// the same tensor every time, so a fed Const is still correct.
+void MarkContractionWithConstantRhs(utils::MutableNodeView* node_view) {
+  NodeDef* node = node_view->node();
+  if (!NodeIsOnCpu(node)) return;
+  if (IsConv2D(*node)) {
+    if (!HasDataType(node, DT_FLOAT) || !IsCpuCompatibleDataFormat(node)) {
+      return;
+    }
+  } else if (IsMatMul(*node) || node->op() == kFusedMatMul) {
+    if (!HasDataType(node, DT_FLOAT) &&
+        !(IsMatMul(*node) && HasDataType(node, DT_BFLOAT16))) {
+      return;
+    }
+  } else {
+    return;
+  }
+  if (node_view->NumRegularFanins() < 2) return;
+  if (!IsConstant(*node_view->GetRegularFanin(1).node_view()->node())) return;
+  SetAttrValue(true, &(*node->mutable_attr())[kBIsConst]);
 }
 
 }  // namespace
@@ -1618,6 +2166,18 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
     }
 #endif  // !INTEL_MKL
 
+    // Remap Unique+GatherV2+SparseSegment{Sum,Mean,SqrtN} into the
+    // _FusedSparseEmbeddingLookupCombine.
+    SparseEmbeddingLookupCombine sparse_embedding_lookup_combine;
+    if (allow_non_differentiable_rewrites &&
+        FindSparseEmbeddingLookupCombine(ctx, i,
+                                         &sparse_embedding_lookup_combine)) {
+      TF_RETURN_IF_ERROR(AddFusedSparseEmbeddingLookupCombineNode(
+          &ctx, sparse_embedding_lookup_combine, &invalidated_nodes,
+          &nodes_to_delete));
+      continue;
+    }
+
     // Infer properties lazily in case they are not needed.
     if (!ctx.inferred_graph_properties && RequiresInferredShapes(ctx, i)) {
       const bool assume_valid_feeds = opt_level_ == RewriterConfig::AGGRESSIVE;
@@ -1629,6 +2189,18 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       ctx.inferred_graph_properties = true;
     }
 
+    // Remap GatherV2+UnsortedSegmentSum, the gradient of SparseSegmentSum,
+    // into the _FusedSparseEmbeddingLookupCombineGrad.
+    GatherWithUnsortedSegmentSum gather_with_unsorted_segment_sum;
+    if (allow_non_differentiable_rewrites &&
+        FindGatherWithUnsortedSegmentSum(ctx, i,
+                                         &gather_with_unsorted_segment_sum)) {
+      TF_RETURN_IF_ERROR(AddFusedSparseEmbeddingLookupCombineGradNode(
+          &ctx, gather_with_unsorted_segment_sum, &invalidated_nodes,
+          &nodes_to_delete));
+      continue;
+    }
+
     // Remap FusedBatchNorm+<SideInput>+<Activation> into the _FusedBatchNormEx.
     FusedBatchNormEx fused_batch_norm_ex;
     if (allow_non_differentiable_rewrites &&
@@ -1638,6 +2210,16 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       continue;
     }
 
+    // Remap BatchMatMul+<Mul>+<Add>+Softmax+BatchMatMul into the
+    // _FusedMultiHeadAttention.
+    MultiHeadAttention multi_head_attention;
+    if (allow_non_differentiable_rewrites &&
+        FindMultiHeadAttention(ctx, i, &multi_head_attention)) {
+      TF_RETURN_IF_ERROR(AddFusedMultiHeadAttentionNode(
+          &ctx, multi_head_attention, &invalidated_nodes, &nodes_to_delete));
+      continue;
+    }
+
     // During inference, most of the inputs to FusedBatchNorm are constant, and
     // we can therefore replace the op with a much cheaper set of primitives.
     FusedBatchNorm fused_batch_norm;
@@ -1656,6 +2238,10 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
   }
   TF_RETURN_IF_ERROR(mutation->Apply());
 
+  for (int i = 0; i < ctx.graph_view.NumNodes(); ++i) {
+    MarkContractionWithConstantRhs(ctx.graph_view.GetNode(i));
+  }
+
   *optimized_graph = mutable_item.graph;
 
   return Status::OK();
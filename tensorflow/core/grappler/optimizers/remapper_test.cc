@@ -852,5 +852,558 @@ TEST_F(RemapperTest, FuseConv2DWithSqueezeAndBias) {
   test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
 }
 
+TEST_F(RemapperTest, MarkMatMulWithConstantRhs) {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto lhs = Placeholder(s.WithOpName("lhs"), DT_FLOAT,
+                         ops::Placeholder::Shape({8, 32}));
+  auto rhs = Placeholder(s.WithOpName("rhs"), DT_FLOAT,
+                         ops::Placeholder::Shape({32, 64}));
+  auto weights = ops::Const(
+      s.WithOpName("weights"),
+      Input::Initializer(GenerateRandomTensor<DT_FLOAT>({32, 64})));
+  auto bias = ops::Const(
+      s.WithOpName("bias"),
+      Input::Initializer(GenerateRandomTensor<DT_FLOAT>({64})));
+
+  auto constant = ops::MatMul(s.WithOpName("constant"), lhs, weights);
+  auto fused = ops::BiasAdd(s.WithOpName("fused"),
+                            ops::MatMul(s.WithOpName("matmul"), lhs, weights),
+                            bias);
+  auto variable = ops::MatMul(s.WithOpName("variable"), lhs, rhs);
+  auto fetch = ops::AddN(s.WithOpName("fetch"),
+                         {Output(constant), Output(fused), Output(variable)});
+
+  Tensor weights_bf16_t(DT_BFLOAT16, TensorShape({32, 64}));
+  weights_bf16_t.flat<bfloat16>() =
+      GenerateRandomTensor<DT_FLOAT>({32, 64}).flat<float>().cast<bfloat16>();
+  auto weights_bf16 = ops::Const(s.WithOpName("weights_bf16"),
+                                 Input::Initializer(weights_bf16_t));
+  auto constant_bf16 = ops::MatMul(
+      s.WithOpName("constant_bf16"),
+      ops::Cast(s.WithOpName("lhs_bf16"), lhs, DT_BFLOAT16), weights_bf16);
+
+  auto lhs_t = GenerateRandomTensor<DT_FLOAT>({8, 32});
+  auto rhs_t = GenerateRandomTensor<DT_FLOAT>({32, 64});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"lhs", lhs_t}, {"rhs", rhs_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "constant") {
+      EXPECT_EQ(node.op(), "MatMul");
+      EXPECT_TRUE(node.attr().at("_b_is_const").b());
+      found++;
+    } else if (node.name() == "fused") {
+      EXPECT_EQ(node.op(), "_FusedMatMul");
+      EXPECT_TRUE(node.attr().at("_b_is_const").b());
+      found++;
+    } else if (node.name() == "variable") {
+      EXPECT_EQ(node.attr().count("_b_is_const"), 0);
+      found++;
+    } else if (node.name() == "constant_bf16") {
+      EXPECT_TRUE(node.attr().at("_b_is_const").b());
+      found++;
+    }
+  }
+  EXPECT_EQ(4, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+}
+
+TEST_F(RemapperTest, MarkConv2DWithConstantFilter) {
+  using ::tensorflow::ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto input = Placeholder(s.WithOpName("input"), DT_FLOAT,
+                           ops::Placeholder::Shape({4, 8, 8, 16}));
+  auto filter = Placeholder(s.WithOpName("filter"), DT_FLOAT,
+                            ops::Placeholder::Shape({3, 3, 16, 32}));
+  auto weights = ops::Const(
+      s.WithOpName("weights"),
+      Input::Initializer(GenerateRandomTensor<DT_FLOAT>({3, 3, 16, 32})));
+
+  std::vector<int> strides = {1, 1, 1, 1};
+  auto constant = ops::Conv2D(s.WithOpName("constant"), input, weights,
+                              strides, "SAME");
+  auto variable = ops::Conv2D(s.WithOpName("variable"), input, filter,
+                              strides, "SAME");
+  auto fetch = ops::Add(s.WithOpName("fetch"), constant, variable);
+
+  auto input_t = GenerateRandomTensor<DT_FLOAT>({4, 8, 8, 16});
+  auto filter_t = GenerateRandomTensor<DT_FLOAT>({3, 3, 16, 32});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"input", input_t}, {"filter", filter_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "constant") {
+      EXPECT_EQ(node.op(), "Conv2D");
+      EXPECT_TRUE(node.attr().at("_b_is_const").b());
+      found++;
+    } else if (node.name() == "variable") {
+      EXPECT_EQ(node.attr().count("_b_is_const"), 0);
+      found++;
+    }
+  }
+  EXPECT_EQ(2, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+}
+
+TEST_F(RemapperTest, FuseSparseEmbeddingLookupCombine) {
+  using ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto params_shape = ops::Placeholder::Shape({10, 4});
+  auto ids_shape = ops::Placeholder::Shape({6});
+
+  auto params = Placeholder(s.WithOpName("params"), DT_FLOAT, params_shape);
+  auto ids = Placeholder(s.WithOpName("ids"), DT_INT64, ids_shape);
+  auto segment_ids =
+      Placeholder(s.WithOpName("segment_ids"), DT_INT32, ids_shape);
+
+  // The subgraph built by embedding_lookup_sparse.
+  auto unique = ops::Unique(s.WithOpName("unique"), ids);
+  auto axis = ops::Const(s.WithOpName("axis"), 0);
+  auto gather = ops::GatherV2(s.WithOpName("gather"), params, unique.y, axis);
+  auto gathered = ops::Identity(s.WithOpName("gathered"), gather);
+  auto reduction = ops::SparseSegmentMean(s.WithOpName("reduction"), gathered,
+                                          unique.idx, segment_ids);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), reduction);
+
+  auto params_t = GenerateRandomTensor<DT_FLOAT>({10, 4});
+  auto ids_t = test::AsTensor<int64>({7, 2, 7, 9, 0, 2});
+  auto segment_ids_t = test::AsTensor<int32>({0, 0, 1, 3, 3, 3});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {
+      {"params", params_t}, {"ids", ids_t}, {"segment_ids", segment_ids_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.name(), "unique");
+    EXPECT_NE(node.name(), "gather");
+    EXPECT_NE(node.name(), "gathered");
+    if (node.name() == "reduction") {
+      EXPECT_EQ(node.op(), "_FusedSparseEmbeddingLookupCombine");
+      ASSERT_EQ(node.input_size(), 3);
+      EXPECT_EQ(node.input(0), "params");
+      EXPECT_EQ(node.input(1), "ids");
+      EXPECT_EQ(node.input(2), "segment_ids");
+      EXPECT_EQ(node.attr().at("Tidx").type(), DT_INT64);
+      EXPECT_EQ(node.attr().at("num_weights").i(), 0);
+      EXPECT_EQ(node.attr().at("combiner").s(), "mean");
+      found++;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
+}
+
+TEST_F(RemapperTest, FuseGatherWithUnsortedSegmentSum) {
+  using ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto grad_shape = ops::Placeholder::Shape({4, 8});
+  auto indices_shape = ops::Placeholder::Shape({6});
+
+  auto grad = Placeholder(s.WithOpName("grad"), DT_FLOAT, grad_shape);
+  auto segment_ids =
+      Placeholder(s.WithOpName("segment_ids"), DT_INT32, indices_shape);
+  auto indices = Placeholder(s.WithOpName("indices"), DT_INT32, indices_shape);
+
+  // The gradient of SparseSegmentSum with respect to its data.
+  auto axis = ops::Const(s.WithOpName("axis"), 0);
+  auto num_segments = ops::Const(s.WithOpName("num_segments"), 5);
+  auto gather = ops::GatherV2(s.WithOpName("gather"), grad, segment_ids, axis);
+  auto segment_sum = ops::UnsortedSegmentSum(s.WithOpName("segment_sum"),
+                                             gather, indices, num_segments);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), segment_sum);
+
+  auto grad_t = GenerateRandomTensor<DT_FLOAT>({4, 8});
+  auto segment_ids_t = test::AsTensor<int32>({0, 0, 1, 3, 3, 2});
+  // Negative indices are dropped.
+  auto indices_t = test::AsTensor<int32>({0, 3, -1, 3, 4, 1});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {
+      {"grad", grad_t}, {"segment_ids", segment_ids_t}, {"indices", indices_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.name(), "gather");
+    if (node.name() == "segment_sum") {
+      EXPECT_EQ(node.op(), "_FusedSparseEmbeddingLookupCombineGrad");
+      ASSERT_EQ(node.input_size(), 4);
+      EXPECT_EQ(node.input(0), "grad");
+      EXPECT_EQ(node.input(1), "indices");
+      EXPECT_EQ(node.input(2), "segment_ids");
+      EXPECT_EQ(node.input(3), "num_segments");
+      EXPECT_EQ(node.attr().at("combiner").s(), "sum");
+      found++;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
+}
+
+TEST_F(RemapperTest, DontFuseSparseEmbeddingLookupAcrossDevices) {
+  using ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto params_shape = ops::Placeholder::Shape({10, 4});
+  auto ids_shape = ops::Placeholder::Shape({6});
+
+  // The params and the gather are on a parameter server.
+  tensorflow::Scope ps = s.WithDevice("/job:ps/replica:0/task:0/device:CPU:0");
+  auto params = Placeholder(ps.WithOpName("params"), DT_FLOAT, params_shape);
+  auto ids = Placeholder(s.WithOpName("ids"), DT_INT64, ids_shape);
+  auto segment_ids =
+      Placeholder(s.WithOpName("segment_ids"), DT_INT32, ids_shape);
+  auto unique = ops::Unique(s.WithOpName("unique"), ids);
+  auto axis = ops::Const(ps.WithOpName("axis"), 0);
+  auto gather = ops::GatherV2(ps.WithOpName("gather"), params, unique.y, axis);
+  auto reduction = ops::SparseSegmentSum(
+      s.WithOpName("reduction")
+          .WithDevice("/job:worker/replica:0/task:0/device:CPU:0"),
+      gather, unique.idx, segment_ids);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), reduction);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "reduction") {
+      EXPECT_EQ(node.op(), "SparseSegmentSum");
+      found++;
+    } else if (node.name() == "gather") {
+      EXPECT_EQ(node.op(), "GatherV2");
+      found++;
+    }
+  }
+  EXPECT_EQ(2, found);
+}
+
+TEST_F(RemapperTest, DontFuseGatherWithUnsortedSegmentSumOfMatrixIndices) {
+  using ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto grad_shape = ops::Placeholder::Shape({4, 8});
+  auto indices_shape = ops::Placeholder::Shape({2, 3});
+
+  auto grad = Placeholder(s.WithOpName("grad"), DT_FLOAT, grad_shape);
+  auto gather_indices =
+      Placeholder(s.WithOpName("gather_indices"), DT_INT32, indices_shape);
+  auto segment_ids =
+      Placeholder(s.WithOpName("segment_ids"), DT_INT32, indices_shape);
+
+  // A valid graph that the fused kernel can not run: UnsortedSegmentSum
+  // accepts segment ids of any rank.
+  auto axis = ops::Const(s.WithOpName("axis"), 0);
+  auto num_segments = ops::Const(s.WithOpName("num_segments"), 5);
+  auto gather =
+      ops::GatherV2(s.WithOpName("gather"), grad, gather_indices, axis);
+  auto segment_sum = ops::UnsortedSegmentSum(s.WithOpName("segment_sum"),
+                                             gather, segment_ids, num_segments);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), segment_sum);
+
+  auto grad_t = GenerateRandomTensor<DT_FLOAT>({4, 8});
+  auto gather_indices_t =
+      test::AsTensor<int32>({0, 0, 1, 3, 3, 2}, TensorShape({2, 3}));
+  auto segment_ids_t =
+      test::AsTensor<int32>({0, 3, -1, 3, 4, 1}, TensorShape({2, 3}));
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"grad", grad_t},
+               {"gather_indices", gather_indices_t},
+               {"segment_ids", segment_ids_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "segment_sum") {
+      EXPECT_EQ(node.op(), "UnsortedSegmentSum");
+      found++;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
+}
+
+TEST_F(RemapperTest, FuseMultiHeadAttention) {
+  using ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto query_shape = ops::Placeholder::Shape({2, 3, 5, 8});
+  auto key_shape = ops::Placeholder::Shape({2, 3, 7, 8});
+  auto value_shape = ops::Placeholder::Shape({2, 3, 7, 4});
+  auto mask_shape = ops::Placeholder::Shape({2, 1, 1, 7});
+
+  auto query = Placeholder(s.WithOpName("query"), DT_FLOAT, query_shape);
+  auto key = Placeholder(s.WithOpName("key"), DT_FLOAT, key_shape);
+  auto value = Placeholder(s.WithOpName("value"), DT_FLOAT, value_shape);
+  auto mask = Placeholder(s.WithOpName("mask"), DT_FLOAT, mask_shape);
+
+  // The subgraph built by BERT.
+  auto scores = ops::BatchMatMulV2(s.WithOpName("scores"), query, key,
+                                   ops::BatchMatMulV2::AdjY(true));
+  auto scale = ops::Const(s.WithOpName("scale"), 0.125f);
+  auto scaled = ops::Mul(s.WithOpName("scaled"), scores, scale);
+  auto masked = ops::AddV2(s.WithOpName("masked"), scaled, mask);
+  auto probs = ops::Softmax(s.WithOpName("probs"), masked);
+  auto context = ops::BatchMatMulV2(s.WithOpName("context"), probs, value);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), context);
+
+  auto query_t = GenerateRandomTensor<DT_FLOAT>({2, 3, 5, 8});
+  auto key_t = GenerateRandomTensor<DT_FLOAT>({2, 3, 7, 8});
+  auto value_t = GenerateRandomTensor<DT_FLOAT>({2, 3, 7, 4});
+  auto mask_t = test::AsTensor<float>(
+      {0, 0, 0, 0, -10000, -10000, -10000, 0, 0, 0, 0, 0, 0, -10000},
+      {2, 1, 1, 7});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"query", query_t},
+               {"key", key_t},
+               {"value", value_t},
+               {"mask", mask_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.name(), "scores");
+    EXPECT_NE(node.name(), "scaled");
+    EXPECT_NE(node.name(), "masked");
+    EXPECT_NE(node.name(), "probs");
+    if (node.name() == "context") {
+      EXPECT_EQ(node.op(), "_FusedMultiHeadAttention");
+      ASSERT_EQ(node.input_size(), 4);
+      EXPECT_EQ(node.input(0), "query");
+      EXPECT_EQ(node.input(1), "key");
+      EXPECT_EQ(node.input(2), "value");
+      EXPECT_EQ(node.input(3), "mask");
+      EXPECT_EQ(node.attr().at("num_masks").i(), 1);
+      EXPECT_EQ(node.attr().at("scale").f(), 0.125f);
+      found++;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+}
+
+TEST_F(RemapperTest, FuseMultiHeadAttentionWithoutMask) {
+  using ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto query_shape = ops::Placeholder::Shape({6, 5, 8});
+  auto value_shape = ops::Placeholder::Shape({6, 7, 8});
+
+  auto query = Placeholder(s.WithOpName("query"), DT_FLOAT, query_shape);
+  auto key = Placeholder(s.WithOpName("key"), DT_FLOAT, value_shape);
+  auto value = Placeholder(s.WithOpName("value"), DT_FLOAT, value_shape);
+
+  auto scores = ops::BatchMatMul(s.WithOpName("scores"), query, key,
+                                 ops::BatchMatMul::AdjY(true));
+  auto divisor = ops::Const(s.WithOpName("divisor"), 4.0f);
+  auto scaled = ops::RealDiv(s.WithOpName("scaled"), scores, divisor);
+  auto probs = ops::Softmax(s.WithOpName("probs"), scaled);
+  auto context = ops::BatchMatMul(s.WithOpName("context"), probs, value);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), context);
+
+  auto query_t = GenerateRandomTensor<DT_FLOAT>({6, 5, 8});
+  auto key_t = GenerateRandomTensor<DT_FLOAT>({6, 7, 8});
+  auto value_t = GenerateRandomTensor<DT_FLOAT>({6, 7, 8});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"query", query_t}, {"key", key_t}, {"value", value_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "context") {
+      EXPECT_EQ(node.op(), "_FusedMultiHeadAttention");
+      ASSERT_EQ(node.input_size(), 3);
+      EXPECT_EQ(node.attr().at("num_masks").i(), 0);
+      EXPECT_EQ(node.attr().at("scale").f(), 0.25f);
+      found++;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+}
+
+TEST_F(RemapperTest, DoNotFuseMultiHeadAttentionWithBroadcastingInputs) {
+  using ops::Placeholder;
+
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  // The keys and values are broadcast over the heads, and the mask adds a
+  // dimension to the scores.
+  auto query = Placeholder(s.WithOpName("query"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 3, 5, 8}));
+  auto key = Placeholder(s.WithOpName("key"), DT_FLOAT,
+                         ops::Placeholder::Shape({2, 1, 7, 8}));
+  auto value = Placeholder(s.WithOpName("value"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 1, 7, 4}));
+  auto mask = Placeholder(s.WithOpName("mask"), DT_FLOAT,
+                          ops::Placeholder::Shape({4, 1, 1, 1, 5}));
+
+  auto scores = ops::BatchMatMulV2(s.WithOpName("scores"), query, key,
+                                   ops::BatchMatMulV2::AdjY(true));
+  auto probs = ops::Softmax(s.WithOpName("probs"), scores);
+  auto context = ops::BatchMatMulV2(s.WithOpName("context"), probs, value);
+  auto masked_scores = ops::BatchMatMulV2(s.WithOpName("masked_scores"),
+                                          query, query,
+                                          ops::BatchMatMulV2::AdjY(true));
+  auto masked = ops::AddV2(s.WithOpName("masked"), masked_scores, mask);
+  auto masked_probs = ops::Softmax(s.WithOpName("masked_probs"), masked);
+  auto masked_context =
+      ops::BatchMatMulV2(s.WithOpName("masked_context"), masked_probs, query);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), context);
+  auto masked_fetch =
+      ops::Identity(s.WithOpName("masked_fetch"), masked_context);
+
+  GrapplerItem item;
+  item.fetch = {"fetch", "masked_fetch"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  // Place all nodes on CPU.
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.op(), "_FusedMultiHeadAttention") << node.name();
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
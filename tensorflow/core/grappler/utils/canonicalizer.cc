@@ -16,14 +16,163 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/canonicalizer.h"
 
 #include <algorithm>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/framework/op_def.pb.h"
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
 
 namespace tensorflow {
 namespace grappler {
 
+namespace {
+
+string FingerprintString(const string& s) {
+  const Fprint128 fp = Fingerprint128(s);
+  return strings::StrCat(strings::FpToString(fp.low64),
+                         strings::FpToString(fp.high64));
+}
+
+void AppendAttrs(const protobuf::Map<string, AttrValue>& attrs, string* out) {
+  std::vector<std::pair<string, const AttrValue*>> sorted_attrs;
+  for (const auto& attr : attrs) {
+    sorted_attrs.emplace_back(attr.first, &attr.second);
+  }
+  std::sort(sorted_attrs.begin(), sorted_attrs.end());
+  for (const auto& attr : sorted_attrs) {
+    string value;
+    SerializeToStringDeterministic(*attr.second, &value);
+    strings::StrAppend(out, attr.first.size(), ":", attr.first, value.size(),
+                       ":", value);
+  }
+}
+
+// Returns the name of the node or argument of the tensor `tensor` of a
+// function body.
+string BodyNodeName(const string& tensor) {
+  const size_t start = IsControlInput(tensor) ? 1 : 0;
+  return tensor.substr(start, tensor.find(':') - start);
+}
+
+// Keys the nodes of a function body by the subgraphs that compute them.
+class FunctionBodyKeys {
+ public:
+  explicit FunctionBodyKeys(const FunctionDef& func) {
+    const OpDef& signature = func.signature();
+    for (int i = 0; i < signature.input_arg_size(); ++i) {
+      keys_[signature.input_arg(i).name()] = strings::StrCat("arg", i);
+    }
+    for (const NodeDef& node : func.node_def()) {
+      nodes_[node.name()] = &node;
+    }
+  }
+
+  // Sets `key` to the key of the node or argument `name`. Returns false if
+  // the node doesn't exist or is part of a cycle.
+  bool NodeKey(const string& name, string* key) {
+    auto it = keys_.find(name);
+    if (it != keys_.end()) {
+      *key = it->second;
+      return true;
+    }
+    auto node_it = nodes_.find(name);
+    if (node_it == nodes_.end()) return false;
+
+    // Key the inputs before the nodes that consume them, without recursing
+    // since function bodies can be arbitrarily deep.
+    std::vector<std::pair<const NodeDef*, bool>> stack = {
+        {node_it->second, false}};
+    absl::flat_hash_set<string> on_path;
+    while (!stack.empty()) {
+      const NodeDef* node = stack.back().first;
+      if (keys_.contains(node->name())) {
+        stack.pop_back();
+        continue;
+      }
+      if (!stack.back().second) {
+        stack.back().second = true;
+        on_path.insert(node->name());
+        for (const string& input : node->input()) {
+          const string input_name = BodyNodeName(input);
+          if (keys_.contains(input_name)) continue;
+          auto input_it = nodes_.find(input_name);
+          if (input_it == nodes_.end() || on_path.contains(input_name)) {
+            return false;
+          }
+          stack.emplace_back(input_it->second, false);
+        }
+        continue;
+      }
+      keys_[node->name()] = ComputeKey(*node);
+      on_path.erase(node->name());
+      stack.pop_back();
+    }
+    *key = keys_[name];
+    return true;
+  }
+
+  // Sets `key` to the key of the tensor `tensor` of the function body, e.g.
+  // "node:output:0", "arg" or "^node".
+  bool TensorKey(const string& tensor, string* key) {
+    if (IsControlInput(tensor)) {
+      if (!NodeKey(tensor.substr(1), key)) return false;
+      *key = strings::StrCat("^", *key);
+      return true;
+    }
+    const size_t pos = tensor.find(':');
+    if (!NodeKey(tensor.substr(0, pos), key)) return false;
+    if (pos != string::npos) strings::StrAppend(key, tensor.substr(pos));
+    return true;
+  }
+
+ private:
+  // PRECONDITION: The inputs of `node` are keyed.
+  string ComputeKey(const NodeDef& node) {
+    std::vector<string> regular_inputs;
+    std::vector<string> control_inputs;
+    for (const string& input : node.input()) {
+      string key;
+      TensorKey(input, &key);
+      if (IsControlInput(input)) {
+        control_inputs.push_back(std::move(key));
+      } else {
+        regular_inputs.push_back(std::move(key));
+      }
+    }
+    if (IsCommutative(node)) {
+      std::sort(regular_inputs.begin(), regular_inputs.end());
+    }
+    std::sort(control_inputs.begin(), control_inputs.end());
+    control_inputs.erase(
+        std::unique(control_inputs.begin(), control_inputs.end()),
+        control_inputs.end());
+
+    string signature =
+        strings::StrCat(node.op(), ";", node.device(), ";", node.input_size());
+    for (const string& input : regular_inputs) {
+      strings::StrAppend(&signature, ";", input);
+    }
+    for (const string& input : control_inputs) {
+      strings::StrAppend(&signature, ";", input);
+    }
+    AppendAttrs(node.attr(), &signature);
+    return FingerprintString(signature);
+  }
+
+  absl::flat_hash_map<string, const NodeDef*> nodes_;
+  absl::flat_hash_map<string, string> keys_;
+};
+
+}  // namespace
+
 void CanonicalizeNode(NodeDef* node) {
   if (node->input_size() < 2) return;
   // Partition control and regular inputs.
@@ -63,5 +212,57 @@ void CompressConstants(GraphDef* graph) {
   }
 }
 
+string FunctionFingerprint(const FunctionDef& func) {
+  OpDef signature = func.signature();
+  signature.clear_name();
+  string serialized_signature;
+  SerializeToStringDeterministic(signature, &serialized_signature);
+  string fingerprint = strings::StrCat(serialized_signature.size(), ":",
+                                       serialized_signature);
+  AppendAttrs(func.attr(), &fingerprint);
+  std::vector<std::pair<uint32, string>> arg_attrs;
+  for (const auto& arg_attr : func.arg_attr()) {
+    string serialized;
+    SerializeToStringDeterministic(arg_attr.second, &serialized);
+    arg_attrs.emplace_back(arg_attr.first, std::move(serialized));
+  }
+  std::sort(arg_attrs.begin(), arg_attrs.end());
+  for (const auto& arg_attr : arg_attrs) {
+    strings::StrAppend(&fingerprint, ";", arg_attr.first, ":",
+                       arg_attr.second.size(), ":", arg_attr.second);
+  }
+
+  FunctionBodyKeys keys(func);
+  // All the nodes of a function body are run, including the ones which don't
+  // contribute to its outputs.
+  std::vector<string> node_keys;
+  for (const NodeDef& node : func.node_def()) {
+    string key;
+    if (!keys.NodeKey(node.name(), &key)) return "";
+    node_keys.push_back(std::move(key));
+  }
+  std::sort(node_keys.begin(), node_keys.end());
+  for (const string& key : node_keys) {
+    strings::StrAppend(&fingerprint, ";", key);
+  }
+  for (const auto& output : signature.output_arg()) {
+    auto it = func.ret().find(output.name());
+    string key;
+    if (it == func.ret().end() || !keys.TensorKey(it->second, &key)) {
+      return "";
+    }
+    strings::StrAppend(&fingerprint, ";ret:", key);
+  }
+  for (const string& control_output : signature.control_output()) {
+    auto it = func.control_ret().find(control_output);
+    string key;
+    if (it == func.control_ret().end() || !keys.NodeKey(it->second, &key)) {
+      return "";
+    }
+    strings::StrAppend(&fingerprint, ";control_ret:", key);
+  }
+  return FingerprintString(fingerprint);
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
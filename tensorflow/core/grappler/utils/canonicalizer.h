@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_GRAPPLER_UTILS_CANONICALIZER_H_
 #define TENSORFLOW_CORE_GRAPPLER_UTILS_CANONICALIZER_H_
 
+#include "tensorflow/core/framework/function.pb.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/lib/core/status.h"
@@ -39,6 +40,15 @@ void CanonicalizeGraph(GraphDef* graph);
 // reduces its size by more than 50%.
 void CompressConstants(GraphDef* graph);
 
+// Returns a fingerprint of the computation performed by `func` which doesn't
+// depend on the names of the function and of its nodes, or an empty string if
+// the function body can't be fingerprinted (e.g. because it has a cycle).
+// Functions with the same fingerprint compute the same outputs from the same
+// inputs. Each node is keyed by its op, device, attributes and the keys of its
+// inputs, where the regular inputs of commutative ops and the control inputs
+// are sorted as in CanonicalizeNode, but by key rather than by name.
+string FunctionFingerprint(const FunctionDef& func);
+
 }  // namespace grappler
 }  // namespace tensorflow
 
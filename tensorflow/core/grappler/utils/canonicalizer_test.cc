@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/utils/canonicalizer.h"
 
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -71,6 +73,49 @@ TEST(CanonicalizeGraph, Simple) {
   }
 }
 
+// Returns a function computing z = op(<lhs>, <rhs>) with a node named `node`.
+FunctionDef MakeFunction(const string& name, const string& op,
+                         const string& lhs, const string& rhs,
+                         const string& node) {
+  return FunctionDefHelper::Create(
+      name, {"x: float", "y: float"}, {"z: float"}, {},
+      {{{node}, op, {lhs, rhs}, {{"T", DT_FLOAT}}}},
+      {{"z", strings::StrCat(node, ":z:0")}});
+}
+
+TEST(FunctionFingerprint, IgnoresNames) {
+  const string fingerprint =
+      FunctionFingerprint(MakeFunction("f", "Mul", "x", "y", "a"));
+  EXPECT_FALSE(fingerprint.empty());
+  EXPECT_EQ(fingerprint,
+            FunctionFingerprint(MakeFunction("g", "Mul", "x", "y", "b")));
+  EXPECT_NE(fingerprint,
+            FunctionFingerprint(MakeFunction("f", "Add", "x", "y", "a")));
+}
+
+TEST(FunctionFingerprint, CommutativeInputs) {
+  EXPECT_EQ(FunctionFingerprint(MakeFunction("f", "Mul", "x", "y", "a")),
+            FunctionFingerprint(MakeFunction("f", "Mul", "y", "x", "a")));
+  EXPECT_NE(FunctionFingerprint(MakeFunction("f", "Div", "x", "y", "a")),
+            FunctionFingerprint(MakeFunction("f", "Div", "y", "x", "a")));
+}
+
+TEST(FunctionFingerprint, Attributes) {
+  FunctionDef func = MakeFunction("f", "Mul", "x", "y", "a");
+  const string fingerprint = FunctionFingerprint(func);
+  (*func.mutable_attr())["_noinline"].set_b(true);
+  EXPECT_NE(fingerprint, FunctionFingerprint(func));
+}
+
+TEST(FunctionFingerprint, Cycle) {
+  FunctionDef func = FunctionDefHelper::Create(
+      "f", {"x: float"}, {"z: float"}, {},
+      {{{"a"}, "Add", {"x", "b:z:0"}, {{"T", DT_FLOAT}}},
+       {{"b"}, "Add", {"x", "a:z:0"}, {{"T", DT_FLOAT}}}},
+      {{"z", "a:z:0"}});
+  EXPECT_EQ("", FunctionFingerprint(func));
+}
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
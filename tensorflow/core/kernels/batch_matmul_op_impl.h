@@ -20,6 +20,8 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
+#include <type_traits>
 #include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
@@ -197,6 +199,243 @@ struct SequentialMatMulKernel {
   }
 };
 
+// Batch matmul kernel for many small real matrices. Each product is computed
+// straight from the operands by register-blocked micro-kernels, without the
+// packing and cache blocking of the general matrix multiply, and the batch is
+// sharded over the worker threads. The number of columns and the depth of
+// common attention shapes are compile time constants.
+template <typename Scalar, bool IsSupported =
+                               std::is_same<Scalar, float>::value ||
+                               std::is_same<Scalar, double>::value>
+struct SmallMatMulKernel {
+  static bool CanRun(int64 m, int64 k, int64 n) { return false; }
+
+  static void Run(const Tensor& in_x, const Tensor& in_y, bool adj_x,
+                  bool adj_y, const MatMulBCast& bcast, Tensor* out, int start,
+                  int limit) {}
+};
+
+template <typename Scalar>
+struct SmallMatMulKernel<Scalar, true> {
+  typedef typename Eigen::internal::packet_traits<Scalar>::type Packet;
+  static constexpr int kPacketSize =
+      Eigen::internal::unpacket_traits<Packet>::size;
+  // Each micro-kernel call computes up to kRows rows and two packets of
+  // columns of the output in 12 registers.
+  static constexpr int kRows = 6;
+  static constexpr int kCols = 2 * kPacketSize;
+  // Above this many multiply-adds per product, the general matrix multiply,
+  // which keeps blocks of its operands in cache, is faster.
+  static constexpr int64 kMaxCost = 128 * 128 * 64;
+
+  // Vector-matrix and matrix-vector products are left to Eigen's GEMV.
+  static bool CanRun(int64 m, int64 k, int64 n) {
+    return m > 1 && n > 1 && m * k * n <= kMaxCost;
+  }
+
+  // c0 += a * b0 and, for two packets, c1 += a * b1.
+  template <int kPackets>
+  static EIGEN_ALWAYS_INLINE void Madd(const Scalar* a, const Packet& b0,
+                                       const Packet& b1, Packet* c0,
+                                       Packet* c1) {
+    const Packet a_packet = Eigen::internal::pset1<Packet>(*a);
+    *c0 = Eigen::internal::pmadd(a_packet, b0, *c0);
+    if (kPackets > 1) *c1 = Eigen::internal::pmadd(a_packet, b1, *c1);
+  }
+
+  template <int kPackets>
+  static EIGEN_ALWAYS_INLINE void Store(const Packet& c0, const Packet& c1,
+                                        Scalar* c) {
+    Eigen::internal::pstoreu(c, c0);
+    if (kPackets > 1) Eigen::internal::pstoreu(c + kPacketSize, c1);
+  }
+
+  // Computes a [kBlockRows, kPackets * kPacketSize] block of the output at
+  // `c`. a(i, l) is a[i * a_row_stride + l * a_depth_stride], and the rows of
+  // b are `b_stride` apart.
+  template <int kBlockRows, int kPackets, int kDepth>
+  static EIGEN_ALWAYS_INLINE void MicroKernel(const Scalar* a,
+                                              int64 a_row_stride,
+                                              int64 a_depth_stride,
+                                              const Scalar* b, int64 b_stride,
+                                              int64 depth, Scalar* c,
+                                              int64 c_stride) {
+    static_assert(kBlockRows <= kRows, "Too many rows");
+    const Packet zero = Eigen::internal::pset1<Packet>(Scalar(0));
+    Packet c00 = zero, c01 = zero, c10 = zero, c11 = zero, c20 = zero,
+           c21 = zero, c30 = zero, c31 = zero, c40 = zero, c41 = zero,
+           c50 = zero, c51 = zero;
+    const int64 d = kDepth == Eigen::Dynamic ? depth : kDepth;
+    for (int64 l = 0; l < d; ++l) {
+      const Packet b0 = Eigen::internal::ploadu<Packet>(b);
+      const Packet b1 =
+          kPackets > 1 ? Eigen::internal::ploadu<Packet>(b + kPacketSize)
+                       : zero;
+      Madd<kPackets>(a, b0, b1, &c00, &c01);
+      if (kBlockRows > 1) Madd<kPackets>(a + a_row_stride, b0, b1, &c10, &c11);
+      if (kBlockRows > 2) {
+        Madd<kPackets>(a + 2 * a_row_stride, b0, b1, &c20, &c21);
+      }
+      if (kBlockRows > 3) {
+        Madd<kPackets>(a + 3 * a_row_stride, b0, b1, &c30, &c31);
+      }
+      if (kBlockRows > 4) {
+        Madd<kPackets>(a + 4 * a_row_stride, b0, b1, &c40, &c41);
+      }
+      if (kBlockRows > 5) {
+        Madd<kPackets>(a + 5 * a_row_stride, b0, b1, &c50, &c51);
+      }
+      a += a_depth_stride;
+      b += b_stride;
+    }
+    Store<kPackets>(c00, c01, c);
+    if (kBlockRows > 1) Store<kPackets>(c10, c11, c + c_stride);
+    if (kBlockRows > 2) Store<kPackets>(c20, c21, c + 2 * c_stride);
+    if (kBlockRows > 3) Store<kPackets>(c30, c31, c + 3 * c_stride);
+    if (kBlockRows > 4) Store<kPackets>(c40, c41, c + 4 * c_stride);
+    if (kBlockRows > 5) Store<kPackets>(c50, c51, c + 5 * c_stride);
+  }
+
+  // Computes kPackets packets of columns of all the rows of the output.
+  template <int kPackets, int kDepth>
+  static EIGEN_ALWAYS_INLINE void MultiplyColumns(
+      const Scalar* a, int64 a_row_stride, int64 a_depth_stride,
+      const Scalar* b, int64 b_stride, Scalar* c, int64 c_stride, int64 m,
+      int64 depth) {
+    int64 i = 0;
+    for (; i + kRows <= m; i += kRows) {
+      MicroKernel<kRows, kPackets, kDepth>(a + i * a_row_stride, a_row_stride,
+                                           a_depth_stride, b, b_stride, depth,
+                                           c + i * c_stride, c_stride);
+    }
+    a += i * a_row_stride;
+    c += i * c_stride;
+    switch (m - i) {
+#define ROWS_CASE(ROWS)                                                     \
+  case ROWS:                                                                \
+    MicroKernel<ROWS, kPackets, kDepth>(a, a_row_stride, a_depth_stride, b, \
+                                        b_stride, depth, c, c_stride);      \
+    break;
+      ROWS_CASE(1)
+      ROWS_CASE(2)
+      ROWS_CASE(3)
+      ROWS_CASE(4)
+      ROWS_CASE(5)
+#undef ROWS_CASE
+    }
+  }
+
+  // Computes the [m, n] product c = a * b of a and the row major [depth, n]
+  // matrix b. `scratch` holds depth * kPacketSize + m * kPacketSize elements
+  // for the last columns when n is not a multiple of kPacketSize.
+  template <int kN, int kDepth>
+  static void Multiply(const Scalar* a, int64 a_row_stride,
+                       int64 a_depth_stride, const Scalar* b, Scalar* c,
+                       int64 m, int64 n, int64 depth, Scalar* scratch) {
+    if (kN != Eigen::Dynamic) n = kN;
+    if (kDepth != Eigen::Dynamic) depth = kDepth;
+    int64 j = 0;
+    for (; j + kCols <= n; j += kCols) {
+      MultiplyColumns<2, kDepth>(a, a_row_stride, a_depth_stride, b + j, n,
+                                 c + j, n, m, depth);
+    }
+    if (j + kPacketSize <= n) {
+      MultiplyColumns<1, kDepth>(a, a_row_stride, a_depth_stride, b + j, n,
+                                 c + j, n, m, depth);
+      j += kPacketSize;
+    }
+    const int64 tail = n - j;
+    if (tail == 0) return;
+    // Multiplies by the last columns padded with zeros to a packet.
+    Scalar* padded_b = scratch;
+    Scalar* padded_c = scratch + depth * kPacketSize;
+    for (int64 l = 0; l < depth; ++l) {
+      std::copy_n(b + l * n + j, tail, padded_b + l * kPacketSize);
+      std::fill_n(padded_b + l * kPacketSize + tail, kPacketSize - tail,
+                  Scalar(0));
+    }
+    MultiplyColumns<1, kDepth>(a, a_row_stride, a_depth_stride, padded_b,
+                               kPacketSize, padded_c, kPacketSize, m, depth);
+    for (int64 i = 0; i < m; ++i) {
+      std::copy_n(padded_c + i * kPacketSize, tail, c + i * n + j);
+    }
+  }
+
+  typedef void (*MultiplyFn)(const Scalar* a, int64 a_row_stride,
+                             int64 a_depth_stride, const Scalar* b, Scalar* c,
+                             int64 m, int64 n, int64 depth, Scalar* scratch);
+
+  template <int kN>
+  static MultiplyFn GetMultiply(int64 depth) {
+    switch (depth) {
+      case 32:
+        return &Multiply<kN, 32>;
+      case 64:
+        return &Multiply<kN, 64>;
+      case 128:
+        return &Multiply<kN, 128>;
+      default:
+        return &Multiply<kN, Eigen::Dynamic>;
+    }
+  }
+
+  // Returns Multiply() specialized for the number of columns and the depth
+  // of common attention shapes.
+  static MultiplyFn GetMultiply(int64 n, int64 depth) {
+    switch (n) {
+      case 32:
+        return GetMultiply<32>(depth);
+      case 64:
+        return GetMultiply<64>(depth);
+      case 128:
+        return GetMultiply<128>(depth);
+      default:
+        return GetMultiply<Eigen::Dynamic>(depth);
+    }
+  }
+
+  static void Run(const Tensor& in_x, const Tensor& in_y, bool adj_x,
+                  bool adj_y, const MatMulBCast& bcast, Tensor* out, int start,
+                  int limit) {
+    using Matrix =
+        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    const int64 m = out->dim_size(1);
+    const int64 n = out->dim_size(2);
+    const int64 depth = in_x.dim_size(adj_x ? 1 : 2);
+    const Scalar* x_data = in_x.flat<Scalar>().data();
+    const Scalar* y_data = in_y.flat<Scalar>().data();
+    Scalar* z_data = out->flat<Scalar>().data();
+    const MultiplyFn multiply = GetMultiply(n, depth);
+
+    // The padded last columns, followed by y transposed to [depth, n] when it
+    // is adjointed.
+    std::vector<Scalar> scratch((depth + m) * kPacketSize +
+                                (adj_y ? depth * n : 0));
+    Scalar* y_transposed = scratch.data() + (depth + m) * kPacketSize;
+    int64 transposed_y_batch_index = -1;
+
+    const bool should_bcast = bcast.IsBroadcastingRequired();
+    const auto& x_batch_indices = bcast.x_batch_indices();
+    const auto& y_batch_indices = bcast.y_batch_indices();
+    for (int64 i = start; i < limit; ++i) {
+      const int64 x_batch_index = should_bcast ? x_batch_indices[i] : i;
+      const int64 y_batch_index = should_bcast ? y_batch_indices[i] : i;
+      const Scalar* y = y_data + y_batch_index * depth * n;
+      if (adj_y) {
+        if (y_batch_index != transposed_y_batch_index) {
+          Eigen::Map<Matrix>(y_transposed, depth, n) =
+              Eigen::Map<const Matrix>(y, n, depth).transpose();
+          transposed_y_batch_index = y_batch_index;
+        }
+        y = y_transposed;
+      }
+      multiply(x_data + x_batch_index * m * depth, adj_x ? 1 : depth,
+               adj_x ? m : 1, y, z_data + i * m * n, m, n, depth,
+               scratch.data());
+    }
+  }
+};
+
 }  // namespace
 
 template <typename Device, typename Scalar>
@@ -230,12 +469,23 @@ struct LaunchBatchMatMul<CPUDevice, Scalar> {
     } else {
       // Parallelize over outer dims. For small matrices and large batches, it
       // is counter-productive to parallelize the inner matrix multiplies.
-      Shard(worker_threads.num_threads, worker_threads.workers, batch_size,
-            cost_per_unit,
-            [&in_x, &in_y, adj_x, adj_y, &bcast, out](int start, int limit) {
-              SequentialMatMulKernel<Scalar>::Run(in_x, in_y, adj_x, adj_y,
-                                                  bcast, out, start, limit);
-            });
+      if (SmallMatMulKernel<Scalar>::CanRun(out->dim_size(1),
+                                            in_x.dim_size(adj_x ? 1 : 2),
+                                            out->dim_size(2))) {
+        Shard(worker_threads.num_threads, worker_threads.workers, batch_size,
+              cost_per_unit,
+              [&in_x, &in_y, adj_x, adj_y, &bcast, out](int start, int limit) {
+                SmallMatMulKernel<Scalar>::Run(in_x, in_y, adj_x, adj_y, bcast,
+                                               out, start, limit);
+              });
+      } else {
+        Shard(worker_threads.num_threads, worker_threads.workers, batch_size,
+              cost_per_unit,
+              [&in_x, &in_y, adj_x, adj_y, &bcast, out](int start, int limit) {
+                SequentialMatMulKernel<Scalar>::Run(in_x, in_y, adj_x, adj_y,
+                                                    bcast, out, start, limit);
+              });
+      }
     }
     if (conjugate_result) {
       // We used one of the identities
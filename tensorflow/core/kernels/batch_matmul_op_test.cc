@@ -225,6 +225,17 @@ BM_BatchMatmul(32, 256, 256, 256, false, false);
 BM_BatchMatmul(32, 1024, 1024, 1024, false, false);
 BM_BatchMatmul(32, 2048, 2048, 2048, false, false);
 
+// Attention with many small heads.
+BM_BatchMatmul(4096, 16, 16, 16, false, false);
+BM_BatchMatmul(4096, 32, 32, 32, false, false);
+BM_BatchMatmul(4096, 64, 64, 64, false, false);
+BM_BatchMatmul(4096, 64, 64, 64, false, true);
+BM_BatchMatmul(4096, 64, 64, 64, true, false);
+BM_BatchMatmul(1024, 128, 64, 128, false, true);
+BM_BatchMatmul(1024, 128, 128, 64, false, false);
+BM_BatchMatmul(1024, 100, 48, 100, false, true);
+BM_BatchMatmul(1024, 100, 100, 48, false, false);
+
 // Matrix-vector multiplies.
 BM_BatchMatmul(1, 10000, 200, 1, false, false);
 BM_BatchMatmul(8, 10000, 200, 1, false, false);
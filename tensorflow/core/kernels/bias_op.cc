@@ -84,6 +84,13 @@ struct AccumulatorType<Eigen::half> {
   typedef float type;
 };
 
+// bfloat16 only has 8 bits of mantissa, so summing many of them loses most of
+// the gradient.
+template <>
+struct AccumulatorType<bfloat16> {
+  typedef float type;
+};
+
 }  // namespace
 
 template <typename Device, typename T>
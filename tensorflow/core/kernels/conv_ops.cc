@@ -27,6 +27,7 @@ limitations under the License.
 #include <string.h>
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <mutex>  // NOLINT(build/c++11): only using std::call_once, not mutex.
 #include <vector>
@@ -41,7 +42,9 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/kernels/conv_2d.h"
+#include "tensorflow/core/kernels/conv_ops_cpu_fast.h"
 #include "tensorflow/core/kernels/deep_conv2d.h"
+#include "tensorflow/core/kernels/matmul_op_packed.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
@@ -176,6 +179,39 @@ struct LaunchConv2DOp<CPUDevice, T> {
   }
 };
 
+// Eigen has no fast bfloat16 contraction kernels on the CPU, so bfloat16
+// convolutions widen their operands, convolve in float32 and narrow the
+// result. This still halves the memory used for the activations between ops.
+template <>
+struct LaunchConv2DOp<CPUDevice, bfloat16> {
+  void operator()(OpKernelContext* ctx, bool use_cudnn, bool cudnn_use_autotune,
+                  const Tensor& input, const Tensor& filter, int row_dilation,
+                  int col_dilation, int row_stride, int col_stride,
+                  const Padding& padding,
+                  const std::vector<int64>& explicit_paddings, Tensor* output,
+                  TensorFormat data_format) {
+    const CPUDevice& d = ctx->eigen_device<CPUDevice>();
+    Tensor input_float, filter_float, output_float;
+    OP_REQUIRES_OK(ctx,
+                   ctx->allocate_temp(DT_FLOAT, input.shape(), &input_float));
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_FLOAT, filter.shape(), &filter_float));
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_FLOAT, output->shape(), &output_float));
+    input_float.flat<float>().device(d) = input.flat<bfloat16>().cast<float>();
+    filter_float.flat<float>().device(d) =
+        filter.flat<bfloat16>().cast<float>();
+
+    LaunchConv2DOp<CPUDevice, float>()(
+        ctx, use_cudnn, cudnn_use_autotune, input_float, filter_float,
+        row_dilation, col_dilation, row_stride, col_stride, padding,
+        explicit_paddings, &output_float, data_format);
+    if (!ctx->status().ok()) return;
+    output->flat<bfloat16>().device(d) =
+        output_float.flat<float>().cast<bfloat16>();
+  }
+};
+
 template <typename Device, typename T>
 class LaunchDeepConvOp {
  public:
@@ -232,6 +268,115 @@ class LaunchDeepConvOp<CPUDevice, float> {
   }
 };
 
+template <typename Device, typename T>
+class LaunchCpuFastConvOp {
+ public:
+  bool Run(OpKernelContext* ctx, const Tensor& input, const Tensor& filter,
+           bool filter_is_const, const Conv2DDimensions& dimensions,
+           const std::function<void()>& run_generic, Tensor* output,
+           TensorFormat data_format) {
+    return false;
+  }
+};
+
+// Runs the Winograd and direct convolutions of conv_ops_cpu_fast.h when
+// TF_CPU_CONV2D_ALGORITHM selects them, or when they are faster than the
+// generic implementation with TF_CPU_CONV2D_ALGORITHM=autotune.
+// `filter_is_const` lets them cache the transform of a constant filter.
+template <>
+class LaunchCpuFastConvOp<CPUDevice, float> {
+ public:
+  bool Run(OpKernelContext* ctx, const Tensor& input, const Tensor& filter,
+           bool filter_is_const, const Conv2DDimensions& dimensions,
+           const std::function<void()>& run_generic, Tensor* output,
+           TensorFormat data_format) {
+    if (data_format != FORMAT_NHWC ||
+        dimensions.in_depth != dimensions.patch_depth) {
+      return false;
+    }
+
+    CpuConv2DArgs args;
+    args.batch = dimensions.batch;
+    args.in_rows = dimensions.input_rows;
+    args.in_cols = dimensions.input_cols;
+    args.in_depth = dimensions.in_depth;
+    args.filter_rows = dimensions.filter_rows;
+    args.filter_cols = dimensions.filter_cols;
+    args.out_depth = dimensions.out_depth;
+    args.out_rows = dimensions.out_rows;
+    args.out_cols = dimensions.out_cols;
+    args.stride_rows = dimensions.stride_rows;
+    args.stride_cols = dimensions.stride_cols;
+    args.dilation_rows = dimensions.dilation_rows;
+    args.dilation_cols = dimensions.dilation_cols;
+    args.pad_rows = dimensions.pad_rows_before;
+    args.pad_cols = dimensions.pad_cols_before;
+
+    return launcher_.Run(ctx, args, input, filter, filter_is_const,
+                         run_generic, output);
+  }
+
+ private:
+  CpuConv2DLauncher launcher_;
+};
+
+template <typename Device, typename T>
+class LaunchPackedConvOp {
+ public:
+  bool Run(OpKernelContext* ctx, const Tensor& input, const Tensor& filter,
+           const Conv2DDimensions& dimensions, const Padding& padding,
+           Tensor* output, TensorFormat data_format) {
+    return false;
+  }
+};
+
+// Runs the convolutions that LaunchGeneric reduces to a matrix multiplication
+// (1x1 filters, and filters as large as the image) with a constant filter
+// packed once, see matmul_op_packed.h.
+template <>
+class LaunchPackedConvOp<CPUDevice, float> {
+ public:
+  bool Run(OpKernelContext* ctx, const Tensor& input, const Tensor& filter,
+           const Conv2DDimensions& dimensions, const Padding& padding,
+           Tensor* output, TensorFormat data_format) {
+    if (data_format != FORMAT_NHWC ||
+        dimensions.in_depth != dimensions.patch_depth) {
+      return false;
+    }
+    const bool is_1x1 = dimensions.filter_rows == 1 &&
+                        dimensions.filter_cols == 1 &&
+                        dimensions.stride_rows == 1 &&
+                        dimensions.stride_cols == 1 &&
+                        (padding == SAME || padding == VALID);
+    const bool is_image_sized =
+        dimensions.filter_rows == dimensions.input_rows &&
+        dimensions.filter_cols == dimensions.input_cols &&
+        dimensions.dilation_rows == 1 && dimensions.dilation_cols == 1 &&
+        padding == VALID;
+    if (!is_1x1 && !is_image_sized) return false;
+
+    // The same [rows, depth] x [depth, out_depth] products as LaunchGeneric,
+    // on views of the tensors.
+    const int64 rows = is_1x1 ? output->NumElements() / dimensions.out_depth
+                              : dimensions.batch;
+    const int64 depth = filter.NumElements() / dimensions.out_depth;
+    Tensor a, b, out;
+    CHECK(a.CopyFrom(input, TensorShape({rows, depth})));
+    CHECK(b.CopyFrom(filter, TensorShape({depth, dimensions.out_depth})));
+    CHECK(out.CopyFrom(*output, TensorShape({rows, dimensions.out_depth})));
+
+    std::shared_ptr<const PackedMatMulRhs> packed_b =
+        packed_b_cache_.Get(b, /*transpose_b=*/false);
+    if (packed_b == nullptr) return false;
+    packed_b->Multiply(ctx, a, /*transpose_a=*/false,
+                       /*output_kernel=*/nullptr, &out);
+    return true;
+  }
+
+ private:
+  PackedMatMulRhsCache packed_b_cache_;
+};
+
 #ifdef TENSORFLOW_USE_LIBXSMM_CONVOLUTIONS
 template <typename Device, typename T>
 class LaunchXsmmConvOp {
@@ -475,6 +620,14 @@ class Conv2DOp : public BinaryOp<T> {
     OP_REQUIRES_OK(context, context->GetAttr("use_cudnn_on_gpu", &use_cudnn_));
     use_cudnn_ &= CanUseCudnn();
     cudnn_use_autotune_ = CudnnUseAutotune();
+
+    // Set by the remapper when the filter is a Const, see conv_ops_cpu_fast.h
+    // and LaunchPackedConvOp.
+    filter_is_const_ = false;
+    if (context->HasAttr(kConv2DConstantFilterAttr)) {
+      OP_REQUIRES_OK(context, context->GetAttr(kConv2DConstantFilterAttr,
+                                               &filter_is_const_));
+    }
   }
 
   void Compute(OpKernelContext* context) override {
@@ -542,18 +695,35 @@ class Conv2DOp : public BinaryOp<T> {
       return;
     }
 
-    launcher_(context, use_cudnn_, cudnn_use_autotune_, input, filter,
-              dimensions.dilation_rows, dimensions.dilation_cols,
-              dimensions.stride_rows, dimensions.stride_cols, params_.padding,
-              params_.explicit_paddings, output, params_.data_format);
+    const auto run_generic = [&]() {
+      if (filter_is_const_ &&
+          packed_launcher_.Run(context, input, filter, dimensions,
+                               params_.padding, output, params_.data_format)) {
+        return;
+      }
+      launcher_(context, use_cudnn_, cudnn_use_autotune_, input, filter,
+                dimensions.dilation_rows, dimensions.dilation_cols,
+                dimensions.stride_rows, dimensions.stride_cols,
+                params_.padding, params_.explicit_paddings, output,
+                params_.data_format);
+    };
+    if (fast_launcher_.Run(context, input, filter, filter_is_const_,
+                           dimensions, run_generic, output,
+                           params_.data_format)) {
+      return;
+    }
+    run_generic();
   }
 
  private:
   Conv2DParameters params_;
   bool use_cudnn_;
   bool cudnn_use_autotune_;
+  bool filter_is_const_;
 
   LaunchConv2DOp<Device, T> launcher_;
+  LaunchCpuFastConvOp<Device, T> fast_launcher_;
+  LaunchPackedConvOp<Device, T> packed_launcher_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(Conv2DOp);
 };
@@ -567,6 +737,7 @@ class Conv2DOp : public BinaryOp<T> {
 // CPU implementation, don't register this EigenTensor-based version.
 #if !defined(USE_GEMM_FOR_CONV)
 TF_CALL_half(REGISTER_CPU);
+TF_CALL_bfloat16(REGISTER_CPU);
 TF_CALL_float(REGISTER_CPU);
 TF_CALL_double(REGISTER_CPU);
 #endif  // USE_GEMM_FOR_CONV
@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <stdlib.h>
+
 #include <string>
 #include <vector>
 
@@ -71,6 +73,14 @@ static Tensor MakeRandomTensor(const TensorShape& shape) {
   return tensor;
 }
 
+template <>
+Tensor MakeRandomTensor<bfloat16>(const TensorShape& shape) {
+  Tensor tensor(DT_BFLOAT16, shape);
+  tensor.flat<bfloat16>() =
+      MakeRandomTensor<float>(shape).flat<float>().cast<bfloat16>();
+  return tensor;
+}
+
 // Creates a simple Tensorflow graph with single Conv2D node.
 template <typename T>
 static Conv2DGraph Conv2D(int batch, int height, int width, int in_depth,
@@ -505,6 +515,71 @@ BM_FusedConv2DWithBatchNormAndRelu(16, 32, 32, 128, 3, 3, 1024, cpu,
 BM_FusedConv2DWithBatchNormAndRelu(32, 32, 32, 128, 3, 3, 1024, cpu,
                                    "3x3 /b 32");
 
+// -------------------------------------------------------------------------- //
+// CPU Conv2D algorithms (see conv_ops_cpu_fast.h) for small-channel layers.
+// -------------------------------------------------------------------------- //
+
+// Kernels read TF_CPU_CONV2D_ALGORITHM when they are created, which happens
+// when the benchmark is constructed.
+#define BM_Conv2DAlgorithm(N, H, W, C, FW, FH, FC, ALGORITHM)              \
+  static void BM_NAME(BM_Conv2D_##ALGORITHM, cpu, N, H, W, C, FW, FH,      \
+                      FC)(int iters) {                                     \
+    BM_SETUP(N, H, W, C, cpu, #ALGORITHM, Conv2D);                         \
+    setenv("TF_CPU_CONV2D_ALGORITHM", #ALGORITHM, 1);                      \
+    test::Benchmark benchmark("cpu", Conv2D<float>(N, H, W, C, FW, FH, FC) \
+                                         .graph);                          \
+    unsetenv("TF_CPU_CONV2D_ALGORITHM");                                   \
+    benchmark.Run(iters);                                                  \
+  }                                                                        \
+  BENCHMARK(BM_NAME(BM_Conv2D_##ALGORITHM, cpu, N, H, W, C, FW, FH, FC));
+
+#define BM_Conv2DAlgorithms(N, H, W, C, FW, FH, FC)         \
+  BM_Conv2DAlgorithm(N, H, W, C, FW, FH, FC, generic);      \
+  BM_Conv2DAlgorithm(N, H, W, C, FW, FH, FC, winograd_2x2); \
+  BM_Conv2DAlgorithm(N, H, W, C, FW, FH, FC, winograd_4x4); \
+  BM_Conv2DAlgorithm(N, H, W, C, FW, FH, FC, direct);       \
+  BM_Conv2DAlgorithm(N, H, W, C, FW, FH, FC, autotune);
+
+// The first layer of an image model.
+BM_Conv2DAlgorithms(1, 224, 224, 3, 3, 3, 32);
+BM_Conv2DAlgorithms(8, 224, 224, 3, 3, 3, 32);
+
+// Small-channel 3x3 layers.
+BM_Conv2DAlgorithms(8, 56, 56, 16, 3, 3, 16);
+BM_Conv2DAlgorithms(8, 28, 28, 32, 3, 3, 32);
+BM_Conv2DAlgorithms(8, 14, 14, 64, 3, 3, 64);
+
+// Layers that only the direct algorithm applies to.
+BM_Conv2DAlgorithms(8, 112, 112, 8, 1, 1, 16);
+BM_Conv2DAlgorithms(8, 112, 112, 4, 5, 5, 16);
+
+// -------------------------------------------------------------------------- //
+// bfloat16 Conv2D on CPU, which widens its operands to float on every call.
+// -------------------------------------------------------------------------- //
+
+#define BM_Conv2DBfloat16(N, H, W, C, FW, FH, FC)                           \
+  static void BM_NAME(BM_Conv2D_float, cpu, N, H, W, C, FW, FH,             \
+                      FC)(int iters) {                                      \
+    BM_SETUP(N, H, W, C, cpu, "float", Conv2D);                             \
+    test::Benchmark("cpu", Conv2D<float>(N, H, W, C, FW, FH, FC).graph)     \
+        .Run(iters);                                                        \
+  }                                                                         \
+  BENCHMARK(BM_NAME(BM_Conv2D_float, cpu, N, H, W, C, FW, FH, FC));         \
+  static void BM_NAME(BM_Conv2D_bfloat16, cpu, N, H, W, C, FW, FH,          \
+                      FC)(int iters) {                                      \
+    BM_SETUP(N, H, W, C, cpu, "bfloat16", Conv2D);                          \
+    test::Benchmark("cpu", Conv2D<bfloat16>(N, H, W, C, FW, FH, FC).graph)  \
+        .Run(iters);                                                        \
+  }                                                                         \
+  BENCHMARK(BM_NAME(BM_Conv2D_bfloat16, cpu, N, H, W, C, FW, FH, FC));
+
+// ResNet50-ish convolutions.
+BM_Conv2DBfloat16(1, 56, 56, 64, 3, 3, 64);
+BM_Conv2DBfloat16(32, 56, 56, 64, 3, 3, 64);
+BM_Conv2DBfloat16(1, 14, 14, 256, 3, 3, 256);
+BM_Conv2DBfloat16(32, 14, 14, 256, 3, 3, 256);
+BM_Conv2DBfloat16(32, 14, 14, 1024, 1, 1, 256);
+
 #if GOOGLE_CUDA
 // -------------------------------------------------------------------------- //
 // 1x1 Convolution
@@ -0,0 +1,574 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/kernels/conv_ops_cpu_fast.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/util/env_var.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Layers with more input channels than this are left to the other algorithms.
+constexpr int kMaxDirectConv2DInDepth = 16;
+
+// The number of times a constant filter may be transformed before caching is
+// given up on. Autotuning transforms it once for every Winograd algorithm.
+constexpr int kMaxFilterTransforms = 6;
+
+// Number of tiles whose transformed inputs are multiplied with the transformed
+// filter at once by the Winograd algorithms.
+constexpr int kWinogradTileBlock = 32;
+
+// Winograd transforms from Lavin & Gray, "Fast Algorithms for Convolutional
+// Neural Networks", in row major order. A tile of the output is
+//   Y = A^T [(G g G^T) * (B^T d B)] A
+// for the 3x3 filter g and the input tile d.
+constexpr float kWinograd2x2BT[] = {
+    1, 0, -1, 0,   //
+    0, 1, 1,  0,   //
+    0, -1, 1, 0,   //
+    0, 1, 0,  -1,  //
+};
+constexpr float kWinograd2x2G[] = {
+    1,   0,    0,    //
+    0.5, 0.5,  0.5,  //
+    0.5, -0.5, 0.5,  //
+    0,   0,    1,    //
+};
+constexpr float kWinograd2x2AT[] = {
+    1, 1, 1,  0,   //
+    0, 1, -1, -1,  //
+};
+
+constexpr float kWinograd4x4BT[] = {
+    4, 0,  -5, 0,  1, 0,  //
+    0, -4, -4, 1,  1, 0,  //
+    0, 4,  -4, -1, 1, 0,  //
+    0, -2, -1, 2,  1, 0,  //
+    0, 2,  -1, -2, 1, 0,  //
+    0, 4,  0,  -5, 0, 1,  //
+};
+constexpr float kWinograd4x4G[] = {
+    1.0f / 4,   0,           0,           //
+    -1.0f / 6,  -1.0f / 6,   -1.0f / 6,   //
+    -1.0f / 6,  1.0f / 6,    -1.0f / 6,   //
+    1.0f / 24,  1.0f / 12,   1.0f / 6,    //
+    1.0f / 24,  -1.0f / 12,  1.0f / 6,    //
+    0,          0,           1,           //
+};
+constexpr float kWinograd4x4AT[] = {
+    1, 1, 1,  1, 1,  0,  //
+    0, 1, -1, 2, -2, 0,  //
+    0, 1, 1,  4, 4,  0,  //
+    0, 1, -1, 8, -8, 1,  //
+};
+
+struct WinogradTransform {
+  int tile;         // Output rows and columns of a tile.
+  int alpha;        // Input rows and columns of a tile: tile + 2.
+  const float* bt;  // alpha x alpha
+  const float* g;   // alpha x 3
+  const float* at;  // tile x alpha
+};
+
+const WinogradTransform& GetWinogradTransform(CpuConv2DAlgorithm algorithm) {
+  static const WinogradTransform winograd_2x2 = {
+      2, 4, kWinograd2x2BT, kWinograd2x2G, kWinograd2x2AT};
+  static const WinogradTransform winograd_4x4 = {
+      4, 6, kWinograd4x4BT, kWinograd4x4G, kWinograd4x4AT};
+  return algorithm == CpuConv2DAlgorithm::kWinograd2x2 ? winograd_2x2
+                                                       : winograd_4x4;
+}
+
+using ConstArray = Eigen::Map<const Eigen::ArrayXf>;
+using Array = Eigen::Map<Eigen::ArrayXf>;
+using RowMajorMatrix =
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+using ConstMatrix = Eigen::Map<const RowMajorMatrix>;
+using Matrix = Eigen::Map<RowMajorMatrix>;
+
+// y[0, n) += a * x[0, n)
+inline void Axpy(float a, const float* x, int64 n, float* y) {
+  if (a == 0) return;
+  Array(y, n) += a * ConstArray(x, n);
+}
+
+// Transforms the input channels [begin, end) of the [3, 3, C, K] `filter` into
+// alpha * alpha matrices of C x K.
+void WinogradTransformFilter(const WinogradTransform& w, int64 C, int64 K,
+                             const float* filter, int64 begin, int64 end,
+                             float* transformed) {
+  const int alpha = w.alpha;
+  std::vector<float> tmp(alpha * 3 * K);
+  for (int64 c = begin; c < end; ++c) {
+    // tmp = G g
+    std::fill(tmp.begin(), tmp.end(), 0.0f);
+    for (int a = 0; a < alpha; ++a) {
+      for (int s = 0; s < 3; ++s) {
+        for (int r = 0; r < 3; ++r) {
+          Axpy(w.g[a * 3 + r], filter + ((r * 3 + s) * C + c) * K, K,
+               &tmp[(a * 3 + s) * K]);
+        }
+      }
+    }
+    // transformed = tmp G^T
+    for (int a = 0; a < alpha; ++a) {
+      for (int b = 0; b < alpha; ++b) {
+        float* u = transformed + ((a * alpha + b) * C + c) * K;
+        std::fill(u, u + K, 0.0f);
+        for (int s = 0; s < 3; ++s) {
+          Axpy(w.g[b * 3 + s], &tmp[(a * 3 + s) * K], K, u);
+        }
+      }
+    }
+  }
+}
+
+// Transforms all the input channels of `filter`, see WinogradTransformFilter.
+void WinogradTransformFilter(
+    const DeviceBase::CpuWorkerThreads& worker_threads,
+    const WinogradTransform& w, int64 C, int64 K, const float* filter,
+    float* transformed) {
+  Shard(worker_threads.num_threads, worker_threads.workers, C,
+        2 * K * w.alpha * (3 + w.alpha) * 3, [&](int64 begin, int64 end) {
+          WinogradTransformFilter(w, C, K, filter, begin, end, transformed);
+        });
+}
+
+// Scratch buffers of one thread of WinogradConv2DTiles.
+struct WinogradScratch {
+  WinogradScratch(const WinogradTransform& w, int64 C, int64 K)
+      : d(w.alpha * w.alpha * C),
+        tmp(w.alpha * w.alpha * std::max(C, K)),
+        v(w.alpha * w.alpha * kWinogradTileBlock * C),
+        m(w.alpha * w.alpha * kWinogradTileBlock * K) {}
+
+  std::vector<float> d;    // An input tile: alpha x alpha x C.
+  std::vector<float> tmp;  // Half transformed tile: alpha x alpha x max(C, K).
+  std::vector<float> v;    // Transformed tiles: alpha x alpha x block x C.
+  std::vector<float> m;    // Products: alpha x alpha x block x K.
+};
+
+// Computes the output tiles [begin, end), at most kWinogradTileBlock of them,
+// with the filter transformed by WinogradTransformFilter.
+void WinogradConv2DTiles(const WinogradTransform& w, const CpuConv2DArgs& args,
+                         const float* input, const float* transformed_filter,
+                         int64 begin, int64 end, WinogradScratch* scratch,
+                         float* output) {
+  const int alpha = w.alpha;
+  const int64 C = args.in_depth;
+  const int64 K = args.out_depth;
+  const int64 tile_rows = (args.out_rows + w.tile - 1) / w.tile;
+  const int64 tile_cols = (args.out_cols + w.tile - 1) / w.tile;
+  const int64 num_tiles = end - begin;
+  float* d = scratch->d.data();
+  float* tmp = scratch->tmp.data();
+  float* v = scratch->v.data();
+  float* m = scratch->m.data();
+
+  // v[e][t] = (B^T d B)[e] for every tile t.
+  for (int64 t = 0; t < num_tiles; ++t) {
+    const int64 tile = begin + t;
+    const int64 n = tile / (tile_rows * tile_cols);
+    const int64 row = (tile / tile_cols) % tile_rows * w.tile - args.pad_rows;
+    const int64 col = tile % tile_cols * w.tile - args.pad_cols;
+    for (int i = 0; i < alpha; ++i) {
+      for (int j = 0; j < alpha; ++j) {
+        float* dst = d + (i * alpha + j) * C;
+        if (row + i < 0 || row + i >= args.in_rows || col + j < 0 ||
+            col + j >= args.in_cols) {
+          std::fill(dst, dst + C, 0.0f);
+        } else {
+          const float* src =
+              input + ((n * args.in_rows + row + i) * args.in_cols + col + j) *
+                          C;
+          std::copy(src, src + C, dst);
+        }
+      }
+    }
+    std::fill(tmp, tmp + alpha * alpha * C, 0.0f);
+    for (int a = 0; a < alpha; ++a) {
+      for (int j = 0; j < alpha; ++j) {
+        for (int i = 0; i < alpha; ++i) {
+          Axpy(w.bt[a * alpha + i], d + (i * alpha + j) * C, C,
+               tmp + (a * alpha + j) * C);
+        }
+      }
+    }
+    for (int a = 0; a < alpha; ++a) {
+      for (int b = 0; b < alpha; ++b) {
+        float* dst = v + ((a * alpha + b) * kWinogradTileBlock + t) * C;
+        std::fill(dst, dst + C, 0.0f);
+        for (int j = 0; j < alpha; ++j) {
+          Axpy(w.bt[b * alpha + j], tmp + (a * alpha + j) * C, C, dst);
+        }
+      }
+    }
+  }
+
+  // m[e] = v[e] * U[e]
+  for (int e = 0; e < alpha * alpha; ++e) {
+    Matrix(m + e * kWinogradTileBlock * K, num_tiles, K).noalias() =
+        ConstMatrix(v + e * kWinogradTileBlock * C, num_tiles, C) *
+        ConstMatrix(transformed_filter + e * C * K, C, K);
+  }
+
+  // Y = A^T m A for every tile.
+  for (int64 t = 0; t < num_tiles; ++t) {
+    const int64 tile = begin + t;
+    const int64 n = tile / (tile_rows * tile_cols);
+    const int64 row = (tile / tile_cols) % tile_rows * w.tile;
+    const int64 col = tile % tile_cols * w.tile;
+    std::fill(tmp, tmp + w.tile * alpha * K, 0.0f);
+    for (int p = 0; p < w.tile; ++p) {
+      for (int b = 0; b < alpha; ++b) {
+        for (int a = 0; a < alpha; ++a) {
+          Axpy(w.at[p * alpha + a],
+               m + ((a * alpha + b) * kWinogradTileBlock + t) * K, K,
+               tmp + (p * alpha + b) * K);
+        }
+      }
+    }
+    for (int p = 0; p < w.tile && row + p < args.out_rows; ++p) {
+      for (int q = 0; q < w.tile && col + q < args.out_cols; ++q) {
+        float* dst =
+            output + ((n * args.out_rows + row + p) * args.out_cols + col + q) *
+                         K;
+        std::fill(dst, dst + K, 0.0f);
+        for (int b = 0; b < alpha; ++b) {
+          Axpy(w.at[q * alpha + b], tmp + (p * alpha + b) * K, K, dst);
+        }
+      }
+    }
+  }
+}
+
+// Computes the output rows [begin, end) of all the images, flattened as
+// n * out_rows + out_row.
+void DirectConv2DRows(const CpuConv2DArgs& args, const float* input,
+                      const float* filter, int64 begin, int64 end,
+                      float* output) {
+  const int64 C = args.in_depth;
+  const int64 K = args.out_depth;
+  for (int64 image_row = begin; image_row < end; ++image_row) {
+    const int64 n = image_row / args.out_rows;
+    const int64 out_row = image_row % args.out_rows;
+    for (int64 out_col = 0; out_col < args.out_cols; ++out_col) {
+      float* dst = output + (image_row * args.out_cols + out_col) * K;
+      std::fill(dst, dst + K, 0.0f);
+      for (int r = 0; r < args.filter_rows; ++r) {
+        const int64 in_row = out_row * args.stride_rows - args.pad_rows +
+                             r * args.dilation_rows;
+        if (in_row < 0 || in_row >= args.in_rows) continue;
+        for (int s = 0; s < args.filter_cols; ++s) {
+          const int64 in_col = out_col * args.stride_cols - args.pad_cols +
+                               s * args.dilation_cols;
+          if (in_col < 0 || in_col >= args.in_cols) continue;
+          const float* x =
+              input + ((n * args.in_rows + in_row) * args.in_cols + in_col) * C;
+          const float* f = filter + (r * args.filter_cols + s) * C * K;
+          for (int64 c = 0; c < C; ++c) {
+            Axpy(x[c], f + c * K, K, dst);
+          }
+        }
+      }
+    }
+  }
+}
+
+// The autotuned algorithm of every shape.
+class Conv2DAutotuneMap {
+ public:
+  static Conv2DAutotuneMap* Global() {
+    static Conv2DAutotuneMap* map = new Conv2DAutotuneMap;
+    return map;
+  }
+
+  bool Find(const string& key, CpuConv2DAlgorithm* algorithm) const {
+    tf_shared_lock l(mu_);
+    auto it = algorithms_.find(key);
+    if (it == algorithms_.end()) return false;
+    *algorithm = it->second;
+    return true;
+  }
+
+  void Insert(const string& key, CpuConv2DAlgorithm algorithm) {
+    mutex_lock l(mu_);
+    algorithms_[key] = algorithm;
+  }
+
+ private:
+  mutable mutex mu_;
+  std::unordered_map<string, CpuConv2DAlgorithm> algorithms_ GUARDED_BY(mu_);
+};
+
+constexpr CpuConv2DAlgorithm kCpuConv2DAlgorithms[] = {
+    CpuConv2DAlgorithm::kGeneric, CpuConv2DAlgorithm::kWinograd2x2,
+    CpuConv2DAlgorithm::kWinograd4x4, CpuConv2DAlgorithm::kDirect};
+
+}  // namespace
+
+const char* CpuConv2DAlgorithmName(CpuConv2DAlgorithm algorithm) {
+  switch (algorithm) {
+    case CpuConv2DAlgorithm::kGeneric:
+      return "generic";
+    case CpuConv2DAlgorithm::kWinograd2x2:
+      return "winograd_2x2";
+    case CpuConv2DAlgorithm::kWinograd4x4:
+      return "winograd_4x4";
+    case CpuConv2DAlgorithm::kDirect:
+      return "direct";
+  }
+  return "unknown";
+}
+
+string CpuConv2DArgs::Key() const {
+  return absl::StrCat(batch, ",", in_rows, ",", in_cols, ",", in_depth, ",",
+                      filter_rows, ",", filter_cols, ",", out_depth, ",",
+                      out_rows, ",", out_cols, ",", stride_rows, ",",
+                      stride_cols, ",", dilation_rows, ",", dilation_cols, ",",
+                      pad_rows, ",", pad_cols);
+}
+
+bool CanUseCpuConv2DAlgorithm(CpuConv2DAlgorithm algorithm,
+                              const CpuConv2DArgs& args) {
+  switch (algorithm) {
+    case CpuConv2DAlgorithm::kGeneric:
+      return true;
+    case CpuConv2DAlgorithm::kWinograd2x2:
+    case CpuConv2DAlgorithm::kWinograd4x4:
+      return args.filter_rows == 3 && args.filter_cols == 3 &&
+             args.stride_rows == 1 && args.stride_cols == 1 &&
+             args.dilation_rows == 1 && args.dilation_cols == 1;
+    case CpuConv2DAlgorithm::kDirect:
+      return args.in_depth <= kMaxDirectConv2DInDepth;
+  }
+  return false;
+}
+
+CpuConv2DLauncher::CpuConv2DLauncher()
+    : autotune_(false), algorithm_(CpuConv2DAlgorithm::kGeneric) {
+  string name;
+  Status s = ReadStringFromEnvVar("TF_CPU_CONV2D_ALGORITHM", "generic", &name);
+  if (s.ok() && name == "autotune") {
+    autotune_ = true;
+    return;
+  }
+  if (s.ok()) {
+    for (CpuConv2DAlgorithm algorithm : kCpuConv2DAlgorithms) {
+      if (name == CpuConv2DAlgorithmName(algorithm)) {
+        algorithm_ = algorithm;
+        return;
+      }
+    }
+    s = errors::InvalidArgument("Unknown algorithm: ", name);
+  }
+  LOG(WARNING) << "Ignoring TF_CPU_CONV2D_ALGORITHM: " << s;
+}
+
+bool CpuConv2DLauncher::Run(OpKernelContext* ctx, const CpuConv2DArgs& args,
+                            const Tensor& input, const Tensor& filter,
+                            bool filter_is_const,
+                            const std::function<void()>& run_generic,
+                            Tensor* output) {
+  CpuConv2DAlgorithm algorithm = algorithm_;
+  if (autotune_) {
+    // Winograd wins more often when its filter transform is cached.
+    const string key =
+        filter_is_const ? absl::StrCat(args.Key(), ",const") : args.Key();
+    if (!Conv2DAutotuneMap::Global()->Find(key, &algorithm)) {
+      bool computed = false;
+      algorithm = Autotune(ctx, args, input, filter, filter_is_const,
+                           run_generic, &computed, output);
+      if (!ctx->status().ok()) return true;
+      Conv2DAutotuneMap::Global()->Insert(key, algorithm);
+      if (computed) return true;
+    }
+  } else if (!CanUseCpuConv2DAlgorithm(algorithm, args)) {
+    algorithm = CpuConv2DAlgorithm::kGeneric;
+  }
+  if (algorithm == CpuConv2DAlgorithm::kGeneric) return false;
+  Compute(ctx, algorithm, args, input, filter, filter_is_const, output);
+  return true;
+}
+
+CpuConv2DAlgorithm CpuConv2DLauncher::Autotune(
+    OpKernelContext* ctx, const CpuConv2DArgs& args, const Tensor& input,
+    const Tensor& filter, bool filter_is_const,
+    const std::function<void()>& run_generic, bool* computed, Tensor* output) {
+  std::vector<CpuConv2DAlgorithm> candidates;
+  for (CpuConv2DAlgorithm algorithm : kCpuConv2DAlgorithms) {
+    if (CanUseCpuConv2DAlgorithm(algorithm, args)) {
+      candidates.push_back(algorithm);
+    }
+  }
+  if (candidates.size() == 1) return candidates[0];
+
+  // Every candidate runs twice, so that the first run warms up the caches, and
+  // the second one is timed. The Winograd algorithms transform a variable
+  // filter on every run, so its cost is part of their time, while the first
+  // run caches the transform of a constant one. All of them compute the same
+  // `output`.
+  Env* env = Env::Default();
+  CpuConv2DAlgorithm best = CpuConv2DAlgorithm::kGeneric;
+  uint64 best_micros = ~uint64{0};
+  for (CpuConv2DAlgorithm algorithm : candidates) {
+    uint64 start_micros = 0;
+    for (int i = 0; i < 2; ++i) {
+      start_micros = env->NowMicros();
+      if (algorithm == CpuConv2DAlgorithm::kGeneric) {
+        run_generic();
+      } else {
+        Compute(ctx, algorithm, args, input, filter, filter_is_const,
+                output);
+      }
+      if (!ctx->status().ok()) return CpuConv2DAlgorithm::kGeneric;
+    }
+    const uint64 micros = env->NowMicros() - start_micros;
+    VLOG(2) << "Conv2D " << args.Key() << ": "
+            << CpuConv2DAlgorithmName(algorithm) << " took " << micros << "us";
+    if (micros < best_micros) {
+      best = algorithm;
+      best_micros = micros;
+    }
+  }
+  VLOG(1) << "Conv2D " << args.Key()
+          << ": autotuned to " << CpuConv2DAlgorithmName(best);
+  *computed = true;
+  return best;
+}
+
+void CpuConv2DLauncher::TransformFilter(OpKernelContext* ctx,
+                                        CpuConv2DAlgorithm algorithm,
+                                        const CpuConv2DArgs& args,
+                                        const Tensor& filter,
+                                        bool filter_is_const,
+                                        Tensor* transformed) {
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *ctx->device()->tensorflow_cpu_worker_threads();
+  const WinogradTransform& w = GetWinogradTransform(algorithm);
+  const int64 C = args.in_depth;
+  const int64 K = args.out_depth;
+  const TensorShape shape({w.alpha * w.alpha * C * K});
+
+  if (filter_is_const) {
+    mutex_lock l(mu_);
+    if (transformed_filter_.IsInitialized() &&
+        transformed_algorithm_ == algorithm &&
+        const_filter_.shape() == filter.shape() &&
+        const_filter_.tensor_data().data() == filter.tensor_data().data()) {
+      *transformed = transformed_filter_;
+      return;
+    }
+    if (num_filter_transforms_ < kMaxFilterTransforms) {
+      ++num_filter_transforms_;
+      // Not allocate_temp(): the transform outlives the step.
+      Tensor t(DT_FLOAT, shape);
+      WinogradTransformFilter(worker_threads, w, C, K,
+                              filter.flat<float>().data(),
+                              t.flat<float>().data());
+      const_filter_ = filter;
+      transformed_algorithm_ = algorithm;
+      transformed_filter_ = t;
+      *transformed = t;
+      return;
+    }
+    if (transformed_filter_.IsInitialized()) {
+      VLOG(1) << "Not caching a Conv2D filter that changed "
+              << num_filter_transforms_ << " times";
+      // Don't hold on to the last filter any longer than necessary.
+      const_filter_ = Tensor();
+      transformed_filter_ = Tensor();
+    }
+  }
+
+  OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_FLOAT, shape, transformed));
+  WinogradTransformFilter(worker_threads, w, C, K, filter.flat<float>().data(),
+                          transformed->flat<float>().data());
+}
+
+void CpuConv2DLauncher::Compute(OpKernelContext* ctx,
+                                CpuConv2DAlgorithm algorithm,
+                                const CpuConv2DArgs& args, const Tensor& input,
+                                const Tensor& filter, bool filter_is_const,
+                                Tensor* output) {
+  const float* input_data = input.flat<float>().data();
+  const float* filter_data = filter.flat<float>().data();
+  float* output_data = output->flat<float>().data();
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *ctx->device()->tensorflow_cpu_worker_threads();
+  const int64 C = args.in_depth;
+  const int64 K = args.out_depth;
+
+  if (algorithm == CpuConv2DAlgorithm::kDirect) {
+    const int64 cost_per_row =
+        2 * args.out_cols * args.filter_rows * args.filter_cols * C * K;
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          static_cast<int64>(args.batch) * args.out_rows, cost_per_row,
+          [&](int64 begin, int64 end) {
+            DirectConv2DRows(args, input_data, filter_data, begin, end,
+                             output_data);
+          });
+    return;
+  }
+
+  // A variable filter is transformed on every call, since it can be updated
+  // in place between calls. The transform of a constant one is cached, which
+  // matters for late layers with few tiles and many channels.
+  const WinogradTransform& w = GetWinogradTransform(algorithm);
+  const int64 alpha2 = w.alpha * w.alpha;
+  Tensor transformed_filter;
+  TransformFilter(ctx, algorithm, args, filter, filter_is_const,
+                  &transformed_filter);
+  if (!ctx->status().ok()) return;
+  const float* transformed_filter_data =
+      transformed_filter.flat<float>().data();
+
+  const int64 tile_rows = (args.out_rows + w.tile - 1) / w.tile;
+  const int64 tile_cols = (args.out_cols + w.tile - 1) / w.tile;
+  const int64 num_tiles = args.batch * tile_rows * tile_cols;
+  const int64 num_blocks =
+      (num_tiles + kWinogradTileBlock - 1) / kWinogradTileBlock;
+  const int64 cost_per_block =
+      kWinogradTileBlock * alpha2 * (2 * C * K + 2 * w.alpha * (C + K));
+  Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+        cost_per_block, [&](int64 begin, int64 end) {
+          WinogradScratch scratch(w, C, K);
+          for (int64 block = begin; block < end; ++block) {
+            const int64 first_tile = block * kWinogradTileBlock;
+            WinogradConv2DTiles(
+                w, args, input_data, transformed_filter_data, first_tile,
+                std::min(first_tile + kWinogradTileBlock, num_tiles), &scratch,
+                output_data);
+          }
+        });
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,144 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_CONV_OPS_CPU_FAST_H_
+#define TENSORFLOW_CORE_KERNELS_CONV_OPS_CPU_FAST_H_
+
+#include <functional>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+class OpKernelContext;
+
+// Set by the remapper on CPU Conv2D nodes whose filter is a Const. The same
+// attr as kMatMulConstantRhsAttr in matmul_op_packed.h.
+constexpr char kConv2DConstantFilterAttr[] = "_b_is_const";
+
+// Float NHWC Conv2D algorithms for the CPU, in addition to the generic
+// implementation in conv_ops.cc (Eigen's SpatialConvolution, or a matrix
+// multiplication for 1x1 and image-sized filters). DeepConv2D is handled
+// before these and is not one of them.
+enum class CpuConv2DAlgorithm {
+  kGeneric,
+  // Winograd F(2x2, 3x3) and F(4x4, 3x3): 3x3 filters, stride 1, no
+  // dilation. Each 4x4 (resp. 6x6) input tile is transformed and multiplied
+  // with the transformed filter, which saves 2.25x (resp. 4x) of the
+  // multiplications of a direct convolution, but rounds differently.
+  kWinograd2x2,
+  kWinograd4x4,
+  // Direct convolution vectorized over the output channels, for layers with
+  // few input channels (e.g. the first layer of an image model), where the
+  // patches of the generic implementation are mostly overhead.
+  kDirect,
+};
+
+const char* CpuConv2DAlgorithmName(CpuConv2DAlgorithm algorithm);
+
+// The shape of a Conv2D. `pad_rows` and `pad_cols` are the paddings before the
+// first row and column.
+struct CpuConv2DArgs {
+  int batch = 0;
+  int in_rows = 0;
+  int in_cols = 0;
+  int in_depth = 0;
+  int filter_rows = 0;
+  int filter_cols = 0;
+  int out_depth = 0;
+  int out_rows = 0;
+  int out_cols = 0;
+  int stride_rows = 0;
+  int stride_cols = 0;
+  int dilation_rows = 0;
+  int dilation_cols = 0;
+  int pad_rows = 0;
+  int pad_cols = 0;
+
+  // A string that identifies the shape, for autotuning.
+  string Key() const;
+};
+
+// Returns true if `algorithm` can compute convolutions of shape `args`.
+bool CanUseCpuConv2DAlgorithm(CpuConv2DAlgorithm algorithm,
+                              const CpuConv2DArgs& args);
+
+// Runs float NHWC convolutions with the algorithm selected by the
+// TF_CPU_CONV2D_ALGORITHM environment variable, read when the launcher is
+// created:
+//   "generic" (default): always use the generic implementation.
+//   "autotune": the first convolution of every shape times all the algorithms
+//       that apply to it and remembers the fastest for all kernels.
+//   "winograd_2x2", "winograd_4x4" or "direct": use this algorithm when it
+//       applies to the shape, and the generic one otherwise.
+//
+// The Winograd algorithms transform the filter on every call, unless it is
+// known to be constant: then the transform of the last filter is kept, with a
+// reference to the filter, and reused while the kernel gets the same buffer.
+class CpuConv2DLauncher {
+ public:
+  CpuConv2DLauncher();
+
+  // Computes `output` with `input` and `filter`, unless the selected algorithm
+  // is the generic one, in which case it returns false without touching
+  // `output`. `filter_is_const` is true if the filter comes from a Const node.
+  // `run_generic` computes `output` with the generic implementation and is
+  // used for autotuning.
+  bool Run(OpKernelContext* ctx, const CpuConv2DArgs& args,
+           const Tensor& input, const Tensor& filter, bool filter_is_const,
+           const std::function<void()>& run_generic, Tensor* output);
+
+ private:
+  void Compute(OpKernelContext* ctx, CpuConv2DAlgorithm algorithm,
+               const CpuConv2DArgs& args, const Tensor& input,
+               const Tensor& filter, bool filter_is_const, Tensor* output);
+
+  // Sets `transformed` to the Winograd transform of `filter` for `algorithm`,
+  // from the cache if `filter_is_const`.
+  void TransformFilter(OpKernelContext* ctx, CpuConv2DAlgorithm algorithm,
+                       const CpuConv2DArgs& args, const Tensor& filter,
+                       bool filter_is_const, Tensor* transformed);
+
+  // Returns the fastest algorithm for `args`. Sets `computed` if `output` was
+  // computed while timing the algorithms.
+  CpuConv2DAlgorithm Autotune(OpKernelContext* ctx, const CpuConv2DArgs& args,
+                              const Tensor& input, const Tensor& filter,
+                              bool filter_is_const,
+                              const std::function<void()>& run_generic,
+                              bool* computed, Tensor* output);
+
+  bool autotune_;
+  CpuConv2DAlgorithm algorithm_;
+
+  // The transform of the last constant filter. `const_filter_` holds on to
+  // the buffer that it is keyed on, so that it cannot be reused for another
+  // tensor while it is cached.
+  mutex mu_;
+  Tensor const_filter_ GUARDED_BY(mu_);
+  CpuConv2DAlgorithm transformed_algorithm_ GUARDED_BY(mu_) =
+      CpuConv2DAlgorithm::kGeneric;
+  Tensor transformed_filter_ GUARDED_BY(mu_);
+  int num_filter_transforms_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CpuConv2DLauncher);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_CONV_OPS_CPU_FAST_H_
@@ -13,6 +13,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <stdlib.h>
+
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -26,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/kernels/conv_ops_cpu_fast.h"
 #include "tensorflow/core/kernels/conv_ops_gpu.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
@@ -527,6 +531,109 @@ TEST_F(ConvOpTest, HandwrittenConv) { HandwrittenConv(); }
 
 TEST_F(ConvOpTest, AnisotropicStride) { AnisotropicStrides(); }
 
+// Checks the CPU Conv2D algorithms of conv_ops_cpu_fast.h against a naive
+// convolution.
+class CpuConv2DAlgorithmTest : public OpsTestBase {
+ protected:
+  void VerifyConv2D(const char* algorithm, int batch, int rows, int cols,
+                    int in_depth, int filter_rows, int filter_cols,
+                    int out_depth, int stride, const string& padding,
+                    bool filter_is_const = false) {
+    setenv("TF_CPU_CONV2D_ALGORITHM", algorithm, 1);
+    TF_EXPECT_OK(NodeDefBuilder("conv_op", "Conv2D")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("strides", {1, stride, stride, 1})
+                     .Attr("padding", padding)
+                     .Attr(kConv2DConstantFilterAttr, filter_is_const)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+    unsetenv("TF_CPU_CONV2D_ALGORITHM");
+
+    Tensor input(DT_FLOAT, {batch, rows, cols, in_depth});
+    Tensor filter(DT_FLOAT, {filter_rows, filter_cols, in_depth, out_depth});
+    input.flat<float>().setRandom();
+    filter.flat<float>().setRandom();
+    AddInputFromArray<float>(input.shape(), input.flat<float>());
+    AddInputFromArray<float>(filter.shape(), filter.flat<float>());
+    // The second run uses the autotuned algorithm, and the cached filter
+    // transform, of the first.
+    for (int run = 0; run < 2; ++run) {
+      TF_ASSERT_OK(RunOpKernel());
+    }
+
+    const Tensor& output = *GetOutput(0);
+    const int out_rows = output.dim_size(1);
+    const int out_cols = output.dim_size(2);
+    const int pad_rows =
+        std::max(0, (out_rows - 1) * stride + filter_rows - rows) / 2;
+    const int pad_cols =
+        std::max(0, (out_cols - 1) * stride + filter_cols - cols) / 2;
+    Tensor expected(DT_FLOAT, output.shape());
+    auto in = input.tensor<float, 4>();
+    auto f = filter.tensor<float, 4>();
+    auto out = expected.tensor<float, 4>();
+    for (int n = 0; n < batch; ++n) {
+      for (int i = 0; i < out_rows; ++i) {
+        for (int j = 0; j < out_cols; ++j) {
+          for (int k = 0; k < out_depth; ++k) {
+            double sum = 0;
+            for (int r = 0; r < filter_rows; ++r) {
+              for (int s = 0; s < filter_cols; ++s) {
+                const int row = i * stride - pad_rows + r;
+                const int col = j * stride - pad_cols + s;
+                if (row < 0 || row >= rows || col < 0 || col >= cols) continue;
+                for (int c = 0; c < in_depth; ++c) {
+                  sum += in(n, row, col, c) * f(r, s, c, k);
+                }
+              }
+            }
+            out(n, i, j, k) = sum;
+          }
+        }
+      }
+    }
+    test::ExpectTensorNear<float>(expected, output, 1e-3);
+  }
+};
+
+TEST_F(CpuConv2DAlgorithmTest, Winograd2x2) {
+  VerifyConv2D("winograd_2x2", 2, 9, 11, 5, 3, 3, 7, 1, "SAME");
+}
+
+TEST_F(CpuConv2DAlgorithmTest, Winograd4x4) {
+  VerifyConv2D("winograd_4x4", 2, 13, 10, 8, 3, 3, 12, 1, "VALID");
+}
+
+TEST_F(CpuConv2DAlgorithmTest, Winograd4x4ConstantFilter) {
+  VerifyConv2D("winograd_4x4", 2, 13, 10, 8, 3, 3, 12, 1, "VALID",
+               /*filter_is_const=*/true);
+}
+
+TEST_F(CpuConv2DAlgorithmTest, PackedConstantFilter1x1) {
+  VerifyConv2D("generic", 2, 6, 5, 8, 1, 1, 12, 1, "SAME",
+               /*filter_is_const=*/true);
+}
+
+TEST_F(CpuConv2DAlgorithmTest, PackedConstantFilterImageSized) {
+  VerifyConv2D("generic", 3, 4, 4, 5, 4, 4, 6, 1, "VALID",
+               /*filter_is_const=*/true);
+}
+
+TEST_F(CpuConv2DAlgorithmTest, Direct) {
+  VerifyConv2D("direct", 2, 12, 9, 3, 5, 3, 16, 2, "SAME");
+}
+
+TEST_F(CpuConv2DAlgorithmTest, Autotune) {
+  VerifyConv2D("autotune", 1, 16, 16, 4, 3, 3, 8, 1, "SAME");
+}
+
+TEST_F(CpuConv2DAlgorithmTest, AutotuneConstantFilter) {
+  VerifyConv2D("autotune", 1, 16, 16, 4, 3, 3, 8, 1, "SAME",
+               /*filter_is_const=*/true);
+}
+
 template <typename T>
 class FusedConv2DOpTest : public OpsTestBase {
  protected:
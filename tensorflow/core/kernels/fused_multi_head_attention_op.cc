@@ -0,0 +1,319 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/nn_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Queries and keys are processed in blocks of these many rows, so that the
+// scores of a block stay in cache.
+constexpr int64 kQueryBlockSize = 64;
+constexpr int64 kKeyBlockSize = 256;
+
+// Computes softmax(scale * query * key^T + mask) * value for blocks of query
+// rows of one batch entry, one block of keys at a time. The softmax is
+// computed online: the running maximum and sum of the exponentials of the
+// scores of each query row are kept along with the output accumulated so far,
+// which is rescaled whenever a larger maximum is found.
+template <typename T>
+class AttentionBlockComputer {
+ public:
+  using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic,
+                               Eigen::RowMajor>;
+  using ConstMatrixMap = Eigen::Map<const Matrix>;
+  using MatrixMap = Eigen::Map<Matrix>;
+  using RowVector = Eigen::Matrix<T, 1, Eigen::Dynamic>;
+  using Vector = Eigen::Array<T, Eigen::Dynamic, 1>;
+
+  AttentionBlockComputer(int64 key_length, int64 depth, int64 value_depth,
+                         T scale)
+      : key_length_(key_length),
+        depth_(depth),
+        value_depth_(value_depth),
+        scale_(scale),
+        scores_(kQueryBlockSize, std::min(kKeyBlockSize, key_length)),
+        accumulator_(kQueryBlockSize, value_depth),
+        row_max_(kQueryBlockSize),
+        new_row_max_(kQueryBlockSize),
+        row_sum_(kQueryBlockSize),
+        shift_(kQueryBlockSize),
+        correction_(kQueryBlockSize) {}
+
+  // Computes `rows` rows of the output at `output` from the query rows at
+  // `query`, the keys and values of the batch entry, and the mask rows at
+  // `mask`, if not null. The mask rows are `mask_row_stride` apart, and
+  // `mask_col_stride` is 0 for a mask broadcast along the keys.
+  void Compute(const T* query, const T* key, const T* value, const T* mask,
+               int64 mask_row_stride, int64 mask_col_stride, int64 rows,
+               T* output) {
+    const ConstMatrixMap q(query, rows, depth_);
+    auto accumulator = accumulator_.topRows(rows);
+    accumulator.setZero();
+    auto row_max = row_max_.head(rows);
+    auto row_sum = row_sum_.head(rows);
+    auto new_row_max = new_row_max_.head(rows);
+    auto shift = shift_.head(rows);
+    auto correction = correction_.head(rows);
+    row_max.setConstant(-std::numeric_limits<T>::infinity());
+    row_sum.setZero();
+
+    for (int64 start = 0; start < key_length_; start += kKeyBlockSize) {
+      const int64 cols = std::min(kKeyBlockSize, key_length_ - start);
+      const ConstMatrixMap k(key + start * depth_, cols, depth_);
+      const ConstMatrixMap v(value + start * value_depth_, cols, value_depth_);
+      auto scores = scores_.block(0, 0, rows, cols);
+      scores.noalias() = q * k.transpose();
+      scores *= scale_;
+      if (mask != nullptr) {
+        for (int64 i = 0; i < rows; ++i) {
+          const T* mask_row = mask + i * mask_row_stride;
+          if (mask_col_stride == 0) {
+            scores.row(i).array() += mask_row[0];
+          } else {
+            scores.row(i) +=
+                Eigen::Map<const RowVector>(mask_row + start, cols);
+          }
+        }
+      }
+
+      // Rows whose scores are all -inf so far are shifted by 0 instead of
+      // their maximum, which keeps their exponentials at 0 instead of NaN.
+      new_row_max = row_max.max(scores.rowwise().maxCoeff().array());
+      shift = (new_row_max == -std::numeric_limits<T>::infinity())
+                  .select(T(0), new_row_max);
+      scores.array().colwise() -= shift;
+      scores.array() = scores.array().exp();
+      correction = (row_max - shift).exp();
+      row_sum = row_sum * correction + scores.rowwise().sum().array();
+      accumulator.array().colwise() *= correction;
+      accumulator.noalias() += scores * v;
+      row_max = new_row_max;
+    }
+
+    // Like Softmax, rows whose scores are all -inf are NaN.
+    row_sum = (row_max == -std::numeric_limits<T>::infinity())
+                  .select(std::numeric_limits<T>::quiet_NaN(), row_sum);
+    MatrixMap(output, rows, value_depth_).array() =
+        accumulator.array().colwise() / row_sum;
+  }
+
+ private:
+  const int64 key_length_;
+  const int64 depth_;
+  const int64 value_depth_;
+  const T scale_;
+  Matrix scores_;
+  Matrix accumulator_;
+  Vector row_max_;
+  Vector new_row_max_;
+  Vector row_sum_;
+  Vector shift_;
+  Vector correction_;
+};
+
+}  // namespace
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+template <typename Device, typename T>
+class FusedMultiHeadAttentionOp : public OpKernel {
+ public:
+  explicit FusedMultiHeadAttentionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    float scale;
+    OP_REQUIRES_OK(context, context->GetAttr("scale", &scale));
+    scale_ = static_cast<T>(scale);
+    int num_masks;
+    OP_REQUIRES_OK(context, context->GetAttr("num_masks", &num_masks));
+    OP_REQUIRES(context, num_masks <= 1,
+                errors::InvalidArgument(
+                    "_FusedMultiHeadAttention supports at most one mask, got ",
+                    num_masks));
+    has_mask_ = num_masks == 1;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& query = context->input(0);
+    const Tensor& key = context->input(1);
+    const Tensor& value = context->input(2);
+    const int rank = query.dims();
+    OP_REQUIRES(context, rank >= 3,
+                errors::InvalidArgument("query must be at least rank 3: ",
+                                        query.shape().DebugString()));
+    OP_REQUIRES(context, key.dims() == rank && value.dims() == rank,
+                errors::InvalidArgument(
+                    "query, key and value must have the same rank: ",
+                    query.shape().DebugString(), " ",
+                    key.shape().DebugString(), " ",
+                    value.shape().DebugString()));
+
+    TensorShape output_shape;
+    int64 num_batches = 1;
+    for (int i = 0; i < rank - 2; ++i) {
+      const int64 dim = query.dim_size(i);
+      OP_REQUIRES(
+          context, key.dim_size(i) == dim && value.dim_size(i) == dim,
+          errors::InvalidArgument(
+              "query, key and value must have the same batch dimensions: ",
+              query.shape().DebugString(), " ", key.shape().DebugString(),
+              " ", value.shape().DebugString()));
+      output_shape.AddDim(dim);
+      num_batches *= dim;
+    }
+    const int64 query_length = query.dim_size(rank - 2);
+    const int64 key_length = key.dim_size(rank - 2);
+    const int64 depth = query.dim_size(rank - 1);
+    const int64 value_depth = value.dim_size(rank - 1);
+    OP_REQUIRES(context, key.dim_size(rank - 1) == depth,
+                errors::InvalidArgument(
+                    "query and key must have the same depth: ",
+                    query.shape().DebugString(), " ",
+                    key.shape().DebugString()));
+    OP_REQUIRES(context, value.dim_size(rank - 2) == key_length,
+                errors::InvalidArgument(
+                    "key and value must have the same length: ",
+                    key.shape().DebugString(), " ",
+                    value.shape().DebugString()));
+    output_shape.AddDim(query_length);
+    output_shape.AddDim(value_depth);
+
+    // The mask is broadcast to the [..., query_length, key_length] scores,
+    // without changing their shape.
+    const T* mask_data = nullptr;
+    gtl::InlinedVector<int64, 4> mask_batch_strides(rank - 2, 0);
+    int64 mask_row_stride = 0;
+    int64 mask_col_stride = 0;
+    if (has_mask_) {
+      const Tensor& mask = context->input(3);
+      OP_REQUIRES(context, mask.dims() <= rank,
+                  errors::InvalidArgument("mask must be at most rank ", rank,
+                                          ": ", mask.shape().DebugString()));
+      int64 stride = 1;
+      for (int i = mask.dims() - 1; i >= 0; --i) {
+        const int scores_dim = i + rank - mask.dims();
+        const int64 expected = scores_dim == rank - 1
+                                   ? key_length
+                                   : (scores_dim == rank - 2
+                                          ? query_length
+                                          : query.dim_size(scores_dim));
+        const int64 dim = mask.dim_size(i);
+        OP_REQUIRES(context, dim == 1 || dim == expected,
+                    errors::InvalidArgument(
+                        "mask of shape ", mask.shape().DebugString(),
+                        " cannot be broadcast to the scores of query ",
+                        query.shape().DebugString(), " and key ",
+                        key.shape().DebugString()));
+        const int64 dim_stride = dim == 1 ? 0 : stride;
+        if (scores_dim == rank - 1) {
+          mask_col_stride = dim_stride;
+        } else if (scores_dim == rank - 2) {
+          mask_row_stride = dim_stride;
+        } else {
+          mask_batch_strides[scores_dim] = dim_stride;
+        }
+        stride *= dim;
+      }
+      mask_data = mask.flat<T>().data();
+    }
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+    if (key_length == 0) {
+      // Softmax over no keys gives empty weights for no values.
+      output->flat<T>().setZero();
+      return;
+    }
+
+    const T* query_data = query.flat<T>().data();
+    const T* key_data = key.flat<T>().data();
+    const T* value_data = value.flat<T>().data();
+    T* output_data = output->flat<T>().data();
+    const T scale = scale_;
+    const int64 query_blocks =
+        (query_length + kQueryBlockSize - 1) / kQueryBlockSize;
+    // Returns the offset of the mask of a batch entry.
+    auto mask_offset = [&output_shape, &mask_batch_strides](int64 batch) {
+      int64 offset = 0;
+      for (int i = mask_batch_strides.size() - 1; i >= 0; --i) {
+        offset += batch % output_shape.dim_size(i) * mask_batch_strides[i];
+        batch /= output_shape.dim_size(i);
+      }
+      return offset;
+    };
+
+    auto compute = [&](int64 begin, int64 end) {
+      AttentionBlockComputer<T> computer(key_length, depth, value_depth,
+                                         scale);
+      for (int64 unit = begin; unit < end; ++unit) {
+        const int64 batch = unit / query_blocks;
+        const int64 row = unit % query_blocks * kQueryBlockSize;
+        const int64 rows = std::min(kQueryBlockSize, query_length - row);
+        const T* mask = nullptr;
+        if (mask_data != nullptr) {
+          mask = mask_data + mask_offset(batch) + row * mask_row_stride;
+        }
+        computer.Compute(
+            query_data + (batch * query_length + row) * depth,
+            key_data + batch * key_length * depth,
+            value_data + batch * key_length * value_depth, mask,
+            mask_row_stride, mask_col_stride, rows,
+            output_data + (batch * query_length + row) * value_depth);
+      }
+    };
+    const int64 cost_per_unit =
+        kQueryBlockSize * key_length * (depth + value_depth + 10);
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          num_batches * query_blocks, cost_per_unit, compute);
+  }
+
+ private:
+  T scale_;
+  bool has_mask_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FusedMultiHeadAttentionOp);
+};
+
+#define REGISTER_CPU(T)                                            \
+  REGISTER_KERNEL_BUILDER(Name("_FusedMultiHeadAttention")         \
+                              .Device(DEVICE_CPU)                  \
+                              .TypeConstraint<T>("T"),             \
+                          FusedMultiHeadAttentionOp<CPUDevice, T>);
+
+TF_CALL_float(REGISTER_CPU);
+TF_CALL_double(REGISTER_CPU);
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
@@ -0,0 +1,277 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the mask value of a score given its batch, row and column.
+using MaskFn = std::function<float(int64, int64, int64)>;
+
+// Computes softmax(scale * query * key^T + mask) * value one query row at a
+// time, in double precision.
+Tensor ReferenceAttention(const Tensor& query, const Tensor& key,
+                          const Tensor& value, float scale,
+                          const MaskFn& mask) {
+  const auto q = query.flat_inner_dims<float, 3>();
+  const auto k = key.flat_inner_dims<float, 3>();
+  const auto v = value.flat_inner_dims<float, 3>();
+  const int64 num_batches = q.dimension(0);
+  const int64 query_length = q.dimension(1);
+  const int64 key_length = k.dimension(1);
+  const int64 depth = q.dimension(2);
+  const int64 value_depth = v.dimension(2);
+
+  TensorShape output_shape = query.shape();
+  output_shape.set_dim(output_shape.dims() - 1, value_depth);
+  Tensor output(DT_FLOAT, output_shape);
+  auto out = output.flat_inner_dims<float, 3>();
+  std::vector<double> scores(key_length);
+  for (int64 b = 0; b < num_batches; ++b) {
+    for (int64 i = 0; i < query_length; ++i) {
+      double max_score = -std::numeric_limits<double>::infinity();
+      for (int64 j = 0; j < key_length; ++j) {
+        double dot = 0;
+        for (int64 d = 0; d < depth; ++d) dot += q(b, i, d) * k(b, j, d);
+        scores[j] = scale * dot + mask(b, i, j);
+        max_score = std::max(max_score, scores[j]);
+      }
+      double sum = 0;
+      for (int64 j = 0; j < key_length; ++j) {
+        scores[j] = std::exp(scores[j] - max_score);
+        sum += scores[j];
+      }
+      for (int64 d = 0; d < value_depth; ++d) {
+        double result = 0;
+        for (int64 j = 0; j < key_length; ++j) result += scores[j] * v(b, j, d);
+        out(b, i, d) = result / sum;
+      }
+    }
+  }
+  return output;
+}
+
+float NoMask(int64 batch, int64 row, int64 col) { return 0; }
+
+class FusedMultiHeadAttentionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(float scale, bool has_mask) {
+    TF_ASSERT_OK(NodeDefBuilder("op", "_FusedMultiHeadAttention")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(has_mask ? 1 : 0, DT_FLOAT))
+                     .Attr("scale", scale)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Adds query, key and value inputs with smoothly varying values.
+  void AddAttentionInputs(const TensorShape& query_shape,
+                          const TensorShape& key_shape,
+                          const TensorShape& value_shape) {
+    AddInput<float>(query_shape, [](int i) { return std::sin(i * 0.37f); });
+    AddInput<float>(key_shape, [](int i) { return std::cos(i * 0.23f); });
+    AddInput<float>(value_shape, [](int i) { return std::sin(i * 0.11f); });
+  }
+
+  void ExpectReferenceOutput(float scale, const MaskFn& mask) {
+    Tensor expected =
+        ReferenceAttention(GetInput(0), GetInput(1), GetInput(2), scale, mask);
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+  }
+};
+
+TEST_F(FusedMultiHeadAttentionOpTest, NoMask) {
+  MakeOp(0.5f, /*has_mask=*/false);
+  AddAttentionInputs(TensorShape({2, 3, 5, 4}), TensorShape({2, 3, 7, 4}),
+                     TensorShape({2, 3, 7, 6}));
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectReferenceOutput(0.5f, NoMask);
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, BroadcastPaddingMask) {
+  // A [batch, 1, 1, key_length] padding mask, as built by BERT.
+  MakeOp(0.5f, /*has_mask=*/true);
+  AddAttentionInputs(TensorShape({2, 3, 5, 4}), TensorShape({2, 3, 7, 4}),
+                     TensorShape({2, 3, 7, 6}));
+  AddInputFromArray<float>(TensorShape({2, 1, 1, 7}),
+                           {0, 0, 0, 0, 0, -10000, -10000,  //
+                            0, 0, 0, -10000, -10000, -10000, -10000});
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectReferenceOutput(0.5f, [](int64 batch, int64 row, int64 col) {
+    const int64 length = batch < 3 ? 5 : 3;
+    return col < length ? 0.0f : -10000.0f;
+  });
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, RowMaskOfLowerRank) {
+  MakeOp(1.0f, /*has_mask=*/true);
+  AddAttentionInputs(TensorShape({2, 5, 4}), TensorShape({2, 7, 4}),
+                     TensorShape({2, 7, 3}));
+  AddInputFromArray<float>(TensorShape({5, 1}), {1, -2, 3, -4, 5});
+  TF_ASSERT_OK(RunOpKernel());
+  // A constant added to all the scores of a row does not change its softmax.
+  ExpectReferenceOutput(1.0f, NoMask);
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, MultipleBlocks) {
+  // More queries and keys than fit in one block, with a full causal mask.
+  MakeOp(0.25f, /*has_mask=*/true);
+  AddAttentionInputs(TensorShape({2, 70, 8}), TensorShape({2, 600, 8}),
+                     TensorShape({2, 600, 5}));
+  AddInput<float>(TensorShape({70, 600}), [](int i) {
+    return i % 600 <= i / 600 * 8 ? 0.0f : -10000.0f;
+  });
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectReferenceOutput(0.25f, [](int64 batch, int64 row, int64 col) {
+    return col <= row * 8 ? 0.0f : -10000.0f;
+  });
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, FullyMaskedRowIsNaN) {
+  MakeOp(1.0f, /*has_mask=*/true);
+  AddAttentionInputs(TensorShape({1, 2, 4}), TensorShape({1, 3, 4}),
+                     TensorShape({1, 3, 2}));
+  const float inf = std::numeric_limits<float>::infinity();
+  AddInputFromArray<float>(TensorShape({2, 3}), {-inf, -inf, -inf, 0, 0, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  const auto output = GetOutput(0)->flat<float>();
+  EXPECT_TRUE(std::isnan(output(0)));
+  EXPECT_TRUE(std::isnan(output(1)));
+  EXPECT_TRUE(std::isfinite(output(2)));
+  EXPECT_TRUE(std::isfinite(output(3)));
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, NoKeys) {
+  MakeOp(1.0f, /*has_mask=*/false);
+  AddAttentionInputs(TensorShape({1, 2, 4}), TensorShape({1, 0, 4}),
+                     TensorShape({1, 0, 3}));
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 2, 3}));
+  test::FillValues<float>(&expected, {0, 0, 0, 0, 0, 0});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, MismatchedBatchDimensions) {
+  MakeOp(1.0f, /*has_mask=*/false);
+  AddAttentionInputs(TensorShape({2, 5, 4}), TensorShape({1, 7, 4}),
+                     TensorShape({2, 7, 3}));
+  Status s = RunOpKernel();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(), "same batch dimensions"))
+      << s;
+}
+
+TEST_F(FusedMultiHeadAttentionOpTest, MaskNotBroadcastable) {
+  MakeOp(1.0f, /*has_mask=*/true);
+  AddAttentionInputs(TensorShape({2, 5, 4}), TensorShape({2, 7, 4}),
+                     TensorShape({2, 7, 3}));
+  AddInput<float>(TensorShape({5, 6}), [](int i) { return 0.0f; });
+  Status s = RunOpKernel();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(), "cannot be broadcast"))
+      << s;
+}
+
+// Attention of `kNumHeads` heads of depth `kDepth` over `seq_length` tokens,
+// with a padding mask, either with the fused kernel or with the
+// BatchMatMul + Mul + Add + Softmax + BatchMatMul graph it replaces.
+constexpr int kNumHeads = 12;
+constexpr int kDepth = 64;
+
+Graph* AttentionGraph(int seq_length, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor query(DT_FLOAT, TensorShape({kNumHeads, seq_length, kDepth}));
+  Tensor key(DT_FLOAT, TensorShape({kNumHeads, seq_length, kDepth}));
+  Tensor value(DT_FLOAT, TensorShape({kNumHeads, seq_length, kDepth}));
+  Tensor mask(DT_FLOAT, TensorShape({1, 1, seq_length}));
+  query.flat<float>().setRandom();
+  key.flat<float>().setRandom();
+  value.flat<float>().setRandom();
+  mask.flat<float>().setZero();
+  Node* query_node = test::graph::Constant(g, query);
+  Node* key_node = test::graph::Constant(g, key);
+  Node* value_node = test::graph::Constant(g, value);
+  Node* mask_node = test::graph::Constant(g, mask);
+  const float scale = 1 / std::sqrt(static_cast<float>(kDepth));
+
+  if (fused) {
+    Node* ret;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_FusedMultiHeadAttention")
+                    .Input(query_node)
+                    .Input(key_node)
+                    .Input(value_node)
+                    .Input(std::vector<NodeBuilder::NodeOut>({mask_node}))
+                    .Attr("T", DT_FLOAT)
+                    .Attr("scale", scale)
+                    .Finalize(g, &ret));
+    return g;
+  }
+
+  Node* scores = test::graph::BatchMatmul(g, query_node, key_node,
+                                          /*adj_x=*/false, /*adj_y=*/true);
+  scores = test::graph::Binary(
+      g, "Mul", scores, test::graph::Constant(g, test::AsScalar<float>(scale)));
+  scores = test::graph::Binary(g, "Add", scores, mask_node);
+  Node* probs = test::graph::Unary(g, "Softmax", scores);
+  test::graph::BatchMatmul(g, probs, value_node, /*adj_x=*/false,
+                           /*adj_y=*/false);
+  return g;
+}
+
+static void BM_Attention(int iters, int seq_length, bool fused) {
+  testing::StopTiming();
+  Graph* g = AttentionGraph(seq_length, fused);
+  // Multiply-adds of the two matrix products.
+  testing::ItemsProcessed(static_cast<int64>(iters) * kNumHeads * seq_length *
+                          seq_length * kDepth * 2);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+static void BM_AttentionFused(int iters, int seq_length) {
+  BM_Attention(iters, seq_length, /*fused=*/true);
+}
+
+static void BM_AttentionUnfused(int iters, int seq_length) {
+  BM_Attention(iters, seq_length, /*fused=*/false);
+}
+
+BENCHMARK(BM_AttentionFused)->Arg(128)->Arg(512)->Arg(2048);
+BENCHMARK(BM_AttentionUnfused)->Arg(128)->Arg(512)->Arg(2048);
+
+}  // namespace
+}  // namespace tensorflow
@@ -30,8 +30,8 @@ limitations under the License.
 namespace tensorflow {
 namespace lookup {
 
-// Lookup table that wraps an unordered_map, where the key and value data type
-// is specified. Each individual value must be a scalar. If vector values are
+// Lookup table that wraps a FlatHashMap, where the key and value data type is
+// specified. Each individual value must be a scalar. If vector values are
 // required, use MutableHashTableOfTensors.
 //
 // This table is mutable and thread safe - Insert can be called at any time.
@@ -57,15 +57,10 @@ class MutableHashTableOfScalars final : public LookupInterface {
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
     const V default_val = default_value.flat<V>()(0);
-    const auto key_values = key.flat<K>();
-    auto value_values = value->flat<V>();
 
     tf_shared_lock l(mu_);
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      value_values(i) = gtl::FindWithDefault(
-          table_, SubtleMustCopyIfIntegral(key_values(i)), default_val);
-    }
-
+    FindInFlatHashMap<K, V>(table_, key.flat<K>(), default_val,
+                            value->flat<V>());
     return Status::OK();
   }
 
@@ -77,6 +72,7 @@ class MutableHashTableOfScalars final : public LookupInterface {
     if (clear) {
       table_.clear();
     }
+    table_.reserve(table_.size() + key_values.size());
     for (int64 i = 0; i < key_values.size(); ++i) {
       gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
                           SubtleMustCopyIfIntegral(value_values(i)));
@@ -134,22 +130,13 @@ class MutableHashTableOfScalars final : public LookupInterface {
   TensorShape value_shape() const override { return TensorShape(); }
 
   int64 MemoryUsed() const override {
-    int64 ret = 0;
     tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfScalars) + ret;
+    return sizeof(MutableHashTableOfScalars) + FlatHashMapMemoryUsed(table_);
   }
 
  private:
   mutable mutex mu_;
-  std::unordered_map<K, V> table_ GUARDED_BY(mu_);
+  FlatHashMap<K, V> table_ GUARDED_BY(mu_);
 };
 
 // Lookup table that wraps an unordered_map. Behaves identical to
@@ -16,6 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 #define TENSORFLOW_CORE_KERNELS_LOOKUP_TABLE_OP_H_
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/lookup_interface.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -148,7 +151,58 @@ inline const Variant& SubtleMustCopyIfIntegral(const Variant& value) {
   return value;
 }
 
-// Lookup table that wraps an unordered_map, where the key and value data type
+// Hashes the keys of the tables backed by a FlatHashMap.
+template <typename K>
+struct FlatHashMapHash : public absl::Hash<K> {};
+
+#ifdef USE_TSTRING
+template <>
+struct FlatHashMapHash<tstring> {
+  size_t operator()(const tstring& key) const {
+    return absl::Hash<absl::string_view>()(
+        absl::string_view(key.data(), key.size()));
+  }
+};
+#endif  // USE_TSTRING
+
+// The hash map backing the scalar lookup tables. It is an open addressing
+// table whose slots are stored contiguously, next to an array of control
+// bytes that are probed a group at a time with SIMD instructions. Unlike
+// std::unordered_map, a lookup does not chase a pointer per node and inserts
+// do not allocate per element.
+template <typename K, typename V>
+using FlatHashMap = absl::flat_hash_map<K, V, FlatHashMapHash<K>>;
+
+// The number of keys ahead of the current one whose slots are prefetched by
+// FindInFlatHashMap, so that the cache misses of consecutive lookups in a
+// large table overlap.
+constexpr int64 kFlatHashMapPrefetchLookahead = 16;
+
+// Looks up all the `keys` in `table`, and stores their values, or
+// `default_value` for the missing keys, in `values`.
+template <typename K, typename V>
+void FindInFlatHashMap(const FlatHashMap<K, V>& table,
+                       typename TTypes<K>::ConstFlat keys,
+                       const V& default_value,
+                       typename TTypes<V>::Flat values) {
+  const int64 num_keys = keys.size();
+  for (int64 i = 0; i < num_keys; ++i) {
+    if (i + kFlatHashMapPrefetchLookahead < num_keys) {
+      table.prefetch(keys(i + kFlatHashMapPrefetchLookahead));
+    }
+    values(i) = gtl::FindWithDefault(table, SubtleMustCopyIfIntegral(keys(i)),
+                                     default_value);
+  }
+}
+
+// Returns the memory used by the slots and control bytes of `table`.
+template <typename K, typename V>
+int64 FlatHashMapMemoryUsed(const FlatHashMap<K, V>& table) {
+  using Slot = typename FlatHashMap<K, V>::value_type;
+  return table.capacity() * (sizeof(Slot) + 1);
+}
+
+// Lookup table that wraps a FlatHashMap, where the key and value data type
 // is specified.
 //
 // This table is recommended for any variations to key values.
@@ -216,8 +270,7 @@ class HashTable : public InitializableLookupTable {
       return errors::Aborted("HashTable already initialized.");
     }
     if (!table_) {
-      table_ = std::unique_ptr<std::unordered_map<K, V>>(
-          new std::unordered_map<K, V>());
+      table_ = std::unique_ptr<FlatHashMap<K, V>>(new FlatHashMap<K, V>());
     }
     return Status::OK();
   };
@@ -234,6 +287,9 @@ class HashTable : public InitializableLookupTable {
 
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
+    // The size of the table is not known when it is prepared, so grow it
+    // once per batch of keys instead of once per power of two.
+    table_->reserve(table_->size() + key_values.size());
     for (int64 i = 0; i < key_values.size(); ++i) {
       const K key = SubtleMustCopyIfIntegral(key_values(i));
       const V value = SubtleMustCopyIfIntegral(value_values(i));
@@ -250,27 +306,17 @@ class HashTable : public InitializableLookupTable {
   Status DoFind(const Tensor& key, Tensor* value,
                 const Tensor& default_value) override {
     const V default_val = default_value.flat<V>()(0);
-    const auto key_values = key.flat<K>();
-    auto value_values = value->flat<V>();
-
-    for (int64 i = 0; i < key_values.size(); ++i) {
-      value_values(i) = gtl::FindWithDefault(
-          *table_, SubtleMustCopyIfIntegral(key_values(i)), default_val);
-    }
+    FindInFlatHashMap<K, V>(*table_, key.flat<K>(), default_val,
+                            value->flat<V>());
     return Status::OK();
   }
 
   int64 MemoryUsed() const override {
-    if (table_) {
-      const int64 num_elements = table_->size();
-      return num_elements * (sizeof(K) + sizeof(V));
-    } else {
-      return 0;
-    }
+    return table_ ? FlatHashMapMemoryUsed(*table_) : 0;
   }
 
  private:
-  std::unique_ptr<std::unordered_map<K, V>> table_;
+  std::unique_ptr<FlatHashMap<K, V>> table_;
 };
 
 }  // namespace lookup
@@ -0,0 +1,185 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/lookup_table_op.h"
+
+#include <unordered_map>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+// Returns `num_keys` distinct keys, spread like the ids of a vocabulary.
+template <typename K>
+Tensor MakeKeys(int64 num_keys);
+
+template <>
+Tensor MakeKeys<int64>(int64 num_keys) {
+  Tensor keys(DT_INT64, TensorShape({num_keys}));
+  auto keys_flat = keys.flat<int64>();
+  for (int64 i = 0; i < num_keys; ++i) keys_flat(i) = i * 7919 + 13;
+  return keys;
+}
+
+template <>
+Tensor MakeKeys<tstring>(int64 num_keys) {
+  Tensor keys(DT_STRING, TensorShape({num_keys}));
+  auto keys_flat = keys.flat<tstring>();
+  for (int64 i = 0; i < num_keys; ++i) {
+    keys_flat(i) = strings::StrCat("token_", i);
+  }
+  return keys;
+}
+
+// Returns the values 0, 1, ..., num_values - 1.
+Tensor MakeValues(int64 num_values) {
+  Tensor values(DT_INT64, TensorShape({num_values}));
+  auto values_flat = values.flat<int64>();
+  for (int64 i = 0; i < num_values; ++i) values_flat(i) = i;
+  return values;
+}
+
+// Returns `num_queries` keys drawn at random from `keys`.
+template <typename K>
+Tensor MakeQueries(const Tensor& keys, int64 num_queries) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor queries(keys.dtype(), TensorShape({num_queries}));
+  auto queries_flat = queries.flat<K>();
+  const auto keys_flat = keys.flat<K>();
+  for (int64 i = 0; i < num_queries; ++i) {
+    queries_flat(i) = keys_flat(rnd.Uniform64(keys_flat.size()));
+  }
+  return queries;
+}
+
+template <typename K>
+HashTable<K, int64>* MakeHashTable(const Tensor& keys, const Tensor& values) {
+  auto* table = new HashTable<K, int64>(nullptr, nullptr);
+  KeyValueTensorIterator iter(&keys, &values);
+  TF_CHECK_OK(table->Initialize(iter));
+  return table;
+}
+
+TEST(HashTableTest, FindInt64Keys) {
+  HashTable<int64, int64>* table =
+      MakeHashTable<int64>(test::AsTensor<int64>({10, 20, 30}),
+                           test::AsTensor<int64>({1, 2, 3}));
+  core::ScopedUnref unref(table);
+  EXPECT_EQ(3, table->size());
+
+  const Tensor queries = test::AsTensor<int64>({30, 15, 10, 20, 40});
+  Tensor found(DT_INT64, queries.shape());
+  TF_ASSERT_OK(
+      table->Find(nullptr, queries, &found, test::AsScalar<int64>(-1)));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({3, -1, 1, 2, -1}),
+                                 found);
+}
+
+TEST(HashTableTest, FindManyStringKeys) {
+  // More keys than are prefetched ahead of a lookup.
+  const int64 kNumKeys = 1000;
+  const Tensor keys = MakeKeys<tstring>(kNumKeys);
+  HashTable<tstring, int64>* table =
+      MakeHashTable<tstring>(keys, MakeValues(kNumKeys));
+  core::ScopedUnref unref(table);
+  EXPECT_EQ(kNumKeys, table->size());
+
+  // Every key in reverse order, each followed by a missing key.
+  Tensor queries(DT_STRING, TensorShape({2 * kNumKeys}));
+  Tensor expected(DT_INT64, TensorShape({2 * kNumKeys}));
+  for (int64 i = 0; i < kNumKeys; ++i) {
+    const int64 key = kNumKeys - 1 - i;
+    queries.flat<tstring>()(2 * i) = keys.flat<tstring>()(key);
+    queries.flat<tstring>()(2 * i + 1) = strings::StrCat("missing_", key);
+    expected.flat<int64>()(2 * i) = key;
+    expected.flat<int64>()(2 * i + 1) = -1;
+  }
+  Tensor found(DT_INT64, queries.shape());
+  TF_ASSERT_OK(
+      table->Find(nullptr, queries, &found, test::AsScalar<int64>(-1)));
+  test::ExpectTensorEqual<int64>(expected, found);
+}
+
+constexpr int64 kNumQueries = 1 << 16;
+
+template <typename K>
+void BM_HashTableFind(int iters, int num_keys) {
+  testing::StopTiming();
+  const Tensor keys = MakeKeys<K>(num_keys);
+  HashTable<K, int64>* table = MakeHashTable<K>(keys, MakeValues(num_keys));
+  core::ScopedUnref unref(table);
+  const Tensor queries = MakeQueries<K>(keys, kNumQueries);
+  const Tensor default_value = test::AsScalar<int64>(-1);
+  Tensor found(DT_INT64, queries.shape());
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(table->Find(nullptr, queries, &found, default_value));
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * kNumQueries);
+}
+
+// The lookups of the std::unordered_map that used to back HashTable, for
+// comparison.
+template <typename K>
+void BM_UnorderedMapFind(int iters, int num_keys) {
+  testing::StopTiming();
+  const Tensor keys = MakeKeys<K>(num_keys);
+  std::unordered_map<K, int64> table;
+  for (int64 i = 0; i < num_keys; ++i) table[keys.flat<K>()(i)] = i;
+  const Tensor queries = MakeQueries<K>(keys, kNumQueries);
+  const auto queries_flat = queries.flat<K>();
+  Tensor found(DT_INT64, queries.shape());
+  auto found_flat = found.flat<int64>();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    for (int64 j = 0; j < kNumQueries; ++j) {
+      found_flat(j) = gtl::FindWithDefault(table, queries_flat(j), -1);
+    }
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * kNumQueries);
+}
+
+static void BM_HashTableFindInt64(int iters, int num_keys) {
+  BM_HashTableFind<int64>(iters, num_keys);
+}
+static void BM_UnorderedMapFindInt64(int iters, int num_keys) {
+  BM_UnorderedMapFind<int64>(iters, num_keys);
+}
+static void BM_HashTableFindString(int iters, int num_keys) {
+  BM_HashTableFind<tstring>(iters, num_keys);
+}
+static void BM_UnorderedMapFindString(int iters, int num_keys) {
+  BM_UnorderedMapFind<tstring>(iters, num_keys);
+}
+
+BENCHMARK(BM_HashTableFindInt64)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24);
+BENCHMARK(BM_UnorderedMapFindInt64)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24);
+BENCHMARK(BM_HashTableFindString)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24);
+BENCHMARK(BM_UnorderedMapFindString)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24);
+
+}  // namespace
+}  // namespace lookup
+}  // namespace tensorflow
@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/kernels/fill_functor.h"
+#include "tensorflow/core/kernels/matmul_op_packed.h"
 #include "tensorflow/core/util/matmul_autotune.h"
 #if GOOGLE_CUDA
 #include "third_party/gpus/cuda/include/cuda.h"
@@ -448,6 +449,14 @@ class MatMulOp : public OpKernel {
     LaunchMatMul<Device, T, USE_CUBLAS>::GetBlasGemmAlgorithm(
         ctx, &algorithms_, &algorithms_set_already_);
     use_autotune_ = MatmulAutotuneEnable();
+
+    // Constant weights are packed once for all steps, see matmul_op_packed.h.
+    pack_b_ = false;
+    if (std::is_same<Device, CPUDevice>::value &&
+        (std::is_same<T, float>::value || std::is_same<T, bfloat16>::value) &&
+        ctx->HasAttr(kMatMulConstantRhsAttr)) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr(kMatMulConstantRhsAttr, &pack_b_));
+    }
   }
 
   void Compute(OpKernelContext* ctx) override {
@@ -494,6 +503,33 @@ class MatMulOp : public OpKernel {
       return;
     }
 
+    if (pack_b_) {
+      std::shared_ptr<const PackedMatMulRhs> packed_b =
+          packed_b_cache_.Get(b, transpose_b_);
+      if (packed_b != nullptr) {
+        if (std::is_same<T, bfloat16>::value) {
+          // The weights were widened when they were packed, so only `a` and
+          // the output are converted on every call.
+          Tensor a_float, out_float;
+          OP_REQUIRES_OK(ctx,
+                         ctx->allocate_temp(DT_FLOAT, a.shape(), &a_float));
+          OP_REQUIRES_OK(
+              ctx, ctx->allocate_temp(DT_FLOAT, out->shape(), &out_float));
+          const CPUDevice& d = ctx->eigen_device<CPUDevice>();
+          a_float.flat<float>().device(d) = a.flat<bfloat16>().cast<float>();
+          packed_b->Multiply(ctx, a_float, transpose_a_,
+                             /*output_kernel=*/nullptr, &out_float);
+          if (!ctx->status().ok()) return;
+          out->flat<bfloat16>().device(d) =
+              out_float.flat<float>().cast<bfloat16>();
+        } else {
+          packed_b->Multiply(ctx, a, transpose_a_,
+                             /*output_kernel=*/nullptr, out);
+        }
+        return;
+      }
+    }
+
     if (std::is_same<T, bfloat16>::value) {
       bool is_cpu = std::is_same<Device, CPUDevice>::value;
       OP_REQUIRES(ctx, is_cpu,
@@ -504,17 +540,19 @@ class MatMulOp : public OpKernel {
       OP_REQUIRES_OK(ctx,
                      ctx->allocate_temp(DT_FLOAT, out->shape(), &out_float));
 
-      // TODO: Avoid extra copy to make bfloat16 matmul efficient on CPU.
-      BFloat16ToFloat(a.flat<bfloat16>().data(), a_float.flat<float>().data(),
-                      a.NumElements());
-      BFloat16ToFloat(b.flat<bfloat16>().data(), b_float.flat<float>().data(),
-                      b.NumElements());
+      // The float32 contraction kernels are much faster than contracting
+      // bfloat16 values directly, so the operands are widened first. The
+      // conversions run on the intra-op thread pool, since they are a
+      // significant fraction of the cost for small matrices.
+      const CPUDevice& d = ctx->eigen_device<CPUDevice>();
+      a_float.flat<float>().device(d) = a.flat<bfloat16>().cast<float>();
+      b_float.flat<float>().device(d) = b.flat<bfloat16>().cast<float>();
 
       LaunchMatMul<Device, float, USE_CUBLAS>::launch(
           ctx, a_float, b_float, dim_pair, &algorithms_, use_autotune_,
           &out_float);
-      FloatToBFloat16(out_float.flat<float>().data(),
-                      out->flat<bfloat16>().data(), out->NumElements());
+      out->flat<bfloat16>().device(d) =
+          out_float.flat<float>().cast<bfloat16>();
     } else {
       LaunchMatMul<Device, T, USE_CUBLAS>::launch(
           ctx, a, b, dim_pair, &algorithms_, use_autotune_, out);
@@ -527,6 +565,8 @@ class MatMulOp : public OpKernel {
   bool use_autotune_;
   bool transpose_a_;
   bool transpose_b_;
+  bool pack_b_;
+  PackedMatMulRhsCache packed_b_cache_;
 };
 
 namespace functor {
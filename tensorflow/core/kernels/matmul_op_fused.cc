@@ -38,6 +38,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/kernels/fill_functor.h"
 #include "tensorflow/core/kernels/fused_eigen_output_kernels.h"
+#include "tensorflow/core/kernels/matmul_op_packed.h"
 #include "tensorflow/core/util/tensor_format.h"
 
 #if defined(TENSORFLOW_USE_CUSTOM_CONTRACTION_KERNEL)
@@ -102,6 +103,60 @@ struct LaunchFusedMatMulOp<CPUDevice, T> {
   }
 };
 
+// Adapts a contraction output kernel to PackedMatMulRhs::Multiply, which
+// computes the product with swapped arguments like the Eigen contraction of
+// row-major tensors.
+template <typename OutputKernel>
+PackedMatMulRhs::OutputKernelFn PackedOutputKernel(
+    const OutputKernel& output_kernel) {
+  return [output_kernel](
+             const ContractionOutputMapper<float, Eigen::Index>& output_mapper,
+             Eigen::Index col, Eigen::Index num_cols, Eigen::Index num_rows) {
+    Eigen::TensorContractionParams params;
+    params.swapped_arguments = true;
+    output_kernel(output_mapper, params, col, /*j=*/Eigen::Index(0), num_cols,
+                  num_rows);
+  };
+}
+
+// Same as LaunchFusedMatMulOp<CPUDevice, float>, with the packing of a
+// constant `b` operand.
+template <typename T>
+void LaunchPackedFusedMatMulOp(OpKernelContext* context,
+                               const PackedMatMulRhs& packed_b,
+                               const Tensor& a, bool transpose_a,
+                               FusedComputationType fusion, Tensor* output) {
+  BiasAddArgs<T> bias_add_args;
+  if (BiasAddArgs<T>::IsSupported(fusion)) {
+    OP_REQUIRES_OK(context, InitBiasAddArgs(context, &bias_add_args));
+  }
+
+  PackedMatMulRhs::OutputKernelFn output_kernel;
+  switch (fusion) {
+    case FusedComputationType::kBiasAdd:
+      output_kernel = PackedOutputKernel(WithBiasAdd<T>(bias_add_args));
+      break;
+    case FusedComputationType::kBiasAddWithRelu:
+      output_kernel =
+          PackedOutputKernel(WithBiasAddAndRelu<T>(bias_add_args));
+      break;
+    case FusedComputationType::kBiasAddWithRelu6:
+      output_kernel =
+          PackedOutputKernel(WithBiasAddAndRelu6<T>(bias_add_args));
+      break;
+    case FusedComputationType::kBiasAddWithElu:
+      output_kernel = PackedOutputKernel(WithBiasAddAndElu<T>(bias_add_args));
+      break;
+    case FusedComputationType::kUndefined:
+      OP_REQUIRES_OK(context, errors::Internal("Fusion type is undefined"));
+      break;
+    default:
+      OP_REQUIRES_OK(context,
+                     errors::Internal("Fusion type is not supported"));
+  }
+  packed_b.Multiply(context, a, transpose_a, output_kernel, output);
+}
+
 template <typename Device, typename T>
 class FusedMatMulOp : public OpKernel {
  public:
@@ -122,6 +177,14 @@ class FusedMatMulOp : public OpKernel {
     OP_REQUIRES_OK(context, InitializeFusedComputation(
                                 context, "MatMul", patterns,
                                 &fused_computation_, &fused_computation_args_));
+
+    pack_b_ = false;
+    if (std::is_same<Device, CPUDevice>::value &&
+        std::is_same<T, float>::value &&
+        context->HasAttr(kMatMulConstantRhsAttr)) {
+      OP_REQUIRES_OK(context,
+                     context->GetAttr(kMatMulConstantRhsAttr, &pack_b_));
+    }
   }
 
   void Compute(OpKernelContext* ctx) override {
@@ -168,6 +231,16 @@ class FusedMatMulOp : public OpKernel {
       return;
     }
 
+    if (pack_b_) {
+      std::shared_ptr<const PackedMatMulRhs> packed_b =
+          packed_b_cache_.Get(b, transpose_b_);
+      if (packed_b != nullptr) {
+        LaunchPackedFusedMatMulOp<T>(ctx, *packed_b, a, transpose_a_,
+                                     fused_computation_, out);
+        return;
+      }
+    }
+
     auto launch = LaunchFusedMatMulOp<Device, T>();
     launch(ctx, a, b, dim_pair, fused_computation_, fused_computation_args_,
            out);
@@ -180,6 +253,9 @@ class FusedMatMulOp : public OpKernel {
   FusedComputationType fused_computation_ = FusedComputationType::kUndefined;
   FusedComputationArgs fused_computation_args_;
 
+  bool pack_b_;
+  PackedMatMulRhsCache packed_b_cache_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(FusedMatMulOp);
 };
 
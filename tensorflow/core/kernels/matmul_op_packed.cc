@@ -0,0 +1,216 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/kernels/matmul_op_packed.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/lib/math/math_util.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+typedef Eigen::Index Index;
+typedef Eigen::internal::gebp_traits<float, float> Traits;
+typedef ContractionOutputMapper<float, Index> OutputMapper;
+typedef Eigen::internal::gebp_kernel<float, float, Index, OutputMapper,
+                                     Traits::mr, Traits::nr,
+                                     /*ConjugateLhs*/ false,
+                                     /*ConjugateRhs*/ false>
+    GebpKernel;
+
+// The number of times the packed operand may change before packing is given
+// up on.
+constexpr int kMaxPackings = 4;
+
+// Packs the [rows, depth] matrix at `data` as GEBP left-hand side blocks of
+// `depth_block`, stored one after the other. Within a block, rows start at
+// multiples of Traits::mr * block depth.
+template <int StorageOrder>
+void PackLhs(const float* data, Index stride, Index rows, Index depth,
+             Index depth_block, float* packed) {
+  typedef Eigen::internal::const_blas_data_mapper<float, Index, StorageOrder>
+      Mapper;
+  Eigen::internal::gemm_pack_lhs<float, Index, Mapper, Traits::mr,
+                                 Traits::LhsProgress,
+                                 typename Traits::LhsPacket4Packing,
+                                 StorageOrder>
+      pack;
+  const Mapper mapper(data, stride);
+  for (Index k = 0; k < depth; k += depth_block) {
+    pack(packed + k * rows, mapper.getSubMapper(0, k),
+         std::min(depth_block, depth - k), rows);
+  }
+}
+
+// Packs the [depth, cols] matrix at `data` as GEBP right-hand side blocks of
+// `depth_block`, stored one after the other.
+template <int StorageOrder>
+void PackRhs(const float* data, Index stride, Index depth, Index cols,
+             Index depth_block, float* packed) {
+  typedef Eigen::internal::const_blas_data_mapper<float, Index, StorageOrder>
+      Mapper;
+  Eigen::internal::gemm_pack_rhs<float, Index, Mapper, Traits::nr,
+                                 StorageOrder>
+      pack;
+  const Mapper mapper(data, stride);
+  for (Index k = 0; k < depth; k += depth_block) {
+    pack(packed + k * cols, mapper.getSubMapper(k, 0),
+         std::min(depth_block, depth - k), cols);
+  }
+}
+
+}  // namespace
+
+PackedMatMulRhs::PackedMatMulRhs(const Tensor& b, bool transpose_b)
+    : b_(b),
+      transpose_b_(transpose_b),
+      depth_(b.dim_size(transpose_b ? 1 : 0)),
+      cols_(b.dim_size(transpose_b ? 0 : 1)) {
+  DCHECK(b.dtype() == DT_FLOAT || b.dtype() == DT_BFLOAT16);
+  DCHECK_GT(b.NumElements(), 0);
+  // Blocking for a typical inference batch; the depth block is what matters
+  // for the packed layout.
+  Index depth_block = depth_;
+  Index rows_block = cols_;
+  Index cols_block = 64;
+  Eigen::internal::computeProductBlockingSizes<float, float>(
+      depth_block, rows_block, cols_block, Index(1));
+  depth_block_ = depth_block;
+
+  packed_ = static_cast<float*>(port::AlignedMalloc(
+      depth_ * cols_ * sizeof(float), EIGEN_MAX_ALIGN_BYTES));
+  CHECK(packed_ != nullptr);
+  // b^T is the left-hand side: it is column-major with stride N when `b` is
+  // [K, N], and row-major with stride K when `b` is [N, K].
+  std::vector<float> widened;
+  const float* data;
+  if (b.dtype() == DT_BFLOAT16) {
+    widened.resize(b.NumElements());
+    BFloat16ToFloat(b.flat<bfloat16>().data(), widened.data(),
+                    b.NumElements());
+    data = widened.data();
+  } else {
+    data = b.flat<float>().data();
+  }
+  if (transpose_b_) {
+    PackLhs<Eigen::RowMajor>(data, depth_, cols_, depth_, depth_block_,
+                             packed_);
+  } else {
+    PackLhs<Eigen::ColMajor>(data, cols_, cols_, depth_, depth_block_,
+                             packed_);
+  }
+}
+
+PackedMatMulRhs::~PackedMatMulRhs() { port::AlignedFree(packed_); }
+
+bool PackedMatMulRhs::IsPackingOf(const Tensor& b, bool transpose_b) const {
+  return transpose_b == transpose_b_ && b.dtype() == b_.dtype() &&
+         b.shape() == b_.shape() &&
+         b.tensor_data().data() == b_.tensor_data().data();
+}
+
+void PackedMatMulRhs::Multiply(OpKernelContext* ctx, const Tensor& a,
+                               bool transpose_a,
+                               const OutputKernelFn& output_kernel,
+                               Tensor* out) const {
+  const Index batch = out->dim_size(0);
+  DCHECK_EQ(out->dim_size(1), cols_);
+  DCHECK_EQ(a.dim_size(transpose_a ? 0 : 1), depth_);
+
+  // a^T is the right-hand side: it is column-major with stride K when `a` is
+  // [M, K], and row-major with stride M when `a` is [K, M].
+  Tensor packed_a;
+  OP_REQUIRES_OK(ctx, ctx->allocate_temp(DT_FLOAT,
+                                         TensorShape({depth_ * batch}),
+                                         &packed_a));
+  const float* a_data = a.flat<float>().data();
+  float* packed_a_data = packed_a.flat<float>().data();
+  if (transpose_a) {
+    PackRhs<Eigen::RowMajor>(a_data, batch, depth_, batch, depth_block_,
+                             packed_a_data);
+  } else {
+    PackRhs<Eigen::ColMajor>(a_data, depth_, depth_, batch, depth_block_,
+                             packed_a_data);
+  }
+
+  // The transposed output is column-major [N, M] with stride N. Each shard
+  // computes whole panels of Traits::mr of its rows, i.e. output columns.
+  float* out_data = out->flat<float>().data();
+  const OutputMapper output(out_data, cols_);
+  const float* packed_b = packed_;
+  const Index cols = cols_;
+  const Index depth = depth_;
+  const Index depth_block = depth_block_;
+  auto compute = [&](int64 begin, int64 end) {
+    const Index col_begin = begin * Traits::mr;
+    const Index col_end = std::min<Index>(end * Traits::mr, cols);
+    const Index num_cols = col_end - col_begin;
+    for (Index row = 0; row < batch; ++row) {
+      std::fill_n(out_data + row * cols + col_begin, num_cols, 0.0f);
+    }
+    GebpKernel gebp;
+    for (Index k = 0; k < depth; k += depth_block) {
+      const Index block_depth = std::min(depth_block, depth - k);
+      gebp(output.getSubMapper(col_begin, 0),
+           packed_b + k * cols + col_begin * block_depth,
+           packed_a_data + k * batch, num_cols, block_depth, batch,
+           /*alpha=*/1.0f);
+    }
+    if (output_kernel) {
+      output_kernel(output.getSubMapper(col_begin, 0), col_begin, num_cols,
+                    batch);
+    }
+  };
+
+  const int64 num_panels = MathUtil::CeilOfRatio<int64>(cols_, Traits::mr);
+  const int64 cost_per_panel = Traits::mr * depth_ * batch;
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *ctx->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads.num_threads, worker_threads.workers, num_panels,
+        cost_per_panel, compute);
+}
+
+std::shared_ptr<const PackedMatMulRhs> PackedMatMulRhsCache::Get(
+    const Tensor& b, bool transpose_b) {
+  if (b.NumElements() == 0) return nullptr;
+  mutex_lock l(mu_);
+  if (packed_ != nullptr && packed_->IsPackingOf(b, transpose_b)) {
+    return packed_;
+  }
+  if (num_packings_ >= kMaxPackings) {
+    if (packed_ != nullptr) {
+      VLOG(1) << "Not packing a MatMul operand that changed "
+              << num_packings_ << " times";
+      // Don't hold on to the last tensor any longer than necessary.
+      packed_.reset();
+    }
+    return nullptr;
+  }
+  ++num_packings_;
+  packed_ = std::make_shared<const PackedMatMulRhs>(b, transpose_b);
+  return packed_;
+}
+
+}  // namespace tensorflow
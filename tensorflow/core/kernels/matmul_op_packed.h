@@ -0,0 +1,107 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_MATMUL_OP_PACKED_H_
+#define TENSORFLOW_CORE_KERNELS_MATMUL_OP_PACKED_H_
+
+#include <functional>
+#include <memory>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/fused_eigen_output_kernels.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+class OpKernelContext;
+
+// Node attribute that the Grappler remapper sets on CPU MatMul and
+// _FusedMatMul nodes whose `b` operand is the output of a Const node. Conv2D
+// nodes with a Const filter get it too, see kConv2DConstantFilterAttr.
+constexpr char kMatMulConstantRhsAttr[] = "_b_is_const";
+
+// The `b` operand of a float or bfloat16 MatMul, packed once into the panel
+// layout of Eigen's GEBP kernel. Bfloat16 operands are widened to float once,
+// when they are packed. Eigen's contraction packs both operands on every call,
+// which for the weights of a fully connected layer at small batch sizes costs
+// as much as the multiplication itself.
+//
+// The product is computed transposed, as out^T = b^T * a^T, so that the large
+// packed operand is the left-hand side of the GEBP kernel and only the small
+// `a` has to be packed per call.
+class PackedMatMulRhs {
+ public:
+  // Called on every block of columns of the output once it is computed, with
+  // a mapper over the transposed block. This matches the arguments of the
+  // Eigen contraction output kernels in fused_eigen_output_kernels.h.
+  typedef std::function<void(
+      const ContractionOutputMapper<float, Eigen::Index>& output_mapper,
+      Eigen::Index col, Eigen::Index num_cols, Eigen::Index num_rows)>
+      OutputKernelFn;
+
+  // Packs the non-empty float or bfloat16 matrix `b`, of shape [K, N], or
+  // [N, K] if `transpose_b` is set. Keeps a reference to `b`.
+  PackedMatMulRhs(const Tensor& b, bool transpose_b);
+  ~PackedMatMulRhs();
+
+  // Returns true if this is the packing of `b`, i.e. `b` is the same buffer
+  // with the same shape. The contents of that buffer are not compared: the
+  // caller must know that `b` is not modified in place.
+  bool IsPackingOf(const Tensor& b, bool transpose_b) const;
+
+  // Computes `out` = op(a) * b, where `a` is a float matrix and `out` has
+  // been allocated with shape [M, N]. Runs `output_kernel`, if set, on every
+  // block of the output.
+  void Multiply(OpKernelContext* ctx, const Tensor& a, bool transpose_a,
+                const OutputKernelFn& output_kernel, Tensor* out) const;
+
+ private:
+  const Tensor b_;
+  const bool transpose_b_;
+  const int64 depth_;
+  const int64 cols_;
+  // The depth of the blocks the GEBP kernel runs over, which fit in L1.
+  int64 depth_block_;
+  float* packed_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PackedMatMulRhs);
+};
+
+// The packing of the constant `b` operand of one MatMul kernel.
+class PackedMatMulRhsCache {
+ public:
+  PackedMatMulRhsCache() {}
+
+  // Returns the packing of `b`, packing it if it is not the tensor seen by
+  // the previous call. Returns nullptr if `b` is empty, or once it has
+  // changed too often for the packing to pay off, e.g. because the Const
+  // node is fed.
+  std::shared_ptr<const PackedMatMulRhs> Get(const Tensor& b,
+                                             bool transpose_b);
+
+ private:
+  mutex mu_;
+  std::shared_ptr<const PackedMatMulRhs> packed_ GUARDED_BY(mu_);
+  int num_packings_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PackedMatMulRhsCache);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_MATMUL_OP_PACKED_H_
@@ -16,7 +16,11 @@ limitations under the License.
 #include "absl/algorithm/container.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/matmul_op_packed.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/platform/test.h"
@@ -146,7 +150,8 @@ class FusedMatMulOpTest : public OpsTestBase {
                         const std::vector<Tensor>& args_data,
                         const std::vector<string>& fused_ops, bool transpose_a,
                         bool transpose_b, Tensor* output,
-                        bool allow_gpu_device = false) {
+                        bool allow_gpu_device = false,
+                        bool rhs_is_const = false) {
     Scope root = tensorflow::Scope::NewRootScope();
 
     DataType dtype = DataTypeToEnum<T>::v();
@@ -174,6 +179,7 @@ class FusedMatMulOpTest : public OpsTestBase {
                      .Attr("fused_ops", fused_ops)
                      .Attr("transpose_a", transpose_a)
                      .Attr("transpose_b", transpose_b)
+                     .Attr(kMatMulConstantRhsAttr, rhs_is_const)
                      .Finalize(&fused_matmul));
 
     RunAndFetch(root, fused_matmul.name(), output, allow_gpu_device,
@@ -236,7 +242,8 @@ class FusedMatMulOpTest : public OpsTestBase {
   // to FusedMatMul.
   void VerifyConv2DWithBiasAndActivation(int m, int k, int n, bool transpose_a,
                                          bool transpose_b,
-                                         const string& activation) {
+                                         const string& activation,
+                                         bool rhs_is_const = false) {
     const BiasAddGraphRunner run_default = [&](const Tensor& input_data,
                                                const Tensor& filter_data,
                                                const Tensor& bias_data,
@@ -250,7 +257,8 @@ class FusedMatMulOpTest : public OpsTestBase {
                                              const Tensor& bias_data,
                                              Tensor* out) {
       RunFusedMatMulOp(input_data, filter_data, {bias_data},
-                       {"BiasAdd", activation}, transpose_a, transpose_b, out);
+                       {"BiasAdd", activation}, transpose_a, transpose_b, out,
+                       /*allow_gpu_device=*/false, rhs_is_const);
     };
 
     VerifyBiasAddTensorsNear(m, k, n, run_default, run_fused);
@@ -337,6 +345,126 @@ using FusedBiasAddDataTypes = ::testing::Types<float>;
 INSTANTIATE_TYPED_TEST_SUITE_P(Test, FusedMatMulWithBiasOpTest,
                                FusedBiasAddDataTypes);
 
+class PackedFusedMatMulOpTest : public FusedMatMulOpTest<float> {};
+
+TEST_F(PackedFusedMatMulOpTest, WithBiasAndActivation) {
+  for (const string& activation : {"Relu", "Relu6", "Elu"}) {
+    for (int m : {1, 7, 64}) {
+      VerifyConv2DWithBiasAndActivation(m, 129, 77, false, false, activation,
+                                        /*rhs_is_const=*/true);
+      VerifyConv2DWithBiasAndActivation(m, 129, 77, true, true, activation,
+                                        /*rhs_is_const=*/true);
+    }
+  }
+}
+
+// MatMul with an operand marked as constant, which is packed once.
+class PackedMatMulOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool transpose_a, bool transpose_b) {
+    TF_ASSERT_OK(NodeDefBuilder("matmul", "MatMul")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("transpose_a", transpose_a)
+                     .Attr("transpose_b", transpose_b)
+                     .Attr(kMatMulConstantRhsAttr, true)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Runs the op on random inputs and compares it with a naive product.
+  void RunAndVerify(int m, int k, int n, bool transpose_a, bool transpose_b) {
+    Tensor a(DT_FLOAT, transpose_a ? TensorShape({k, m}) : TensorShape({m, k}));
+    a.flat<float>().setRandom();
+    Tensor b(DT_FLOAT, transpose_b ? TensorShape({n, k}) : TensorShape({k, n}));
+    b.flat<float>().setRandom();
+
+    Tensor expected(DT_FLOAT, TensorShape({m, n}));
+    auto a_m = a.matrix<float>();
+    auto b_m = b.matrix<float>();
+    for (int i = 0; i < m; ++i) {
+      for (int j = 0; j < n; ++j) {
+        float sum = 0;
+        for (int l = 0; l < k; ++l) {
+          sum += (transpose_a ? a_m(l, i) : a_m(i, l)) *
+                 (transpose_b ? b_m(j, l) : b_m(l, j));
+        }
+        expected.matrix<float>()(i, j) = sum;
+      }
+    }
+
+    inputs_.clear();
+    AddInputFromArray<float>(a.shape(), a.flat<float>());
+    AddInputFromArray<float>(b.shape(), b.flat<float>());
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectClose(expected, *GetOutput(0), /*atol=*/1e-4);
+  }
+};
+
+TEST_F(PackedMatMulOpTest, MatchesNaiveProduct) {
+  for (bool transpose_a : {false, true}) {
+    for (bool transpose_b : {false, true}) {
+      for (int m : {1, 2, 5, 64}) {
+        for (int n : {1, 23, 25, 300}) {
+          MakeOp(transpose_a, transpose_b);
+          RunAndVerify(m, 519, n, transpose_a, transpose_b);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(PackedMatMulOpTest, OperandChanges) {
+  MakeOp(false, false);
+  // Every call gets a new `b`, which stops being packed after a few calls.
+  for (int i = 0; i < 8; ++i) {
+    RunAndVerify(4, 64, 48, false, false);
+  }
+}
+
+TEST_F(PackedMatMulOpTest, Bfloat16) {
+  TF_ASSERT_OK(NodeDefBuilder("matmul", "MatMul")
+                   .Input(FakeInput(DT_BFLOAT16))
+                   .Input(FakeInput(DT_BFLOAT16))
+                   .Attr(kMatMulConstantRhsAttr, true)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+
+  const int m = 5;
+  const int k = 67;
+  const int n = 23;
+  Tensor a(DT_FLOAT, TensorShape({m, k}));
+  a.flat<float>().setRandom();
+  Tensor b(DT_FLOAT, TensorShape({k, n}));
+  b.flat<float>().setRandom();
+  Tensor a_bf16(DT_BFLOAT16, a.shape());
+  a_bf16.flat<bfloat16>() = a.flat<float>().cast<bfloat16>();
+  Tensor b_bf16(DT_BFLOAT16, b.shape());
+  b_bf16.flat<bfloat16>() = b.flat<float>().cast<bfloat16>();
+
+  // The product of the rounded operands, which the kernel computes in float
+  // before rounding its output.
+  a.flat<float>() = a_bf16.flat<bfloat16>().cast<float>();
+  b.flat<float>() = b_bf16.flat<bfloat16>().cast<float>();
+  Tensor expected(DT_FLOAT, TensorShape({m, n}));
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      float sum = 0;
+      for (int l = 0; l < k; ++l) {
+        sum += a.matrix<float>()(i, l) * b.matrix<float>()(l, j);
+      }
+      expected.matrix<float>()(i, j) = sum;
+    }
+  }
+
+  AddInputFromArray<bfloat16>(a_bf16.shape(), a_bf16.flat<bfloat16>());
+  AddInputFromArray<bfloat16>(b_bf16.shape(), b_bf16.flat<bfloat16>());
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor output(DT_FLOAT, TensorShape({m, n}));
+  output.flat<float>() = GetOutput(0)->flat<bfloat16>().cast<float>();
+  test::ExpectClose(expected, output, /*atol=*/1e-2, /*rtol=*/1e-2);
+}
+
 //----------------------------------------------------------------------------//
 // Performance benchmarks are below.                                          //
 //----------------------------------------------------------------------------//
@@ -384,6 +512,68 @@ static Graph* Matmul(int m, int k, int n, bool transpose_a, bool transpose_b,
 
 #endif  // GOOGLE_CUDA
 
+// A fully connected layer with constant weights, which are packed once when
+// `pack_rhs` is set and by every call otherwise.
+static void BM_MatmulConstantRhs(int iters, int batch, int pack_rhs) {
+  testing::UseRealTime();
+  const int k = 1024;
+  const int n = 1024;
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch * k * n * 2);
+  Graph* g = Matmul<float>(batch, k, n, false, false, DT_FLOAT);
+  for (Node* node : g->op_nodes()) {
+    if (node->type_string() == "MatMul") {
+      node->AddAttr(kMatMulConstantRhsAttr, pack_rhs != 0);
+    }
+  }
+  test::Benchmark("cpu", g).Run(iters);
+}
+BENCHMARK(BM_MatmulConstantRhs)
+    ->ArgPair(1, 0)
+    ->ArgPair(1, 1)
+    ->ArgPair(2, 0)
+    ->ArgPair(2, 1)
+    ->ArgPair(4, 0)
+    ->ArgPair(4, 1)
+    ->ArgPair(8, 0)
+    ->ArgPair(8, 1)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 1)
+    ->ArgPair(32, 0)
+    ->ArgPair(32, 1)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1);
+
+// The same layer in bfloat16, whose weights are widened to float once when
+// `pack_rhs` is set and by every call otherwise. Compare with the float
+// benchmark above for the cost of the conversions.
+static void BM_MatmulConstantRhsBfloat16(int iters, int batch, int pack_rhs) {
+  testing::UseRealTime();
+  const int k = 1024;
+  const int n = 1024;
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch * k * n * 2);
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor a(DT_FLOAT, TensorShape({batch, k}));
+  a.flat<float>().setRandom();
+  Tensor b(DT_FLOAT, TensorShape({k, n}));
+  b.flat<float>().setRandom();
+  Tensor a_bf16(DT_BFLOAT16, a.shape());
+  a_bf16.flat<bfloat16>() = a.flat<float>().cast<bfloat16>();
+  Tensor b_bf16(DT_BFLOAT16, b.shape());
+  b_bf16.flat<bfloat16>() = b.flat<float>().cast<bfloat16>();
+  Node* matmul =
+      test::graph::Matmul(g, test::graph::Constant(g, a_bf16),
+                          test::graph::Constant(g, b_bf16), false, false);
+  matmul->AddAttr(kMatMulConstantRhsAttr, pack_rhs != 0);
+  test::Benchmark("cpu", g).Run(iters);
+}
+BENCHMARK(BM_MatmulConstantRhsBfloat16)
+    ->ArgPair(1, 0)
+    ->ArgPair(1, 1)
+    ->ArgPair(8, 0)
+    ->ArgPair(8, 1)
+    ->ArgPair(64, 0)
+    ->ArgPair(64, 1);
+
 // Batch size of 1 included for inference.
 // Typical fully connected layers
 BM_Matmul(1, 512, 512, false, false);
@@ -23,6 +23,7 @@ limitations under the License.
 #define EIGEN_USE_GPU
 #endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 
+#include <algorithm>
 #include <vector>
 
 #include "third_party/eigen3/Eigen/Core"
@@ -37,7 +38,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/segment_reduction_ops.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
 #include "tensorflow/core/common_runtime/gpu/gpu_event_mgr.h"
@@ -310,7 +313,20 @@ class SegmentSumGPUOp : public AsyncOpKernel {
 
 namespace functor {
 
+// CPU segment reductions of fewer elements than this run on one thread.
+constexpr int64 kMinParallelSegmentReductionSize = 32768;
+
+// Number of segment ids sampled to find the segments that hold most rows.
+constexpr int64 kNumSegmentIdSamples = 1024;
+
 // The ReductionFunctor implementation for CPU.
+//
+// Large reductions are split by the rows of `data`. Each light segment is
+// owned by one shard, which reduces the rows of its segments in order, so the
+// result does not depend on the number of threads. Heavy segments, found from
+// a histogram of sampled segment ids, would make their shards much longer
+// than the others: their rows are split evenly into chunks that reduce into
+// private partial results, which are reduced into the output afterwards.
 template <typename T, typename Index, typename InitialValueF,
           typename ReductionF>
 struct UnsortedSegmentFunctor<CPUDevice, T, Index, InitialValueF, ReductionF> {
@@ -324,18 +340,146 @@ struct UnsortedSegmentFunctor<CPUDevice, T, Index, InitialValueF, ReductionF> {
     }
     const int64 N = segment_ids.dimension(0);
     const int64 num_segments = output.dimension(0);
-    ReductionF reduction;
+    const auto& worker_threads =
+        *ctx->device()->tensorflow_cpu_worker_threads();
+    if (data.size() < kMinParallelSegmentReductionSize ||
+        worker_threads.num_threads <= 1) {
+      ReductionF reduction;
+      for (int64 i = 0; i < N; ++i) {
+        Index j = internal::SubtleMustCopy(segment_ids(i));
+        if (j < 0) {
+          continue;
+        }
+        OP_REQUIRES(ctx, FastBoundsCheck(j, num_segments),
+                    errors::InvalidArgument(
+                        "segment_ids", SliceDebugString(segment_ids_shape, i),
+                        " = ", j, " is out of range [0, ", num_segments, ")"));
+        reduction(data.template chip<0>(i), output.template chip<0>(j));
+      }
+      return;
+    }
+
+    // Copy the segment ids once, so that they can not change after they were
+    // checked.
+    std::vector<Index> ids(N);
     for (int64 i = 0; i < N; ++i) {
-      Index j = internal::SubtleMustCopy(segment_ids(i));
-      if (j < 0) {
-        continue;
+      ids[i] = internal::SubtleMustCopy(segment_ids(i));
+      OP_REQUIRES(
+          ctx, ids[i] < 0 || FastBoundsCheck(ids[i], num_segments),
+          errors::InvalidArgument(
+              "segment_ids", SliceDebugString(segment_ids_shape, i), " = ",
+              ids[i], " is out of range [0, ", num_segments, ")"));
+    }
+
+    // A segment is heavy if it holds more than half of the rows of a thread.
+    const int num_threads = worker_threads.num_threads;
+    const int64 num_samples = std::min(N, kNumSegmentIdSamples);
+    std::vector<Index> samples;
+    samples.reserve(num_samples);
+    for (int64 s = 0; s < num_samples; ++s) {
+      const Index j = ids[s * N / num_samples];
+      if (j >= 0) samples.push_back(j);
+    }
+    std::sort(samples.begin(), samples.end());
+    std::vector<Index> heavy_ids;
+    for (size_t begin = 0, end = 0; begin < samples.size(); begin = end) {
+      while (end < samples.size() && samples[end] == samples[begin]) ++end;
+      if (static_cast<int64>(end - begin) * 2 * num_threads > num_samples) {
+        heavy_ids.push_back(samples[begin]);
       }
-      OP_REQUIRES(ctx, FastBoundsCheck(j, num_segments),
-                  errors::InvalidArgument(
-                      "segment_ids", SliceDebugString(segment_ids_shape, i),
-                      " = ", j, " is out of range [0, ", num_segments, ")"));
-      reduction(data.template chip<0>(i), output.template chip<0>(j));
     }
+    // Returns the index of `id` in `heavy_ids`, or -1 for a light segment.
+    const auto heavy_index = [&heavy_ids](Index id) -> int64 {
+      const auto it = std::lower_bound(heavy_ids.begin(), heavy_ids.end(), id);
+      return it != heavy_ids.end() && *it == id ? it - heavy_ids.begin() : -1;
+    };
+
+    // Group the rows of the light segments by owner, keeping their order.
+    const int64 num_owners = 4 * num_threads;
+    std::vector<int64> owner_begin(num_owners + 1, 0);
+    int64 num_heavy_rows = 0;
+    for (int64 i = 0; i < N; ++i) {
+      if (ids[i] < 0) continue;
+      if (heavy_index(ids[i]) >= 0) {
+        ++num_heavy_rows;
+      } else {
+        ++owner_begin[ids[i] % num_owners + 1];
+      }
+    }
+    for (int64 owner = 0; owner < num_owners; ++owner) {
+      owner_begin[owner + 1] += owner_begin[owner];
+    }
+    std::vector<int64> light_rows(owner_begin[num_owners]);
+    std::vector<int64> heavy_rows;
+    heavy_rows.reserve(num_heavy_rows);
+    {
+      std::vector<int64> owner_end(owner_begin.begin(), owner_begin.end() - 1);
+      for (int64 i = 0; i < N; ++i) {
+        if (ids[i] < 0) continue;
+        if (heavy_index(ids[i]) >= 0) {
+          heavy_rows.push_back(i);
+        } else {
+          light_rows[owner_end[ids[i] % num_owners]++] = i;
+        }
+      }
+    }
+
+    // The partial results take no more memory than the heavy rows.
+    const int64 num_heavy = heavy_ids.size();
+    int64 num_chunks = 0;
+    if (num_heavy_rows > 0) {
+      num_chunks = std::max<int64>(
+          1, std::min<int64>(num_threads, num_heavy_rows / num_heavy));
+    }
+    Tensor partials_t;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(
+                            DataTypeToEnum<T>::value,
+                            TensorShape({num_chunks * num_heavy,
+                                         data.dimension(1)}),
+                            &partials_t));
+    typename TTypes<T, 2>::Tensor partials = partials_t.matrix<T>();
+    partials.setConstant(InitialValueF()());
+
+    const auto reduce_rows = [&](int64 begin, int64 end) {
+      ReductionF reduction;
+      for (int64 unit = begin; unit < end; ++unit) {
+        if (unit < num_owners) {
+          for (int64 k = owner_begin[unit]; k < owner_begin[unit + 1]; ++k) {
+            const int64 i = light_rows[k];
+            reduction(data.template chip<0>(i),
+                      output.template chip<0>(ids[i]));
+          }
+          continue;
+        }
+        const int64 chunk = unit - num_owners;
+        const int64 first = chunk * num_heavy_rows / num_chunks;
+        const int64 last = (chunk + 1) * num_heavy_rows / num_chunks;
+        for (int64 k = first; k < last; ++k) {
+          const int64 i = heavy_rows[k];
+          reduction(data.template chip<0>(i),
+                    partials.template chip<0>(chunk * num_heavy +
+                                              heavy_index(ids[i])));
+        }
+      }
+    };
+    // One block per unit, so that the pool balances units of unequal cost.
+    const int64 num_units = num_owners + num_chunks;
+    Shard(num_units, worker_threads.workers, num_units,
+          data.size() / num_units, reduce_rows);
+
+    const typename TTypes<T, 2>::ConstTensor const_partials =
+        static_cast<const Tensor&>(partials_t).matrix<T>();
+    const auto merge_partials = [&](int64 begin, int64 end) {
+      ReductionF reduction;
+      for (int64 h = begin; h < end; ++h) {
+        for (int64 chunk = 0; chunk < num_chunks; ++chunk) {
+          reduction(const_partials.template chip<0>(chunk * num_heavy + h),
+                    output.template chip<0>(heavy_ids[h]));
+        }
+      }
+    };
+    Shard(num_threads, worker_threads.workers, num_heavy,
+          num_chunks * data.dimension(1), merge_partials);
   }
 };
 
@@ -502,6 +646,8 @@ class SparseSegmentReductionOpBase : public OpKernel {
                 errors::InvalidArgument("segment ids must be >= 0"));
     auto output_flat = output->flat_outer_dims<T>();
 
+    // The segments are reduced once they are all validated.
+    std::vector<Segment> segments;
     int64 start = 0, end = 1;
     // Index from which the output is not initialized.
     OutputRow uninitialized_index = 0;
@@ -539,14 +685,7 @@ class SparseSegmentReductionOpBase : public OpKernel {
         gap_slice.setConstant(default_value_);
       }
 
-      auto out = output_flat.template chip<0>(out_index);
-      const int bad_offset =
-          Reduce(input_flat, indices_vec, start, end - start, out);
-      OP_REQUIRES(context, bad_offset < 0,
-                  errors::InvalidArgument(
-                      "Bad: indices[", start + bad_offset,
-                      "] == ", indices_vec(start + bad_offset),
-                      " out of range [0, ", input_flat.dimension(0), ")"));
+      segments.push_back({start, end, out_index});
 
       start = end;
       ++end;
@@ -563,14 +702,160 @@ class SparseSegmentReductionOpBase : public OpKernel {
           gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
       gap_slice.setConstant(default_value_);
     }
+
+    ReduceSegments(context, input_flat, indices_vec, segments, output_flat);
   }
 
  private:
   typedef int32 Index;
 
+  // The rows [start, end) of the indices, reduced into output row out_index.
+  struct Segment {
+    int64 start;
+    int64 end;
+    int32 out_index;
+  };
+
+  // Reduces the segments into their rows of the output. Small reductions run
+  // on one thread. Otherwise consecutive segments are grouped into units of
+  // about the same number of rows, and segments larger than a unit are split
+  // into chunks that are summed into partial results, which are merged once
+  // all units are done.
+  void ReduceSegments(OpKernelContext* context,
+                      const typename TTypes<T>::ConstMatrix& input_flat,
+                      const typename TTypes<Index>::ConstVec& indices_vec,
+                      const std::vector<Segment>& segments,
+                      typename TTypes<T>::Matrix output_flat) {
+    const int64 num_indices = indices_vec.dimension(0);
+    const int64 num_col = input_flat.dimension(1);
+    const auto& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    const auto bad_index_error = [&](int64 position) {
+      return errors::InvalidArgument("Bad: indices[", position,
+                                     "] == ", indices_vec(position),
+                                     " out of range [0, ",
+                                     input_flat.dimension(0), ")");
+    };
+
+    if (num_indices * num_col < functor::kMinParallelSegmentReductionSize ||
+        worker_threads.num_threads <= 1) {
+      for (const Segment& segment : segments) {
+        const int64 bad_offset =
+            Reduce(input_flat, indices_vec, segment.start,
+                   segment.end - segment.start, /*normalize=*/true,
+                   output_flat.template chip<0>(segment.out_index));
+        OP_REQUIRES(context, bad_offset < 0,
+                    bad_index_error(segment.start + bad_offset));
+      }
+      return;
+    }
+
+    // A unit is either the segments [first, last) or the rows [start, end) of
+    // one segment, summed into row `partial` of the partial results.
+    struct Unit {
+      int64 first;
+      int64 last;
+      int64 start;
+      int64 end;
+      int64 partial;
+    };
+    const int64 unit_rows =
+        std::max<int64>(16, (num_indices + 4 * worker_threads.num_threads - 1) /
+                                (4 * worker_threads.num_threads));
+    std::vector<Unit> units;
+    // The split segments and the first of their partial results.
+    std::vector<std::pair<int64, int64>> split_segments;
+    int64 num_partials = 0;
+    int64 group_rows = 0;
+    const int64 num_segments = segments.size();
+    for (int64 s = 0; s < num_segments; ++s) {
+      const Segment& segment = segments[s];
+      const int64 rows = segment.end - segment.start;
+      if (rows > unit_rows) {
+        const int64 num_chunks = (rows + unit_rows - 1) / unit_rows;
+        split_segments.emplace_back(s, num_partials);
+        for (int64 chunk = 0; chunk < num_chunks; ++chunk) {
+          units.push_back({s, s + 1, segment.start + chunk * rows / num_chunks,
+                           segment.start + (chunk + 1) * rows / num_chunks,
+                           num_partials++});
+        }
+        continue;
+      }
+      if (units.empty() || units.back().partial >= 0 ||
+          group_rows + rows > unit_rows) {
+        units.push_back({s, s + 1, 0, 0, -1});
+        group_rows = 0;
+      } else {
+        units.back().last = s + 1;
+      }
+      group_rows += rows;
+    }
+
+    Tensor partials_t;
+    OP_REQUIRES_OK(context, context->allocate_temp(
+                                DataTypeToEnum<T>::value,
+                                TensorShape({num_partials, num_col}),
+                                &partials_t));
+    auto partials = partials_t.matrix<T>();
+
+    mutex mu;
+    int64 bad_position = -1;
+    const auto reduce_units = [&](int64 begin, int64 end) {
+      for (int64 u = begin; u < end; ++u) {
+        const Unit& unit = units[u];
+        int64 bad_offset = -1;
+        int64 start = unit.start;
+        if (unit.partial >= 0) {
+          bad_offset = Reduce(input_flat, indices_vec, unit.start,
+                              unit.end - unit.start, /*normalize=*/false,
+                              partials.template chip<0>(unit.partial));
+        } else {
+          for (int64 s = unit.first; s < unit.last && bad_offset < 0; ++s) {
+            start = segments[s].start;
+            bad_offset = Reduce(
+                input_flat, indices_vec, start, segments[s].end - start,
+                /*normalize=*/true,
+                output_flat.template chip<0>(segments[s].out_index));
+          }
+        }
+        if (bad_offset >= 0) {
+          mutex_lock l(mu);
+          if (bad_position < 0 || start + bad_offset < bad_position) {
+            bad_position = start + bad_offset;
+          }
+          return;
+        }
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, units.size(),
+          unit_rows * num_col, reduce_units);
+    OP_REQUIRES(context, bad_position < 0, bad_index_error(bad_position));
+
+    for (const auto& split_segment : split_segments) {
+      const Segment& segment = segments[split_segment.first];
+      const int64 num = segment.end - segment.start;
+      const int64 num_chunks = (num + unit_rows - 1) / unit_rows;
+      auto out = output_flat.template chip<0>(segment.out_index);
+      out = partials.template chip<0>(split_segment.second);
+      for (int64 chunk = 1; chunk < num_chunks; ++chunk) {
+        out += partials.template chip<0>(split_segment.second + chunk);
+      }
+      if (is_mean_) {
+        out = out / static_cast<T>(num);
+      }
+      if (is_sqrtn_) {
+        out = out / static_cast<T>(sqrt(num));
+      }
+    }
+  }
+
+  // Reduces `num` rows of the input selected by the indices from `start` into
+  // `out`, and divides the result by the mean or sqrtn normalization if
+  // `normalize` is true. Returns the offset from `start` of an out of range
+  // index, or -1.
   int64 Reduce(const typename TTypes<T>::ConstMatrix& input_flat,
                const typename TTypes<Index>::ConstVec& indices_vec, int64 start,
-               int64 num,
+               int64 num, bool normalize,
                Eigen::TensorChippingOp<0, typename TTypes<T>::Matrix> out) {
 #define INDEX(n, i)                               \
   const auto index##n = indices_vec(start + (i)); \
@@ -584,10 +869,10 @@ class SparseSegmentReductionOpBase : public OpKernel {
     } else {
       int64 r = num % 8;
       T m(1);
-      if (is_mean_ && (num < 10)) {
+      if (normalize && is_mean_ && (num < 10)) {
         m = T(num);
       }
-      if (is_sqrtn_ && (num < 10)) {
+      if (normalize && is_sqrtn_ && (num < 10)) {
         m = T(sqrt(num));
       }
       switch (r) {
@@ -682,10 +967,10 @@ class SparseSegmentReductionOpBase : public OpKernel {
         INDEX(7, r + 7);
         out += L(0) + L(1) + L(2) + L(3) + L(4) + L(5) + L(6) + L(7);
       }
-      if (is_mean_ && num >= 10) {
+      if (normalize && is_mean_ && num >= 10) {
         out = out / static_cast<T>(num);
       }
-      if (is_sqrtn_ && num >= 10) {
+      if (normalize && is_sqrtn_ && num >= 10) {
         out = out / static_cast<T>(sqrt(num));
       }
     }
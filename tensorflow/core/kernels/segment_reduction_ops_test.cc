@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <vector>
 
@@ -31,6 +33,8 @@ limitations under the License.
 #include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
@@ -166,4 +170,80 @@ static void BM_SparseSegmentMeanGrad_High(int iters, int size) {
 BENCHMARK(BM_SparseSegmentMeanGrad_Low)->Arg(1000)->Arg(100000);
 BENCHMARK(BM_SparseSegmentMeanGrad_High)->Arg(1000)->Arg(100000);
 
+// Returns `num_rows` segment ids in [0, num_segments) with power-law segment
+// sizes: segment k holds about 1 / (k + 1) of the rows of segment 0.
+static Tensor PowerLawSegmentIds(int num_rows, int num_segments, bool sorted) {
+  Tensor segment_ids(DT_INT32, TensorShape({num_rows}));
+  auto ids = segment_ids.flat<int32>();
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  for (int i = 0; i < num_rows; ++i) {
+    ids(i) = std::min(
+        num_segments - 1,
+        static_cast<int>(std::pow(num_segments, rnd.RandFloat())) - 1);
+  }
+  if (sorted) std::sort(ids.data(), ids.data() + num_rows);
+  return segment_ids;
+}
+
+static void BM_UnsortedSegmentSumPowerLaw(int iters, int num_rows,
+                                          int num_cols) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  const int num_segments = 10000;
+  Tensor data(DT_FLOAT, TensorShape({num_rows, num_cols}));
+  data.flat<float>().setRandom();
+  Node* node;
+  TF_CHECK_OK(
+      NodeBuilder(g->NewName("n"), "UnsortedSegmentSum")
+          .Input(test::graph::Constant(g, data))
+          .Input(test::graph::Constant(
+              g, PowerLawSegmentIds(num_rows, num_segments, false)))
+          .Input(test::graph::Constant(g, test::AsScalar<int32>(num_segments)))
+          .Finalize(g, &node));
+
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_rows * num_cols *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+static void BM_SparseSegmentSumPowerLaw(int iters, int num_rows,
+                                        int num_cols) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  const int num_segments = 10000;
+  Tensor data(DT_FLOAT, TensorShape({num_rows, num_cols}));
+  data.flat<float>().setRandom();
+  Tensor indices(DT_INT32, TensorShape({num_rows}));
+  test::FillFn<int32>(&indices, [num_rows](int i) -> int32 {
+    return (i * 31) % num_rows;
+  });
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "SparseSegmentSum")
+                  .Input(test::graph::Constant(g, data))
+                  .Input(test::graph::Constant(g, indices))
+                  .Input(test::graph::Constant(
+                      g, PowerLawSegmentIds(num_rows, num_segments, true)))
+                  .Finalize(g, &node));
+
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_rows * num_cols *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_UnsortedSegmentSumPowerLaw)
+    ->ArgPair(100000, 1)
+    ->ArgPair(100000, 16)
+    ->ArgPair(100000, 128)
+    ->ArgPair(1000000, 16);
+BENCHMARK(BM_SparseSegmentSumPowerLaw)
+    ->ArgPair(100000, 1)
+    ->ArgPair(100000, 16)
+    ->ArgPair(100000, 128)
+    ->ArgPair(1000000, 16);
+
 }  // namespace tensorflow
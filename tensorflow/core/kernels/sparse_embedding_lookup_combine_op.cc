@@ -0,0 +1,385 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+enum class Combiner { kSum, kMean, kSqrtN };
+
+// Returns the factor by which the weighted rows of a segment are scaled,
+// given the sum of their weights and the sum of their squared weights.
+double SegmentScale(Combiner combiner, double weight_sum,
+                    double weight_sq_sum) {
+  switch (combiner) {
+    case Combiner::kMean:
+      return 1.0 / weight_sum;
+    case Combiner::kSqrtN:
+      return 1.0 / std::sqrt(weight_sq_sum);
+    case Combiner::kSum:
+    default:
+      return 1.0;
+  }
+}
+
+// Sets row `r` of the [num_rows, num_cols] `output` to the sum of
+// `coefficients[e] * input[source_rows[e]]` over the entries `e` in
+// [row_starts[r], row_starts[r + 1]), or to zeros if that range is empty.
+//
+// Every output row is owned by exactly one shard and the input rows are read
+// in place, so rows are streamed straight into their accumulators without
+// materializing the gathered rows, and Eigen vectorizes the row updates.
+template <typename T>
+void CombineRows(OpKernelContext* context, const T* input, int64 num_cols,
+                 const std::vector<int64>& row_starts,
+                 const std::vector<int64>& source_rows,
+                 const std::vector<T>& coefficients, T* output) {
+  typedef Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>> Row;
+  typedef Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>> ConstRow;
+
+  const int64 num_rows = row_starts.size() - 1;
+  auto work = [&](int64 begin, int64 end) {
+    for (int64 r = begin; r < end; ++r) {
+      Row out(output + r * num_cols, num_cols);
+      const int64 first = row_starts[r];
+      const int64 last = row_starts[r + 1];
+      if (first == last) {
+        out.setZero();
+        continue;
+      }
+      for (int64 e = first; e < last; ++e) {
+        // The rows are usually far apart in a large embedding, so fetch the
+        // next one while this one is being accumulated.
+        if (e + 1 < last) {
+          port::prefetch<port::PREFETCH_HINT_T0>(input +
+                                                 source_rows[e + 1] * num_cols);
+        }
+        const ConstRow in(input + source_rows[e] * num_cols, num_cols);
+        if (e == first) {
+          out = coefficients[e] * in;
+        } else {
+          out += coefficients[e] * in;
+        }
+      }
+    }
+  };
+
+  const int64 num_entries = source_rows.size();
+  const int64 cost_per_row =
+      (num_entries / std::max<int64>(num_rows, 1) + 1) * num_cols;
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *context->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+        cost_per_row, work);
+}
+
+}  // namespace
+
+class FusedSparseEmbeddingLookupCombineOpBase : public OpKernel {
+ public:
+  explicit FusedSparseEmbeddingLookupCombineOpBase(
+      OpKernelConstruction* context)
+      : OpKernel(context) {
+    string combiner;
+    OP_REQUIRES_OK(context, context->GetAttr("combiner", &combiner));
+    if (combiner == "sum") {
+      combiner_ = Combiner::kSum;
+    } else if (combiner == "mean") {
+      combiner_ = Combiner::kMean;
+    } else if (combiner == "sqrtn") {
+      combiner_ = Combiner::kSqrtN;
+    } else {
+      context->CtxFailure(
+          errors::InvalidArgument("Unsupported combiner: ", combiner));
+      return;
+    }
+    int num_weights;
+    OP_REQUIRES_OK(context, context->GetAttr("num_weights", &num_weights));
+    OP_REQUIRES(context, num_weights <= 1,
+                errors::InvalidArgument(
+                    "Expected at most one weights tensor, got ", num_weights));
+    weighted_ = num_weights == 1;
+  }
+
+ protected:
+  // Validates that `weights` holds one weight per entry.
+  Status CheckWeights(const Tensor& weights, int64 num_entries) const {
+    if (!TensorShapeUtils::IsVector(weights.shape())) {
+      return errors::InvalidArgument("weights should be a vector, got shape ",
+                                     weights.shape().DebugString());
+    }
+    if (weights.NumElements() != num_entries) {
+      return errors::InvalidArgument(
+          "weights and segment_ids should have same size: ",
+          weights.NumElements(), " vs ", num_entries);
+    }
+    return Status::OK();
+  }
+
+  Combiner combiner_ = Combiner::kSum;
+  bool weighted_ = false;
+};
+
+template <typename T, typename Tidx>
+class FusedSparseEmbeddingLookupCombineOp
+    : public FusedSparseEmbeddingLookupCombineOpBase {
+ public:
+  explicit FusedSparseEmbeddingLookupCombineOp(OpKernelConstruction* context)
+      : FusedSparseEmbeddingLookupCombineOpBase(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& params = context->input(0);
+    const Tensor& ids = context->input(1);
+    const Tensor& segment_ids = context->input(2);
+
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(params.shape()),
+                errors::InvalidArgument("params must be at least 1-D, got ",
+                                        params.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids should be a vector."));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(segment_ids.shape()),
+                errors::InvalidArgument("segment_ids should be a vector."));
+    const int64 num_ids = ids.NumElements();
+    OP_REQUIRES(
+        context, num_ids == segment_ids.NumElements(),
+        errors::InvalidArgument("segment_ids and ids should have same size."));
+    const T* weights = nullptr;
+    if (weighted_) {
+      OP_REQUIRES_OK(context, CheckWeights(context->input(3), num_ids));
+      weights = context->input(3).flat<T>().data();
+    }
+
+    const auto params_flat = params.flat_outer_dims<T>();
+    const int64 num_params = params_flat.dimension(0);
+    const int64 num_cols = params_flat.dimension(1);
+    const auto ids_vec = ids.vec<Tidx>();
+    const auto segment_vec = segment_ids.vec<int32>();
+
+    // Segment ids are sorted, so the output has as many rows as the last
+    // segment id plus one.
+    const int32 num_segments =
+        num_ids > 0 ? internal::SubtleMustCopy(segment_vec(num_ids - 1)) + 1
+                    : 0;
+    OP_REQUIRES(context, num_segments >= 0,
+                errors::InvalidArgument("segment ids must be >= 0"));
+
+    // The entries of segment s are [row_starts[s], row_starts[s + 1]).
+    std::vector<int64> row_starts(num_segments + 1, 0);
+    std::vector<int64> source_rows(num_ids);
+    std::vector<T> coefficients(num_ids, T(1));
+    const bool needs_weight_sums = combiner_ != Combiner::kSum;
+    std::vector<double> weight_sums(needs_weight_sums ? num_segments : 0);
+    std::vector<double> weight_sq_sums(needs_weight_sums ? num_segments : 0);
+    int32 previous_segment = 0;
+    for (int64 i = 0; i < num_ids; ++i) {
+      const int32 segment = internal::SubtleMustCopy(segment_vec(i));
+      OP_REQUIRES(context, FastBoundsCheck(segment, num_segments),
+                  errors::InvalidArgument("Segment id ", segment,
+                                          " out of range [0, ", num_segments,
+                                          ")."));
+      OP_REQUIRES(context, segment >= previous_segment,
+                  errors::InvalidArgument("segment ids are not increasing"));
+      previous_segment = segment;
+
+      const Tidx id = internal::SubtleMustCopy(ids_vec(i));
+      OP_REQUIRES(context, FastBoundsCheck(id, num_params),
+                  errors::InvalidArgument("ids[", i, "] = ", id,
+                                          " is not in [0, ", num_params, ")"));
+      source_rows[i] = id;
+      ++row_starts[segment + 1];
+
+      if (weights != nullptr) coefficients[i] = weights[i];
+      if (needs_weight_sums) {
+        const double weight = static_cast<double>(coefficients[i]);
+        weight_sums[segment] += weight;
+        weight_sq_sums[segment] += weight * weight;
+      }
+    }
+    for (int32 s = 0; s < num_segments; ++s) {
+      row_starts[s + 1] += row_starts[s];
+    }
+    if (needs_weight_sums) {
+      for (int32 s = 0; s < num_segments; ++s) {
+        const T scale = static_cast<T>(
+            SegmentScale(combiner_, weight_sums[s], weight_sq_sums[s]));
+        for (int64 e = row_starts[s]; e < row_starts[s + 1]; ++e) {
+          coefficients[e] *= scale;
+        }
+      }
+    }
+
+    TensorShape output_shape = params.shape();
+    output_shape.set_dim(0, num_segments);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+
+    CombineRows<T>(context, params_flat.data(), num_cols, row_starts,
+                   source_rows, coefficients, output->flat<T>().data());
+  }
+};
+
+template <typename T, typename Tidx>
+class FusedSparseEmbeddingLookupCombineGradOp
+    : public FusedSparseEmbeddingLookupCombineOpBase {
+ public:
+  explicit FusedSparseEmbeddingLookupCombineGradOp(
+      OpKernelConstruction* context)
+      : FusedSparseEmbeddingLookupCombineOpBase(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& grad = context->input(0);
+    const Tensor& indices = context->input(1);
+    const Tensor& segment_ids = context->input(2);
+    const Tensor& output_dim0 = context->input(3);
+
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(grad.shape()),
+                errors::InvalidArgument("grad must be at least 1-D, got ",
+                                        grad.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(indices.shape()),
+                errors::InvalidArgument("indices should be a vector."));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(segment_ids.shape()),
+                errors::InvalidArgument("segment_ids should be a vector."));
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(output_dim0.shape()),
+                errors::InvalidArgument("output_dim0 should be a scalar."));
+    const int64 num_indices = indices.NumElements();
+    OP_REQUIRES(context, num_indices == segment_ids.NumElements(),
+                errors::InvalidArgument(
+                    "segment_ids and indices should have same size."));
+    const T* weights = nullptr;
+    if (weighted_) {
+      OP_REQUIRES_OK(context, CheckWeights(context->input(4), num_indices));
+      weights = context->input(4).flat<T>().data();
+    }
+    const int32 num_outputs =
+        internal::SubtleMustCopy(output_dim0.scalar<int32>()());
+    OP_REQUIRES(context, num_outputs >= 0,
+                errors::InvalidArgument("output_dim0 must be >= 0, got ",
+                                        num_outputs));
+
+    const auto grad_flat = grad.flat_outer_dims<T>();
+    const int64 num_segments = grad_flat.dimension(0);
+    const int64 num_cols = grad_flat.dimension(1);
+    const auto indices_vec = indices.vec<Tidx>();
+    const auto segment_vec = segment_ids.vec<int32>();
+
+    // Validate the inputs, count the entries of every output row and sum the
+    // weights of every segment.
+    std::vector<int64> row_starts(num_outputs + 1, 0);
+    const bool needs_weight_sums = combiner_ != Combiner::kSum;
+    std::vector<double> weight_sums(needs_weight_sums ? num_segments : 0);
+    std::vector<double> weight_sq_sums(needs_weight_sums ? num_segments : 0);
+    for (int64 i = 0; i < num_indices; ++i) {
+      const int32 segment = internal::SubtleMustCopy(segment_vec(i));
+      OP_REQUIRES(context, FastBoundsCheck(segment, num_segments),
+                  errors::InvalidArgument("Segment id ", segment,
+                                          " out of range [0, ", num_segments,
+                                          ")."));
+      const Tidx index = internal::SubtleMustCopy(indices_vec(i));
+      // As in UnsortedSegmentSum, entries with negative indices are dropped.
+      if (index < 0) continue;
+      OP_REQUIRES(context, FastBoundsCheck(index, num_outputs),
+                  errors::InvalidArgument("Index ", index, " out of range [0, ",
+                                          num_outputs, ")."));
+      ++row_starts[index + 1];
+      if (needs_weight_sums) {
+        const double weight =
+            weights != nullptr ? static_cast<double>(weights[i]) : 1.0;
+        weight_sums[segment] += weight;
+        weight_sq_sums[segment] += weight * weight;
+      }
+    }
+    for (int32 r = 0; r < num_outputs; ++r) {
+      row_starts[r + 1] += row_starts[r];
+    }
+
+    std::vector<T> scales(needs_weight_sums ? num_segments : 0);
+    for (size_t s = 0; s < scales.size(); ++s) {
+      scales[s] = static_cast<T>(
+          SegmentScale(combiner_, weight_sums[s], weight_sq_sums[s]));
+    }
+
+    // Bucket the entries by output row, keeping their relative order so that
+    // the result does not depend on the number of threads.
+    const int64 num_entries = row_starts[num_outputs];
+    std::vector<int64> source_rows(num_entries);
+    std::vector<T> coefficients(num_entries);
+    std::vector<int64> next_entry(row_starts.begin(), row_starts.end() - 1);
+    for (int64 i = 0; i < num_indices; ++i) {
+      const int32 segment = internal::SubtleMustCopy(segment_vec(i));
+      const Tidx index = internal::SubtleMustCopy(indices_vec(i));
+      if (index < 0) continue;
+      const int64 e = next_entry[index]++;
+      source_rows[e] = segment;
+      T coefficient = weights != nullptr ? weights[i] : T(1);
+      if (needs_weight_sums) coefficient *= scales[segment];
+      coefficients[e] = coefficient;
+    }
+
+    TensorShape output_shape = grad.shape();
+    output_shape.set_dim(0, num_outputs);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+
+    CombineRows<T>(context, grad_flat.data(), num_cols, row_starts,
+                   source_rows, coefficients, output->flat<T>().data());
+  }
+};
+
+#define REGISTER_KERNELS(type, index_type)                           \
+  REGISTER_KERNEL_BUILDER(Name("_FusedSparseEmbeddingLookupCombine") \
+                              .Device(DEVICE_CPU)                    \
+                              .TypeConstraint<type>("T")             \
+                              .TypeConstraint<index_type>("Tidx"),   \
+                          FusedSparseEmbeddingLookupCombineOp<       \
+                              type, index_type>);                    \
+  REGISTER_KERNEL_BUILDER(                                           \
+      Name("_FusedSparseEmbeddingLookupCombineGrad")                 \
+          .Device(DEVICE_CPU)                                        \
+          .TypeConstraint<type>("T")                                 \
+          .TypeConstraint<index_type>("Tidx"),                       \
+      FusedSparseEmbeddingLookupCombineGradOp<type, index_type>);
+
+#define REGISTER_CPU_KERNELS(type) \
+  REGISTER_KERNELS(type, int32);   \
+  REGISTER_KERNELS(type, int64);
+
+TF_CALL_float(REGISTER_CPU_KERNELS);
+TF_CALL_double(REGISTER_CPU_KERNELS);
+
+#undef REGISTER_CPU_KERNELS
+#undef REGISTER_KERNELS
+
+}  // namespace tensorflow
@@ -0,0 +1,239 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedSparseEmbeddingLookupCombineOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, const string& combiner, bool weighted,
+              bool is_grad) {
+    NodeDefBuilder builder("op", op);
+    builder.Input(FakeInput(DT_FLOAT))
+        .Input(FakeInput(DT_INT32))
+        .Input(FakeInput(DT_INT32));
+    if (is_grad) builder.Input(FakeInput(DT_INT32));
+    TF_ASSERT_OK(builder.Input(FakeInput(weighted ? 1 : 0, DT_FLOAT))
+                     .Attr("combiner", combiner)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  void MakeLookupOp(const string& combiner, bool weighted) {
+    MakeOp("_FusedSparseEmbeddingLookupCombine", combiner, weighted,
+           /*is_grad=*/false);
+  }
+
+  void MakeGradOp(const string& combiner, bool weighted) {
+    MakeOp("_FusedSparseEmbeddingLookupCombineGrad", combiner, weighted,
+           /*is_grad=*/true);
+  }
+
+  // Adds a [5, 2] params tensor whose row r is {2r, 2r + 1}, and two segments
+  // that each look up two rows, with an empty segment in between.
+  void AddLookupInputs() {
+    AddInputFromArray<float>(TensorShape({5, 2}),
+                             {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+    AddInputFromArray<int32>(TensorShape({4}), {4, 1, 1, 3});
+    AddInputFromArray<int32>(TensorShape({4}), {0, 0, 2, 2});
+  }
+};
+
+TEST_F(FusedSparseEmbeddingLookupCombineOpTest, Sum) {
+  MakeLookupOp("sum", /*weighted=*/false);
+  AddLookupInputs();
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {10, 12, 0, 0, 8, 10});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedSparseEmbeddingLookupCombineOpTest, WeightedMean) {
+  MakeLookupOp("mean", /*weighted=*/true);
+  AddLookupInputs();
+  AddInputFromArray<float>(TensorShape({4}), {1, 2, 3, 1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // (1 * {8, 9} + 2 * {2, 3}) / 3 and (3 * {2, 3} + 1 * {6, 7}) / 4.
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {4, 5, 0, 0, 3, 4});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-6);
+}
+
+TEST_F(FusedSparseEmbeddingLookupCombineOpTest, SqrtN) {
+  MakeLookupOp("sqrtn", /*weighted=*/false);
+  AddLookupInputs();
+  TF_ASSERT_OK(RunOpKernel());
+
+  const float scale = 1 / std::sqrt(2.0f);
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(
+      &expected, {10 * scale, 12 * scale, 0, 0, 8 * scale, 10 * scale});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-6);
+}
+
+TEST_F(FusedSparseEmbeddingLookupCombineOpTest, UnsortedSegmentIds) {
+  MakeLookupOp("sum", /*weighted=*/false);
+  AddInputFromArray<float>(TensorShape({2, 1}), {1, 2});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 1, 0});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 2, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(), "not increasing")) << s;
+}
+
+TEST_F(FusedSparseEmbeddingLookupCombineOpTest, IdOutOfRange) {
+  MakeLookupOp("sum", /*weighted=*/false);
+  AddInputFromArray<float>(TensorShape({2, 1}), {1, 2});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 2});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(), "ids[1] = 2 is not in"))
+      << s;
+}
+
+TEST_F(FusedSparseEmbeddingLookupCombineOpTest, GradSumWithUnsortedSegments) {
+  MakeGradOp("sum", /*weighted=*/false);
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<int32>(TensorShape({3}), {1, 0, 1});
+  AddInputFromArray<int32>(TensorShape({3}), {2, 0, 1});
+  AddInputFromArray<int32>(TensorShape({}), {2});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {1, 2, 8, 10});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedSparseEmbeddingLookupCombineOpTest, GradWeightedMean) {
+  MakeGradOp("mean", /*weighted=*/true);
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 2, 2, 1});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 2, 2});
+  AddInputFromArray<int32>(TensorShape({}), {3});
+  AddInputFromArray<float>(TensorShape({4}), {1, 2, 3, 1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // Segment 0 has a total weight of 3 and segment 2 a total weight of 4.
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(
+      &expected, {1.f / 3, 2.f / 3,  // 1/3 * {1, 2}
+                  5.f / 4, 6.f / 4,  // 1/4 * {5, 6}
+                  2.f / 3 + 15.f / 4, 4.f / 3 + 18.f / 4});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+constexpr int kNumParams = 100000;
+constexpr int kEmbeddingDim = 64;
+constexpr int kIdsPerSegment = 8;
+
+// Looks up `num_ids` random rows of a [kNumParams, kEmbeddingDim] embedding
+// into segments of `kIdsPerSegment` ids, either with the fused kernel or with
+// the Unique + GatherV2 + SparseSegmentSum graph that embedding_lookup_sparse
+// builds.
+Graph* EmbeddingLookupGraph(int num_ids, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor params(DT_FLOAT, TensorShape({kNumParams, kEmbeddingDim}));
+  params.flat<float>().setRandom();
+  Tensor ids(DT_INT64, TensorShape({num_ids}));
+  Tensor segment_ids(DT_INT32, TensorShape({num_ids}));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  for (int i = 0; i < num_ids; ++i) {
+    ids.vec<int64>()(i) = rnd.Uniform(kNumParams);
+    segment_ids.vec<int32>()(i) = i / kIdsPerSegment;
+  }
+  Node* params_node = test::graph::Constant(g, params);
+  Node* ids_node = test::graph::Constant(g, ids);
+  Node* segment_ids_node = test::graph::Constant(g, segment_ids);
+
+  Node* ret;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"),
+                            "_FusedSparseEmbeddingLookupCombine")
+                    .Input(params_node)
+                    .Input(ids_node)
+                    .Input(segment_ids_node)
+                    .Input(std::vector<NodeBuilder::NodeOut>())
+                    .Attr("T", DT_FLOAT)
+                    .Attr("Tidx", DT_INT64)
+                    .Attr("combiner", "sum")
+                    .Finalize(g, &ret));
+    return g;
+  }
+
+  Node* unique;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                  .Input(ids_node)
+                  .Attr("T", DT_INT64)
+                  .Attr("out_idx", DT_INT32)
+                  .Finalize(g, &unique));
+  Node* gather;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "GatherV2")
+                  .Input(params_node)
+                  .Input(unique, 0)
+                  .Input(test::graph::Constant(g, test::AsScalar<int32>(0)))
+                  .Finalize(g, &gather));
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "SparseSegmentSum")
+                  .Input(gather)
+                  .Input(unique, 1)
+                  .Input(segment_ids_node)
+                  .Finalize(g, &ret));
+  return g;
+}
+
+static void BM_EmbeddingLookup(int iters, int num_ids, bool fused) {
+  testing::StopTiming();
+  Graph* g = EmbeddingLookupGraph(num_ids, fused);
+  testing::BytesProcessed(static_cast<int64>(iters) * num_ids *
+                          kEmbeddingDim * sizeof(float));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+static void BM_EmbeddingLookupFused(int iters, int num_ids) {
+  BM_EmbeddingLookup(iters, num_ids, /*fused=*/true);
+}
+
+static void BM_EmbeddingLookupUnfused(int iters, int num_ids) {
+  BM_EmbeddingLookup(iters, num_ids, /*fused=*/false);
+}
+
+BENCHMARK(BM_EmbeddingLookupFused)->Arg(1024)->Arg(16384)->Arg(262144);
+BENCHMARK(BM_EmbeddingLookupUnfused)->Arg(1024)->Arg(16384)->Arg(262144);
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,10 +15,36 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/training_op_helpers.h"
 
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/util/ptr_util.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Number of row mutexes shared by all the variables. Two rows only contend if
+// they hash to the same stripe.
+constexpr int kNumSparseUpdateRowStripes = 1024;
+
+}  // namespace
+
+Status GetSparseUpdateRowLockKey(OpKernelContext* ctx, int input,
+                                 const void** key) {
+  Var* var = nullptr;
+  TF_RETURN_IF_ERROR(LookupResource(ctx, HandleFromInput(ctx, input), &var));
+  // The key is only compared, so the variable need not outlive it.
+  *key = var;
+  var->Unref();
+  return Status::OK();
+}
+
+mutex* GetSparseUpdateRowMutex(const void* key, int64 row) {
+  static mutex* stripes = new mutex[kNumSparseUpdateRowStripes];
+  const uint64 hash =
+      Hash64Combine(reinterpret_cast<uintptr_t>(key), static_cast<uint64>(row));
+  return &stripes[hash % kNumSparseUpdateRowStripes];
+}
+
 
 void MaybeForwardRefInputToRefOutput(OpKernelContext* ctx, int input,
                                      int output) {
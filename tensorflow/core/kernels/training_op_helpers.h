@@ -16,12 +16,19 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_TRAINING_OP_HELPERS_H_
 #define TENSORFLOW_CORE_KERNELS_TRAINING_OP_HELPERS_H_
 
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/framework/variant_op_registry.h"
 #include "tensorflow/core/kernels/dense_update_functor.h"
 #include "tensorflow/core/kernels/variable_ops.h"
 #include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -256,6 +263,81 @@ Status GetInputTensorFromVariable(OpKernelContext* ctx, int input,
   return Status::OK();
 }
 
+// Sets `*key` to the identity of the resource variable `input` used by
+// GetSparseUpdateRowMutex(). Unlike the address of its buffer, it does not
+// change when the variable switches to copy-on-read mode.
+Status GetSparseUpdateRowLockKey(OpKernelContext* ctx, int input,
+                                 const void** key);
+
+// Returns the mutex of the stripe that row `row` of the variable identified by
+// `key` (see GetSparseUpdateRowLockKey()) belongs to. The sparse apply kernels
+// with `lock_rows` set hold the variable mutexes shared, which excludes dense
+// updates, and lock each updated row with its stripe mutex, so that updates
+// of different rows of one large variable proceed in parallel.
+mutex* GetSparseUpdateRowMutex(const void* key, int64 row);
+
+// Calls `update(i)` for every offset `i` of `indices`, on the intra-op threads
+// when the updates are expensive enough. The updates of one row are applied by
+// a single thread in the order of their offsets, so the result is the same as
+// applying them sequentially even when `indices` has duplicates. All the
+// indices must be valid rows.
+//
+// If `row_lock_key` is not null, every update holds the stripe mutex of its
+// row (see GetSparseUpdateRowMutex), which serializes it with the updates of
+// the same row by other kernels with `lock_rows` set.
+template <typename Tindex, typename UpdateFn>
+void ApplySparseUpdates(OpKernelContext* ctx,
+                        typename TTypes<Tindex>::ConstVec indices,
+                        int64 cost_per_update, const void* row_lock_key,
+                        const UpdateFn& update) {
+  const int64 N = indices.size();
+  const auto apply = [&](int64 i) {
+    if (row_lock_key == nullptr) {
+      update(static_cast<Tindex>(i));
+      return;
+    }
+    const Tindex row = internal::SubtleMustCopy(indices(i));
+    mutex_lock l(*GetSparseUpdateRowMutex(row_lock_key, row));
+    update(static_cast<Tindex>(i));
+  };
+
+  // Same minimum amount of work per shard as Shard().
+  constexpr int64 kMinCostPerShard = 10000;
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *ctx->device()->tensorflow_cpu_worker_threads();
+  const int64 num_shards = std::min<int64>(
+      {static_cast<int64>(worker_threads.num_threads), N,
+       N * std::max<int64>(cost_per_update, 1) / kMinCostPerShard});
+  if (num_shards <= 1) {
+    for (int64 i = 0; i < N; ++i) apply(i);
+    return;
+  }
+
+  // Bucket the offsets by row, so that every row is owned by one shard.
+  const auto shard_of = [&](int64 i) {
+    return static_cast<uint64>(internal::SubtleMustCopy(indices(i))) %
+           num_shards;
+  };
+  std::vector<int64> shard_starts(num_shards + 1, 0);
+  for (int64 i = 0; i < N; ++i) ++shard_starts[shard_of(i) + 1];
+  for (int64 s = 0; s < num_shards; ++s) {
+    shard_starts[s + 1] += shard_starts[s];
+  }
+  std::vector<int64> offsets(N);
+  std::vector<int64> next(shard_starts.begin(), shard_starts.end() - 1);
+  for (int64 i = 0; i < N; ++i) offsets[next[shard_of(i)]++] = i;
+
+  Shard(worker_threads.num_threads, worker_threads.workers, num_shards,
+        /*cost_per_unit=*/kMinCostPerShard * N,
+        [&](int64 begin, int64 end) {
+          for (int64 s = begin; s < end; ++s) {
+            for (int64 e = shard_starts[s]; e < shard_starts[s + 1]; ++e) {
+              apply(offsets[e]);
+            }
+          }
+        });
+}
+
 }  // end namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_KERNELS_TRAINING_OP_HELPERS_H_
@@ -1518,18 +1518,25 @@ class SparseApplyAdagradOp : public OpKernel {
   explicit SparseApplyAdagradOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("update_slots", &update_slots_));
+    // Only the resource variant has the attr. Ref variables have no shared
+    // lock that excludes dense updates, so they are always locked exclusively.
+    if (ctx->HasAttr("lock_rows")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("lock_rows", &lock_rows_));
+    }
   }
 
   void Compute(OpKernelContext* ctx) override NO_THREAD_SAFETY_ANALYSIS {
     const bool sparse = true;
+    const bool lock_rows = use_exclusive_lock_ && lock_rows_;
+    const bool lock_variables = use_exclusive_lock_ && !lock_rows_;
     auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
-        ctx, use_exclusive_lock_, sparse, {0, 1});
+        ctx, lock_variables, sparse, {0, 1});
     Tensor var;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
-                            ctx, 0, use_exclusive_lock_, sparse, &var));
+                            ctx, 0, lock_variables, sparse, &var));
     Tensor accum;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
-                            ctx, 1, use_exclusive_lock_, sparse, &accum));
+                            ctx, 1, lock_variables, sparse, &accum));
     OP_REQUIRES(
         ctx, var.IsInitialized(),
         errors::FailedPrecondition(
@@ -1572,76 +1579,58 @@ class SparseApplyAdagradOp : public OpKernel {
                 errors::InvalidArgument(
                     "Inner dimension should be greater than zero."));
 
-    // This op is implemented only for CPU device.
-    const auto& d = ctx->eigen_cpu_device();
+    const Tindex first_dim_size = var.dim_size(0);
+    auto indices_vec = indices.vec<Tindex>();
+    for (Tindex i = 0; i < N; ++i) {
+      const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+      OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
+                  errors::InvalidArgument(
+                      strings::StrCat("Index ", index, " at offset ", i,
+                                      " in indices is out of range")));
+    }
 
     if (N > 0) {
-      const int in_bytes = inner_dim * sizeof(T) * 3;
-      const int out_bytes = inner_dim * sizeof(T) * 2;
-      const int cycles = inner_dim * (Eigen::TensorOpCost::AddCost<T>() * 2 +
-                                      Eigen::TensorOpCost::MulCost<T>() * 2);
-      const Eigen::TensorOpCost cost(in_bytes, out_bytes, cycles);
+      const int64 cost_per_update =
+          inner_dim * (Eigen::TensorOpCost::AddCost<T>() * 2 +
+                       Eigen::TensorOpCost::MulCost<T>() * 2 +
+                       Eigen::TensorOpCost::DivCost<T>());
+      const void* row_lock_key = nullptr;
+      if (lock_rows) {
+        OP_REQUIRES_OK(ctx, GetSparseUpdateRowLockKey(ctx, 0, &row_lock_key));
+      }
+      T lr_scalar = lr.scalar<T>()();
 
       if (inner_dim > 1) {
-        const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
         auto accum_flat = accum.flat_outer_dims<T>();
         auto grad_flat = grad.flat_outer_dims<T>();
-        T lr_scalar = lr.scalar<T>()();
-
-        for (Tindex i = 0; i < N; ++i) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-        }
-
-        const auto shard = [&](Tindex start_idx, Tindex end_idx) -> void {
-          for (Tindex i = start_idx; i < end_idx; ++i) {
-            const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-            auto a = accum_flat.template chip<0>(index);
-            auto g = grad_flat.template chip<0>(i);
-            auto v = var_flat.template chip<0>(index);
-            if (update_slots_) {
-              a += g.square();
-            }
-            v -= g.constant(lr_scalar) * g * a.rsqrt();
-          }
-        };
-
-        d.parallelFor(N, cost, shard);
 
+        ApplySparseUpdates<Tindex>(
+            ctx, indices_vec, cost_per_update, row_lock_key, [&](Tindex i) {
+              const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+              auto a = accum_flat.template chip<0>(index);
+              auto g = grad_flat.template chip<0>(i);
+              auto v = var_flat.template chip<0>(index);
+              if (update_slots_) {
+                a += g.square();
+              }
+              v -= g.constant(lr_scalar) * g * a.rsqrt();
+            });
       } else {
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat<T>();
         auto accum_flat = accum.flat<T>();
         auto grad_flat = grad.flat<T>();
-        T lr_scalar = lr.scalar<T>()();
-        const Tindex first_dim_size = accum_flat.size();
 
-        for (Tindex i = 0; i < N; ++i) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-        }
-
-        const auto shard = [&](Tindex start_idx, Tindex end_idx) -> void {
-          for (Tindex i = start_idx; i < end_idx; ++i) {
-            const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-            T& a = accum_flat(index);
-            const T& g = grad_flat(i);
-            if (update_slots_) {
-              a += g * g;
-            }
-            var_flat(index) -= lr_scalar * g / Eigen::numext::sqrt(a);
-          }
-        };
-
-        d.parallelFor(N, cost, shard);
+        ApplySparseUpdates<Tindex>(
+            ctx, indices_vec, cost_per_update, row_lock_key, [&](Tindex i) {
+              const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+              T& a = accum_flat(index);
+              const T& g = grad_flat(i);
+              if (update_slots_) {
+                a += g * g;
+              }
+              var_flat(index) -= lr_scalar * g / Eigen::numext::sqrt(a);
+            });
       }
     }
 
@@ -1651,6 +1640,7 @@ class SparseApplyAdagradOp : public OpKernel {
  private:
   bool use_exclusive_lock_;
   bool update_slots_;
+  bool lock_rows_ = false;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -2517,21 +2507,28 @@ class SparseApplyFtrlOp : public OpKernel {
  public:
   explicit SparseApplyFtrlOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
+    // Only the resource variants have the attr. Ref variables have no shared
+    // lock that excludes dense updates, so they are always locked exclusively.
+    if (ctx->HasAttr("lock_rows")) {
+      OP_REQUIRES_OK(ctx, ctx->GetAttr("lock_rows", &lock_rows_));
+    }
   }
 
   void Compute(OpKernelContext* ctx) override NO_THREAD_SAFETY_ANALYSIS {
     const bool sparse = true;
+    const bool lock_rows = use_exclusive_lock_ && lock_rows_;
+    const bool lock_variables = use_exclusive_lock_ && !lock_rows_;
     auto locks = MaybeLockVariableInputMutexesInOrder<Device, T>(
-        ctx, use_exclusive_lock_, sparse, {0, 1, 2});
+        ctx, lock_variables, sparse, {0, 1, 2});
     Tensor var;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<Device, T>(
-                            ctx, 0, use_exclusive_lock_, sparse, &var));
+                            ctx, 0, lock_variables, sparse, &var));
     Tensor accum;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<Device, T>(
-                            ctx, 1, use_exclusive_lock_, sparse, &accum));
+                            ctx, 1, lock_variables, sparse, &accum));
     Tensor linear;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<Device, T>(
-                            ctx, 2, use_exclusive_lock_, sparse, &linear));
+                            ctx, 2, lock_variables, sparse, &linear));
     OP_REQUIRES(
         ctx, var.IsInitialized(),
         errors::FailedPrecondition(
@@ -2620,10 +2617,26 @@ class SparseApplyFtrlOp : public OpKernel {
                                   l2_shrinkage->shape().DebugString()));
     }
 
+    const Tindex first_dim_size = var.dim_size(0);
+    auto indices_vec = indices.vec<Tindex>();
+    for (Tindex i = 0; i < N; i++) {
+      const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+      OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
+                  errors::InvalidArgument(
+                      strings::StrCat("Index ", index, " at offset ", i,
+                                      " in indices is out of range")));
+    }
+
     if (N > 0) {
+      const int64 cost_per_update =
+          inner_dim * (Eigen::TensorOpCost::AddCost<T>() * 8 +
+                       Eigen::TensorOpCost::MulCost<T>() * 6 +
+                       Eigen::TensorOpCost::DivCost<T>() * 4);
+      const void* row_lock_key = nullptr;
+      if (lock_rows) {
+        OP_REQUIRES_OK(ctx, GetSparseUpdateRowLockKey(ctx, 0, &row_lock_key));
+      }
       if (inner_dim > 1) {
-        const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
         auto accum_flat = accum.flat_outer_dims<T>();
         auto linear_flat = linear.flat_outer_dims<T>();
@@ -2637,12 +2650,8 @@ class SparseApplyFtrlOp : public OpKernel {
         }
         T lr_power_scalar = lr_power.scalar<T>()();
 
-        for (Tindex i = 0; i < N; i++) {
+        const auto update = [&](Tindex i) {
           const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
           auto accum = accum_flat.template chip<0>(index);
           auto linear = linear_flat.template chip<0>(index);
           auto grad = grad_flat.template chip<0>(i);
@@ -2680,8 +2689,10 @@ class SparseApplyFtrlOp : public OpKernel {
           } else {
             COMPUTE_FTRL(grad, grad);
           }
-        }
+        };
 #undef COMPUTE_FTRL
+        ApplySparseUpdates<Tindex>(ctx, indices_vec, cost_per_update,
+                                   row_lock_key, update);
       } else {
         T lr_scalar = lr.scalar<T>()();
         T l1_scalar = l1.scalar<T>()();
@@ -2692,19 +2703,13 @@ class SparseApplyFtrlOp : public OpKernel {
           l2_shrinkage_scalar = l2_shrinkage->scalar<T>()();
         }
 
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat<T>();
         auto accum_flat = accum.flat<T>();
         auto linear_flat = linear.flat<T>();
         auto grad_flat = grad.flat<T>();
-        const Tindex first_dim_size = accum_flat.size();
 
-        for (Tindex i = 0; i < N; i++) {
+        const auto update = [&](Tindex i) {
           const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
           T& a = accum_flat(index);
           T& l = linear_flat(index);
           T& v = var_flat(index);
@@ -2725,7 +2730,9 @@ class SparseApplyFtrlOp : public OpKernel {
                           lr_power_scalar);
           a = updated_a;
           l = updated_l;
-        }
+        };
+        ApplySparseUpdates<Tindex>(ctx, indices_vec, cost_per_update,
+                                   row_lock_key, update);
       }
     }
 
@@ -2734,6 +2741,7 @@ class SparseApplyFtrlOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
+  bool lock_rows_ = false;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                         \
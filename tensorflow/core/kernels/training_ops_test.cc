@@ -13,9 +13,18 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <cmath>
+
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/resource_var.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
@@ -80,6 +89,15 @@ static Node* Iota(Graph* g, int n) {
   return test::graph::Constant(g, data);
 }
 
+static Node* RandomIndices(Graph* g, int n, int limit) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor data(DT_INT32, TensorShape({n}));
+  int32* base = data.flat<int32>().data();
+  for (int i = 0; i < n; ++i) base[i] = rnd.Uniform(limit);
+  return test::graph::Constant(g, data);
+}
+
 static Node* Scalar(Graph* g, float val) {
   Tensor data(DT_FLOAT, TensorShape({}));
   data.flat<float>()(0) = val;
@@ -185,6 +203,178 @@ BENCHMARK(BM_SparseAdagrad)
     ->ArgPair(128, 32 << 10)
     ->ArgPair(128, 128 << 10);
 
+// Ways in which concurrent sparse updates of one variable are synchronized.
+enum SparseApplyLocking { kExclusive, kLockRows, kUnlocked };
+
+static const char* const kSparseApplyLockingLabels[] = {
+    "exclusive", "lock_rows", "unlocked"};
+
+static Node* ResourceVar(Graph* g, const string& name, int m, int n) {
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "VarHandleOp")
+                  .Attr("dtype", DT_FLOAT)
+                  .Attr("shape", TensorShape({m, n}))
+                  .Attr("shared_name", name)
+                  .Finalize(g, &ret));
+  return ret;
+}
+
+// `num_updaters` ResourceSparseApplyAdagrad ops that update random rows of
+// one shared embedding table concurrently.
+static void SparseAdagradUpdaters(int num_updaters, SparseApplyLocking locking,
+                                  int32 m, int32 n, int32 num_indices,
+                                  Graph** init_g, Graph** train_g) {
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto zero = Zeros(g, m, n);
+    for (const char* name : {"var", "accum"}) {
+      TF_CHECK_OK(NodeBuilder(g->NewName("n"), "AssignVariableOp")
+                      .Input(ResourceVar(g, name, m, n))
+                      .Input(zero)
+                      .Attr("dtype", DT_FLOAT)
+                      .Finalize(g, nullptr));
+    }
+    *init_g = g;
+  }
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto var = ResourceVar(g, "var", m, n);
+    auto accum = ResourceVar(g, "accum", m, n);
+    auto lr = Scalar(g, 0.01);
+    for (int i = 0; i < num_updaters; ++i) {
+      TF_CHECK_OK(NodeBuilder(g->NewName("n"), "ResourceSparseApplyAdagrad")
+                      .Input(var)
+                      .Input(accum)
+                      .Input(lr)
+                      .Input(Random(g, num_indices, n))
+                      .Input(RandomIndices(g, num_indices, m))
+                      .Attr("use_locking", locking != kUnlocked)
+                      .Attr("lock_rows", locking == kLockRows)
+                      .Finalize(g, nullptr));
+    }
+    *train_g = g;
+  }
+}
+
+// `locking` is a SparseApplyLocking.
+static void BM_SparseAdagradContention(int iters, int num_updaters,
+                                       int locking) {
+  const int32 m = 1 << 16;
+  const int32 n = 64;
+  const int32 num_indices = 1024;
+  const int64 tot =
+      static_cast<int64>(iters) * num_updaters * num_indices * n;
+  testing::UseRealTime();
+  testing::ItemsProcessed(tot);
+  testing::BytesProcessed(tot * sizeof(float));
+  testing::SetLabel(kSparseApplyLockingLabels[locking]);
+  Graph* init;
+  Graph* train;
+  SparseAdagradUpdaters(num_updaters, static_cast<SparseApplyLocking>(locking),
+                        m, n, num_indices, &init, &train);
+  test::Benchmark("cpu", train, GetMultiThreadedOptions(), init).Run(iters);
+}
+BENCHMARK(BM_SparseAdagradContention)
+    ->ArgPair(1, kExclusive)
+    ->ArgPair(1, kLockRows)
+    ->ArgPair(1, kUnlocked)
+    ->ArgPair(8, kExclusive)
+    ->ArgPair(8, kLockRows)
+    ->ArgPair(8, kUnlocked)
+    ->ArgPair(32, kExclusive)
+    ->ArgPair(32, kLockRows)
+    ->ArgPair(32, kUnlocked);
+
+class SparseApplyAdagradOpTest : public OpsTestBase {
+ protected:
+  // Applies many updates to few rows, which the kernel distributes over its
+  // threads, and checks that the result matches applying them in order.
+  void RunWithDuplicateIndices(bool resource, SparseApplyLocking locking) {
+    const int m = 16;
+    const int n = 64;
+    const int num_indices = 4096;
+    const DataType var_type = resource ? DT_RESOURCE : DT_FLOAT_REF;
+    const char* op =
+        resource ? "ResourceSparseApplyAdagrad" : "SparseApplyAdagrad";
+    NodeDefBuilder builder("sparse_apply_adagrad", op);
+    builder.Input(FakeInput(var_type))
+        .Input(FakeInput(var_type))
+        .Input(FakeInput(DT_FLOAT))
+        .Input(FakeInput(DT_FLOAT))
+        .Input(FakeInput(DT_INT32))
+        .Attr("T", DT_FLOAT)
+        .Attr("use_locking", locking != kUnlocked);
+    if (resource) builder.Attr("lock_rows", locking == kLockRows);
+    TF_ASSERT_OK(builder.Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+
+    const float lr = 0.01;
+    const auto grad_fn = [](int i) { return (i % 7) * 0.1f - 0.3f; };
+    const auto index_fn = [](int i) { return (i * 7) % m; };
+    Var* var_resource = nullptr;
+    Var* accum_resource = nullptr;
+    if (resource) {
+      var_resource = MakeVariable(m, n, 1.0f);
+      accum_resource = MakeVariable(m, n, 0.1f);
+      AddResourceInput("", "var", var_resource);
+      AddResourceInput("", "accum", accum_resource);
+    } else {
+      AddInput<float>(TensorShape({m, n}), [](int) { return 1.0f; });
+      AddInput<float>(TensorShape({m, n}), [](int) { return 0.1f; });
+    }
+    AddInputFromArray<float>(TensorShape({}), {lr});
+    AddInput<float>(TensorShape({num_indices, n}), grad_fn);
+    AddInput<int32>(TensorShape({num_indices}), index_fn);
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected_var(DT_FLOAT, TensorShape({m, n}));
+    Tensor expected_accum(DT_FLOAT, TensorShape({m, n}));
+    auto var = expected_var.matrix<float>();
+    auto accum = expected_accum.matrix<float>();
+    var.setConstant(1.0f);
+    accum.setConstant(0.1f);
+    for (int i = 0; i < num_indices; ++i) {
+      const int row = index_fn(i);
+      for (int j = 0; j < n; ++j) {
+        const float g = grad_fn(i * n + j);
+        accum(row, j) += g * g;
+        var(row, j) -= lr * g / std::sqrt(accum(row, j));
+      }
+    }
+    // The resource manager holds a reference to the variables.
+    test::ExpectTensorNear<float>(
+        expected_var,
+        resource ? *var_resource->tensor() : *mutable_input(0).tensor, 1e-5);
+    test::ExpectTensorNear<float>(
+        expected_accum,
+        resource ? *accum_resource->tensor() : *mutable_input(1).tensor, 1e-5);
+  }
+
+  static Var* MakeVariable(int m, int n, float value) {
+    Var* var = new Var(DT_FLOAT);
+    *var->tensor() = Tensor(DT_FLOAT, TensorShape({m, n}));
+    var->tensor()->flat<float>().setConstant(value);
+    var->is_initialized = true;
+    return var;
+  }
+};
+
+TEST_F(SparseApplyAdagradOpTest, DuplicateIndicesExclusive) {
+  RunWithDuplicateIndices(/*resource=*/false, kExclusive);
+}
+
+TEST_F(SparseApplyAdagradOpTest, DuplicateIndicesUnlocked) {
+  RunWithDuplicateIndices(/*resource=*/false, kUnlocked);
+}
+
+TEST_F(SparseApplyAdagradOpTest, DuplicateIndicesResourceExclusive) {
+  RunWithDuplicateIndices(/*resource=*/true, kExclusive);
+}
+
+TEST_F(SparseApplyAdagradOpTest, DuplicateIndicesResourceLockRows) {
+  RunWithDuplicateIndices(/*resource=*/true, kLockRows);
+}
+
 static void Momentum(int32 n, Graph** init_g, Graph** train_g) {
   TensorShape shape({n});
   {
@@ -15,7 +15,9 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <complex>
+#include <type_traits>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/attr_value.pb.h"
@@ -25,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/math/math_util.h"
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
@@ -65,12 +68,255 @@ void TransposeSimple(const CPUDevice& device, const Tensor& in,
   device.parallelFor(in.NumElements(), cost, std::move(transpose_fn));
 }
 
+// Packed transposes of kSize x kSize tiles with Eigen's ptranspose. Only
+// element types whose full packet transpose exists on every platform with
+// that packet are specialized.
+template <typename T>
+struct TileTranspose {
+  static constexpr int kSize = 1;
+  static void Run(const T* src, int64 src_stride, T* dst, int64 dst_stride) {
+    *dst = *src;
+  }
+};
+
+template <typename T, typename Packet>
+struct PacketTileTranspose {
+  static constexpr int kSize = Eigen::internal::unpacket_traits<Packet>::size;
+  typedef typename Eigen::internal::unpacket_traits<Packet>::type Scalar;
+  static_assert(sizeof(T) == sizeof(Scalar), "Tile elements must be packed");
+
+  static EIGEN_STRONG_INLINE void Run(const T* src, int64 src_stride, T* dst,
+                                      int64 dst_stride) {
+    Eigen::internal::PacketBlock<Packet, kSize> block;
+    for (int i = 0; i < kSize; ++i) {
+      block.packet[i] = Eigen::internal::ploadu<Packet>(
+          reinterpret_cast<const Scalar*>(src + i * src_stride));
+    }
+    Eigen::internal::ptranspose(block);
+    for (int i = 0; i < kSize; ++i) {
+      Eigen::internal::pstoreu(reinterpret_cast<Scalar*>(dst + i * dst_stride),
+                               block.packet[i]);
+    }
+  }
+};
+
+#if defined(EIGEN_VECTORIZE)
+template <>
+struct TileTranspose<uint32>
+    : PacketTileTranspose<uint32,
+                          Eigen::internal::packet_traits<float>::type> {};
+#endif
+#if defined(EIGEN_VECTORIZE_SSE2)
+template <>
+struct TileTranspose<uint64>
+    : PacketTileTranspose<uint64,
+                          Eigen::internal::packet_traits<double>::type> {};
+#endif
+
+// Writes the transpose of the [rows, cols] matrix at `src`, whose rows are
+// `src_stride` apart, to `dst`, whose rows are `dst_stride` apart.
+template <typename T>
+void TransposeTile(const T* src, int64 src_stride, int64 rows, int64 cols,
+                   T* dst, int64 dst_stride) {
+  constexpr int kSize = TileTranspose<T>::kSize;
+  int64 row = 0;
+  if (kSize > 1) {
+    for (; row + kSize <= rows; row += kSize) {
+      int64 col = 0;
+      for (; col + kSize <= cols; col += kSize) {
+        TileTranspose<T>::Run(src + row * src_stride + col, src_stride,
+                              dst + col * dst_stride + row, dst_stride);
+      }
+      for (; col < cols; ++col) {
+        for (int64 i = row; i < row + kSize; ++i) {
+          dst[col * dst_stride + i] = src[i * src_stride + col];
+        }
+      }
+    }
+  }
+  if (row == rows) return;
+  for (int64 col = 0; col < cols; ++col) {
+    for (int64 i = row; i < rows; ++i) {
+      dst[col * dst_stride + i] = src[i * src_stride + col];
+    }
+  }
+}
+
+// Transposes `in` into `out` for a trivially copyable T. The dimensions are
+// reduced first: dimensions of size 1 are dropped, and dimensions that stay
+// adjacent are merged. If the innermost dimension stays innermost, rows of
+// it are copied. Otherwise the innermost input and output dimensions form
+// the tiles of a blocked two dimensional transpose, one per index of the
+// other dimensions.
+template <typename T>
+void TransposeBlocked(const CPUDevice& d, const Tensor& in,
+                      const gtl::ArraySlice<int32> perm, Tensor* out) {
+  // The tile sizes below divide by the sizes of the dimensions.
+  if (in.NumElements() == 0) return;
+  const T* src = reinterpret_cast<const T*>(in.tensor_data().data());
+  T* dst = reinterpret_cast<T*>(const_cast<char*>(out->tensor_data().data()));
+
+  TensorShape squeezed_shape;
+  internal::TransposePermsVec squeezed_perm;
+  {
+    internal::TransposePermsVec new_index(in.dims(), -1);
+    for (int i = 0; i < in.dims(); ++i) {
+      if (in.dim_size(i) != 1) {
+        new_index[i] = squeezed_shape.dims();
+        squeezed_shape.AddDim(in.dim_size(i));
+      }
+    }
+    for (int32 i : perm) {
+      if (new_index[i] >= 0) squeezed_perm.push_back(new_index[i]);
+    }
+  }
+  if (squeezed_shape.dims() <= 1) {
+    d.memcpy(dst, src, in.NumElements() * sizeof(T));
+    return;
+  }
+  // ReduceTransposeDimensions() returns the inverse of the reduced
+  // permutation, i.e. the output position of each input dimension.
+  internal::TransposePermsVec inverse_perm;
+  internal::TransposeDimsVec dims;
+  internal::ReduceTransposeDimensions(squeezed_shape, squeezed_perm,
+                                      &inverse_perm, &dims);
+  const int ndims = dims.size();
+  internal::TransposePermsVec new_perm(ndims);
+  for (int i = 0; i < ndims; ++i) new_perm[inverse_perm[i]] = i;
+  if (ndims == 1) {
+    d.memcpy(dst, src, in.NumElements() * sizeof(T));
+    return;
+  }
+
+  internal::TransposeDimsVec in_strides(ndims);
+  internal::TransposeDimsVec out_dims(ndims);
+  internal::TransposeDimsVec out_strides(ndims);
+  in_strides[ndims - 1] = 1;
+  for (int i = ndims - 2; i >= 0; --i) {
+    in_strides[i] = in_strides[i + 1] * dims[i + 1];
+  }
+  for (int i = 0; i < ndims; ++i) out_dims[i] = dims[new_perm[i]];
+  out_strides[ndims - 1] = 1;
+  for (int i = ndims - 2; i >= 0; --i) {
+    out_strides[i] = out_strides[i + 1] * out_dims[i + 1];
+  }
+  // The input stride of each output dimension.
+  internal::TransposeDimsVec src_strides(ndims);
+  for (int i = 0; i < ndims; ++i) src_strides[i] = in_strides[new_perm[i]];
+
+  if (new_perm[ndims - 1] == ndims - 1) {
+    // Copies contiguous rows of the innermost dimension, visiting the other
+    // dimensions in output order.
+    const int64 row_size = dims[ndims - 1];
+    const int64 num_rows = in.NumElements() / row_size;
+    auto copy_rows = [&](int64 begin, int64 end) {
+      internal::TransposeDimsVec index(ndims - 1);
+      int64 src_offset = 0;
+      int64 remainder = begin;
+      for (int i = ndims - 2; i >= 0; --i) {
+        index[i] = remainder % out_dims[i];
+        remainder /= out_dims[i];
+        src_offset += index[i] * src_strides[i];
+      }
+      T* dst_row = dst + begin * row_size;
+      for (int64 row = begin; row < end; ++row) {
+        std::copy_n(src + src_offset, row_size, dst_row);
+        dst_row += row_size;
+        for (int i = ndims - 2; i >= 0; --i) {
+          src_offset += src_strides[i];
+          if (++index[i] < out_dims[i]) break;
+          src_offset -= index[i] * src_strides[i];
+          index[i] = 0;
+        }
+      }
+    };
+    const Eigen::TensorOpCost cost(/*bytes_loaded=*/row_size * sizeof(T),
+                                   /*bytes_stored=*/row_size * sizeof(T),
+                                   /*compute_cycles=*/ndims);
+    d.parallelFor(num_rows, cost, copy_rows);
+    return;
+  }
+
+  // Tiles are [rows, cols] blocks of the input dimension that becomes the
+  // innermost output dimension, and of the innermost input dimension.
+  const int row_dim = new_perm[ndims - 1];
+  int col_dim = 0;  // Position of the innermost input dimension in `out`.
+  while (new_perm[col_dim] != ndims - 1) ++col_dim;
+  const int64 rows = dims[row_dim];
+  const int64 cols = dims[ndims - 1];
+  const int64 src_row_stride = in_strides[row_dim];
+  const int64 dst_row_stride = out_strides[col_dim];
+
+  // Tiles of about kTileEdge x kTileEdge, stretched along one dimension when
+  // the other is small.
+  constexpr int64 kTileEdge = sizeof(T) <= 2 ? 64 : (sizeof(T) <= 8 ? 32 : 16);
+  int64 tile_cols = std::min(cols, kTileEdge);
+  int64 tile_rows = std::min(rows, kTileEdge * kTileEdge / tile_cols);
+  tile_cols = std::min(cols, kTileEdge * kTileEdge / tile_rows);
+  // Tiles that don't span a dimension are made of whole packed tiles.
+  constexpr int64 kMultiple =
+      TileTranspose<T>::kSize > 8 ? TileTranspose<T>::kSize : 8;
+  if (tile_rows < rows) {
+    tile_rows = std::max(kMultiple, tile_rows / kMultiple * kMultiple);
+  }
+  if (tile_cols < cols) {
+    tile_cols = std::max(kMultiple, tile_cols / kMultiple * kMultiple);
+  }
+  const int64 row_tiles = MathUtil::CeilOfRatio(rows, tile_rows);
+  const int64 col_tiles = MathUtil::CeilOfRatio(cols, tile_cols);
+
+  // The remaining output dimensions, outermost first.
+  internal::TransposeDimsVec outer_dims;
+  internal::TransposeDimsVec outer_src_strides;
+  internal::TransposeDimsVec outer_dst_strides;
+  for (int i = 0; i < ndims - 1; ++i) {
+    if (i == col_dim) continue;
+    outer_dims.push_back(out_dims[i]);
+    outer_src_strides.push_back(src_strides[i]);
+    outer_dst_strides.push_back(out_strides[i]);
+  }
+
+  auto transpose_tiles = [&](int64 begin, int64 end) {
+    for (int64 tile = begin; tile < end; ++tile) {
+      const int64 row_tile = tile % row_tiles;
+      const int64 col_tile = (tile / row_tiles) % col_tiles;
+      int64 outer = tile / (col_tiles * row_tiles);
+      const int64 row = row_tile * tile_rows;
+      const int64 col = col_tile * tile_cols;
+      int64 src_offset = row * src_row_stride + col;
+      int64 dst_offset = col * dst_row_stride + row;
+      for (int i = outer_dims.size() - 1; i >= 0; --i) {
+        const int64 index = outer % outer_dims[i];
+        outer /= outer_dims[i];
+        src_offset += index * outer_src_strides[i];
+        dst_offset += index * outer_dst_strides[i];
+      }
+      TransposeTile(src + src_offset, src_row_stride,
+                    std::min(tile_rows, rows - row),
+                    std::min(tile_cols, cols - col), dst + dst_offset,
+                    dst_row_stride);
+    }
+  };
+  const int64 tile_size = tile_rows * tile_cols;
+  const Eigen::TensorOpCost cost(/*bytes_loaded=*/tile_size * sizeof(T),
+                                 /*bytes_stored=*/tile_size * sizeof(T),
+                                 /*compute_cycles=*/tile_size);
+  const int64 num_tiles =
+      in.NumElements() / (rows * cols) * row_tiles * col_tiles;
+  d.parallelFor(num_tiles, cost, transpose_tiles);
+}
+
 }  // namespace
 
 template <typename T, bool conjugate>
 struct Transpose<CPUDevice, T, conjugate> {
   static void run(const CPUDevice& d, const Tensor& in,
                   const gtl::ArraySlice<int32> perm, Tensor* out) {
+    // All the types that are transposed as raw bits.
+    if (!conjugate && std::is_integral<T>::value) {
+      TransposeBlocked<T>(d, in, perm, out);
+      return;
+    }
     switch (in.dims()) {
       case 2:
         internal::TransposeUsingEigen<CPUDevice, T, 2>(d, in, perm, conjugate,
@@ -0,0 +1,186 @@
+/* Copyright 2019 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/kernels/transpose_functor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+class TransposeFunctorTest : public ::testing::Test {
+ protected:
+  TransposeFunctorTest()
+      : pool_(Env::Default(), "transpose_test", 4),
+        device_(pool_.AsEigenThreadPool(), 4) {}
+
+  // Transposes a tensor with distinct elements and compares with
+  // transposing one element at a time.
+  template <typename T>
+  void Verify(const TensorShape& shape, const std::vector<int32>& perm) {
+    Tensor in(DataTypeToEnum<T>::v(), shape);
+    auto in_flat = in.flat<T>();
+    for (int64 i = 0; i < in_flat.size(); ++i) {
+      in_flat(i) = static_cast<T>(i % 251 + 1);
+    }
+    TensorShape out_shape;
+    for (int32 dim : perm) out_shape.AddDim(shape.dim_size(dim));
+
+    Tensor expected(in.dtype(), out_shape);
+    auto expected_flat = expected.flat<T>();
+    const gtl::InlinedVector<int64, 8> in_strides = ComputeStride<int64>(shape);
+    const gtl::InlinedVector<int64, 8> out_strides =
+        ComputeStride<int64>(out_shape);
+    for (int64 o = 0; o < expected_flat.size(); ++o) {
+      int64 i = 0;
+      int64 remainder = o;
+      for (size_t d = 0; d < perm.size(); ++d) {
+        i += remainder / out_strides[d] * in_strides[perm[d]];
+        remainder %= out_strides[d];
+      }
+      expected_flat(o) = in_flat(i);
+    }
+
+    Tensor out(in.dtype(), out_shape);
+    TF_ASSERT_OK(DoTranspose(device_, in, perm, &out));
+    test::ExpectTensorEqual<T>(expected, out);
+  }
+
+  // Verifies random permutations of random shapes.
+  template <typename T>
+  void VerifyRandom() {
+    random::PhiloxRandom philox(7, 17);
+    random::SimplePhilox rnd(&philox);
+    for (int i = 0; i < 200; ++i) {
+      const int dims = 2 + rnd.Uniform(5);
+      TensorShape shape;
+      for (int d = 0; d < dims; ++d) {
+        shape.AddDim(1 + rnd.Uniform(d % 2 == 0 ? 7 : 40));
+      }
+      std::vector<int32> perm(dims);
+      std::iota(perm.begin(), perm.end(), 0);
+      for (int d = dims - 1; d > 0; --d) {
+        std::swap(perm[d], perm[rnd.Uniform(d + 1)]);
+      }
+      Verify<T>(shape, perm);
+    }
+  }
+
+  thread::ThreadPool pool_;
+  CPUDevice device_;
+};
+
+TEST_F(TransposeFunctorTest, Random) {
+  VerifyRandom<uint8>();
+  VerifyRandom<int16>();
+  VerifyRandom<float>();
+  VerifyRandom<double>();
+  VerifyRandom<complex128>();
+}
+
+TEST_F(TransposeFunctorTest, CommonLayouts) {
+  // NHWC <-> NCHW.
+  Verify<float>({2, 17, 19, 35}, {0, 3, 1, 2});
+  Verify<float>({2, 35, 17, 19}, {0, 2, 3, 1});
+  Verify<uint8>({2, 31, 29, 3}, {0, 3, 1, 2});
+  // Attention heads.
+  Verify<float>({3, 40, 4, 24}, {0, 2, 1, 3});
+  Verify<float>({3, 4, 40, 24}, {0, 1, 3, 2});
+  // Matrices larger than a tile.
+  Verify<float>({300, 517}, {1, 0});
+  Verify<double>({129, 257}, {1, 0});
+  Verify<int16>({3, 130, 200}, {0, 2, 1});
+  // Singleton dimensions and the identity.
+  Verify<float>({1, 64, 1, 33}, {2, 3, 0, 1});
+  Verify<float>({5, 7, 9}, {0, 1, 2});
+}
+
+TEST_F(TransposeFunctorTest, EmptyTensors) {
+  // E.g. NCHW FusedBatchNorm on CPU with an empty image.
+  Verify<float>({2, 3, 0, 0}, {0, 2, 3, 1});
+  Verify<float>({2, 0, 5, 7}, {0, 3, 1, 2});
+  Verify<uint8>({0, 17}, {1, 0});
+  Verify<double>({4, 0}, {1, 0});
+  Verify<int16>({0, 1, 3}, {2, 1, 0});
+}
+
+// Runs the Transpose op on a constant of `shape` permuted by `perm`.
+template <typename T>
+static void BM_Transpose(int iters, const TensorShape& shape,
+                         const std::vector<int32>& perm) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor in(DataTypeToEnum<T>::v(), shape);
+  in.flat<T>().setRandom();
+  Tensor perm_tensor(DT_INT32, TensorShape({static_cast<int64>(perm.size())}));
+  std::copy(perm.begin(), perm.end(), perm_tensor.flat<int32>().data());
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("transpose"), "Transpose")
+                  .Input(test::graph::Constant(g, in))
+                  .Input(test::graph::Constant(g, perm_tensor))
+                  .Finalize(g, &node));
+  testing::BytesProcessed(static_cast<int64>(iters) * in.TotalBytes() * 2);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+#define BM_TRANSPOSE(NAME, T, SHAPE, PERM)                 \
+  static void BM_Transpose_##NAME(int iters) {             \
+    BM_Transpose<T>(iters, TensorShape(SHAPE), PERM);      \
+  }                                                        \
+  BENCHMARK(BM_Transpose_##NAME);
+
+#define LIST(...) \
+  { __VA_ARGS__ }
+
+BM_TRANSPOSE(NHWC_to_NCHW, float, LIST(32, 56, 56, 64), LIST(0, 3, 1, 2));
+BM_TRANSPOSE(NCHW_to_NHWC, float, LIST(32, 64, 56, 56), LIST(0, 2, 3, 1));
+BM_TRANSPOSE(NHWC_to_NCHW_uint8_3, uint8, LIST(32, 224, 224, 3),
+             LIST(0, 3, 1, 2));
+BM_TRANSPOSE(NHWC_to_NCHW_half, Eigen::half, LIST(32, 56, 56, 64),
+             LIST(0, 3, 1, 2));
+BM_TRANSPOSE(NDHWC_to_NCDHW, float, LIST(8, 16, 28, 28, 32),
+             LIST(0, 4, 1, 2, 3));
+BM_TRANSPOSE(NCDHW_to_NDHWC, float, LIST(8, 32, 16, 28, 28),
+             LIST(0, 2, 3, 4, 1));
+BM_TRANSPOSE(SplitHeads, float, LIST(16, 128, 16, 64), LIST(0, 2, 1, 3));
+BM_TRANSPOSE(KeysForScores, float, LIST(16, 16, 128, 64), LIST(0, 1, 3, 2));
+BM_TRANSPOSE(Matrix, float, LIST(4096, 4096), LIST(1, 0));
+BM_TRANSPOSE(Matrix_double, double, LIST(2048, 2048), LIST(1, 0));
+BM_TRANSPOSE(Reverse4D, float, LIST(64, 64, 64, 64), LIST(3, 2, 1, 0));
+
+#undef LIST
+#undef BM_TRANSPOSE
+
+}  // namespace
+}  // namespace tensorflow
@@ -13,10 +13,14 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -24,11 +28,185 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
+// Unique runs on a single thread if there are fewer elements than this per
+// intra-op thread.
+constexpr int64 kMinParallelUniqueElementsPerShard = 64 * 1024;
+
+// Returns the number of intra-op threads that UniqueParallel uses for a 1-D
+// `input`, or 1 if it must be deduplicated on a single thread.
+template <typename T>
+int NumUniqueShards(OpKernelContext* context, const Tensor& input) {
+  if (!std::is_integral<T>::value || std::is_same<T, bool>::value) return 1;
+  const int num_threads =
+      context->device()->tensorflow_cpu_worker_threads()->num_threads;
+  return static_cast<int>(std::max<int64>(
+      1, std::min<int64>(num_threads, input.NumElements() /
+                                          kMinParallelUniqueElementsPerShard)));
+}
+
+// Hashes the keys of UniqueParallel. hash<T> is the identity for integers,
+// so it is mixed to spread the keys over the partitions and table slots.
+template <typename T>
+struct UniqueHash {
+  size_t operator()(const T& key) const {
+    uint64 h = hash<T>{}(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+};
+
+// Returns the partition of `key`, in [0, num_partitions).
+template <typename T>
+inline int UniquePartition(const T& key, int num_partitions) {
+  const uint64 h = UniqueHash<T>{}(key);
+  return static_cast<int>(((h >> 32) * num_partitions) >> 32);
+}
+
+// Computes the outputs of Unique for the 1-D integer `input` on
+// `num_shards` intra-op threads. They are identical to the outputs of the
+// single-threaded implementation, i.e. the unique keys are in the order of
+// their first occurrence.
+//
+// The keys are partitioned by hash, so that each partition can be
+// deduplicated on its own:
+// 1. The input is split in `num_shards` contiguous blocks, and each block
+//    scatters its keys, and their positions, to their partitions. Each
+//    partition lists its keys in the order of the input.
+// 2. Each partition is deduplicated with a hash table, which gives the first
+//    position and the count of each of its unique keys, and the local id of
+//    each of its keys.
+// 3. The unique keys are numbered in the order of their first positions, with
+//    a prefix sum over the input blocks.
+// 4. Each partition maps the local ids of its keys to the global ones, and
+//    writes `y`, `idx` and the counts.
+template <typename T, typename TIndex>
+void UniqueParallel(OpKernelContext* context, int num_shards, int64 axis,
+                    typename TTypes<TIndex>::Vec idx_vec) {
+  const Tensor& input = context->input(0);
+  const auto Tin = input.flat<T>();
+  const int64 N = Tin.size();
+  const int num_partitions = num_shards;
+  const int64 block_size = (N + num_shards - 1) / num_shards;
+  const auto block_start = [&](int64 block) {
+    return std::min(N, block * block_size);
+  };
+
+  // Runs `fn(i)` for i in [0, num_shards), each on its own thread.
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *context->device()->tensorflow_cpu_worker_threads();
+  const auto run_shards = [&](const std::function<void(int64)>& fn) {
+    Shard(worker_threads.num_threads, worker_threads.workers, num_shards,
+          /*cost_per_unit=*/block_size, [&fn](int64 start, int64 limit) {
+            for (int64 i = start; i < limit; ++i) fn(i);
+          });
+  };
+
+  // 1. Scatter the keys to their partitions. `offsets[b * P + p]` is where
+  // the keys of block b in partition p start.
+  std::vector<int64> offsets(num_shards * num_partitions, 0);
+  run_shards([&](int64 block) {
+    int64* block_counts = &offsets[block * num_partitions];
+    for (int64 i = block_start(block); i < block_start(block + 1); ++i) {
+      ++block_counts[UniquePartition(Tin(i), num_partitions)];
+    }
+  });
+  std::vector<int64> partition_starts(num_partitions + 1, 0);
+  for (int p = 0; p < num_partitions; ++p) {
+    partition_starts[p + 1] = partition_starts[p];
+    for (int64 block = 0; block < num_shards; ++block) {
+      const int64 count = offsets[block * num_partitions + p];
+      offsets[block * num_partitions + p] = partition_starts[p + 1];
+      partition_starts[p + 1] += count;
+    }
+  }
+  std::vector<T> keys(N);
+  std::vector<int32> positions(N);
+  run_shards([&](int64 block) {
+    int64* cursors = &offsets[block * num_partitions];
+    for (int64 i = block_start(block); i < block_start(block + 1); ++i) {
+      const T& key = Tin(i);
+      const int64 k = cursors[UniquePartition(key, num_partitions)]++;
+      keys[k] = key;
+      positions[k] = static_cast<int32>(i);
+    }
+  });
+
+  // 2. Deduplicate each partition, and flag the first occurrences.
+  std::vector<int32> local_ids(N);
+  std::vector<std::vector<int32>> first_positions(num_partitions);
+  std::vector<std::vector<int64>> local_counts(num_partitions);
+  std::vector<uint8> is_first(N, 0);
+  run_shards([&](int64 p) {
+    absl::flat_hash_map<T, int32, UniqueHash<T>> ids;
+    for (int64 k = partition_starts[p]; k < partition_starts[p + 1]; ++k) {
+      auto it = ids.emplace(keys[k], static_cast<int32>(ids.size()));
+      if (it.second) {
+        first_positions[p].push_back(positions[k]);
+        local_counts[p].push_back(0);
+        is_first[positions[k]] = 1;
+      }
+      local_ids[k] = it.first->second;
+      ++local_counts[p][it.first->second];
+    }
+  });
+
+  // 3. Number the unique keys in the order of their first occurrence. The
+  // number of each first occurrence is stored in `idx_vec` for now.
+  std::vector<int64> block_num_unique(num_shards + 1, 0);
+  run_shards([&](int64 block) {
+    for (int64 i = block_start(block); i < block_start(block + 1); ++i) {
+      block_num_unique[block + 1] += is_first[i];
+    }
+  });
+  for (int64 block = 0; block < num_shards; ++block) {
+    block_num_unique[block + 1] += block_num_unique[block];
+  }
+  run_shards([&](int64 block) {
+    TIndex id = block_num_unique[block];
+    for (int64 i = block_start(block); i < block_start(block + 1); ++i) {
+      if (is_first[i]) idx_vec(i) = id++;
+    }
+  });
+
+  const int64 uniq_size = block_num_unique[num_shards];
+  TensorShape output_shape(input.shape());
+  output_shape.set_dim(axis, uniq_size);
+  Tensor* output = nullptr;
+  OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+  auto Tout = output->flat<T>();
+  Tensor* count_output = nullptr;
+  if (context->num_outputs() > 2) {
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                2, TensorShape({uniq_size}), &count_output));
+  }
+
+  // 4. Write the outputs of each partition.
+  run_shards([&](int64 p) {
+    std::vector<TIndex> global_ids(first_positions[p].size());
+    for (size_t l = 0; l < global_ids.size(); ++l) {
+      const int32 position = first_positions[p][l];
+      global_ids[l] = idx_vec(position);
+      Tout(global_ids[l]) = Tin(position);
+      if (count_output != nullptr) {
+        count_output->vec<TIndex>()(global_ids[l]) = local_counts[p][l];
+      }
+    }
+    for (int64 k = partition_starts[p]; k < partition_starts[p + 1]; ++k) {
+      idx_vec(positions[k]) = global_ids[local_ids[k]];
+    }
+  });
+}
+
 template <typename T, typename TIndex>
 class UniqueOp : public OpKernel {
  public:
@@ -100,6 +278,12 @@ class UniqueOp : public OpKernel {
 
     int64 uniq_size;
     if (new_sizes[0] == 1 && new_sizes[2] == 1) {
+      const int num_shards = NumUniqueShards<T>(context, input);
+      if (num_shards > 1) {
+        UniqueParallel<T, TIndex>(context, num_shards, axis, idx_vec);
+        return;
+      }
+
       // Specialized and faster implementation when unique is run over single
       // elements. Here we put T directly into the map rather than ints pointing
       // to them as in the general case.
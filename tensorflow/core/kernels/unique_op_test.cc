@@ -13,12 +13,18 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/node_builder.h"
@@ -26,6 +32,8 @@ limitations under the License.
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -35,6 +43,45 @@ namespace {
 
 const int kMaxStrLen = 40;
 
+class UniqueOpTest : public OpsTestBase {};
+
+// Large inputs are deduplicated on the intra-op threads, which must give the
+// same outputs as deduplicating the input in order.
+TEST_F(UniqueOpTest, LargeInputMatchesSequentialUnique) {
+  TF_ASSERT_OK(NodeDefBuilder("unique", "UniqueWithCounts")
+                   .Input(FakeInput(DT_INT64))
+                   .Attr("out_idx", DT_INT32)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+
+  const int kNumElements = 1 << 20;
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> x(kNumElements);
+  for (int i = 0; i < kNumElements; ++i) {
+    x[i] = static_cast<int64>(rnd.Uniform64(1 << 16)) - (1 << 15);
+  }
+  AddInputFromArray<int64>(TensorShape({kNumElements}), x);
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::unordered_map<int64, int32> ids;
+  std::vector<int64> y;
+  std::vector<int32> idx;
+  std::vector<int32> count;
+  for (int64 key : x) {
+    auto it = ids.emplace(key, static_cast<int32>(y.size()));
+    if (it.second) {
+      y.push_back(key);
+      count.push_back(0);
+    }
+    idx.push_back(it.first->second);
+    ++count[it.first->second];
+  }
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>(y), *GetOutput(0));
+  test::ExpectTensorEqual<int32>(test::AsTensor<int32>(idx), *GetOutput(1));
+  test::ExpectTensorEqual<int32>(test::AsTensor<int32>(count), *GetOutput(2));
+}
+
 TensorProto GetRandomInt32TensorProto(int dim, int max_int) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_INT32);
@@ -102,6 +149,36 @@ static void BM_Unique_INT32_Repeat(int iters, int dim, int max_int) {
   test::Benchmark("cpu", g).Run(iters);
 }
 
+// Deduplicates `dim` ids drawn at random from `unique_percent`% as many
+// distinct ids.
+static void BM_Unique_INT64(int iters, int dim, int unique_percent) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  const int64 num_ids =
+      std::max<int64>(1, static_cast<int64>(dim) * unique_percent / 100);
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor input(DT_INT64, TensorShape({dim}));
+  auto input_flat = input.flat<int64>();
+  for (int i = 0; i < dim; ++i) {
+    // Sparse feature ids are spread over the whole int64 range.
+    input_flat(i) = static_cast<int64>(rnd.Uniform64(num_ids) *
+                                       0x9E3779B97F4A7C15ull);
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("T", DT_INT64)
+                  .Finalize(g, &node));
+
+  testing::BytesProcessed(static_cast<int64>(iters) * dim * sizeof(int64));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
 TensorProto GetRandomStringsTensorProto(int dim, int max_str_len) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_STRING);
@@ -180,6 +257,17 @@ BENCHMARK(BM_Unique_INT32_Repeat)
     ->ArgPair(64 * 1024, 64 * 1024 * 1024)
     ->ArgPair(1024 * 1024, 64 * 1024 * 1024);
 
+BENCHMARK(BM_Unique_INT64)
+    ->ArgPair(64 * 1024, 1)
+    ->ArgPair(64 * 1024, 10)
+    ->ArgPair(64 * 1024, 100)
+    ->ArgPair(1024 * 1024, 1)
+    ->ArgPair(1024 * 1024, 10)
+    ->ArgPair(1024 * 1024, 100)
+    ->ArgPair(16 * 1024 * 1024, 1)
+    ->ArgPair(16 * 1024 * 1024, 10)
+    ->ArgPair(16 * 1024 * 1024, 100);
+
 BENCHMARK(BM_Unique_STRING)
     ->Arg(32)
     ->Arg(256)
@@ -1367,6 +1367,47 @@ REGISTER_OP("SparseSegmentSqrtNGrad")
     .Attr("Tidx: {int32, int64} = DT_INT32")
     .SetShapeFn(SparseSegmentReductionGradShapeFn);
 
+// Computes SparseSegment{Sum,Mean,SqrtN}(params, ids, segment_ids), with each
+// row of `params` optionally scaled by its weight, without materializing the
+// gathered rows. Mean and SqrtN divide by the sum of the weights and the
+// square root of the sum of the squared weights respectively.
+REGISTER_OP("_FusedSparseEmbeddingLookupCombine")
+    .Input("params: T")
+    .Input("ids: Tidx")
+    .Input("segment_ids: int32")
+    .Input("weights: num_weights * T")
+    .Output("output: T")
+    .Attr("T: {float, double}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("num_weights: int >= 0 = 0")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'sum'")
+    .SetShapeFn(SparseSegmentReductionShapeFn)
+    .Doc(R"doc(
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
+// Gradient of _FusedSparseEmbeddingLookupCombine with respect to the gathered
+// rows: output[indices[i]] += weights[i] * scale(s) * grad[s] for
+// s = segment_ids[i]. Segment ids need not be sorted, and entries with negative
+// indices are dropped as in UnsortedSegmentSum.
+REGISTER_OP("_FusedSparseEmbeddingLookupCombineGrad")
+    .Input("grad: T")
+    .Input("indices: Tidx")
+    .Input("segment_ids: int32")
+    .Input("output_dim0: int32")
+    .Input("weights: num_weights * T")
+    .Output("output: T")
+    .Attr("T: {float, double}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("num_weights: int >= 0 = 0")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'sum'")
+    .SetShapeFn(SparseSegmentReductionGradShapeFn)
+    .Doc(R"doc(
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
 REGISTER_OP("All")
     .Input("input: bool")
     .Input("reduction_indices: Tidx")
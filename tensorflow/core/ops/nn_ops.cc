@@ -1165,6 +1165,55 @@ REGISTER_OP("LogSoftmax")
 
 // --------------------------------------------------------------------------
 
+// Scaled dot-product attention of a batch of queries, keys and values:
+//   output = Softmax(scale * query * key^T + mask) * value
+// where the optional mask is broadcast to the scores without changing their
+// shape. The [..., query_length, key_length] scores are never materialized.
+REGISTER_OP("_FusedMultiHeadAttention")
+    .Input("query: T")
+    .Input("key: T")
+    .Input("value: T")
+    .Input("mask: num_masks * T")
+    .Output("output: T")
+    .Attr("T: {float, double}")
+    .Attr("num_masks: int >= 0 = 0")
+    .Attr("scale: float = 1.0")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle query;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 3, &query));
+      if (!c->RankKnown(query)) return shape_inference::UnknownShape(c);
+      ShapeHandle key;
+      ShapeHandle value;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), c->Rank(query), &key));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), c->Rank(query), &value));
+
+      ShapeHandle batch;
+      ShapeHandle other_batch;
+      TF_RETURN_IF_ERROR(c->Subshape(query, 0, -2, &batch));
+      TF_RETURN_IF_ERROR(c->Subshape(key, 0, -2, &other_batch));
+      TF_RETURN_IF_ERROR(c->Merge(batch, other_batch, &batch));
+      TF_RETURN_IF_ERROR(c->Subshape(value, 0, -2, &other_batch));
+      TF_RETURN_IF_ERROR(c->Merge(batch, other_batch, &batch));
+
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(query, -1), c->Dim(key, -1), &unused));
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(key, -2), c->Dim(value, -2), &unused));
+
+      ShapeHandle output;
+      TF_RETURN_IF_ERROR(c->Concatenate(
+          batch, c->Matrix(c->Dim(query, -2), c->Dim(value, -1)), &output));
+      c->set_output(0, output);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
+// --------------------------------------------------------------------------
+
 REGISTER_OP("SoftmaxCrossEntropyWithLogits")
     .Input("features: T")
     .Input("labels: T")
@@ -398,6 +398,26 @@ TEST(NNOpsTest, MergeBothInputs_ShapeFn) {
   }
 }
 
+TEST(NNOpsTest, FusedMultiHeadAttention_ShapeFn) {
+  ShapeInferenceTestOp op("_FusedMultiHeadAttention");
+
+  INFER_OK(op, "?;?;?", "?");
+  INFER_OK(op, "[2,5,7];[2,11,7];[2,11,13]", "[d0_0|d1_0|d2_0,d0_1,d2_2]");
+  INFER_OK(op, "[2,3,5,7];[?,3,11,7];[2,?,11,13]",
+           "[d0_0|d2_0,d0_1|d1_1,d0_2,d2_3]");
+
+  INFER_ERROR("Shape must be at least rank 3 but is rank 2", op, "[2,5];?;?");
+  INFER_ERROR("Shape must be rank 3 but is rank 2", op, "[2,5,7];[2,11];?");
+  INFER_ERROR("Shape must be rank 3 but is rank 4", op,
+              "[2,5,7];?;[1,2,11,13]");
+  INFER_ERROR("Dimension 0 in both shapes must be equal, but are 2 and 3", op,
+              "[2,5,7];[3,11,7];?");
+  INFER_ERROR("Dimensions must be equal, but are 7 and 8", op,
+              "[2,5,7];[2,11,8];?");
+  INFER_ERROR("Dimensions must be equal, but are 11 and 12", op,
+              "[2,5,7];[2,11,7];[2,12,13]");
+}
+
 TEST(NNOpsTest, SoftmaxCrossEntropyWithLogits_ShapeFn) {
   ShapeInferenceTestOp op("SoftmaxCrossEntropyWithLogits");
 
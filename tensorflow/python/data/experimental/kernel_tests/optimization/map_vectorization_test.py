@@ -37,9 +37,11 @@ from tensorflow.python.ops import bitwise_ops
 from tensorflow.python.ops import check_ops
 from tensorflow.python.ops import clip_ops
 from tensorflow.python.ops import control_flow_ops
+from tensorflow.python.ops import gen_image_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import nn
 from tensorflow.python.ops import parsing_ops
+from tensorflow.python.ops import string_ops
 from tensorflow.python.platform import test
 
 
@@ -298,6 +300,27 @@ def _generate_optimization_test_cases():
       ("Unpack", array_ops.unstack, base_dataset_factory),
       ("UnpackNegativeAxis", lambda x: array_ops.unstack(x, axis=-1),
        base_dataset_factory),
+      ("ExpandDims", lambda x: array_ops.expand_dims(x, -1),
+       base_dataset_factory),
+      ("Squeeze", lambda x: array_ops.squeeze(x[:, None], axis=[1]),
+       base_dataset_factory),
+      ("Slice", lambda x: array_ops.slice(x, [1, 0], [5, 2]),
+       base_dataset_factory),
+      ("StridedSlice", lambda x: x[1:8:2, 1], base_dataset_factory),
+      ("GatherParams", lambda x: array_ops.gather(x, [2, 0, 1], axis=1),
+       base_dataset_factory),
+      ("GatherIndices", lambda x: array_ops.gather(
+          constant_op.constant([1., 2., 3.]), math_ops.cast(x * 2,
+                                                            dtypes.int32)),
+       base_dataset_factory),
+      ("ResizeBilinear", lambda x: gen_image_ops.resize_bilinear(
+          array_ops.reshape(x, (1, 10, 3, 1)), (20, 6)), base_dataset_factory),
+      ("StringToNumber",
+       lambda x: string_ops.string_to_number(string_ops.as_string(x)),
+       base_dataset_factory),
+      ("DecodeRaw", lambda x: parsing_ops.decode_raw(x, dtypes.uint8),
+       lambda: dataset_ops.Dataset.from_tensor_slices(["abcd", "efgh"]).repeat(
+           5)),
       # Parsing ops
       ("DecodeCSV", csv_test_case[0], csv_test_case[1]),
       ("ParseSingleExample", parse_fn, parse_base),
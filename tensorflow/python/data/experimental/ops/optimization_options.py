@@ -41,6 +41,13 @@ class MapVectorizationOptions(options.OptionsBase):
       "original segment at runtime based on their iterations speed. If None, "
       "defaults to False.")
 
+  check_profitability = options.create_option(
+      name="check_profitability",
+      ty=bool,
+      docstring="Whether to skip the vectorization of map functions most of "
+      "whose ops can't be vectorized. Only used if `use_choose_fastest` is not "
+      "True. If None, defaults to False.")
+
   def _static_optimizations(self):
     if self.enabled:
       return ["map_vectorization"]
@@ -48,9 +55,12 @@ class MapVectorizationOptions(options.OptionsBase):
 
   def _static_optimization_configs(self):
     if self.use_choose_fastest:
-      return ["map_vectorization:use_choose_fastest:true"]
+      configs = ["map_vectorization:use_choose_fastest:true"]
     else:
-      return ["map_vectorization:use_choose_fastest:false"]
+      configs = ["map_vectorization:use_choose_fastest:false"]
+    if self.check_profitability:
+      configs.append("map_vectorization:check_profitability:true")
+    return configs
 
 
 @tf_export("data.experimental.OptimizationOptions")
@@ -94,6 +94,8 @@ class BatchMatmulOpTest(test.TestCase):
     CompareNonEmpty(self, [7, 2, 3], [7, 3, 1])
     CompareNonEmpty(self, [7, 2, 3], [7, 3, 5])
     CompareNonEmpty(self, [10, 64, 75], [10, 75, 30])
+    CompareNonEmpty(self, [16, 64, 64], [16, 64, 64])
+    CompareNonEmpty(self, [6, 13, 37], [6, 37, 29])
     CompareNonEmpty(self, [5, 7, 2, 3], [5, 7, 3, 5])
 
   def _testBroadcasting(self, dtype, adjoint_a, adjoint_b, use_static_shape):
@@ -462,6 +462,26 @@ class UnsortedSegmentTest(SegmentReductionHelper):
         self.assertAllClose(np_ans, tf_ans)
         self.assertShapeEqual(np_ans, s)
 
+  def testSkewedSegments(self):
+    # Large enough to be reduced in parallel, with one segment holding half of
+    # the rows. Every segment gets some rows.
+    num_rows, num_segments = 40000, 1000
+    np.random.seed(0)
+    np_x = np.random.rand(num_rows, 4)
+    indices = np.random.randint(-1, num_segments, num_rows)
+    indices[::2] = 7
+    for np_op, tf_op, initial_value in [
+        (np.add, math_ops.unsorted_segment_sum, 0),
+        (np.maximum, math_ops.unsorted_segment_max, -np.inf),
+        (np.minimum, math_ops.unsorted_segment_min, np.inf)]:
+      np_ans = np.full((num_segments, 4), initial_value)
+      valid = indices >= 0
+      np_op.at(np_ans, indices[valid], np_x[valid])
+      with self.cached_session(use_gpu=False):
+        tf_ans = self.evaluate(
+            tf_op(np_x, segment_ids=indices, num_segments=num_segments))
+      self.assertAllClose(np_ans, tf_ans)
+
 
 class SparseSegmentReductionHelper(SegmentReductionHelper):
 
@@ -605,6 +625,29 @@ class SparseSegmentReductionOpTest(SparseSegmentReductionHelper):
         s = tf_op(data=tf_x, indices=tf_indices, segment_ids=segment_indices)
         self.evaluate(s)
 
+  def testSkewedSegments(self):
+    # Large enough to be reduced in parallel, with one segment holding most of
+    # the indices, and empty segments.
+    np.random.seed(0)
+    np_x = np.random.rand(1000, 8)
+    segment_indices = np.sort(np.concatenate([
+        np.random.randint(0, 500, 5000),
+        np.full(15000, 300)])).astype(np.int32)
+    indices = np.random.randint(0, 1000, segment_indices.size)
+    num_segments = segment_indices[-1] + 1
+    counts = np.bincount(segment_indices, minlength=num_segments)[:, None]
+    np_sum = np.zeros((num_segments, 8))
+    np.add.at(np_sum, segment_indices, np_x[indices])
+    with self.cached_session(use_gpu=False):
+      for tf_op, np_ans in [
+          (math_ops.sparse_segment_sum, np_sum),
+          (math_ops.sparse_segment_mean, np_sum / np.maximum(counts, 1)),
+          (math_ops.sparse_segment_sqrt_n,
+           np_sum / np.sqrt(np.maximum(counts, 1)))]:
+        tf_ans = self.evaluate(
+            tf_op(data=np_x, indices=indices, segment_ids=segment_indices))
+        self.assertAllClose(np_ans, tf_ans)
+
   @test_util.run_deprecated_v1
   def testIndicesInvalid1(self):
     tf_x, _ = self._input([10, 4], dtype=dtypes_lib.float32)